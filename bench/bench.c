@@ -0,0 +1,354 @@
+/**
+ * bench.c - Headless benchmarks of the hex pipeline.
+ * Copyright (C) 2022 Trevor Last
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#define _GNU_SOURCE
+
+#include "version.h"
+#include "engine/Buffer.h"
+#include "engine/HexFormat.h"
+
+#include <gio/gio.h>
+#include <glib/gstdio.h>
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <time.h>
+#include <unistd.h>
+
+
+/** Bytes formatted per throughput measurement. */
+#define FORMAT_BYTES (64 * 1024 * 1024)
+/** Rows drawn per simulated frame, a tall window's worth. */
+#define FRAME_ROWS 80
+/** Frames drawn per file. */
+#define FRAMES 2000
+/** Scattered single-byte inserts made before the second round of frames. */
+#define EDITS 10000
+/** Files up to this size are filled with data; larger ones are left sparse. */
+#define DENSE_LIMIT (G_GUINT64_CONSTANT(256) * 1024 * 1024)
+/** Block size for filling synthetic files. */
+#define FILL_BLOCK (1024 * 1024)
+/** --smoke divides the work above by this, and defaults to these sizes. */
+#define SMOKE_DIVISOR 64
+#define SMOKE_SIZES "1M"
+
+static char *sizes_option = NULL;
+static char *directory_option = NULL;
+static gboolean smoke_option = FALSE;
+
+/** Work done per measurement; smaller under --smoke. */
+static gsize format_bytes = FORMAT_BYTES;
+static guint frames = FRAMES;
+static guint edits = EDITS;
+
+static GOptionEntry const options[] = {
+    {"sizes", 's', 0, G_OPTION_ARG_STRING, &sizes_option, "Comma-separated synthetic file sizes, with K/M/G suffixes (default 1M,64M,1G,8G)", "LIST"},
+    {"dir", 'd', 0, G_OPTION_ARG_FILENAME, &directory_option, "Directory to create synthetic files in (default: the temporary directory)", "DIR"},
+    {"smoke", 0, 0, G_OPTION_ARG_NONE, &smoke_option, "Run briefly over small inputs, to check the benchmarks still work (default sizes " SMOKE_SIZES ")", NULL},
+    {NULL}
+};
+
+/** Layouts measured for formatting throughput. */
+static guint const layouts[][2] = {
+    {8, 4}, {16, 8}, {16, 1}, {32, 8}, {64, 16},
+};
+
+
+/* ===[ Helpers ]=== */
+/** Monotonic clock in nanoseconds; g_get_monotonic_time is too coarse for frames. */
+static gint64 now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (gint64)ts.tv_sec * G_GINT64_CONSTANT(1000000000) + ts.tv_nsec;
+}
+
+/** Peak resident set size so far, in KiB. */
+static long peak_rss_kib(void)
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+static guint32 xorshift(guint32 *state)
+{
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return *state;
+}
+
+static guint64 random_below(guint32 *state, guint64 bound)
+{
+    guint64 r = (guint64)xorshift(state) << 32 | xorshift(state);
+    return bound ? r % bound : 0;
+}
+
+static int compare_gint64(void const *a, void const *b)
+{
+    gint64 x = *(gint64 const *)a, y = *(gint64 const *)b;
+    return (x > y) - (x < y);
+}
+
+/** Parse a size such as "64M". Returns 0 if it isn't one. */
+static guint64 parse_size(char const *text)
+{
+    char *end;
+    guint64 value = g_ascii_strtoull(text, &end, 10);
+    switch (g_ascii_toupper(*end))
+    {
+    case 'G':
+        value <<= 10;
+        /* fallthrough */
+    case 'M':
+        value <<= 10;
+        /* fallthrough */
+    case 'K':
+        value <<= 10;
+        ++end;
+        break;
+    }
+    return end == text || *end != '\0' ? 0 : value;
+}
+
+/**
+ * Create a file of `size` bytes in `directory` and return its path.
+ * The first DENSE_LIMIT bytes are pseudo-random; past that the file is a
+ * hole, so multi-gigabyte sizes don't need the disk space.
+ */
+static char *make_file(char const *directory, guint64 size, GError **error)
+{
+    char *path = g_build_filename(directory, "ghexedit-bench-XXXXXX", NULL);
+    int fd = g_mkstemp(path);
+    if (fd < 0)
+    {
+        int saved = errno;
+        g_set_error(error, G_IO_ERROR, g_io_error_from_errno(saved), "%s: %s", path, g_strerror(saved));
+        g_free(path);
+        return NULL;
+    }
+
+    gboolean ok = ftruncate(fd, size) == 0;
+    guint8 *block = g_malloc(FILL_BLOCK);
+    guint32 state = 2463534242u;
+    for (guint64 done = 0; ok && done < MIN(size, DENSE_LIMIT);)
+    {
+        gsize length = MIN(FILL_BLOCK, size - done);
+        for (gsize i = 0; i < length; i += 4)
+        {
+            guint32 r = xorshift(&state);
+            memcpy(block + i, &r, MIN(4, length - i));
+        }
+        ok = pwrite(fd, block, length, done) == (ssize_t)length;
+        done += length;
+    }
+    g_free(block);
+
+    int saved = errno;
+    g_close(fd, NULL);
+    if (!ok)
+    {
+        g_set_error(error, G_IO_ERROR, g_io_error_from_errno(saved), "%s: %s", path, g_strerror(saved));
+        g_unlink(path);
+        g_free(path);
+        return NULL;
+    }
+    return path;
+}
+
+
+/* ===[ Benchmarks ]=== */
+/** Formatting throughput of every supported kernel over several layouts. */
+static void bench_format(GString *json)
+{
+    guint8 *data = g_malloc(format_bytes);
+    guint32 state = 88675123u;
+    for (gsize i = 0; i < format_bytes; ++i)
+        data[i] = xorshift(&state);
+
+    g_string_append(json, "  \"format\": [");
+    gboolean first = TRUE;
+    for (guint l = 0; l < G_N_ELEMENTS(layouts); ++l)
+    {
+        GHexEditHexFormat format = {
+            .bytes_per_line = layouts[l][0],
+            .grouping = layouts[l][1],
+            .offset_digits = ghexedit_hex_format_offset_digits(format_bytes),
+        };
+        char *out = g_malloc(ghexedit_hex_format_max_length(&format, format_bytes));
+        for (GHexEditHexKernel kernel = 0; kernel < GHEXEDIT_N_HEX_KERNELS; ++kernel)
+        {
+            if (!ghexedit_hex_kernel_is_supported(kernel))
+                continue;
+            // Once to fault the output in, once timed
+            ghexedit_hex_format_with(kernel, &format, data, format_bytes, 0, out);
+            gint64 start = now_ns();
+            ghexedit_hex_format_with(kernel, &format, data, format_bytes, 0, out);
+            double seconds = (now_ns() - start) / 1e9;
+            g_string_append_printf(json, "%s\n    {\"kernel\": \"%s\", \"bytes_per_line\": %u, \"grouping\": %u, \"mb_per_s\": %.1f}",
+                first ? "" : ",", ghexedit_hex_kernel_get_name(kernel), format.bytes_per_line, format.grouping, format_bytes / seconds / 1e6);
+            first = FALSE;
+        }
+        g_free(out);
+    }
+    g_string_append(json, "\n  ],\n");
+    g_free(data);
+}
+
+/**
+ * Draw `frames` frames at random rows, the way HexView's snapshot does: read a
+ * screenful through the buffer and format it. Fills `mean` and `p99` in µs.
+ */
+static void draw_frames(GHexEditBuffer *buffer, double *mean, double *p99)
+{
+    GHexEditHexFormat format = {
+        .bytes_per_line = 16,
+        .grouping = 8,
+        .offset_digits = ghexedit_hex_format_offset_digits(ghexedit_buffer_get_size(buffer)),
+    };
+    gsize screen = FRAME_ROWS * format.bytes_per_line;
+    guint8 *data = g_malloc(screen);
+    char *out = g_malloc(ghexedit_hex_format_max_length(&format, screen));
+    gint64 *times = g_new(gint64, frames);
+    guint64 rows = ghexedit_buffer_get_size(buffer) / format.bytes_per_line + 1;
+    guint32 state = 521288629u;
+    gint64 total = 0;
+
+    for (guint f = 0; f < frames; ++f)
+    {
+        guint64 offset = random_below(&state, rows) * format.bytes_per_line;
+        gint64 start = now_ns();
+        gssize got = ghexedit_buffer_read(buffer, offset, data, screen, NULL);
+        if (got > 0)
+            ghexedit_hex_format(&format, data, got, offset, out);
+        times[f] = now_ns() - start;
+        total += times[f];
+    }
+    qsort(times, frames, sizeof *times, compare_gint64);
+    *mean = total / 1e3 / frames;
+    *p99 = times[frames * 99 / 100] / 1e3;
+
+    g_free(times);
+    g_free(out);
+    g_free(data);
+}
+
+/** Open latency and frame cost for one synthetic file. */
+static gboolean bench_file(GString *json, char const *directory, guint64 size, gboolean first, GError **error)
+{
+    g_printerr("Creating a %" G_GUINT64_FORMAT " byte file...\n", size);
+    char *path = make_file(directory, size, error);
+    if (path == NULL)
+        return FALSE;
+    GFile *file = g_file_new_for_path(path);
+
+    gint64 start = now_ns();
+    GHexEditDocument *document = ghexedit_document_new(file, error);
+    gint64 opened = now_ns();
+    GHexEditBuffer *buffer = document ? ghexedit_buffer_new(document) : NULL;
+    if (buffer)
+    {
+        // First screenful, as shown right after opening
+        guint8 screen[FRAME_ROWS * 16];
+        ghexedit_buffer_read(buffer, 0, screen, sizeof screen, NULL);
+        gint64 shown = now_ns();
+
+        double mean, p99, edited_mean, edited_p99;
+        draw_frames(buffer, &mean, &p99);
+        // Fragment the piece table, then draw again
+        guint32 state = 362436069u;
+        for (guint e = 0; e < edits; ++e)
+        {
+            guint8 byte = xorshift(&state);
+            ghexedit_buffer_insert(buffer, random_below(&state, ghexedit_buffer_get_size(buffer) + 1), &byte, 1);
+        }
+        draw_frames(buffer, &edited_mean, &edited_p99);
+
+        g_string_append_printf(json, "%s\n    {\"size\": %" G_GUINT64_FORMAT ", \"sparse\": %s, \"open_us\": %.1f, \"first_screen_us\": %.1f, "
+            "\"frame_us_mean\": %.2f, \"frame_us_p99\": %.2f, \"edited_frame_us_mean\": %.2f, \"edited_frame_us_p99\": %.2f, \"peak_rss_kib\": %ld}",
+            first ? "" : ",", size, size > DENSE_LIMIT ? "true" : "false", (opened - start) / 1e3, (shown - start) / 1e3,
+            mean, p99, edited_mean, edited_p99, peak_rss_kib());
+        g_object_unref(buffer);
+    }
+    gboolean ok = document != NULL;
+    g_clear_object(&document);
+
+    g_object_unref(file);
+    g_unlink(path);
+    g_free(path);
+    return ok;
+}
+
+
+/* ===[ Main ]=== */
+int main(int argc, char *argv[])
+{
+    GError *error = NULL;
+    GOptionContext *context = g_option_context_new("- benchmark the GHexEdit engine");
+    g_option_context_set_summary(context, "Prints results as JSON on standard output.");
+    g_option_context_add_main_entries(context, options, NULL);
+    if (!g_option_context_parse(context, &argc, &argv, &error))
+    {
+        g_printerr("%s\n", error->message);
+        return EXIT_FAILURE;
+    }
+    g_option_context_free(context);
+
+    if (smoke_option)
+    {
+        format_bytes /= SMOKE_DIVISOR;
+        frames /= SMOKE_DIVISOR;
+        edits /= SMOKE_DIVISOR;
+    }
+    char const *default_sizes = smoke_option ? SMOKE_SIZES : "1M,64M,1G,8G";
+    char **sizes = g_strsplit(sizes_option ? sizes_option : default_sizes, ",", -1);
+    char const *directory = directory_option ? directory_option : g_get_tmp_dir();
+
+    GString *json = g_string_new("{\n");
+    g_string_append_printf(json, "  \"version\": \"%s\",\n", GHX_VERSION);
+    g_string_append_printf(json, "  \"default_kernel\": \"%s\",\n", ghexedit_hex_kernel_get_name(ghexedit_hex_kernel_get_default()));
+    bench_format(json);
+
+    g_string_append(json, "  \"files\": [");
+    int status = EXIT_SUCCESS;
+    for (guint i = 0; sizes[i] && status == EXIT_SUCCESS; ++i)
+    {
+        guint64 size = parse_size(sizes[i]);
+        if (size == 0)
+        {
+            g_printerr("Invalid size: %s\n", sizes[i]);
+            status = EXIT_FAILURE;
+        }
+        else if (!bench_file(json, directory, size, i == 0, &error))
+        {
+            g_printerr("%s\n", error->message);
+            g_clear_error(&error);
+            status = EXIT_FAILURE;
+        }
+    }
+    g_string_append_printf(json, "\n  ],\n  \"peak_rss_kib\": %ld\n}\n", peak_rss_kib());
+
+    if (status == EXIT_SUCCESS)
+        fputs(json->str, stdout);
+    g_string_free(json, TRUE);
+    g_strfreev(sizes);
+    return status;
+}
@@ -19,32 +19,66 @@
 #include "App.h"
 #include "AppPrefs.h"
 #include "AppWin.h"
+#include "engine/Batch.h"
+#include "engine/Export.h"
+#include "engine/PageCache.h"
 
 #include "appid.h"
 
+#include <gio/gunixinputstream.h>
+#include <gio/gunixoutputstream.h>
 #include <gtk/gtk.h>
+#include <unistd.h>
 
 
 struct _GHexEditApp
 {
     GtkApplication parent;
+    GSettings *settings;
+    /** Files named on the command line, for the first window to open. */
+    GPtrArray *startup_files;
 };
 
 G_DEFINE_TYPE(GHexEditApp, ghexedit_app, GTK_TYPE_APPLICATION);
 
 
-/** File>Open callback. */
-void file_picked(GtkNativeDialog *native, int response, gpointer app)
+/** File>Open callback. Cancelling the dialog picks no file. */
+void file_picked(GObject *source, GAsyncResult *result, gpointer app)
 {
-    if (response == GTK_RESPONSE_ACCEPT)
+    GFile *file = gtk_file_dialog_open_finish(GTK_FILE_DIALOG(source), result, NULL);
+    if (file)
     {
         GtkWindow *win = gtk_application_get_active_window(GTK_APPLICATION(app));
-        GtkFileChooser *chooser = GTK_FILE_CHOOSER(native);
-        GFile *file = gtk_file_chooser_get_file(chooser);
         ghexedit_app_window_open(GHEXEDIT_APP_WINDOW(win), file);
         g_object_unref(file);
     }
-    g_object_unref(native);
+}
+
+
+/** File>Save As callback. */
+void save_picked(GObject *source, GAsyncResult *result, gpointer app)
+{
+    GFile *file = gtk_file_dialog_save_finish(GTK_FILE_DIALOG(source), result, NULL);
+    if (file)
+    {
+        GtkWindow *win = gtk_application_get_active_window(GTK_APPLICATION(app));
+        ghexedit_app_window_save(GHEXEDIT_APP_WINDOW(win), file);
+        g_object_unref(file);
+    }
+}
+
+
+/** Edit>Export Selection callback; the dialog carries the format chosen from the menu. */
+void export_picked(GObject *source, GAsyncResult *result, gpointer app)
+{
+    GFile *file = gtk_file_dialog_save_finish(GTK_FILE_DIALOG(source), result, NULL);
+    if (file)
+    {
+        GtkWindow *win = gtk_application_get_active_window(GTK_APPLICATION(app));
+        GHexEditExportFormat format = GPOINTER_TO_UINT(g_object_get_data(source, "format"));
+        ghexedit_app_window_export_selection(GHEXEDIT_APP_WINDOW(win), file, format);
+        g_object_unref(file);
+    }
 }
 
 
@@ -53,9 +87,28 @@ void file_picked(GtkNativeDialog *native, int response, gpointer app)
 void open_activated(GSimpleAction *action, GVariant *parameter, gpointer app)
 {
     GtkWindow *win = gtk_application_get_active_window(GTK_APPLICATION(app));
-    GtkFileChooserNative *chooser = gtk_file_chooser_native_new("Open", win, GTK_FILE_CHOOSER_ACTION_OPEN, "Open", "Cancel");
-    g_signal_connect(chooser, "response", G_CALLBACK(file_picked), app);
-    gtk_native_dialog_show(GTK_NATIVE_DIALOG(chooser));
+    GtkFileDialog *dialog = gtk_file_dialog_new();
+    gtk_file_dialog_set_title(dialog, "Open");
+    gtk_file_dialog_open(dialog, win, NULL, file_picked, app);
+    g_object_unref(dialog);
+}
+
+/** Save a file. */
+void save_activated(GSimpleAction *action, GVariant *parameter, gpointer app)
+{
+    GtkWindow *win = gtk_application_get_active_window(GTK_APPLICATION(app));
+    ghexedit_app_window_save(GHEXEDIT_APP_WINDOW(win), NULL);
+}
+
+/** Save a file under a new name. */
+void save_as_activated(GSimpleAction *action, GVariant *parameter, gpointer app)
+{
+    GtkWindow *win = gtk_application_get_active_window(GTK_APPLICATION(app));
+    GtkFileDialog *dialog = gtk_file_dialog_new();
+    gtk_file_dialog_set_title(dialog, "Save As");
+    gtk_file_dialog_set_accept_label(dialog, "Save");
+    gtk_file_dialog_save(dialog, win, NULL, save_picked, app);
+    g_object_unref(dialog);
 }
 
 /** Close a file. */
@@ -65,10 +118,72 @@ void close_activated(GSimpleAction *action, GVariant *parameter, gpointer app)
     ghexedit_app_window_close_current(GHEXEDIT_APP_WINDOW(win));
 }
 
-/** Quit the App. */
+/**
+ * Quit the App. The windows are closed rather than the App stopped outright,
+ * so each asks about its unsaved edits and saves its pages' sessions; it
+ * exits once the last is gone and they are written.
+ */
 void quit_activated(GSimpleAction *action, GVariant *parameter, gpointer app)
 {
-    g_application_quit(G_APPLICATION(app));
+    // Closing windows leave the list
+    GList *windows = g_list_copy(gtk_application_get_windows(GTK_APPLICATION(app)));
+    for (GList *w = windows; w; w = w->next)
+        gtk_window_close(GTK_WINDOW(w->data));
+    g_list_free(windows);
+}
+
+/** Undo the last edit in the current file. */
+void undo_activated(GSimpleAction *action, GVariant *parameter, gpointer app)
+{
+    GtkWindow *win = gtk_application_get_active_window(GTK_APPLICATION(app));
+    ghexedit_app_window_undo(GHEXEDIT_APP_WINDOW(win));
+}
+
+/** Redo the last undone edit in the current file. */
+void redo_activated(GSimpleAction *action, GVariant *parameter, gpointer app)
+{
+    GtkWindow *win = gtk_application_get_active_window(GTK_APPLICATION(app));
+    ghexedit_app_window_redo(GHEXEDIT_APP_WINDOW(win));
+}
+
+/** Copy the selection, encoded as the format named by the parameter. */
+void copy_activated(GSimpleAction *action, GVariant *parameter, gpointer app)
+{
+    GtkWindow *win = gtk_application_get_active_window(GTK_APPLICATION(app));
+    GHexEditExportFormat format;
+    if (ghexedit_export_format_from_id(g_variant_get_string(parameter, NULL), &format))
+        ghexedit_app_window_copy(GHEXEDIT_APP_WINDOW(win), format);
+}
+
+/** Paste at the cursor. */
+void paste_activated(GSimpleAction *action, GVariant *parameter, gpointer app)
+{
+    GtkWindow *win = gtk_application_get_active_window(GTK_APPLICATION(app));
+    ghexedit_app_window_paste(GHEXEDIT_APP_WINDOW(win));
+}
+
+/** Write the selection to a file, encoded as the format named by the parameter. */
+void export_activated(GSimpleAction *action, GVariant *parameter, gpointer app)
+{
+    GHexEditExportFormat format;
+    if (!ghexedit_export_format_from_id(g_variant_get_string(parameter, NULL), &format))
+        return;
+    GtkWindow *win = gtk_application_get_active_window(GTK_APPLICATION(app));
+    GtkFileDialog *dialog = gtk_file_dialog_new();
+    char *title = g_strdup_printf("Export Selection as %s", ghexedit_export_format_get_name(format));
+    gtk_file_dialog_set_title(dialog, title);
+    gtk_file_dialog_set_accept_label(dialog, "Export");
+    g_object_set_data(G_OBJECT(dialog), "format", GUINT_TO_POINTER(format));
+    gtk_file_dialog_save(dialog, win, NULL, export_picked, app);
+    g_object_unref(dialog);
+    g_free(title);
+}
+
+/** Show the find bar in the active window. */
+void find_activated(GSimpleAction *action, GVariant *parameter, gpointer app)
+{
+    GtkWindow *win = gtk_application_get_active_window(GTK_APPLICATION(app));
+    ghexedit_app_window_find(GHEXEDIT_APP_WINDOW(win));
 }
 
 /** Display Preferences window. */
@@ -79,16 +194,220 @@ void preferences_activated(GSimpleAction *action, GVariant *parameter, gpointer
     gtk_window_present(GTK_WINDOW(prefs));
 }
 
+/** app.perf-overlay change-state callback: show or hide the figures in every window. */
+void perf_overlay_changed(GSimpleAction *action, GVariant *state, gpointer app)
+{
+    for (GList *windows = gtk_application_get_windows(GTK_APPLICATION(app)); windows; windows = windows->next)
+        if (GHEXEDIT_IS_APP_WINDOW(windows->data))
+            ghexedit_app_window_set_perf_overlay(GHEXEDIT_APP_WINDOW(windows->data), g_variant_get_boolean(state));
+    g_simple_action_set_state(action, state);
+}
+
 /** `app.XXX` action definitions for GActionMap. */
 static GActionEntry const app_entries[] = {
     // File menu
     {"open", open_activated, NULL, NULL, NULL},
+    {"save", save_activated, NULL, NULL, NULL},
+    {"save-as", save_as_activated, NULL, NULL, NULL},
     {"close", close_activated, NULL, NULL, NULL},
     {"quit", quit_activated, NULL, NULL, NULL},
     // Edit menu
+    {"undo", undo_activated, NULL, NULL, NULL},
+    {"redo", redo_activated, NULL, NULL, NULL},
+    {"copy", copy_activated, "s", NULL, NULL},
+    {"paste", paste_activated, NULL, NULL, NULL},
+    {"export-selection", export_activated, "s", NULL, NULL},
+    {"find", find_activated, NULL, NULL, NULL},
     {"preferences", preferences_activated, NULL, NULL, NULL},
+    // View menu
+    {"perf-overlay", NULL, NULL, "false", perf_overlay_changed},
+};
+
+
+/** Settings::changed::cache-memory callback. */
+static void cache_memory_changed(GSettings *settings, char const *key, gpointer app)
+{
+    ghexedit_page_cache_set_budget(ghexedit_page_cache_get_default(), g_settings_get_uint64(settings, key));
+}
+
+
+/* ===[ Batch mode ]=== */
+/** Options that run one operation without a display, then exit. */
+static GOptionEntry const batch_options[] = {
+    {"dump", 'd', 0, G_OPTION_ARG_NONE, NULL, "Print FILE as hex rows", NULL},
+    {"search", 's', 0, G_OPTION_ARG_STRING, NULL, "Print the offset and length of each match of hex bytes (?? for any byte)", "HEX"},
+    {"search-text", 0, 0, G_OPTION_ARG_STRING, NULL, "Search for UTF-8 text", "TEXT"},
+    {"search-regex", 0, 0, G_OPTION_ARG_STRING, NULL, "Search for a regular expression", "REGEX"},
+    {"checksum", 'c', 0, G_OPTION_ARG_STRING, NULL, "Print checksums: crc32, adler32, sha256, blake3, comma-separated, or all", "LIST"},
+    {"patch", 'p', 0, G_OPTION_ARG_FILENAME, NULL, "Apply a patch script and write the whole result", "SCRIPT"},
+    {"offset", 0, 0, G_OPTION_ARG_INT64, NULL, "Start dumping, searching or checksumming here", "OFFSET"},
+    {"length", 'n', 0, G_OPTION_ARG_INT64, NULL, "Stop after this many bytes", "LENGTH"},
+    {"bytes-per-line", 0, 0, G_OPTION_ARG_INT, NULL, "Bytes per dumped row (default 16)", "N"},
+    {"grouping", 0, 0, G_OPTION_ARG_INT, NULL, "Bytes per dumped group (default 8)", "N"},
+    {"output", 'o', 0, G_OPTION_ARG_FILENAME, NULL, "Write to FILE instead of standard output", "FILE"},
+    {G_OPTION_REMAINING, 0, 0, G_OPTION_ARG_FILENAME_ARRAY, NULL, NULL, "[FILE…]"},
+    {NULL}
 };
 
+/** Read `path`, or standard input for "-". */
+static GInputStream *open_input(char const *path, GError **error)
+{
+    if (g_strcmp0(path, "-") == 0)
+        return g_unix_input_stream_new(STDIN_FILENO, FALSE);
+    GFile *file = g_file_new_for_commandline_arg(path);
+    GFileInputStream *stream = g_file_read(file, NULL, error);
+    g_object_unref(file);
+    return stream ? G_INPUT_STREAM(stream) : NULL;
+}
+
+/** Write `path`, replacing it once closed, or standard output for NULL or "-". */
+static GOutputStream *open_output(char const *path, GError **error)
+{
+    if (path == NULL || g_strcmp0(path, "-") == 0)
+        return g_unix_output_stream_new(STDOUT_FILENO, FALSE);
+    GFile *file = g_file_new_for_commandline_arg(path);
+    GFileOutputStream *stream = g_file_replace(file, NULL, FALSE, G_FILE_CREATE_NONE, NULL, error);
+    g_object_unref(file);
+    return stream ? G_OUTPUT_STREAM(stream) : NULL;
+}
+
+/**
+ * Offset digits for dumping `length` bytes of `input` from `offset`: enough
+ * for the last offset dumped, or for any offset if that can't be told (a
+ * pipe with no --length), so rows past 4 GiB never wrap.
+ */
+static guint dump_offset_digits(GInputStream *input, guint64 offset, guint64 length)
+{
+    guint64 end = G_MAXUINT64;
+    if (length != GHEXEDIT_BATCH_TO_END)
+        end = offset + MIN(length, G_MAXUINT64 - offset);
+    else if (G_IS_SEEKABLE(input) && g_seekable_can_seek(G_SEEKABLE(input)))
+    {
+        GSeekable *seekable = G_SEEKABLE(input);
+        goffset here = g_seekable_tell(seekable);
+        if (g_seekable_seek(seekable, 0, G_SEEK_END, NULL, NULL))
+        {
+            end = MAX((guint64)g_seekable_tell(seekable), offset);
+            g_seekable_seek(seekable, here, G_SEEK_SET, NULL, NULL);
+        }
+    }
+    return ghexedit_hex_format_offset_digits(end);
+}
+
+/**
+ * Open `path` as a document, apply `script` to it, and write the result.
+ * Standard input is spooled first, as the editor would, since edits need
+ * random access.
+ */
+static gboolean patch_document(char const *path, char const *script_path, GOutputStream *output, GError **error)
+{
+    char *script = NULL;
+    if (!g_file_get_contents(script_path, &script, NULL, error))
+        return FALSE;
+    GFile *file = g_strcmp0(path, "-") == 0 ? g_file_new_for_path("/dev/stdin") : g_file_new_for_commandline_arg(path);
+    GHexEditDocument *document = ghexedit_document_new(file, error);
+    g_object_unref(file);
+    gboolean ok = document != NULL;
+    if (ok)
+    {
+        GHexEditBuffer *buffer = ghexedit_buffer_new(document);
+        ok = ghexedit_batch_patch(buffer, script, error);
+        if (ok)
+        {
+            GHexEditSnapshot *snapshot = ghexedit_buffer_snapshot(buffer, 0, ghexedit_buffer_get_size(buffer));
+            ok = ghexedit_export_write(snapshot, GHEXEDIT_EXPORT_RAW, output, NULL, error);
+            ghexedit_snapshot_unref(snapshot);
+        }
+        g_object_unref(buffer);
+        g_object_unref(document);
+    }
+    g_free(script);
+    return ok;
+}
+
+/**
+ * Run the operation in `options` on `path`, writing to --output.
+ * Returns the exit status: for searches, 0 if anything matched and 1 if
+ * not, like grep; otherwise 0. Errors give 2.
+ */
+static int run_batch(GVariantDict *options, char const *path)
+{
+    gboolean dump = FALSE;
+    char const *hex = NULL, *text = NULL, *regex = NULL, *checksums = NULL, *script = NULL, *output_path = NULL;
+    gint64 offset = 0, length = -1;
+    gint bytes_per_line = 16, grouping = 8;
+    g_variant_dict_lookup(options, "dump", "b", &dump);
+    g_variant_dict_lookup(options, "search", "&s", &hex);
+    g_variant_dict_lookup(options, "search-text", "&s", &text);
+    g_variant_dict_lookup(options, "search-regex", "&s", &regex);
+    g_variant_dict_lookup(options, "checksum", "&s", &checksums);
+    g_variant_dict_lookup(options, "patch", "^&ay", &script);
+    g_variant_dict_lookup(options, "offset", "x", &offset);
+    g_variant_dict_lookup(options, "length", "x", &length);
+    g_variant_dict_lookup(options, "bytes-per-line", "i", &bytes_per_line);
+    g_variant_dict_lookup(options, "grouping", "i", &grouping);
+    g_variant_dict_lookup(options, "output", "^&ay", &output_path);
+    guint64 end = length < 0 ? GHEXEDIT_BATCH_TO_END : (guint64)length;
+
+    GError *error = NULL;
+    GHexEditPattern *pattern = NULL;
+    guint kinds = 0;
+    if (offset < 0 || bytes_per_line < 1 || grouping < 1)
+        g_set_error(&error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT, "--offset, --bytes-per-line and --grouping must be positive");
+    else if (hex)
+        pattern = ghexedit_pattern_new_hex(hex, &error);
+    else if (text)
+        pattern = ghexedit_pattern_new_text(text, GHEXEDIT_TEXT_ENCODING_UTF8, TRUE, &error);
+    else if (regex)
+        pattern = ghexedit_pattern_new_regex(regex, TRUE, &error);
+    else if (checksums)
+        ghexedit_batch_parse_checksums(checksums, &kinds, &error);
+
+    GInputStream *input = NULL;
+    GOutputStream *output = error ? NULL : open_output(output_path, &error);
+    if (output && !script)
+        input = open_input(path, &error);
+
+    int status = 0;
+    gboolean ok = error == NULL;
+    if (ok && script)
+        ok = patch_document(path, script, output, &error);
+    else if (ok && pattern)
+    {
+        guint64 n_matches = 0;
+        ok = ghexedit_batch_search(input, offset, end, pattern, output, &n_matches, NULL, &error);
+        status = n_matches ? 0 : 1;
+    }
+    else if (ok && kinds)
+        ok = ghexedit_batch_checksum(input, offset, end, kinds, output, NULL, &error);
+    else if (ok)
+    {
+        GHexEditHexFormat format = {bytes_per_line, grouping, dump_offset_digits(input, offset, end)};
+        ok = ghexedit_batch_dump(input, offset, end, &format, output, NULL, &error);
+    }
+    // Closing a replaced file puts it in place; a cancelled close leaves the old one
+    if (output && ok)
+        ok = g_output_stream_close(output, NULL, &error);
+    else if (output)
+    {
+        GCancellable *abandon = g_cancellable_new();
+        g_cancellable_cancel(abandon);
+        g_output_stream_close(output, abandon, NULL);
+        g_object_unref(abandon);
+    }
+
+    if (!ok)
+    {
+        g_printerr("%s: %s\n", g_get_prgname(), error->message);
+        g_error_free(error);
+        status = 2;
+    }
+    g_clear_object(&input);
+    g_clear_object(&output);
+    g_clear_pointer(&pattern, ghexedit_pattern_free);
+    return status;
+}
+
 
 /* ===[ GtkApplication ]=== */
 /** Called before the App is displayed. */
@@ -97,22 +416,85 @@ void ghexedit_app_startup(GApplication *app)
     GtkBuilder *builder;
     GMenuModel *app_menu;
     char const *open_accels[2] = {"<Ctrl>O", NULL};
+    char const *save_accels[2] = {"<Ctrl>S", NULL};
+    char const *save_as_accels[2] = {"<Ctrl><Shift>S", NULL};
     char const *close_accels[2] = {"<Ctrl>W", NULL};
     char const *quit_accels[2] = {"<Ctrl>Q", NULL};
+    char const *undo_accels[2] = {"<Ctrl>Z", NULL};
+    char const *redo_accels[3] = {"<Ctrl><Shift>Z", "<Ctrl>Y", NULL};
+    char const *find_accels[2] = {"<Ctrl>F", NULL};
+    char const *follow_accels[2] = {"<Ctrl><Shift>T", NULL};
 
     G_APPLICATION_CLASS(ghexedit_app_parent_class)->startup(app);
 
     g_action_map_add_action_entries(G_ACTION_MAP(app), app_entries, G_N_ELEMENTS(app_entries), app);
     gtk_application_set_accels_for_action(GTK_APPLICATION(app), "app.open", open_accels);
+    gtk_application_set_accels_for_action(GTK_APPLICATION(app), "app.save", save_accels);
+    gtk_application_set_accels_for_action(GTK_APPLICATION(app), "app.save-as", save_as_accels);
     gtk_application_set_accels_for_action(GTK_APPLICATION(app), "app.close", close_accels);
     gtk_application_set_accels_for_action(GTK_APPLICATION(app), "app.quit", quit_accels);
+    gtk_application_set_accels_for_action(GTK_APPLICATION(app), "app.undo", undo_accels);
+    gtk_application_set_accels_for_action(GTK_APPLICATION(app), "app.redo", redo_accels);
+    gtk_application_set_accels_for_action(GTK_APPLICATION(app), "app.find", find_accels);
+    gtk_application_set_accels_for_action(GTK_APPLICATION(app), "win.follow", follow_accels);
+
+    // Size the shared page cache, and resize it when the setting changes
+    GHexEditApp *self = GHEXEDIT_APP(app);
+    self->settings = g_settings_new(GHX_APPLICATION_ID);
+    g_signal_connect(self->settings, "changed::cache-memory", G_CALLBACK(cache_memory_changed), app);
+    cache_memory_changed(self->settings, "cache-memory", app);
 }
 
-/** Called when App is started without any files passed. */
-void ghexedit_app_activate(GApplication *app)
+/**
+ * Called before registering, with the command line parsed.
+ * Batch options run here, without a display, and exit; otherwise this
+ * returns -1 to carry on into the editor.
+ */
+int ghexedit_app_handle_local_options(GApplication *app, GVariantDict *options)
 {
-    GHexEditAppWindow *win = ghexedit_app_window_new(GHEXEDIT_APP(app));
-    gtk_window_present(GTK_WINDOW(win));
+    GHexEditApp *self = GHEXEDIT_APP(app);
+    char const **files = NULL;
+    g_variant_dict_lookup(options, G_OPTION_REMAINING, "^a&ay", &files);
+    guint n_files = files ? g_strv_length((char **)files) : 0;
+
+    char const *const batch[] = {"dump", "search", "search-text", "search-regex", "checksum", "patch"};
+    guint operations = 0;
+    for (gsize i = 0; i < G_N_ELEMENTS(batch); ++i)
+        operations += g_variant_dict_contains(options, batch[i]);
+    if (operations > 0)
+    {
+        int status = 2;
+        if (operations > 1 || n_files > 1)
+            g_printerr("%s: give one of --dump, --search, --search-text, --search-regex, --checksum or --patch, and at most one file\n", g_get_prgname());
+        else
+            status = run_batch(options, n_files ? files[0] : "-");
+        g_free(files);
+        return status;
+    }
+    if (n_files == 0)
+        return -1;
+
+    // The files were parsed as options, so GApplication won't open them itself
+    GError *error = NULL;
+    if (!g_application_register(app, NULL, &error))
+    {
+        g_printerr("%s: %s\n", g_get_prgname(), error->message);
+        g_error_free(error);
+        g_free(files);
+        return 1;
+    }
+    self->startup_files = g_ptr_array_new_with_free_func(g_object_unref);
+    for (guint i = 0; i < n_files; ++i)
+        g_ptr_array_add(self->startup_files, g_file_new_for_commandline_arg(files[i]));
+    g_free(files);
+    // A running instance gets them straight away; this one only passes them on
+    if (g_application_get_is_remote(app))
+    {
+        g_application_open(app, (GFile **)self->startup_files->pdata, self->startup_files->len, "");
+        g_clear_pointer(&self->startup_files, g_ptr_array_unref);
+        return 0;
+    }
+    return -1;
 }
 
 /** Called when App is started with files passed. */
@@ -132,6 +514,22 @@ void ghexedit_app_open(GApplication *app, GFile **files, int n_files, char const
 }
 
 
+/** Called when App is started without any files passed. */
+void ghexedit_app_activate(GApplication *app)
+{
+    GHexEditApp *self = GHEXEDIT_APP(app);
+    // Files from the command line, held back by ghexedit_app_handle_local_options
+    if (self->startup_files)
+    {
+        GPtrArray *files = g_steal_pointer(&self->startup_files);
+        ghexedit_app_open(app, (GFile **)files->pdata, files->len, "");
+        g_ptr_array_unref(files);
+        return;
+    }
+    GHexEditAppWindow *win = ghexedit_app_window_new(GHEXEDIT_APP(app));
+    gtk_window_present(GTK_WINDOW(win));
+}
+
 /* ===[ GObject ]=== */
 /** Instantiate a new instance of the class. */
 GHexEditApp *ghexedit_app_new(void)
@@ -140,10 +538,33 @@ GHexEditApp *ghexedit_app_new(void)
 }
 
 
+/**
+ * Drop held references.
+ * Can be executed more than once!
+ * Should chain up before returning.
+ */
+void ghexedit_app_dispose(GObject *object)
+{
+    GHexEditApp *app = GHEXEDIT_APP(object);
+    // Clear the settings
+    g_clear_object(&app->settings);
+    g_clear_pointer(&app->startup_files, g_ptr_array_unref);
+    // Call parent class's dispose method
+    G_OBJECT_CLASS(ghexedit_app_parent_class)->dispose(object);
+}
+
+
 /* ===[ Base GLib ]=== */
 /** Equivalent to C++ constructor. */
 void ghexedit_app_init(GHexEditApp *app)
 {
+    app->settings = NULL;
+    app->startup_files = NULL;
+    g_application_add_main_option_entries(G_APPLICATION(app), batch_options);
+    g_application_set_option_context_summary(G_APPLICATION(app),
+        "Open FILEs in the editor, or with one of --dump, --search, --search-text,\n"
+        "--search-regex, --checksum or --patch, process FILE (- or none for standard\n"
+        "input) without a display and exit.");
 }
 
 /**
@@ -152,6 +573,8 @@ void ghexedit_app_init(GHexEditApp *app)
  */
 void ghexedit_app_class_init(GHexEditAppClass *class)
 {
+    G_OBJECT_CLASS(class)->dispose = ghexedit_app_dispose;
+    G_APPLICATION_CLASS(class)->handle_local_options = ghexedit_app_handle_local_options;
     G_APPLICATION_CLASS(class)->startup = ghexedit_app_startup;
     G_APPLICATION_CLASS(class)->activate = ghexedit_app_activate;
     G_APPLICATION_CLASS(class)->open = ghexedit_app_open;
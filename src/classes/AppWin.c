@@ -18,7 +18,18 @@
 
 #include "AppWin.h"
 #include "App.h"
+#include "ChecksumPanel.h"
+#include "CompareView.h"
+#include "EntropyMap.h"
+#include "FindBar.h"
 #include "HexView.h"
+#include "Histogram.h"
+#include "Inspector.h"
+#include "PerfOverlay.h"
+#include "TemplatePanel.h"
+#include "engine/Buffer.h"
+#include "engine/Registry.h"
+#include "engine/Session.h"
 
 #include "appid.h"
 
@@ -29,31 +40,318 @@ struct _GHexEditAppWindow
 {
     GtkApplicationWindow parent;
     GSettings *settings;
+    GtkWidget *search_bar;
+    GtkWidget *find_bar;
     GtkWidget *notebook;
+    GtkWidget *entropy_map;
+    GtkWidget *side_panel;
+    GtkWidget *inspector;
+    GtkWidget *template_panel;
+    GtkWidget *checksum_panel;
+    GtkWidget *histogram;
+    GtkWidget *perf_overlay;
+    /** The view current before this one, what win.compare compares with. */
+    GHexEditHexView *previous_view;
+    /** Asking whether to save before the window closes. */
+    gboolean closing;
 };
 
 G_DEFINE_TYPE(GHexEditAppWindow, ghexedit_app_window, GTK_TYPE_APPLICATION_WINDOW);
 
 
-/** TextBuffer::changed callback: Apply the selected font to a buffer. */
-void apply_font(GObject *self, gpointer user_data)
+/** Buffer::notify::modified and ::notify::document callback: label the tab with the file name, marked if unsaved. */
+static void buffer_modified(GHexEditBuffer *buffer, GParamSpec *pspec, gpointer label)
+{
+    char *basename = g_file_get_basename(ghexedit_document_get_file(ghexedit_buffer_get_document(buffer)));
+    char *text = g_strconcat(ghexedit_buffer_get_modified(buffer) ? "*" : "", basename, NULL);
+    gtk_label_set_text(GTK_LABEL(label), text);
+    g_free(text);
+    g_free(basename);
+}
+
+/**
+ * Tell the user `message`, with the reason from `error`, in a dialog over
+ * `win` if it's still shown.
+ */
+static void show_error(GHexEditAppWindow *win, char const *message, GError const *error)
+{
+    GtkAlertDialog *dialog = gtk_alert_dialog_new("%s", message);
+    gtk_alert_dialog_set_detail(dialog, error->message);
+    gtk_alert_dialog_show(dialog, gtk_widget_get_visible(GTK_WIDGET(win)) ? GTK_WINDOW(win) : NULL);
+    g_object_unref(dialog);
+}
+
+/** Where a save or export that fails is reported. */
+typedef struct
+{
+    GHexEditAppWindow *win;
+    char *basename;
+} Report;
+
+static Report *report_new(GHexEditAppWindow *win, GFile *file)
+{
+    Report *report = g_new(Report, 1);
+    report->win = g_object_ref(win);
+    report->basename = g_file_get_basename(file);
+    return report;
+}
+
+static void report_free(Report *report)
+{
+    g_object_unref(report->win);
+    g_free(report->basename);
+    g_free(report);
+}
+
+
+/** The HexView on a page; for a comparison, the side last focused. */
+static GHexEditHexView *page_view(GtkWidget *page)
+{
+    if (GHEXEDIT_IS_COMPARE_VIEW(page))
+        return ghexedit_compare_view_get_focus_view(GHEXEDIT_COMPARE_VIEW(page));
+    return GHEXEDIT_HEX_VIEW(gtk_scrolled_window_get_child(GTK_SCROLLED_WINDOW(page)));
+}
+
+/** The HexView on the current page, or NULL if no file is open. */
+static GHexEditHexView *current_view(GHexEditAppWindow *win)
+{
+    GtkNotebook *notebook = GTK_NOTEBOOK(win->notebook);
+    int page = gtk_notebook_get_current_page(notebook);
+    if (page < 0)
+        return NULL;
+    return page_view(gtk_notebook_get_nth_page(notebook, page));
+}
+
+/** Show whether `view` is following its file in the win.follow toggle. */
+static void sync_follow(GHexEditAppWindow *win, GHexEditHexView *view)
+{
+    GAction *action = g_action_map_lookup_action(G_ACTION_MAP(win), "follow");
+    gboolean follow = view && ghexedit_hex_view_get_follow_tail(view);
+    g_simple_action_set_state(G_SIMPLE_ACTION(action), g_variant_new_boolean(follow));
+}
+
+/** Point the entropy map at `view` if it or the histogram is showing, else stop analysing. */
+static void sync_analysis(GHexEditAppWindow *win, GHexEditHexView *view)
+{
+    gboolean shown = gtk_widget_get_visible(win->entropy_map) || gtk_revealer_get_reveal_child(GTK_REVEALER(win->side_panel));
+    ghexedit_entropy_map_set_view(GHEXEDIT_ENTROPY_MAP(win->entropy_map), shown ? view : NULL);
+}
+
+/** Notebook::switch-page callback: point the find bar at the new page. */
+static void page_switched(GtkNotebook *notebook, GtkWidget *page, guint page_num, gpointer user_data)
+{
+    GHexEditAppWindow *win = GHEXEDIT_APP_WINDOW(user_data);
+    // The notebook hasn't switched yet, so this is the page being left
+    GHexEditHexView *previous = current_view(win);
+    if (previous && !GHEXEDIT_IS_COMPARE_VIEW(gtk_notebook_get_nth_page(notebook, gtk_notebook_get_current_page(notebook))))
+        g_set_weak_pointer(&win->previous_view, previous);
+    GHexEditHexView *view = page_view(page);
+    ghexedit_find_bar_set_view(GHEXEDIT_FIND_BAR(win->find_bar), view);
+    ghexedit_inspector_set_view(GHEXEDIT_INSPECTOR(win->inspector), view);
+    ghexedit_template_panel_set_view(GHEXEDIT_TEMPLATE_PANEL(win->template_panel), view);
+    ghexedit_checksum_panel_set_view(GHEXEDIT_CHECKSUM_PANEL(win->checksum_panel), view);
+    ghexedit_perf_overlay_set_view(GHEXEDIT_PERF_OVERLAY(win->perf_overlay), view);
+    sync_analysis(win, view);
+    sync_follow(win, view);
+}
+
+/** Session save callback: the application can exit now. */
+static void session_saved(GObject *source, GAsyncResult *result, gpointer user_data)
+{
+    GError *error = NULL;
+    if (!ghexedit_session_save_finish(GHEXEDIT_SESSION(source), result, &error))
+    {
+        g_warning("Failed to save session: %s", error->message);
+        g_error_free(error);
+    }
+    g_application_release(G_APPLICATION(user_data));
+    g_object_unref(user_data);
+}
+
+/** Remember where a closed page's file was left, and what was learnt about it. */
+static void save_session(GtkWidget *page)
+{
+    if (GHEXEDIT_IS_COMPARE_VIEW(page))
+        return;
+    GHexEditHexView *view = page_view(page);
+    // Closed before the file was open
+    GHexEditSession *session = ghexedit_hex_view_get_session(view);
+    if (session == NULL)
+        return;
+    ghexedit_session_set_cursor(session, ghexedit_hex_view_get_cursor(view));
+    ghexedit_session_set_top(session, ghexedit_hex_view_get_top(view));
+    // Closing the last window shouldn't cut the write short
+    GApplication *app = g_object_ref(g_application_get_default());
+    g_application_hold(app);
+    ghexedit_session_save_async(session, NULL, session_saved, app);
+}
+
+/** Notebook::page-removed callback: the searched page may be gone. */
+static void page_removed(GtkNotebook *notebook, GtkWidget *page, guint page_num, gpointer user_data)
+{
+    GHexEditAppWindow *win = GHEXEDIT_APP_WINDOW(user_data);
+    save_session(page);
+    ghexedit_find_bar_set_view(GHEXEDIT_FIND_BAR(win->find_bar), current_view(win));
+    ghexedit_inspector_set_view(GHEXEDIT_INSPECTOR(win->inspector), current_view(win));
+    ghexedit_template_panel_set_view(GHEXEDIT_TEMPLATE_PANEL(win->template_panel), current_view(win));
+    ghexedit_checksum_panel_set_view(GHEXEDIT_CHECKSUM_PANEL(win->checksum_panel), current_view(win));
+    ghexedit_perf_overlay_set_view(GHEXEDIT_PERF_OVERLAY(win->perf_overlay), current_view(win));
+    sync_analysis(win, current_view(win));
+    sync_follow(win, current_view(win));
+}
+
+/**
+ * win.follow change-state callback: follow the current file like `tail -f`,
+ * appending what is written to it and keeping the view at the end.
+ */
+static void follow_changed(GSimpleAction *action, GVariant *state, gpointer user_data)
+{
+    GHexEditHexView *view = current_view(GHEXEDIT_APP_WINDOW(user_data));
+    GHexEditBuffer *buffer = view ? ghexedit_hex_view_get_underlying(view) : NULL;
+    if (buffer == NULL)
+        return;
+    gboolean follow = g_variant_get_boolean(state);
+    ghexedit_buffer_set_follow(buffer, follow);
+    ghexedit_hex_view_set_follow_tail(view, follow);
+    g_simple_action_set_state(action, state);
+}
+
+/** win.side-panel change-state callback: show or hide the inspector, template, checksums and histogram. */
+static void side_panel_changed(GSimpleAction *action, GVariant *state, gpointer user_data)
+{
+    GHexEditAppWindow *win = GHEXEDIT_APP_WINDOW(user_data);
+    gtk_revealer_set_reveal_child(GTK_REVEALER(win->side_panel), g_variant_get_boolean(state));
+    sync_analysis(win, current_view(win));
+    g_simple_action_set_state(action, state);
+}
+
+/** win.entropy-map change-state callback: show or hide the entropy strip. */
+static void entropy_map_changed(GSimpleAction *action, GVariant *state, gpointer user_data)
 {
-    GtkTextBuffer *buffer = GTK_TEXT_BUFFER(self);
     GHexEditAppWindow *win = GHEXEDIT_APP_WINDOW(user_data);
-    // Create a new tag for the buffer
-    GtkTextTag *tag = gtk_text_buffer_create_tag(buffer, NULL, NULL);
-    // Tag's font comes from settings
-    g_settings_bind(win->settings, "font", tag, "font", G_SETTINGS_BIND_DEFAULT);
-    // Tag applies to whole buffer
-    GtkTextIter start_iter, end_iter;
-    gtk_text_buffer_get_start_iter(buffer, &start_iter);
-    gtk_text_buffer_get_end_iter(buffer, &end_iter);
-    gtk_text_buffer_apply_tag(buffer, tag, &start_iter, &end_iter);
+    gtk_widget_set_visible(win->entropy_map, g_variant_get_boolean(state));
+    sync_analysis(win, current_view(win));
+    g_simple_action_set_state(action, state);
+}
+
+/** win.compare activate callback. */
+static void compare_activated(GSimpleAction *action, GVariant *parameter, gpointer win)
+{
+    ghexedit_app_window_compare(GHEXEDIT_APP_WINDOW(win));
+}
+
+static GActionEntry const win_entries[] = {
+    // View menu
+    {"follow", NULL, NULL, "false", follow_changed},
+    {"side-panel", NULL, NULL, "false", side_panel_changed},
+    {"entropy-map", NULL, NULL, "false", entropy_map_changed},
+    {"compare", compare_activated, NULL, NULL, NULL},
+};
+
+/** A file being opened into a page. */
+typedef struct
+{
+    GHexEditAppWindow *win;
+    GtkWidget *view;
+    GtkWidget *label;
+    char *basename;
+    GCancellable *cancellable;
+    GHexEditBuffer *buffer;
+} OpenData;
+
+static void open_data_free(OpenData *data)
+{
+    g_object_unref(data->win);
+    g_object_unref(data->view);
+    g_object_unref(data->label);
+    g_free(data->basename);
+    g_object_unref(data->cancellable);
+    g_clear_object(&data->buffer);
+    g_free(data);
+}
+
+/** Document open progress callback: show how much has been read in the tab. */
+static void open_progress(goffset current, goffset total, gpointer user_data)
+{
+    OpenData *data = user_data;
+    char *text;
+    if (total > 0)
+        text = g_strdup_printf("%s (%d%%)", data->basename, (int)(current * 100 / total));
+    else
+    {
+        char *size = g_format_size(current);
+        text = g_strdup_printf("%s (%s)", data->basename, size);
+        g_free(size);
+    }
+    gtk_label_set_text(GTK_LABEL(data->label), text);
+    g_free(text);
+}
+
+/**
+ * Session load callback: attach the file's buffer to its page, back where
+ * it was left last time.
+ */
+static void session_loaded(GObject *source, GAsyncResult *result, gpointer user_data)
+{
+    OpenData *data = user_data;
+    // Only fails if the tab was closed meanwhile
+    GHexEditSession *session = ghexedit_session_load_finish(result, NULL);
+    if (session)
+    {
+        GHexEditHexView *view = GHEXEDIT_HEX_VIEW(data->view);
+        GHexEditBuffer *buffer = data->buffer;
+        g_signal_connect_object(buffer, "notify::modified", G_CALLBACK(buffer_modified), data->label, 0);
+        g_signal_connect_object(buffer, "notify::document", G_CALLBACK(buffer_modified), data->label, 0);
+        g_settings_bind(data->win->settings, "undo-memory", buffer, "undo-limit", G_SETTINGS_BIND_GET);
+        ghexedit_hex_view_set_session(view, session);
+        ghexedit_hex_view_set_underlying(view, buffer);
+        if (ghexedit_session_get_restored(session))
+        {
+            // Another page may have the file open, and edited
+            ghexedit_hex_view_set_cursor(view, MIN(ghexedit_session_get_cursor(session), ghexedit_buffer_get_size(buffer)), FALSE);
+            ghexedit_hex_view_scroll_to(view, ghexedit_session_get_top(session));
+        }
+        buffer_modified(buffer, NULL, data->label);
+        g_object_unref(session);
+    }
+    open_data_free(data);
+}
+
+/** Registry open callback: look up what was saved about the file before showing it. */
+static void open_done(GObject *source, GAsyncResult *result, gpointer user_data)
+{
+    OpenData *data = user_data;
+    GError *error = NULL;
+    // Edits go to a piece table over the document, never to the file itself;
+    // pages showing the same file share it and keep only their own cursor
+    GHexEditBuffer *buffer = ghexedit_registry_open_finish(result, &error);
+    if (buffer)
+    {
+        data->buffer = buffer;
+        GFile *file = ghexedit_document_get_file(ghexedit_buffer_get_document(buffer));
+        ghexedit_session_load_async(file, data->cancellable, session_loaded, data);
+        return;
+    }
+    // Closing the tab cancels the open; nothing is left to report to
+    if (!g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+    {
+        gtk_label_set_text(GTK_LABEL(data->label), data->basename);
+        char *message = g_strdup_printf("Could not open \u201c%s\u201d", data->basename);
+        show_error(data->win, message, error);
+        g_free(message);
+    }
+    g_clear_error(&error);
+    open_data_free(data);
 }
 
 
 /* ===[ GHexEditAppWindow ]=== */
-/** Called by App to send a file to open. */
+/**
+ * Called by App to send a file to open.
+ * The page appears at once; the file is opened on a worker thread and shown
+ * when ready, unless it is already open elsewhere, where it was left when
+ * last closed. Closing the page first cancels the open.
+ */
 void ghexedit_app_window_open(GHexEditAppWindow *win, GFile *file)
 {
     char *basename = g_file_get_basename(file);
@@ -64,34 +362,362 @@ void ghexedit_app_window_open(GHexEditAppWindow *win, GFile *file)
     gtk_widget_set_vexpand(scrolled, TRUE);
     // Create HexView for file contents
     GtkWidget *view = ghexedit_hex_view_new();
-    gtk_text_view_set_editable(GTK_TEXT_VIEW(view), FALSE);
-    gtk_text_view_set_cursor_visible(GTK_TEXT_VIEW(view), TRUE);
-    gtk_text_view_set_monospace(GTK_TEXT_VIEW(view), TRUE);
     // Add view as child of scrolled
     gtk_scrolled_window_set_child(GTK_SCROLLED_WINDOW(scrolled), view);
     // Add scrolled as a notebook page
-    gtk_notebook_append_page(GTK_NOTEBOOK(win->notebook), scrolled, gtk_label_new(basename));
-    // Get HexView's buffer
-    GtkTextBuffer *buffer = gtk_text_view_get_buffer(GTK_TEXT_VIEW(view));
+    GtkWidget *label = gtk_label_new(basename);
+    gtk_notebook_append_page(GTK_NOTEBOOK(win->notebook), scrolled, label);
 
-    // Need to reapply font tag when text changes
-    g_signal_connect(buffer, "changed", G_CALLBACK(apply_font), win);
+    // Open file contents; data is paged in as the view needs it
+    GCancellable *cancellable = g_cancellable_new();
+    g_signal_connect_object(scrolled, "destroy", G_CALLBACK(g_cancellable_cancel), cancellable, G_CONNECT_SWAPPED);
+    OpenData *data = g_new0(OpenData, 1);
+    data->win = g_object_ref(win);
+    data->view = g_object_ref(view);
+    data->label = g_object_ref(label);
+    data->basename = basename;
+    data->cancellable = cancellable;
+    ghexedit_registry_open_async(file, cancellable, open_progress, data, open_done, data);
+}
 
-    // Load file contents
-    GBytes *content;
-    if (content = g_file_load_bytes(file, NULL, NULL, NULL))
+/** Buffer save callback. */
+static void save_done(GObject *source, GAsyncResult *result, gpointer user_data)
+{
+    Report *report = user_data;
+    GError *error = NULL;
+    if (!ghexedit_buffer_save_finish(GHEXEDIT_BUFFER(source), result, &error))
     {
-        gsize size;
-        ghexedit_hex_view_set_underlying(GHEXEDIT_HEX_VIEW(view), content);
+        char *message = g_strdup_printf("Could not save \u201c%s\u201d", report->basename);
+        show_error(report->win, message, error);
+        g_free(message);
+        g_error_free(error);
     }
-    g_free(basename);
+    report_free(report);
+}
+
+/** Save the current file, to `file` if given or else back where it came from. */
+void ghexedit_app_window_save(GHexEditAppWindow *win, GFile *file)
+{
+    GHexEditHexView *view = current_view(win);
+    GHexEditBuffer *buffer = view ? ghexedit_hex_view_get_underlying(view) : NULL;
+    if (buffer == NULL || ghexedit_buffer_get_saving(buffer))
+        return;
+    if (file == NULL)
+        file = ghexedit_document_get_file(ghexedit_buffer_get_document(buffer));
+    ghexedit_buffer_save_async(buffer, file, NULL, save_done, report_new(win, file));
+}
+
+/** Undo the last edit in the current file, moving the cursor to it. */
+void ghexedit_app_window_undo(GHexEditAppWindow *win)
+{
+    GHexEditHexView *view = current_view(win);
+    GHexEditBuffer *buffer = view ? ghexedit_hex_view_get_underlying(view) : NULL;
+    guint64 offset;
+    if (buffer && !ghexedit_buffer_get_saving(buffer) && ghexedit_buffer_undo(buffer, &offset))
+        ghexedit_hex_view_set_cursor(view, offset, FALSE);
+}
+
+/** Redo the last undone edit in the current file, moving the cursor to it. */
+void ghexedit_app_window_redo(GHexEditAppWindow *win)
+{
+    GHexEditHexView *view = current_view(win);
+    GHexEditBuffer *buffer = view ? ghexedit_hex_view_get_underlying(view) : NULL;
+    guint64 offset;
+    if (buffer && !ghexedit_buffer_get_saving(buffer) && ghexedit_buffer_redo(buffer, &offset))
+        ghexedit_hex_view_set_cursor(view, offset, FALSE);
+}
+
+/** Copy the current selection to the clipboard as `format`. */
+void ghexedit_app_window_copy(GHexEditAppWindow *win, GHexEditExportFormat format)
+{
+    GHexEditHexView *view = current_view(win);
+    if (view)
+        ghexedit_hex_view_copy(view, format);
+}
+
+/** Paste the clipboard at the cursor of the current file. */
+void ghexedit_app_window_paste(GHexEditAppWindow *win)
+{
+    GHexEditHexView *view = current_view(win);
+    if (view)
+        ghexedit_hex_view_paste(view);
+}
+
+/** Selection export callback. */
+static void export_done(GObject *source, GAsyncResult *result, gpointer user_data)
+{
+    Report *report = user_data;
+    GError *error = NULL;
+    if (!ghexedit_export_finish(result, &error))
+    {
+        char *message = g_strdup_printf("Could not export to \u201c%s\u201d", report->basename);
+        show_error(report->win, message, error);
+        g_free(message);
+        g_error_free(error);
+    }
+    report_free(report);
+}
+
+/**
+ * Write the current selection to `file` as `format`. The selection is
+ * snapshotted first, so editing on while it's written changes nothing.
+ */
+void ghexedit_app_window_export_selection(GHexEditAppWindow *win, GFile *file, GHexEditExportFormat format)
+{
+    GHexEditHexView *view = current_view(win);
+    GHexEditSnapshot *snapshot = view ? ghexedit_hex_view_get_selection_snapshot(view) : NULL;
+    if (snapshot == NULL)
+        return;
+    ghexedit_export_to_file_async(snapshot, format, file, NULL, export_done, report_new(win, file));
+    ghexedit_snapshot_unref(snapshot);
+}
+
+/** Show the find bar and focus its entry. */
+void ghexedit_app_window_find(GHexEditAppWindow *win)
+{
+    gtk_search_bar_set_search_mode(GTK_SEARCH_BAR(win->search_bar), TRUE);
+    gtk_widget_grab_focus(GTK_WIDGET(ghexedit_find_bar_get_entry(GHEXEDIT_FIND_BAR(win->find_bar))));
+}
+
+/**
+ * Compare the current file with the one shown before it, in a new page with
+ * the two side by side and their differences highlighted.
+ */
+void ghexedit_app_window_compare(GHexEditAppWindow *win)
+{
+    GHexEditHexView *view = current_view(win);
+    GHexEditBuffer *a = win->previous_view ? ghexedit_hex_view_get_underlying(win->previous_view) : NULL;
+    GHexEditBuffer *b = view ? ghexedit_hex_view_get_underlying(view) : NULL;
+    if (a == NULL || b == NULL || a == b)
+    {
+        gtk_widget_error_bell(GTK_WIDGET(win));
+        return;
+    }
+    char *a_name = g_file_get_basename(ghexedit_document_get_file(ghexedit_buffer_get_document(a)));
+    char *b_name = g_file_get_basename(ghexedit_document_get_file(ghexedit_buffer_get_document(b)));
+    char *text = g_strdup_printf("%s \u2194 %s", a_name, b_name);
+    GtkWidget *compare = ghexedit_compare_view_new(a, b);
+    int page = gtk_notebook_append_page(GTK_NOTEBOOK(win->notebook), compare, gtk_label_new(text));
+    gtk_notebook_set_current_page(GTK_NOTEBOOK(win->notebook), page);
+    g_free(text);
+    g_free(b_name);
+    g_free(a_name);
+}
+
+/** The buffer a file's page edits, or NULL for comparisons and files still opening. */
+static GHexEditBuffer *page_buffer(GtkWidget *page)
+{
+    if (GHEXEDIT_IS_COMPARE_VIEW(page))
+        return NULL;
+    return ghexedit_hex_view_get_underlying(page_view(page));
+}
+
+/** Whether a page other than `page`, in a window staying open, edits `buffer`. */
+static gboolean buffer_shown_elsewhere(GHexEditBuffer *buffer, GtkWidget *page)
+{
+    for (GList *w = gtk_application_get_windows(GTK_APPLICATION(g_application_get_default())); w; w = w->next)
+    {
+        if (!GHEXEDIT_IS_APP_WINDOW(w->data) || GHEXEDIT_APP_WINDOW(w->data)->closing)
+            continue;
+        GtkNotebook *notebook = GTK_NOTEBOOK(GHEXEDIT_APP_WINDOW(w->data)->notebook);
+        for (int i = 0; i < gtk_notebook_get_n_pages(notebook); ++i)
+        {
+            GtkWidget *other = gtk_notebook_get_nth_page(notebook, i);
+            if (other != page && page_buffer(other) == buffer)
+                return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+/** Add the edits closing `page` would lose to `unsaved`, once per buffer. */
+static void collect_unsaved(GtkWidget *page, GPtrArray *unsaved)
+{
+    GHexEditBuffer *buffer = page_buffer(page);
+    if (buffer && ghexedit_buffer_get_modified(buffer) && !g_ptr_array_find(unsaved, buffer, NULL)
+        && !buffer_shown_elsewhere(buffer, page))
+        g_ptr_array_add(unsaved, g_object_ref(buffer));
+}
+
+/** Pages about to close, waiting on the user, then on saving their files. */
+typedef struct
+{
+    GHexEditAppWindow *win;
+    /** The page to remove, or NULL to close the whole window. */
+    GtkWidget *page;
+    /** Buffers whose edits closing would lose. */
+    GPtrArray *unsaved;
+    guint pending;
+    gboolean failed;
+} Closing;
+
+static void closing_free(Closing *closing)
+{
+    // Still open unless it was closed; ask again next time
+    if (closing->page == NULL)
+        closing->win->closing = FALSE;
+    g_object_unref(closing->win);
+    g_clear_object(&closing->page);
+    g_ptr_array_unref(closing->unsaved);
+    g_free(closing);
 }
 
-/** Close the current NotebookPage. */
+/** Close what was asked for, now nothing unsaved stands in the way. */
+static void closing_finish(Closing *closing)
+{
+    if (closing->page == NULL)
+        gtk_window_destroy(GTK_WINDOW(closing->win));
+    else
+    {
+        GtkNotebook *notebook = GTK_NOTEBOOK(closing->win->notebook);
+        int page_num = gtk_notebook_page_num(notebook, closing->page);
+        if (page_num >= 0)
+            gtk_notebook_remove_page(notebook, page_num);
+    }
+    closing_free(closing);
+}
+
+/** Count a save done, closing once every file is saved. */
+static void closing_save_done(Closing *closing)
+{
+    if (--closing->pending > 0)
+        return;
+    // Keep the page open rather than lose what didn't reach the disk
+    if (closing->failed)
+        closing_free(closing);
+    else
+        closing_finish(closing);
+}
+
+/** Buffer save callback, while closing. */
+static void closing_saved(GObject *source, GAsyncResult *result, gpointer user_data)
+{
+    Closing *closing = user_data;
+    GError *error = NULL;
+    if (!ghexedit_buffer_save_finish(GHEXEDIT_BUFFER(source), result, &error))
+    {
+        char *basename = g_file_get_basename(ghexedit_document_get_file(ghexedit_buffer_get_document(GHEXEDIT_BUFFER(source))));
+        char *message = g_strdup_printf("Could not save \u201c%s\u201d", basename);
+        show_error(closing->win, message, error);
+        g_free(message);
+        g_free(basename);
+        g_error_free(error);
+        closing->failed = TRUE;
+    }
+    closing_save_done(closing);
+}
+
+/**
+ * Buffer::notify::saving callback, for a save already running when asked to
+ * close: the file's own save callback reports any failure.
+ */
+static void closing_save_ended(GHexEditBuffer *buffer, GParamSpec *pspec, gpointer user_data)
+{
+    Closing *closing = user_data;
+    if (ghexedit_buffer_get_saving(buffer))
+        return;
+    g_signal_handlers_disconnect_by_func(buffer, closing_save_ended, closing);
+    if (ghexedit_buffer_get_modified(buffer))
+        closing->failed = TRUE;
+    closing_save_done(closing);
+}
+
+/** Responses to the save prompt, in button order. */
+enum
+{
+    CLOSING_CANCEL,
+    CLOSING_DISCARD,
+    CLOSING_SAVE,
+};
+
+/** Save prompt callback. */
+static void closing_answered(GObject *source, GAsyncResult *result, gpointer user_data)
+{
+    Closing *closing = user_data;
+    // Dismissing the prompt counts as Cancel
+    int response = gtk_alert_dialog_choose_finish(GTK_ALERT_DIALOG(source), result, NULL);
+    if (response == CLOSING_DISCARD)
+        closing_finish(closing);
+    else if (response == CLOSING_SAVE)
+    {
+        closing->pending = 1;
+        for (guint i = 0; i < closing->unsaved->len; ++i)
+        {
+            GHexEditBuffer *buffer = g_ptr_array_index(closing->unsaved, i);
+            ++closing->pending;
+            if (ghexedit_buffer_get_saving(buffer))
+            {
+                g_signal_connect(buffer, "notify::saving", G_CALLBACK(closing_save_ended), closing);
+                continue;
+            }
+            GFile *file = ghexedit_document_get_file(ghexedit_buffer_get_document(buffer));
+            ghexedit_buffer_save_async(buffer, file, NULL, closing_saved, closing);
+        }
+        // Held until every save has started
+        if (--closing->pending == 0)
+            closing_finish(closing);
+    }
+    else
+        closing_free(closing);
+}
+
+/**
+ * Close `page`, or the whole window if NULL, first asking whether to save
+ * any edits that would be lost: those to files no other page is showing.
+ */
+static void close_pages(GHexEditAppWindow *win, GtkWidget *page)
+{
+    Closing *closing = g_new0(Closing, 1);
+    closing->win = g_object_ref(win);
+    closing->page = page ? g_object_ref(page) : NULL;
+    closing->unsaved = g_ptr_array_new_with_free_func(g_object_unref);
+    // Other windows closing meanwhile count on this one no longer
+    if (page == NULL)
+        win->closing = TRUE;
+    GtkNotebook *notebook = GTK_NOTEBOOK(win->notebook);
+    for (int i = 0; i < gtk_notebook_get_n_pages(notebook); ++i)
+        if (page == NULL || gtk_notebook_get_nth_page(notebook, i) == page)
+            collect_unsaved(gtk_notebook_get_nth_page(notebook, i), closing->unsaved);
+    if (closing->unsaved->len == 0)
+    {
+        closing_finish(closing);
+        return;
+    }
+
+    char *message;
+    if (closing->unsaved->len == 1)
+    {
+        GHexEditBuffer *buffer = g_ptr_array_index(closing->unsaved, 0);
+        char *basename = g_file_get_basename(ghexedit_document_get_file(ghexedit_buffer_get_document(buffer)));
+        message = g_strdup_printf("Save changes to \u201c%s\u201d before closing?", basename);
+        g_free(basename);
+    }
+    else
+        message = g_strdup_printf("Save changes to %u files before closing?", closing->unsaved->len);
+    GtkAlertDialog *dialog = gtk_alert_dialog_new("%s", message);
+    gtk_alert_dialog_set_detail(dialog, "Unsaved changes will be lost.");
+    char const *buttons[] = {"Cancel", "Discard", "Save", NULL};
+    gtk_alert_dialog_set_buttons(dialog, buttons);
+    gtk_alert_dialog_set_cancel_button(dialog, CLOSING_CANCEL);
+    gtk_alert_dialog_set_default_button(dialog, CLOSING_SAVE);
+    gtk_alert_dialog_choose(dialog, GTK_WINDOW(win), NULL, closing_answered, closing);
+    g_object_unref(dialog);
+    g_free(message);
+}
+
+/** Close the current NotebookPage, asking first whether to save unsaved edits. */
 void ghexedit_app_window_close_current(GHexEditAppWindow *win)
 {
     GtkNotebook *notebook = GTK_NOTEBOOK(win->notebook);
-    gtk_notebook_remove_page(notebook, gtk_notebook_get_current_page(notebook));
+    int page_num = gtk_notebook_get_current_page(notebook);
+    if (page_num >= 0)
+        close_pages(win, gtk_notebook_get_nth_page(notebook, page_num));
+}
+
+/** Show or hide the frame, cache and memory figures over the pages. */
+void ghexedit_app_window_set_perf_overlay(GHexEditAppWindow *win, gboolean visible)
+{
+    gtk_widget_set_visible(win->perf_overlay, visible);
 }
 
 
@@ -103,9 +729,28 @@ GHexEditAppWindow *ghexedit_app_window_new(GHexEditApp *app)
     GHexEditAppWindow *win = g_object_new(GHEXEDIT_TYPE_APP_WINDOW, "application", app, NULL);
     // Enable window menubar
     gtk_application_window_set_show_menubar(GTK_APPLICATION_WINDOW(win), TRUE);
+    // Show the performance overlay if other windows are
+    GVariant *overlay = g_action_group_get_action_state(G_ACTION_GROUP(app), "perf-overlay");
+    if (overlay)
+    {
+        ghexedit_app_window_set_perf_overlay(win, g_variant_get_boolean(overlay));
+        g_variant_unref(overlay);
+    }
     return win;
 }
 
+/**
+ * Window closing: ask about unsaved edits first, closing only once they're
+ * dealt with.
+ */
+gboolean ghexedit_app_window_close_request(GtkWindow *window)
+{
+    GHexEditAppWindow *win = GHEXEDIT_APP_WINDOW(window);
+    if (!win->closing)
+        close_pages(win, NULL);
+    return TRUE;
+}
+
 /**
  * Drop held references.
  * Can be executed more than once!
@@ -116,6 +761,7 @@ void ghexedit_app_window_dispose(GObject *object)
     GHexEditAppWindow *win = GHEXEDIT_APP_WINDOW(object);
     // Clear the settings
     g_clear_object(&win->settings);
+    g_clear_weak_pointer(&win->previous_view);
     // Call parent class's dispose method
     G_OBJECT_CLASS(ghexedit_app_window_parent_class)->dispose(object);
 }
@@ -127,8 +773,16 @@ void ghexedit_app_window_init(GHexEditAppWindow *win)
 {
     // Create child widgets from class template
     gtk_widget_init_template(GTK_WIDGET(win));
+    // Per-window actions
+    g_action_map_add_action_entries(G_ACTION_MAP(win), win_entries, G_N_ELEMENTS(win_entries), win);
     // Set notebook's properties
     gtk_notebook_set_scrollable(GTK_NOTEBOOK(win->notebook), TRUE);
+    g_signal_connect(win->notebook, "switch-page", G_CALLBACK(page_switched), win);
+    g_signal_connect(win->notebook, "page-removed", G_CALLBACK(page_removed), win);
+    // The histogram shows the map's analysis
+    g_object_bind_property(win->entropy_map, "analysis", win->histogram, "analysis", G_BINDING_SYNC_CREATE);
+    // Let the search bar handle Escape and type-to-search for the find entry
+    gtk_search_bar_connect_entry(GTK_SEARCH_BAR(win->search_bar), ghexedit_find_bar_get_entry(GHEXEDIT_FIND_BAR(win->find_bar)));
     // Create settings object from schema
     win->settings = g_settings_new(GHX_APPLICATION_ID);
 }
@@ -141,8 +795,26 @@ void ghexedit_app_window_class_init(GHexEditAppWindowClass *class)
 {
     // Method overrides
     G_OBJECT_CLASS(class)->dispose = ghexedit_app_window_dispose;
+    GTK_WINDOW_CLASS(class)->close_request = ghexedit_app_window_close_request;
+    // Template uses custom widget types
+    g_type_ensure(GHEXEDIT_TYPE_FIND_BAR);
+    g_type_ensure(GHEXEDIT_TYPE_CHECKSUM_PANEL);
+    g_type_ensure(GHEXEDIT_TYPE_ENTROPY_MAP);
+    g_type_ensure(GHEXEDIT_TYPE_HISTOGRAM);
+    g_type_ensure(GHEXEDIT_TYPE_INSPECTOR);
+    g_type_ensure(GHEXEDIT_TYPE_PERF_OVERLAY);
+    g_type_ensure(GHEXEDIT_TYPE_TEMPLATE_PANEL);
     // Set widget template
     gtk_widget_class_set_template_from_resource(GTK_WIDGET_CLASS(class), GHX_GRESOURCE_PREFIX "AppWindow.ui");
     // Bind class children in template
+    gtk_widget_class_bind_template_child(GTK_WIDGET_CLASS(class), GHexEditAppWindow, search_bar);
+    gtk_widget_class_bind_template_child(GTK_WIDGET_CLASS(class), GHexEditAppWindow, find_bar);
     gtk_widget_class_bind_template_child(GTK_WIDGET_CLASS(class), GHexEditAppWindow, notebook);
+    gtk_widget_class_bind_template_child(GTK_WIDGET_CLASS(class), GHexEditAppWindow, entropy_map);
+    gtk_widget_class_bind_template_child(GTK_WIDGET_CLASS(class), GHexEditAppWindow, side_panel);
+    gtk_widget_class_bind_template_child(GTK_WIDGET_CLASS(class), GHexEditAppWindow, inspector);
+    gtk_widget_class_bind_template_child(GTK_WIDGET_CLASS(class), GHexEditAppWindow, template_panel);
+    gtk_widget_class_bind_template_child(GTK_WIDGET_CLASS(class), GHexEditAppWindow, checksum_panel);
+    gtk_widget_class_bind_template_child(GTK_WIDGET_CLASS(class), GHexEditAppWindow, histogram);
+    gtk_widget_class_bind_template_child(GTK_WIDGET_CLASS(class), GHexEditAppWindow, perf_overlay);
 }
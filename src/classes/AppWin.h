@@ -20,6 +20,7 @@
 #define _GHX_APPWIN_H
 
 #include "App.h"
+#include "engine/Export.h"
 
 #include <gtk/gtk.h>
 
@@ -29,6 +30,15 @@ G_DECLARE_FINAL_TYPE(GHexEditAppWindow, ghexedit_app_window, GHEXEDIT, APP_WINDO
 
 GHexEditAppWindow *ghexedit_app_window_new(GHexEditApp *app);
 void ghexedit_app_window_open(GHexEditAppWindow *win, GFile *file);
+void ghexedit_app_window_save(GHexEditAppWindow *win, GFile *file);
+void ghexedit_app_window_undo(GHexEditAppWindow *win);
+void ghexedit_app_window_redo(GHexEditAppWindow *win);
+void ghexedit_app_window_copy(GHexEditAppWindow *win, GHexEditExportFormat format);
+void ghexedit_app_window_paste(GHexEditAppWindow *win);
+void ghexedit_app_window_export_selection(GHexEditAppWindow *win, GFile *file, GHexEditExportFormat format);
+void ghexedit_app_window_find(GHexEditAppWindow *win);
+void ghexedit_app_window_compare(GHexEditAppWindow *win);
 void ghexedit_app_window_close_current(GHexEditAppWindow *win);
+void ghexedit_app_window_set_perf_overlay(GHexEditAppWindow *win, gboolean visible);
 
 #endif
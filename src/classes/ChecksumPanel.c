@@ -0,0 +1,278 @@
+/**
+ * ChecksumPanel.c - Side panel showing checksums of the current HexView.
+ * Copyright (C) 2022 Trevor Last
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "ChecksumPanel.h"
+#include "engine/Checksum.h"
+
+#include "appid.h"
+
+#include <gtk/gtk.h>
+
+
+/** Entries of the range drop-down, in order. */
+typedef enum
+{
+    CHECKSUM_RANGE_FILE,
+    CHECKSUM_RANGE_SELECTION,
+} GHexEditChecksumRange;
+
+struct _GHexEditChecksumPanel
+{
+    GtkWidget parent;
+    GtkWidget *range;
+    GtkWidget *crc32_check;
+    GtkWidget *crc32_value;
+    GtkWidget *adler32_check;
+    GtkWidget *adler32_value;
+    GtkWidget *sha256_check;
+    GtkWidget *sha256_value;
+    GtkWidget *blake3_check;
+    GtkWidget *blake3_value;
+    GtkWidget *progress;
+    GtkWidget *status;
+    GtkWidget *cancel;
+    GtkWidget *compute;
+    // The above, indexed by GHexEditChecksumKind
+    GtkWidget *checks[GHEXEDIT_N_CHECKSUMS];
+    GtkWidget *values[GHEXEDIT_N_CHECKSUMS];
+    // What is being checksummed
+    GHexEditHexView *view;
+    GHexEditBuffer *buffer;
+    GHexEditChecksum *checksum;
+    guint64 offset;
+    guint64 length;
+};
+
+G_DEFINE_TYPE(GHexEditChecksumPanel, ghexedit_checksum_panel, GTK_TYPE_WIDGET)
+
+
+/* ===[ Checksumming ]=== */
+/** Show whether a checksum is running. */
+static void set_running(GHexEditChecksumPanel *panel, gboolean running)
+{
+    gtk_widget_set_visible(panel->progress, running);
+    gtk_widget_set_sensitive(panel->cancel, running);
+    gtk_widget_set_sensitive(panel->compute, !running && panel->buffer);
+}
+
+/** Empty every digest label. */
+static void clear_values(GHexEditChecksumPanel *panel)
+{
+    for (int i = 0; i < GHEXEDIT_N_CHECKSUMS; ++i)
+        gtk_label_set_text(GTK_LABEL(panel->values[i]), "");
+}
+
+/** Describe the checksummed range in the status label. */
+static void describe_range(GHexEditChecksumPanel *panel)
+{
+    char *size = g_format_size(panel->length);
+    char *text = g_strdup_printf("%s at 0x%08" G_GINT64_MODIFIER "X", size, panel->offset);
+    gtk_label_set_text(GTK_LABEL(panel->status), text);
+    g_free(text);
+    g_free(size);
+}
+
+/** Checksum::notify::progress callback. */
+static void checksum_progress(GHexEditChecksum *checksum, GParamSpec *pspec, gpointer user_data)
+{
+    GHexEditChecksumPanel *panel = GHEXEDIT_CHECKSUM_PANEL(user_data);
+    gtk_progress_bar_set_fraction(GTK_PROGRESS_BAR(panel->progress), ghexedit_checksum_get_progress(checksum));
+}
+
+/** Checksum::notify::finished callback: show the digests, or why there are none. */
+static void checksum_finished(GHexEditChecksum *checksum, GParamSpec *pspec, gpointer user_data)
+{
+    GHexEditChecksumPanel *panel = GHEXEDIT_CHECKSUM_PANEL(user_data);
+    GError const *error = ghexedit_checksum_get_error(checksum);
+    if (error)
+        gtk_label_set_text(GTK_LABEL(panel->status), g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED) ? "Cancelled" : error->message);
+    else
+        describe_range(panel);
+    for (int i = 0; i < GHEXEDIT_N_CHECKSUMS; ++i)
+    {
+        char const *digest = ghexedit_checksum_get_digest(checksum, i);
+        gtk_label_set_text(GTK_LABEL(panel->values[i]), digest ? digest : "");
+    }
+    set_running(panel, FALSE);
+}
+
+/** Cancel and forget the current checksum. */
+static void stop_checksum(GHexEditChecksumPanel *panel)
+{
+    if (panel->checksum == NULL)
+        return;
+    ghexedit_checksum_cancel(panel->checksum);
+    g_signal_handlers_disconnect_by_data(panel->checksum, panel);
+    g_clear_object(&panel->checksum);
+    set_running(panel, FALSE);
+}
+
+/** Buffer::changed callback: the digests no longer describe the data. */
+static void buffer_changed(GHexEditBuffer *buffer, guint64 offset, guint64 removed, guint64 added, gpointer user_data)
+{
+    GHexEditChecksumPanel *panel = GHEXEDIT_CHECKSUM_PANEL(user_data);
+    stop_checksum(panel);
+    clear_values(panel);
+    gtk_label_set_text(GTK_LABEL(panel->status), "");
+}
+
+/** Button::clicked callback: checksum the chosen range with the chosen digests. */
+static void compute_clicked(GtkButton *button, gpointer user_data)
+{
+    GHexEditChecksumPanel *panel = GHEXEDIT_CHECKSUM_PANEL(user_data);
+    stop_checksum(panel);
+    clear_values(panel);
+    if (panel->buffer == NULL)
+        return;
+
+    guint kinds = 0;
+    for (int i = 0; i < GHEXEDIT_N_CHECKSUMS; ++i)
+        if (gtk_check_button_get_active(GTK_CHECK_BUTTON(panel->checks[i])))
+            kinds |= 1u << i;
+    if (kinds == 0)
+    {
+        gtk_widget_error_bell(GTK_WIDGET(panel));
+        return;
+    }
+
+    guint64 size = ghexedit_buffer_get_size(panel->buffer);
+    panel->offset = 0;
+    panel->length = size;
+    if (gtk_drop_down_get_selected(GTK_DROP_DOWN(panel->range)) == CHECKSUM_RANGE_SELECTION)
+    {
+        guint64 start, end;
+        ghexedit_hex_view_get_selection(panel->view, &start, &end);
+        // The cursor may sit on the append slot past the last byte
+        panel->offset = MIN(start, size);
+        panel->length = MIN(end, size) - panel->offset;
+    }
+
+    panel->checksum = ghexedit_checksum_new(panel->buffer, panel->offset, panel->length, kinds);
+    g_signal_connect(panel->checksum, "notify::progress", G_CALLBACK(checksum_progress), panel);
+    g_signal_connect(panel->checksum, "notify::finished", G_CALLBACK(checksum_finished), panel);
+    gtk_progress_bar_set_fraction(GTK_PROGRESS_BAR(panel->progress), 0);
+    describe_range(panel);
+    set_running(panel, TRUE);
+    ghexedit_checksum_start(panel->checksum, NULL);
+}
+
+/** Button::clicked callback. */
+static void cancel_clicked(GtkButton *button, gpointer user_data)
+{
+    GHexEditChecksumPanel *panel = GHEXEDIT_CHECKSUM_PANEL(user_data);
+    if (panel->checksum)
+        ghexedit_checksum_cancel(panel->checksum);
+}
+
+
+/** HexView::notify::underlying callback: checksum the view's new buffer. */
+static void view_underlying(GHexEditHexView *view, GParamSpec *pspec, gpointer user_data)
+{
+    GHexEditChecksumPanel *panel = GHEXEDIT_CHECKSUM_PANEL(user_data);
+    if (panel->buffer)
+        g_signal_handlers_disconnect_by_func(panel->buffer, buffer_changed, panel);
+    g_set_object(&panel->buffer, view ? ghexedit_hex_view_get_underlying(view) : NULL);
+    if (panel->buffer)
+        g_signal_connect(panel->buffer, "changed", G_CALLBACK(buffer_changed), panel);
+    buffer_changed(panel->buffer, 0, 0, 0, panel);
+    set_running(panel, FALSE);
+}
+
+
+/* ===[ GHexEditChecksumPanel ]=== */
+/** Checksum the contents of `view` from now on. */
+void ghexedit_checksum_panel_set_view(GHexEditChecksumPanel *panel, GHexEditHexView *view)
+{
+    if (panel->view == view)
+        return;
+    if (panel->view)
+        g_signal_handlers_disconnect_by_func(panel->view, view_underlying, panel);
+    g_set_object(&panel->view, view);
+    if (panel->view)
+        g_signal_connect(panel->view, "notify::underlying", G_CALLBACK(view_underlying), panel);
+    view_underlying(view, NULL, panel);
+}
+
+
+/* ===[ GObject ]=== */
+/** Instantiate a new instance of the class. */
+GtkWidget *ghexedit_checksum_panel_new()
+{
+    return g_object_new(GHEXEDIT_TYPE_CHECKSUM_PANEL, NULL);
+}
+
+/**
+ * Drop held references.
+ * Can be executed more than once!
+ * Should chain up before returning.
+ */
+void ghexedit_checksum_panel_dispose(GObject *object)
+{
+    GHexEditChecksumPanel *panel = GHEXEDIT_CHECKSUM_PANEL(object);
+    ghexedit_checksum_panel_set_view(panel, NULL);
+    GtkWidget *child;
+    while ((child = gtk_widget_get_first_child(GTK_WIDGET(panel))))
+        gtk_widget_unparent(child);
+    G_OBJECT_CLASS(ghexedit_checksum_panel_parent_class)->dispose(object);
+}
+
+
+/* ===[ Base GLib ]=== */
+/** Equivalent to C++ constructor. */
+void ghexedit_checksum_panel_init(GHexEditChecksumPanel *panel)
+{
+    // Create child widgets from class template
+    gtk_widget_init_template(GTK_WIDGET(panel));
+    panel->checks[GHEXEDIT_CHECKSUM_CRC32] = panel->crc32_check;
+    panel->checks[GHEXEDIT_CHECKSUM_ADLER32] = panel->adler32_check;
+    panel->checks[GHEXEDIT_CHECKSUM_SHA256] = panel->sha256_check;
+    panel->checks[GHEXEDIT_CHECKSUM_BLAKE3] = panel->blake3_check;
+    panel->values[GHEXEDIT_CHECKSUM_CRC32] = panel->crc32_value;
+    panel->values[GHEXEDIT_CHECKSUM_ADLER32] = panel->adler32_value;
+    panel->values[GHEXEDIT_CHECKSUM_SHA256] = panel->sha256_value;
+    panel->values[GHEXEDIT_CHECKSUM_BLAKE3] = panel->blake3_value;
+    set_running(panel, FALSE);
+
+    g_signal_connect(panel->compute, "clicked", G_CALLBACK(compute_clicked), panel);
+    g_signal_connect(panel->cancel, "clicked", G_CALLBACK(cancel_clicked), panel);
+}
+
+/**
+ * Called upon first instantiation of an object of this class.
+ * Sets/overrides class methods/signals/properties.
+ */
+void ghexedit_checksum_panel_class_init(GHexEditChecksumPanelClass *class)
+{
+    G_OBJECT_CLASS(class)->dispose = ghexedit_checksum_panel_dispose;
+    // Set widget template
+    gtk_widget_class_set_template_from_resource(GTK_WIDGET_CLASS(class), GHX_GRESOURCE_PREFIX "ChecksumPanel.ui");
+    // Bind class children in template
+    gtk_widget_class_bind_template_child(GTK_WIDGET_CLASS(class), GHexEditChecksumPanel, range);
+    gtk_widget_class_bind_template_child(GTK_WIDGET_CLASS(class), GHexEditChecksumPanel, crc32_check);
+    gtk_widget_class_bind_template_child(GTK_WIDGET_CLASS(class), GHexEditChecksumPanel, crc32_value);
+    gtk_widget_class_bind_template_child(GTK_WIDGET_CLASS(class), GHexEditChecksumPanel, adler32_check);
+    gtk_widget_class_bind_template_child(GTK_WIDGET_CLASS(class), GHexEditChecksumPanel, adler32_value);
+    gtk_widget_class_bind_template_child(GTK_WIDGET_CLASS(class), GHexEditChecksumPanel, sha256_check);
+    gtk_widget_class_bind_template_child(GTK_WIDGET_CLASS(class), GHexEditChecksumPanel, sha256_value);
+    gtk_widget_class_bind_template_child(GTK_WIDGET_CLASS(class), GHexEditChecksumPanel, blake3_check);
+    gtk_widget_class_bind_template_child(GTK_WIDGET_CLASS(class), GHexEditChecksumPanel, blake3_value);
+    gtk_widget_class_bind_template_child(GTK_WIDGET_CLASS(class), GHexEditChecksumPanel, progress);
+    gtk_widget_class_bind_template_child(GTK_WIDGET_CLASS(class), GHexEditChecksumPanel, status);
+    gtk_widget_class_bind_template_child(GTK_WIDGET_CLASS(class), GHexEditChecksumPanel, cancel);
+    gtk_widget_class_bind_template_child(GTK_WIDGET_CLASS(class), GHexEditChecksumPanel, compute);
+}
@@ -0,0 +1,33 @@
+/**
+ * ChecksumPanel.h - Side panel showing checksums of the current HexView.
+ * Copyright (C) 2022 Trevor Last
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _GHX_CHECKSUMPANEL_H
+#define _GHX_CHECKSUMPANEL_H
+
+#include "HexView.h"
+
+#include <gtk/gtk.h>
+
+
+#define GHEXEDIT_TYPE_CHECKSUM_PANEL ghexedit_checksum_panel_get_type()
+G_DECLARE_FINAL_TYPE (GHexEditChecksumPanel, ghexedit_checksum_panel, GHEXEDIT, CHECKSUM_PANEL, GtkWidget);
+
+GtkWidget *ghexedit_checksum_panel_new();
+void ghexedit_checksum_panel_set_view(GHexEditChecksumPanel *panel, GHexEditHexView *view);
+
+#endif
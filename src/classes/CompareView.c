@@ -0,0 +1,309 @@
+/**
+ * CompareView.c - Two HexViews side by side, highlighting differences.
+ * Copyright (C) 2022 Trevor Last
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "CompareView.h"
+#include "engine/Diff.h"
+
+#include "appid.h"
+
+#include <gtk/gtk.h>
+
+
+/** Wait this long after an edit before comparing again, in milliseconds. */
+#define RECOMPARE_DELAY 250
+
+struct _GHexEditCompareView
+{
+    GtkWidget parent;
+    GtkWidget *status;
+    GtkWidget *previous;
+    GtkWidget *next;
+    GtkWidget *left_scrolled;
+    GtkWidget *right_scrolled;
+    GtkWidget *left;
+    GtkWidget *right;
+    /** The side last focused, which navigation starts from. */
+    GHexEditHexView *focus_view;
+    GHexEditDiff *diff;
+    guint recompare_source;
+    /** Copying a scroll position to the other side. */
+    gboolean syncing;
+};
+
+G_DEFINE_TYPE(GHexEditCompareView, ghexedit_compare_view, GTK_TYPE_WIDGET)
+
+
+/* ===[ Comparing ]=== */
+/** Describe the comparison's state in the status label. */
+static void update_status(GHexEditCompareView *compare)
+{
+    char *text = NULL;
+    if (compare->diff)
+    {
+        guint n = ghexedit_diff_get_n_ranges(compare->diff);
+        GError const *error = ghexedit_diff_get_error(compare->diff);
+        if (!ghexedit_diff_get_finished(compare->diff))
+            text = g_strdup_printf("%u differences so far (%.0f%%)", n, ghexedit_diff_get_progress(compare->diff) * 100);
+        else if (error)
+            text = g_strdup_printf("Comparison failed after %u differences: %s", n, error->message);
+        else if (n == 0)
+            text = g_strdup("Identical");
+        else
+            text = g_strdup_printf(ghexedit_diff_get_truncated(compare->diff) ? "%u+ differences" : n == 1 ? "%u difference" : "%u differences", n);
+    }
+    gtk_label_set_text(GTK_LABEL(compare->status), text ? text : "");
+    g_free(text);
+}
+
+/** Diff::ranges-added callback. */
+static void diff_ranges_added(GHexEditDiff *diff, guint position, guint added, gpointer user_data)
+{
+    update_status(GHEXEDIT_COMPARE_VIEW(user_data));
+}
+
+/** Diff::notify::progress and ::notify::finished callback. */
+static void diff_progress(GHexEditDiff *diff, GParamSpec *pspec, gpointer user_data)
+{
+    update_status(GHEXEDIT_COMPARE_VIEW(user_data));
+}
+
+/** Cancel and forget the current comparison. */
+static void stop_diff(GHexEditCompareView *compare)
+{
+    if (compare->diff == NULL)
+        return;
+    ghexedit_diff_cancel(compare->diff);
+    g_signal_handlers_disconnect_by_data(compare->diff, compare);
+    g_clear_object(&compare->diff);
+}
+
+/** Compare both sides from scratch. */
+static void run_diff(GHexEditCompareView *compare)
+{
+    stop_diff(compare);
+    GHexEditBuffer *a = ghexedit_hex_view_get_underlying(GHEXEDIT_HEX_VIEW(compare->left));
+    GHexEditBuffer *b = ghexedit_hex_view_get_underlying(GHEXEDIT_HEX_VIEW(compare->right));
+    if (a && b)
+    {
+        compare->diff = ghexedit_diff_new(a, b);
+        g_signal_connect(compare->diff, "ranges-added", G_CALLBACK(diff_ranges_added), compare);
+        g_signal_connect(compare->diff, "notify::progress", G_CALLBACK(diff_progress), compare);
+        g_signal_connect(compare->diff, "notify::finished", G_CALLBACK(diff_progress), compare);
+        ghexedit_diff_start(compare->diff, NULL);
+    }
+    update_status(compare);
+}
+
+/** Timeout callback: editing paused, so compare again. */
+static gboolean recompare(gpointer user_data)
+{
+    GHexEditCompareView *compare = GHEXEDIT_COMPARE_VIEW(user_data);
+    compare->recompare_source = 0;
+    run_diff(compare);
+    return G_SOURCE_REMOVE;
+}
+
+/** Buffer::changed callback: ranges may have moved, so compare again shortly. */
+static void buffer_changed(GHexEditBuffer *buffer, guint64 offset, guint64 removed, guint64 added, gpointer user_data)
+{
+    GHexEditCompareView *compare = GHEXEDIT_COMPARE_VIEW(user_data);
+    stop_diff(compare);
+    update_status(compare);
+    if (compare->recompare_source == 0)
+        compare->recompare_source = g_timeout_add(RECOMPARE_DELAY, recompare, compare);
+}
+
+/** Select a range in both views, cursor at its start. */
+static void select_range(GHexEditCompareView *compare, GHexEditDiffRange const *range)
+{
+    guint64 last = range->offset + MAX(range->length, 1) - 1;
+    GHexEditHexView *views[] = {GHEXEDIT_HEX_VIEW(compare->left), GHEXEDIT_HEX_VIEW(compare->right)};
+    for (gsize i = 0; i < G_N_ELEMENTS(views); ++i)
+    {
+        ghexedit_hex_view_set_cursor(views[i], last, FALSE);
+        ghexedit_hex_view_set_cursor(views[i], range->offset, TRUE);
+    }
+}
+
+
+/* ===[ Scrolling ]=== */
+/** The matching adjustment on the other side. */
+static GtkAdjustment *partner(GHexEditCompareView *compare, GtkAdjustment *adjustment)
+{
+    GtkScrolledWindow *left = GTK_SCROLLED_WINDOW(compare->left_scrolled);
+    GtkScrolledWindow *right = GTK_SCROLLED_WINDOW(compare->right_scrolled);
+    if (adjustment == gtk_scrolled_window_get_vadjustment(left))
+        return gtk_scrolled_window_get_vadjustment(right);
+    if (adjustment == gtk_scrolled_window_get_vadjustment(right))
+        return gtk_scrolled_window_get_vadjustment(left);
+    if (adjustment == gtk_scrolled_window_get_hadjustment(left))
+        return gtk_scrolled_window_get_hadjustment(right);
+    return gtk_scrolled_window_get_hadjustment(left);
+}
+
+/**
+ * Adjustment::value-changed callback: scroll the other side to match. Rows
+ * line up since both views follow the same settings. Each side clamps to its
+ * own length, and that clamping isn't copied back.
+ */
+static void scrolled(GtkAdjustment *adjustment, gpointer user_data)
+{
+    GHexEditCompareView *compare = GHEXEDIT_COMPARE_VIEW(user_data);
+    if (compare->syncing)
+        return;
+    compare->syncing = TRUE;
+    gtk_adjustment_set_value(partner(compare, adjustment), gtk_adjustment_get_value(adjustment));
+    compare->syncing = FALSE;
+}
+
+/** EventControllerFocus::enter callback: navigate from this side. */
+static void view_focused(GtkEventControllerFocus *controller, gpointer user_data)
+{
+    GHexEditCompareView *compare = GHEXEDIT_COMPARE_VIEW(user_data);
+    compare->focus_view = GHEXEDIT_HEX_VIEW(gtk_event_controller_get_widget(GTK_EVENT_CONTROLLER(controller)));
+}
+
+/** Button::clicked callback. */
+static void next_clicked(GtkButton *button, gpointer compare)
+{
+    ghexedit_compare_view_jump(GHEXEDIT_COMPARE_VIEW(compare), TRUE);
+}
+
+/** Button::clicked callback. */
+static void previous_clicked(GtkButton *button, gpointer compare)
+{
+    ghexedit_compare_view_jump(GHEXEDIT_COMPARE_VIEW(compare), FALSE);
+}
+
+
+/* ===[ GHexEditCompareView ]=== */
+/** The side that last had focus, the left one at first. */
+GHexEditHexView *ghexedit_compare_view_get_focus_view(GHexEditCompareView *compare)
+{
+    return compare->focus_view;
+}
+
+/** Select the next or previous difference relative to the cursor, wrapping around. */
+void ghexedit_compare_view_jump(GHexEditCompareView *compare, gboolean forward)
+{
+    if (compare->diff == NULL || ghexedit_diff_get_n_ranges(compare->diff) == 0)
+    {
+        gtk_widget_error_bell(GTK_WIDGET(compare));
+        return;
+    }
+    guint64 start, end;
+    ghexedit_hex_view_get_selection(compare->focus_view, &start, &end);
+    GHexEditDiffRange const *range = ghexedit_diff_find(compare->diff, start, forward);
+    if (range == NULL)
+        range = ghexedit_diff_get_range(compare->diff, forward ? 0 : ghexedit_diff_get_n_ranges(compare->diff) - 1);
+    select_range(compare, range);
+}
+
+
+/* ===[ GObject ]=== */
+/** Instantiate a new instance of the class, comparing `a` (left) with `b` (right). */
+GtkWidget *ghexedit_compare_view_new(GHexEditBuffer *a, GHexEditBuffer *b)
+{
+    GHexEditCompareView *compare = g_object_new(GHEXEDIT_TYPE_COMPARE_VIEW, NULL);
+    ghexedit_hex_view_set_underlying(GHEXEDIT_HEX_VIEW(compare->left), a);
+    ghexedit_hex_view_set_underlying(GHEXEDIT_HEX_VIEW(compare->right), b);
+    ghexedit_hex_view_set_reference(GHEXEDIT_HEX_VIEW(compare->left), b);
+    ghexedit_hex_view_set_reference(GHEXEDIT_HEX_VIEW(compare->right), a);
+    g_signal_connect(a, "changed", G_CALLBACK(buffer_changed), compare);
+    if (b != a)
+        g_signal_connect(b, "changed", G_CALLBACK(buffer_changed), compare);
+    run_diff(compare);
+    return GTK_WIDGET(compare);
+}
+
+/**
+ * Drop held references.
+ * Can be executed more than once!
+ * Should chain up before returning.
+ */
+void ghexedit_compare_view_dispose(GObject *object)
+{
+    GHexEditCompareView *compare = GHEXEDIT_COMPARE_VIEW(object);
+    stop_diff(compare);
+    if (compare->recompare_source)
+    {
+        g_source_remove(compare->recompare_source);
+        compare->recompare_source = 0;
+    }
+    GtkWidget *views[] = {compare->left, compare->right};
+    for (gsize i = 0; i < G_N_ELEMENTS(views); ++i)
+    {
+        GHexEditBuffer *buffer = views[i] ? ghexedit_hex_view_get_underlying(GHEXEDIT_HEX_VIEW(views[i])) : NULL;
+        if (buffer)
+            g_signal_handlers_disconnect_by_func(buffer, buffer_changed, compare);
+    }
+    GtkWidget *child;
+    while ((child = gtk_widget_get_first_child(GTK_WIDGET(compare))))
+        gtk_widget_unparent(child);
+    compare->left = compare->right = NULL;
+    G_OBJECT_CLASS(ghexedit_compare_view_parent_class)->dispose(object);
+}
+
+
+/* ===[ Base GLib ]=== */
+/** Equivalent to C++ constructor. */
+void ghexedit_compare_view_init(GHexEditCompareView *compare)
+{
+    // Create child widgets from class template
+    gtk_widget_init_template(GTK_WIDGET(compare));
+    compare->focus_view = GHEXEDIT_HEX_VIEW(compare->left);
+
+    // Scroll both sides together
+    GtkScrolledWindow *sides[] = {GTK_SCROLLED_WINDOW(compare->left_scrolled), GTK_SCROLLED_WINDOW(compare->right_scrolled)};
+    for (gsize i = 0; i < G_N_ELEMENTS(sides); ++i)
+    {
+        g_signal_connect(gtk_scrolled_window_get_vadjustment(sides[i]), "value-changed", G_CALLBACK(scrolled), compare);
+        g_signal_connect(gtk_scrolled_window_get_hadjustment(sides[i]), "value-changed", G_CALLBACK(scrolled), compare);
+    }
+    GtkWidget *views[] = {compare->left, compare->right};
+    for (gsize i = 0; i < G_N_ELEMENTS(views); ++i)
+    {
+        GtkEventController *focus = gtk_event_controller_focus_new();
+        g_signal_connect(focus, "enter", G_CALLBACK(view_focused), compare);
+        gtk_widget_add_controller(views[i], focus);
+    }
+
+    g_signal_connect(compare->next, "clicked", G_CALLBACK(next_clicked), compare);
+    g_signal_connect(compare->previous, "clicked", G_CALLBACK(previous_clicked), compare);
+}
+
+/**
+ * Called upon first instantiation of an object of this class.
+ * Sets/overrides class methods/signals/properties.
+ */
+void ghexedit_compare_view_class_init(GHexEditCompareViewClass *class)
+{
+    G_OBJECT_CLASS(class)->dispose = ghexedit_compare_view_dispose;
+    // Template uses custom widget types
+    g_type_ensure(GHEXEDIT_TYPE_HEX_VIEW);
+    // Set widget template
+    gtk_widget_class_set_template_from_resource(GTK_WIDGET_CLASS(class), GHX_GRESOURCE_PREFIX "CompareView.ui");
+    // Bind class children in template
+    gtk_widget_class_bind_template_child(GTK_WIDGET_CLASS(class), GHexEditCompareView, status);
+    gtk_widget_class_bind_template_child(GTK_WIDGET_CLASS(class), GHexEditCompareView, previous);
+    gtk_widget_class_bind_template_child(GTK_WIDGET_CLASS(class), GHexEditCompareView, next);
+    gtk_widget_class_bind_template_child(GTK_WIDGET_CLASS(class), GHexEditCompareView, left_scrolled);
+    gtk_widget_class_bind_template_child(GTK_WIDGET_CLASS(class), GHexEditCompareView, right_scrolled);
+    gtk_widget_class_bind_template_child(GTK_WIDGET_CLASS(class), GHexEditCompareView, left);
+    gtk_widget_class_bind_template_child(GTK_WIDGET_CLASS(class), GHexEditCompareView, right);
+}
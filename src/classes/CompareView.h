@@ -0,0 +1,35 @@
+/**
+ * CompareView.h - Two HexViews side by side, highlighting differences.
+ * Copyright (C) 2022 Trevor Last
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _GHX_COMPAREVIEW_H
+#define _GHX_COMPAREVIEW_H
+
+#include "HexView.h"
+#include "engine/Buffer.h"
+
+#include <gtk/gtk.h>
+
+
+#define GHEXEDIT_TYPE_COMPARE_VIEW ghexedit_compare_view_get_type()
+G_DECLARE_FINAL_TYPE (GHexEditCompareView, ghexedit_compare_view, GHEXEDIT, COMPARE_VIEW, GtkWidget);
+
+GtkWidget *ghexedit_compare_view_new(GHexEditBuffer *a, GHexEditBuffer *b);
+GHexEditHexView *ghexedit_compare_view_get_focus_view(GHexEditCompareView *compare);
+void ghexedit_compare_view_jump(GHexEditCompareView *compare, gboolean forward);
+
+#endif
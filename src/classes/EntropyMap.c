@@ -0,0 +1,460 @@
+/**
+ * EntropyMap.c - Entropy strip for a HexView's buffer.
+ * Copyright (C) 2022 Trevor Last
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "EntropyMap.h"
+#include "engine/Buffer.h"
+#include "engine/Session.h"
+
+#include <gtk/gtk.h>
+
+
+/** Strip width, in pixels. */
+#define MAP_WIDTH 24
+/** Wait this long after an edit before analysing again, in milliseconds. */
+#define REANALYSE_DELAY 500
+
+/**
+ * Top to bottom, the strip shows a window of the buffer, the whole of it
+ * until zoomed with Ctrl+scroll. Each pixel row is coloured by the entropy
+ * of the bytes it covers, looked up at the matching level of the analysis.
+ */
+struct _GHexEditEntropyMap
+{
+    GtkWidget parent;
+    GHexEditHexView *view;
+    GHexEditBuffer *buffer;
+    GtkAdjustment *vadjustment;
+    GHexEditEntropy *analysis;
+    guint reanalyse_source;
+    /** First byte shown, and how many; 0 for the whole buffer. */
+    guint64 window_start;
+    guint64 window_length;
+    double pointer_y;
+};
+
+G_DEFINE_TYPE(GHexEditEntropyMap, ghexedit_entropy_map, GTK_TYPE_WIDGET)
+
+typedef enum
+{
+    PROP_ANALYSIS = 1,
+    N_PROPERTIES
+} GHexEditEntropyMapProperty;
+
+static GParamSpec *properties[N_PROPERTIES] = {NULL,};
+
+
+/* ===[ Layout ]=== */
+/** The bytes currently shown, clamped to the analysed size. */
+static void get_window(GHexEditEntropyMap *map, guint64 *start, guint64 *length)
+{
+    guint64 size = map->analysis ? ghexedit_entropy_get_size(map->analysis) : 0;
+    if (map->window_length == 0 || map->window_length >= size)
+    {
+        *start = 0;
+        *length = size;
+        return;
+    }
+    *length = map->window_length;
+    *start = MIN(map->window_start, size - *length);
+}
+
+/** Byte offset at widget height `y`. */
+static guint64 offset_at(GHexEditEntropyMap *map, double y)
+{
+    guint64 start, length;
+    get_window(map, &start, &length);
+    double height = MAX(gtk_widget_get_height(GTK_WIDGET(map)), 1);
+    double fraction = CLAMP(y / height, 0, 1);
+    return start + MIN((guint64)(fraction * length), length ? length - 1 : 0);
+}
+
+
+/* ===[ Drawing ]=== */
+/** Colour for `bits` of entropy per byte: dark for fill, green for code and text, red for compressed or encrypted. */
+static void entropy_color(float bits, GdkRGBA *color)
+{
+    static struct { float bits; GdkRGBA color; } const stops[] = {
+        {0.0f, {0.05f, 0.05f, 0.20f, 1.0f}},
+        {4.0f, {0.10f, 0.55f, 0.30f, 1.0f}},
+        {6.5f, {0.95f, 0.80f, 0.10f, 1.0f}},
+        {8.0f, {0.90f, 0.10f, 0.10f, 1.0f}},
+    };
+    gsize i = 1;
+    while (i + 1 < G_N_ELEMENTS(stops) && bits > stops[i].bits)
+        ++i;
+    float t = CLAMP((bits - stops[i - 1].bits) / (stops[i].bits - stops[i - 1].bits), 0.0f, 1.0f);
+    color->red = stops[i - 1].color.red + t * (stops[i].color.red - stops[i - 1].color.red);
+    color->green = stops[i - 1].color.green + t * (stops[i].color.green - stops[i - 1].color.green);
+    color->blue = stops[i - 1].color.blue + t * (stops[i].color.blue - stops[i - 1].color.blue);
+    color->alpha = 1.0f;
+}
+
+/** Shade the part of the window the view is scrolled to. */
+static void draw_viewport(GHexEditEntropyMap *map, GtkSnapshot *snapshot, int width, int height)
+{
+    guint64 start, length;
+    get_window(map, &start, &length);
+    double upper = map->vadjustment ? gtk_adjustment_get_upper(map->vadjustment) : 0;
+    if (upper <= 0 || length == 0)
+        return;
+    double size = ghexedit_entropy_get_size(map->analysis);
+    double top = gtk_adjustment_get_value(map->vadjustment) / upper * size;
+    double bottom = (gtk_adjustment_get_value(map->vadjustment) + gtk_adjustment_get_page_size(map->vadjustment)) / upper * size;
+    double y0 = (top - start) / length * height;
+    double y1 = MAX((bottom - start) / length * height, y0 + 2);
+    if (y1 < 0 || y0 > height)
+        return;
+    GdkRGBA const shade = {1, 1, 1, 0.35f};
+    GdkRGBA const edge = {1, 1, 1, 0.9f};
+    gtk_snapshot_append_color(snapshot, &shade, &GRAPHENE_RECT_INIT(0, y0, width, y1 - y0));
+    gtk_snapshot_append_color(snapshot, &edge, &GRAPHENE_RECT_INIT(0, y0, width, 1));
+    gtk_snapshot_append_color(snapshot, &edge, &GRAPHENE_RECT_INIT(0, y1 - 1, width, 1));
+}
+
+/** Draw a row per pixel, runs of one colour as one rectangle. */
+void ghexedit_entropy_map_snapshot(GtkWidget *widget, GtkSnapshot *snapshot)
+{
+    GHexEditEntropyMap *map = GHEXEDIT_ENTROPY_MAP(widget);
+    int width = gtk_widget_get_width(widget);
+    int height = gtk_widget_get_height(widget);
+    guint64 start, length;
+    get_window(map, &start, &length);
+    if (length == 0 || height <= 0)
+        return;
+
+    // Not analysed yet
+    GdkRGBA const pending = {0.5f, 0.5f, 0.5f, 0.3f};
+    guint64 span = MAX(length / height, 1);
+    GdkRGBA run_color = pending;
+    int run_start = 0;
+    for (int y = 0; y <= height; ++y)
+    {
+        GdkRGBA color = pending;
+        float bits;
+        if (y < height && ghexedit_entropy_lookup(map->analysis, start + (guint64)((double)y / height * length), span, &bits))
+            entropy_color(bits, &color);
+        if (y == height || !gdk_rgba_equal(&color, &run_color))
+        {
+            if (y > run_start)
+                gtk_snapshot_append_color(snapshot, &run_color, &GRAPHENE_RECT_INIT(0, run_start, width, y - run_start));
+            run_color = color;
+            run_start = y;
+        }
+    }
+    draw_viewport(map, snapshot, width, height);
+}
+
+/** A fixed-width strip, any height. */
+void ghexedit_entropy_map_measure(GtkWidget *widget, GtkOrientation orientation, int for_size, int *minimum, int *natural, int *minimum_baseline, int *natural_baseline)
+{
+    *minimum = *natural = orientation == GTK_ORIENTATION_HORIZONTAL ? MAP_WIDTH : 0;
+}
+
+
+/* ===[ Input ]=== */
+/** Scroll the view so the byte at `y` is in the middle. */
+static void scroll_view_to(GHexEditEntropyMap *map, double y)
+{
+    if (map->analysis == NULL || map->vadjustment == NULL)
+        return;
+    guint64 size = ghexedit_entropy_get_size(map->analysis);
+    if (size == 0)
+        return;
+    double upper = gtk_adjustment_get_upper(map->vadjustment);
+    double page = gtk_adjustment_get_page_size(map->vadjustment);
+    gtk_adjustment_set_value(map->vadjustment, (double)offset_at(map, y) / size * upper - page / 2);
+}
+
+/** GestureDrag::drag-begin callback: jump there. */
+static void drag_begin(GtkGestureDrag *gesture, double x, double y, gpointer map)
+{
+    scroll_view_to(GHEXEDIT_ENTROPY_MAP(map), y);
+}
+
+/** GestureDrag::drag-update callback: follow the pointer. */
+static void drag_update(GtkGestureDrag *gesture, double offset_x, double offset_y, gpointer map)
+{
+    double x, y;
+    gtk_gesture_drag_get_start_point(gesture, &x, &y);
+    scroll_view_to(GHEXEDIT_ENTROPY_MAP(map), y + offset_y);
+}
+
+/** EventControllerMotion::motion callback: remember where to zoom around. */
+static void pointer_moved(GtkEventControllerMotion *controller, double x, double y, gpointer map)
+{
+    GHEXEDIT_ENTROPY_MAP(map)->pointer_y = y;
+}
+
+/**
+ * EventControllerScroll::scroll callback: Ctrl zooms around the pointer,
+ * which only changes which level is looked up. Otherwise pan while zoomed.
+ */
+static gboolean scrolled(GtkEventControllerScroll *controller, double dx, double dy, gpointer user_data)
+{
+    GHexEditEntropyMap *map = GHEXEDIT_ENTROPY_MAP(user_data);
+    guint64 start, length;
+    get_window(map, &start, &length);
+    if (length == 0 || dy == 0)
+        return GDK_EVENT_PROPAGATE;
+    guint64 size = ghexedit_entropy_get_size(map->analysis);
+    double height = MAX(gtk_widget_get_height(GTK_WIDGET(map)), 1);
+
+    GdkModifierType state = gtk_event_controller_get_current_event_state(GTK_EVENT_CONTROLLER(controller));
+    if (state & GDK_CONTROL_MASK)
+    {
+        // Down to a pixel per block
+        guint64 minimum = MIN((guint64)height * ghexedit_entropy_get_block_size(map->analysis), size);
+        double zoomed = dy > 0 ? length * 2.0 : length / 2.0;
+        guint64 new_length = CLAMP((guint64)zoomed, minimum, size);
+        double fraction = CLAMP(map->pointer_y / height, 0, 1);
+        guint64 anchor = start + (guint64)(fraction * length);
+        guint64 before = fraction * new_length;
+        map->window_start = MIN(anchor > before ? anchor - before : 0, size - new_length);
+        map->window_length = new_length < size ? new_length : 0;
+    }
+    else if (map->window_length)
+    {
+        double step = dy * length / 10;
+        map->window_start = step < 0 ? start - MIN((guint64)-step, start) : MIN(start + (guint64)step, size - length);
+    }
+    else
+        return GDK_EVENT_PROPAGATE;
+    gtk_widget_queue_draw(GTK_WIDGET(map));
+    return GDK_EVENT_STOP;
+}
+
+/** Widget::query-tooltip callback: offset and entropy under the pointer. */
+static gboolean query_tooltip(GtkWidget *widget, int x, int y, gboolean keyboard_mode, GtkTooltip *tooltip, gpointer user_data)
+{
+    GHexEditEntropyMap *map = GHEXEDIT_ENTROPY_MAP(widget);
+    guint64 start, length;
+    get_window(map, &start, &length);
+    if (length == 0)
+        return FALSE;
+    guint64 offset = offset_at(map, y);
+    guint64 span = MAX(length / MAX(gtk_widget_get_height(widget), 1), 1);
+    float bits;
+    char *text;
+    GError const *error = ghexedit_entropy_get_error(map->analysis);
+    if (ghexedit_entropy_lookup(map->analysis, offset, span, &bits))
+        text = g_strdup_printf("0x%08" G_GINT64_MODIFIER "x: %.2f bits/byte", offset, bits);
+    else if (error)
+        text = g_strdup_printf("0x%08" G_GINT64_MODIFIER "x: not analysed: %s", offset, error->message);
+    else
+        text = g_strdup_printf("0x%08" G_GINT64_MODIFIER "x: not analysed yet", offset);
+    gtk_tooltip_set_text(tooltip, text);
+    g_free(text);
+    return TRUE;
+}
+
+
+/* ===[ Analysis ]=== */
+/** Entropy::notify::progress callback: more of the strip can be coloured. */
+static void analysis_progress(GHexEditEntropy *analysis, GParamSpec *pspec, gpointer map)
+{
+    gtk_widget_queue_draw(GTK_WIDGET(map));
+}
+
+/** The session of the file mapped, if it is as on disk; analyses kept there describe it. */
+static GHexEditSession *unmodified_session(GHexEditEntropyMap *map)
+{
+    GHexEditSession *session = map->view ? ghexedit_hex_view_get_session(map->view) : NULL;
+    return session && map->buffer && !ghexedit_buffer_get_modified(map->buffer) ? session : NULL;
+}
+
+/** Entropy::notify::finished callback: keep a full analysis of the file with its session. */
+static void analysis_finished(GHexEditEntropy *analysis, GParamSpec *pspec, gpointer user_data)
+{
+    GHexEditSession *session = unmodified_session(GHEXEDIT_ENTROPY_MAP(user_data));
+    GVariant *saved = session ? ghexedit_entropy_save(analysis) : NULL;
+    if (saved)
+        ghexedit_session_set_analysis(session, "entropy", saved);
+}
+
+/**
+ * Analyse the current buffer from scratch, or take the analysis saved with
+ * its session if it hasn't been edited.
+ */
+static void reanalyse(GHexEditEntropyMap *map)
+{
+    if (map->analysis)
+    {
+        ghexedit_entropy_cancel(map->analysis);
+        g_signal_handlers_disconnect_by_data(map->analysis, map);
+        g_clear_object(&map->analysis);
+    }
+    GHexEditSession *session = unmodified_session(map);
+    GVariant *saved = session ? ghexedit_session_get_analysis(session, "entropy") : NULL;
+    if (saved)
+        map->analysis = ghexedit_entropy_new_saved(map->buffer, saved);
+    if (map->buffer && map->analysis == NULL)
+    {
+        map->analysis = ghexedit_entropy_new(map->buffer);
+        g_signal_connect(map->analysis, "notify::progress", G_CALLBACK(analysis_progress), map);
+        g_signal_connect(map->analysis, "notify::finished", G_CALLBACK(analysis_finished), map);
+        ghexedit_entropy_start(map->analysis, NULL);
+    }
+    gtk_widget_queue_draw(GTK_WIDGET(map));
+    g_object_notify_by_pspec(G_OBJECT(map), properties[PROP_ANALYSIS]);
+}
+
+/** Timeout callback: editing paused, so analyse again. */
+static gboolean reanalyse_timeout(gpointer user_data)
+{
+    GHexEditEntropyMap *map = GHEXEDIT_ENTROPY_MAP(user_data);
+    map->reanalyse_source = 0;
+    reanalyse(map);
+    return G_SOURCE_REMOVE;
+}
+
+/** Buffer::changed callback: the analysis is stale; redo it once editing pauses. */
+static void buffer_changed(GHexEditBuffer *buffer, guint64 offset, guint64 removed, guint64 added, gpointer user_data)
+{
+    GHexEditEntropyMap *map = GHEXEDIT_ENTROPY_MAP(user_data);
+    if (map->reanalyse_source)
+        g_source_remove(map->reanalyse_source);
+    map->reanalyse_source = g_timeout_add(REANALYSE_DELAY, reanalyse_timeout, map);
+}
+
+/** Adjustment::value-changed and ::changed callback: move the viewport marker. */
+static void view_scrolled(GtkAdjustment *adjustment, gpointer map)
+{
+    gtk_widget_queue_draw(GTK_WIDGET(map));
+}
+
+/** HexView::notify::underlying callback: follow the view to its new buffer. */
+static void view_underlying(GHexEditHexView *view, GParamSpec *pspec, gpointer user_data)
+{
+    GHexEditEntropyMap *map = GHEXEDIT_ENTROPY_MAP(user_data);
+    if (map->buffer)
+        g_signal_handlers_disconnect_by_func(map->buffer, buffer_changed, map);
+    g_set_object(&map->buffer, view ? ghexedit_hex_view_get_underlying(view) : NULL);
+    if (map->buffer)
+        g_signal_connect(map->buffer, "changed", G_CALLBACK(buffer_changed), map);
+    if (map->reanalyse_source)
+    {
+        g_source_remove(map->reanalyse_source);
+        map->reanalyse_source = 0;
+    }
+    map->window_start = map->window_length = 0;
+    reanalyse(map);
+}
+
+
+/* ===[ GHexEditEntropyMap ]=== */
+/** Map the contents of `view` from now on; NULL stops analysing. */
+void ghexedit_entropy_map_set_view(GHexEditEntropyMap *map, GHexEditHexView *view)
+{
+    if (map->view == view)
+        return;
+    if (map->view)
+        g_signal_handlers_disconnect_by_func(map->view, view_underlying, map);
+    if (map->vadjustment)
+        g_signal_handlers_disconnect_by_func(map->vadjustment, view_scrolled, map);
+    g_set_object(&map->view, view);
+    g_set_object(&map->vadjustment, view ? gtk_scrollable_get_vadjustment(GTK_SCROLLABLE(view)) : NULL);
+    if (map->view)
+        g_signal_connect(map->view, "notify::underlying", G_CALLBACK(view_underlying), map);
+    if (map->vadjustment)
+    {
+        g_signal_connect(map->vadjustment, "value-changed", G_CALLBACK(view_scrolled), map);
+        g_signal_connect(map->vadjustment, "changed", G_CALLBACK(view_scrolled), map);
+    }
+    view_underlying(view, NULL, map);
+}
+
+/** The analysis being drawn, or NULL without a buffer. */
+GHexEditEntropy *ghexedit_entropy_map_get_analysis(GHexEditEntropyMap *map)
+{
+    return map->analysis;
+}
+
+
+/* ===[ GObject ]=== */
+/** Instantiate a new instance of the class. */
+GtkWidget *ghexedit_entropy_map_new()
+{
+    return g_object_new(GHEXEDIT_TYPE_ENTROPY_MAP, NULL);
+}
+
+/** Called when a property is read with g_object_get. */
+void ghexedit_entropy_map_get_property(GObject *object, guint property_id, GValue *value, GParamSpec *pspec)
+{
+    GHexEditEntropyMap *map = GHEXEDIT_ENTROPY_MAP(object);
+    switch ((GHexEditEntropyMapProperty)property_id)
+    {
+    case PROP_ANALYSIS:
+        g_value_set_object(value, map->analysis);
+        break;
+    default:
+        G_OBJECT_WARN_INVALID_PROPERTY_ID(object, property_id, pspec);
+        break;
+    }
+}
+
+/**
+ * Drop held references.
+ * Can be executed more than once!
+ * Should chain up before returning.
+ */
+void ghexedit_entropy_map_dispose(GObject *object)
+{
+    GHexEditEntropyMap *map = GHEXEDIT_ENTROPY_MAP(object);
+    ghexedit_entropy_map_set_view(map, NULL);
+    G_OBJECT_CLASS(ghexedit_entropy_map_parent_class)->dispose(object);
+}
+
+
+/* ===[ Base GLib ]=== */
+/** Equivalent to C++ constructor. */
+void ghexedit_entropy_map_init(GHexEditEntropyMap *map)
+{
+    // Click or drag to scroll the view there
+    GtkGesture *drag = gtk_gesture_drag_new();
+    g_signal_connect(drag, "drag-begin", G_CALLBACK(drag_begin), map);
+    g_signal_connect(drag, "drag-update", G_CALLBACK(drag_update), map);
+    gtk_widget_add_controller(GTK_WIDGET(map), GTK_EVENT_CONTROLLER(drag));
+    // Zoom and pan
+    GtkEventController *motion = gtk_event_controller_motion_new();
+    g_signal_connect(motion, "motion", G_CALLBACK(pointer_moved), map);
+    gtk_widget_add_controller(GTK_WIDGET(map), motion);
+    GtkEventController *scroll = gtk_event_controller_scroll_new(GTK_EVENT_CONTROLLER_SCROLL_VERTICAL);
+    g_signal_connect(scroll, "scroll", G_CALLBACK(scrolled), map);
+    gtk_widget_add_controller(GTK_WIDGET(map), scroll);
+
+    gtk_widget_set_has_tooltip(GTK_WIDGET(map), TRUE);
+    g_signal_connect(map, "query-tooltip", G_CALLBACK(query_tooltip), NULL);
+}
+
+/**
+ * Called upon first instantiation of an object of this class.
+ * Sets/overrides class methods/signals/properties.
+ */
+void ghexedit_entropy_map_class_init(GHexEditEntropyMapClass *class)
+{
+    GObjectClass *klass = G_OBJECT_CLASS(class);
+    GtkWidgetClass *widget_class = GTK_WIDGET_CLASS(class);
+    // Overrides
+    klass->get_property = ghexedit_entropy_map_get_property;
+    klass->dispose = ghexedit_entropy_map_dispose;
+    widget_class->snapshot = ghexedit_entropy_map_snapshot;
+    widget_class->measure = ghexedit_entropy_map_measure;
+    // Install properties
+    properties[PROP_ANALYSIS] = g_param_spec_object("analysis", "Analysis", "Entropy analysis of the view's buffer.", GHEXEDIT_TYPE_ENTROPY, G_PARAM_READABLE);
+    g_object_class_install_properties(klass, N_PROPERTIES, properties);
+}
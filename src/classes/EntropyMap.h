@@ -0,0 +1,35 @@
+/**
+ * EntropyMap.h - Entropy strip for a HexView's buffer.
+ * Copyright (C) 2022 Trevor Last
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _GHX_ENTROPYMAP_H
+#define _GHX_ENTROPYMAP_H
+
+#include "HexView.h"
+#include "engine/Entropy.h"
+
+#include <gtk/gtk.h>
+
+
+#define GHEXEDIT_TYPE_ENTROPY_MAP ghexedit_entropy_map_get_type()
+G_DECLARE_FINAL_TYPE (GHexEditEntropyMap, ghexedit_entropy_map, GHEXEDIT, ENTROPY_MAP, GtkWidget);
+
+GtkWidget *ghexedit_entropy_map_new();
+void ghexedit_entropy_map_set_view(GHexEditEntropyMap *map, GHexEditHexView *view);
+GHexEditEntropy *ghexedit_entropy_map_get_analysis(GHexEditEntropyMap *map);
+
+#endif
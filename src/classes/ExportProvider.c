@@ -0,0 +1,136 @@
+/**
+ * ExportProvider.c - Clipboard contents encoded on demand.
+ * Copyright (C) 2022 Trevor Last
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "ExportProvider.h"
+#include "engine/Buffer.h"
+#include "engine/Export.h"
+
+#include <gtk/gtk.h>
+
+
+/**
+ * Serves a snapshot of the selection to whoever pastes it. Nothing is
+ * encoded until a paste asks for a format, and then it is streamed from a
+ * worker thread, so copying a gigabyte costs no more than copying a byte.
+ */
+struct _GHexEditExportProvider
+{
+    GdkContentProvider parent;
+    GHexEditSnapshot *snapshot;
+    GHexEditExportFormat format;
+};
+
+G_DEFINE_TYPE(GHexEditExportProvider, ghexedit_export_provider, GDK_TYPE_CONTENT_PROVIDER)
+
+
+/* ===[ GdkContentProvider ]=== */
+/**
+ * Raw copies are offered as binary, and as a hex string to text-only
+ * targets; everything else is text.
+ */
+GdkContentFormats *ghexedit_export_provider_ref_formats(GdkContentProvider *provider)
+{
+    GHexEditExportProvider *self = GHEXEDIT_EXPORT_PROVIDER(provider);
+    GdkContentFormatsBuilder *builder = gdk_content_formats_builder_new();
+    if (self->format == GHEXEDIT_EXPORT_RAW)
+        gdk_content_formats_builder_add_mime_type(builder, GHEXEDIT_MIME_BINARY);
+    gdk_content_formats_builder_add_mime_type(builder, GHEXEDIT_MIME_TEXT_UTF8);
+    gdk_content_formats_builder_add_mime_type(builder, GHEXEDIT_MIME_TEXT);
+    return gdk_content_formats_builder_free_to_formats(builder);
+}
+
+/** Export callback: pass the result on to the paste. */
+static void export_done(GObject *source, GAsyncResult *result, gpointer user_data)
+{
+    GTask *task = user_data;
+    GError *error = NULL;
+    if (ghexedit_export_finish(result, &error))
+        g_task_return_boolean(task, TRUE);
+    else
+        g_task_return_error(task, error);
+    g_object_unref(task);
+}
+
+void ghexedit_export_provider_write_mime_type_async(GdkContentProvider *provider, char const *mime_type, GOutputStream *stream, int io_priority, GCancellable *cancellable, GAsyncReadyCallback callback, gpointer user_data)
+{
+    GHexEditExportProvider *self = GHEXEDIT_EXPORT_PROVIDER(provider);
+    GHexEditExportFormat format;
+    if (g_str_equal(mime_type, GHEXEDIT_MIME_BINARY) && self->format == GHEXEDIT_EXPORT_RAW)
+        format = GHEXEDIT_EXPORT_RAW;
+    else if (g_str_equal(mime_type, GHEXEDIT_MIME_TEXT_UTF8) || g_str_equal(mime_type, GHEXEDIT_MIME_TEXT))
+        format = self->format == GHEXEDIT_EXPORT_RAW ? GHEXEDIT_EXPORT_HEX : self->format;
+    else
+    {
+        g_task_report_new_error(provider, callback, user_data, ghexedit_export_provider_write_mime_type_async,
+            G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED, "Cannot provide contents as “%s”", mime_type);
+        return;
+    }
+
+    GTask *task = g_task_new(provider, cancellable, callback, user_data);
+    g_task_set_source_tag(task, ghexedit_export_provider_write_mime_type_async);
+    ghexedit_export_async(self->snapshot, format, stream, io_priority, cancellable, export_done, task);
+}
+
+gboolean ghexedit_export_provider_write_mime_type_finish(GdkContentProvider *provider, GAsyncResult *result, GError **error)
+{
+    g_return_val_if_fail(g_task_is_valid(result, provider), FALSE);
+    return g_task_propagate_boolean(G_TASK(result), error);
+}
+
+
+/* ===[ GHexEditExportProvider ]=== */
+/** Offer `snapshot` encoded as `format`. */
+GdkContentProvider *ghexedit_export_provider_new(GHexEditSnapshot *snapshot, GHexEditExportFormat format)
+{
+    GHexEditExportProvider *provider = g_object_new(GHEXEDIT_TYPE_EXPORT_PROVIDER, NULL);
+    provider->snapshot = ghexedit_snapshot_ref(snapshot);
+    provider->format = format;
+    return GDK_CONTENT_PROVIDER(provider);
+}
+
+/** Free remaining resources. */
+void ghexedit_export_provider_finalize(GObject *object)
+{
+    GHexEditExportProvider *provider = GHEXEDIT_EXPORT_PROVIDER(object);
+    ghexedit_snapshot_unref(provider->snapshot);
+    G_OBJECT_CLASS(ghexedit_export_provider_parent_class)->finalize(object);
+}
+
+
+/* ===[ Base GLib ]=== */
+/** Equivalent to C++ constructor. */
+void ghexedit_export_provider_init(GHexEditExportProvider *provider)
+{
+    provider->snapshot = NULL;
+    provider->format = GHEXEDIT_EXPORT_RAW;
+}
+
+/**
+ * Called upon first instantiation of an object of this class.
+ * Sets/overrides class methods/signals/properties.
+ */
+void ghexedit_export_provider_class_init(GHexEditExportProviderClass *class)
+{
+    GObjectClass *klass = G_OBJECT_CLASS(class);
+    GdkContentProviderClass *provider_class = GDK_CONTENT_PROVIDER_CLASS(class);
+    // Overrides
+    klass->finalize = ghexedit_export_provider_finalize;
+    provider_class->ref_formats = ghexedit_export_provider_ref_formats;
+    provider_class->write_mime_type_async = ghexedit_export_provider_write_mime_type_async;
+    provider_class->write_mime_type_finish = ghexedit_export_provider_write_mime_type_finish;
+}
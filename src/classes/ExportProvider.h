@@ -0,0 +1,38 @@
+/**
+ * ExportProvider.h - Clipboard contents encoded on demand.
+ * Copyright (C) 2022 Trevor Last
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _GHX_EXPORTPROVIDER_H
+#define _GHX_EXPORTPROVIDER_H
+
+#include "engine/Buffer.h"
+#include "engine/Export.h"
+
+#include <gtk/gtk.h>
+
+
+/** Mime types copies are offered as. */
+#define GHEXEDIT_MIME_BINARY "application/octet-stream"
+#define GHEXEDIT_MIME_TEXT_UTF8 "text/plain;charset=utf-8"
+#define GHEXEDIT_MIME_TEXT "text/plain"
+
+#define GHEXEDIT_TYPE_EXPORT_PROVIDER ghexedit_export_provider_get_type()
+G_DECLARE_FINAL_TYPE (GHexEditExportProvider, ghexedit_export_provider, GHEXEDIT, EXPORT_PROVIDER, GdkContentProvider);
+
+GdkContentProvider *ghexedit_export_provider_new(GHexEditSnapshot *snapshot, GHexEditExportFormat format);
+
+#endif
@@ -0,0 +1,393 @@
+/**
+ * FindBar.c - Find bar searching the current HexView.
+ * Copyright (C) 2022 Trevor Last
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "FindBar.h"
+#include "HitList.h"
+#include "engine/Search.h"
+
+#include "appid.h"
+
+#include <gtk/gtk.h>
+
+
+/** Entries of the mode drop-down, in order. */
+typedef enum
+{
+    FIND_MODE_HEX,
+    FIND_MODE_TEXT,
+    FIND_MODE_UTF16LE,
+    FIND_MODE_UTF16BE,
+    FIND_MODE_REGEX,
+} GHexEditFindMode;
+
+/** Entry placeholder for each GHexEditFindMode. */
+static char const *const placeholders[] = {
+    "Hex bytes, e.g. DE AD ?? E?",
+    "Text",
+    "Text stored as UTF-16LE",
+    "Text stored as UTF-16BE",
+    "Regular expression over bytes, e.g. MZ\\x90\\x00",
+};
+
+struct _GHexEditFindBar
+{
+    GtkWidget parent;
+    GtkWidget *mode;
+    GtkWidget *entry;
+    GtkWidget *match_case;
+    GtkWidget *status;
+    GtkWidget *previous;
+    GtkWidget *next;
+    GtkWidget *hits_button;
+    GtkWidget *hits;
+    GHexEditHitList *hit_list;
+    // What is being searched
+    GHexEditHexView *view;
+    GHexEditBuffer *buffer;
+    GHexEditSearch *search;
+    /** Already moved to a match for the current search. */
+    gboolean jumped;
+};
+
+G_DEFINE_TYPE(GHexEditFindBar, ghexedit_find_bar, GTK_TYPE_WIDGET)
+
+
+/* ===[ Searching ]=== */
+/** Describe the search's state in the status label. */
+static void update_status(GHexEditFindBar *bar)
+{
+    char *text = NULL;
+    if (bar->search)
+    {
+        guint n = ghexedit_search_get_n_matches(bar->search);
+        GError const *error = ghexedit_search_get_error(bar->search);
+        if (!ghexedit_search_get_finished(bar->search))
+            text = g_strdup_printf("%u found (%.0f%%)", n, ghexedit_search_get_progress(bar->search) * 100);
+        else if (error)
+            text = g_strdup_printf("Search failed after %u found: %s", n, error->message);
+        else if (n == 0)
+            text = g_strdup("No matches");
+        else
+            text = g_strdup_printf(ghexedit_search_get_truncated(bar->search) ? "%u+ matches" : n == 1 ? "%u match" : "%u matches", n);
+    }
+    gtk_label_set_text(GTK_LABEL(bar->status), text ? text : "");
+    g_free(text);
+}
+
+/** Select a match in the view, cursor at its start. */
+static void select_match(GHexEditFindBar *bar, GHexEditMatch const *match)
+{
+    guint64 last = match->offset + MAX(match->length, 1) - 1;
+    ghexedit_hex_view_set_cursor(bar->view, last, FALSE);
+    ghexedit_hex_view_set_cursor(bar->view, match->offset, TRUE);
+    bar->jumped = TRUE;
+}
+
+/** Search::matches-added callback: go to the first match past the cursor. */
+static void matches_added(GHexEditSearch *search, guint position, guint added, gpointer user_data)
+{
+    GHexEditFindBar *bar = GHEXEDIT_FIND_BAR(user_data);
+    for (guint i = position; i < position + added; ++i)
+    {
+        GHexEditMatch const *match = ghexedit_search_get_match(search, i);
+        ghexedit_hex_view_add_hit(bar->view, match->offset, match->length);
+    }
+    if (!bar->jumped)
+    {
+        guint64 start, end;
+        ghexedit_hex_view_get_selection(bar->view, &start, &end);
+        GHexEditMatch const *first = ghexedit_search_get_match(search, 0);
+        GHexEditMatch const *match = first->offset >= start ? first : ghexedit_search_find(search, start - 1, TRUE);
+        if (match)
+            select_match(bar, match);
+    }
+    update_status(bar);
+}
+
+/** Search::notify::finished callback. */
+static void search_finished(GHexEditSearch *search, GParamSpec *pspec, gpointer user_data)
+{
+    GHexEditFindBar *bar = GHEXEDIT_FIND_BAR(user_data);
+    // Nothing after the cursor; wrap around to the first match
+    if (!bar->jumped && ghexedit_search_get_n_matches(search) > 0)
+        select_match(bar, ghexedit_search_get_match(search, 0));
+    update_status(bar);
+}
+
+/** Search::notify::progress callback. */
+static void search_progress(GHexEditSearch *search, GParamSpec *pspec, gpointer user_data)
+{
+    update_status(GHEXEDIT_FIND_BAR(user_data));
+}
+
+/** Cancel and forget the current search. */
+static void stop_search(GHexEditFindBar *bar)
+{
+    if (bar->search == NULL)
+        return;
+    ghexedit_search_cancel(bar->search);
+    g_signal_handlers_disconnect_by_data(bar->search, bar);
+    if (bar->view)
+        ghexedit_hex_view_clear_hits(bar->view);
+    ghexedit_hit_list_set_search(bar->hit_list, NULL);
+    g_clear_object(&bar->search);
+    update_status(bar);
+}
+
+/** Buffer::changed callback: matches may have moved, so drop them. */
+static void buffer_changed(GHexEditBuffer *buffer, guint64 offset, guint64 removed, guint64 added, gpointer user_data)
+{
+    stop_search(GHEXEDIT_FIND_BAR(user_data));
+}
+
+/** Compile the entry's text according to the selected mode. */
+static GHexEditPattern *parse_query(GHexEditFindBar *bar, GError **error)
+{
+    char const *text = gtk_editable_get_text(GTK_EDITABLE(bar->entry));
+    gboolean match_case = gtk_check_button_get_active(GTK_CHECK_BUTTON(bar->match_case));
+    switch (gtk_drop_down_get_selected(GTK_DROP_DOWN(bar->mode)))
+    {
+    case FIND_MODE_TEXT:
+        return ghexedit_pattern_new_text(text, GHEXEDIT_TEXT_ENCODING_UTF8, match_case, error);
+    case FIND_MODE_UTF16LE:
+        return ghexedit_pattern_new_text(text, GHEXEDIT_TEXT_ENCODING_UTF16LE, match_case, error);
+    case FIND_MODE_UTF16BE:
+        return ghexedit_pattern_new_text(text, GHEXEDIT_TEXT_ENCODING_UTF16BE, match_case, error);
+    case FIND_MODE_REGEX:
+        return ghexedit_pattern_new_regex(text, match_case, error);
+    default:
+        return ghexedit_pattern_new_hex(text, error);
+    }
+}
+
+/** SearchEntry::activate callback: search for the entry's pattern. */
+static void entry_activate(GtkSearchEntry *entry, gpointer user_data)
+{
+    GHexEditFindBar *bar = GHEXEDIT_FIND_BAR(user_data);
+    stop_search(bar);
+    if (bar->buffer == NULL)
+        return;
+
+    GError *error = NULL;
+    GHexEditPattern *pattern = parse_query(bar, &error);
+    if (pattern == NULL)
+    {
+        gtk_widget_add_css_class(bar->entry, "error");
+        gtk_label_set_text(GTK_LABEL(bar->status), error->message);
+        g_error_free(error);
+        return;
+    }
+
+    bar->search = ghexedit_search_new(bar->buffer, pattern);
+    bar->jumped = FALSE;
+    g_signal_connect(bar->search, "matches-added", G_CALLBACK(matches_added), bar);
+    g_signal_connect(bar->search, "notify::finished", G_CALLBACK(search_finished), bar);
+    g_signal_connect(bar->search, "notify::progress", G_CALLBACK(search_progress), bar);
+    ghexedit_hit_list_set_search(bar->hit_list, bar->search);
+    ghexedit_search_start(bar->search, NULL);
+    update_status(bar);
+}
+
+/** SearchEntry::search-changed callback: the old results no longer apply. */
+static void entry_changed(GtkSearchEntry *entry, gpointer user_data)
+{
+    GHexEditFindBar *bar = GHEXEDIT_FIND_BAR(user_data);
+    gtk_widget_remove_css_class(bar->entry, "error");
+    stop_search(bar);
+}
+
+/** DropDown::notify::selected callback: adjust the entry to the new mode. */
+static void mode_changed(GtkDropDown *mode, GParamSpec *pspec, gpointer user_data)
+{
+    GHexEditFindBar *bar = GHEXEDIT_FIND_BAR(user_data);
+    guint selected = gtk_drop_down_get_selected(mode);
+    if (selected < G_N_ELEMENTS(placeholders))
+        g_object_set(bar->entry, "placeholder-text", placeholders[selected], NULL);
+    gtk_widget_set_sensitive(bar->match_case, selected != FIND_MODE_HEX);
+    entry_changed(GTK_SEARCH_ENTRY(bar->entry), bar);
+}
+
+/** CheckButton::toggled callback. */
+static void match_case_toggled(GtkCheckButton *button, gpointer bar)
+{
+    stop_search(GHEXEDIT_FIND_BAR(bar));
+}
+
+/** SignalListItemFactory::setup callback: hit rows are plain labels. */
+static void hit_setup(GtkSignalListItemFactory *factory, GtkListItem *item, gpointer user_data)
+{
+    GtkWidget *label = gtk_label_new(NULL);
+    gtk_label_set_xalign(GTK_LABEL(label), 0);
+    gtk_widget_add_css_class(label, "monospace");
+    gtk_list_item_set_child(item, label);
+}
+
+/** SignalListItemFactory::bind callback. */
+static void hit_bind(GtkSignalListItemFactory *factory, GtkListItem *item, gpointer user_data)
+{
+    GtkStringObject *hit = gtk_list_item_get_item(item);
+    gtk_label_set_text(GTK_LABEL(gtk_list_item_get_child(item)), gtk_string_object_get_string(hit));
+}
+
+/** ListView::activate callback: go to the chosen match. */
+static void hit_activated(GtkListView *hits, guint position, gpointer user_data)
+{
+    GHexEditFindBar *bar = GHEXEDIT_FIND_BAR(user_data);
+    if (bar->search == NULL || position >= ghexedit_search_get_n_matches(bar->search))
+        return;
+    select_match(bar, ghexedit_search_get_match(bar->search, position));
+    gtk_menu_button_popdown(GTK_MENU_BUTTON(bar->hits_button));
+}
+
+/** SearchEntry::next-match and Button::clicked callback. */
+static void next_match(GtkWidget *widget, gpointer bar)
+{
+    ghexedit_find_bar_jump(GHEXEDIT_FIND_BAR(bar), TRUE);
+}
+
+/** SearchEntry::previous-match and Button::clicked callback. */
+static void previous_match(GtkWidget *widget, gpointer bar)
+{
+    ghexedit_find_bar_jump(GHEXEDIT_FIND_BAR(bar), FALSE);
+}
+
+
+/** HexView::notify::underlying callback: search the view's new buffer. */
+static void view_underlying(GHexEditHexView *view, GParamSpec *pspec, gpointer user_data)
+{
+    GHexEditFindBar *bar = GHEXEDIT_FIND_BAR(user_data);
+    stop_search(bar);
+    if (bar->buffer)
+        g_signal_handlers_disconnect_by_func(bar->buffer, buffer_changed, bar);
+    g_set_object(&bar->buffer, view ? ghexedit_hex_view_get_underlying(view) : NULL);
+    if (bar->buffer)
+        g_signal_connect(bar->buffer, "changed", G_CALLBACK(buffer_changed), bar);
+}
+
+
+/* ===[ GHexEditFindBar ]=== */
+/** Search in `view` from now on. */
+void ghexedit_find_bar_set_view(GHexEditFindBar *bar, GHexEditHexView *view)
+{
+    if (bar->view == view)
+        return;
+    if (bar->view)
+    {
+        g_signal_handlers_disconnect_by_func(bar->view, view_underlying, bar);
+        ghexedit_hex_view_clear_hits(bar->view);
+    }
+    g_set_object(&bar->view, view);
+    if (bar->view)
+        g_signal_connect(bar->view, "notify::underlying", G_CALLBACK(view_underlying), bar);
+    view_underlying(view, NULL, bar);
+}
+
+/** The search entry, for GtkSearchBar to hook up. */
+GtkEditable *ghexedit_find_bar_get_entry(GHexEditFindBar *bar)
+{
+    return GTK_EDITABLE(bar->entry);
+}
+
+/** Select the next or previous match relative to the selection, wrapping around. */
+void ghexedit_find_bar_jump(GHexEditFindBar *bar, gboolean forward)
+{
+    if (bar->search == NULL || ghexedit_search_get_n_matches(bar->search) == 0)
+    {
+        gtk_widget_error_bell(GTK_WIDGET(bar));
+        return;
+    }
+    guint64 start, end;
+    ghexedit_hex_view_get_selection(bar->view, &start, &end);
+    GHexEditMatch const *match = ghexedit_search_find(bar->search, start, forward);
+    if (match == NULL)
+        match = ghexedit_search_get_match(bar->search, forward ? 0 : ghexedit_search_get_n_matches(bar->search) - 1);
+    select_match(bar, match);
+}
+
+
+/* ===[ GObject ]=== */
+/** Instantiate a new instance of the class. */
+GtkWidget *ghexedit_find_bar_new()
+{
+    return g_object_new(GHEXEDIT_TYPE_FIND_BAR, NULL);
+}
+
+/**
+ * Drop held references.
+ * Can be executed more than once!
+ * Should chain up before returning.
+ */
+void ghexedit_find_bar_dispose(GObject *object)
+{
+    GHexEditFindBar *bar = GHEXEDIT_FIND_BAR(object);
+    ghexedit_find_bar_set_view(bar, NULL);
+    g_clear_object(&bar->hit_list);
+    GtkWidget *child;
+    while ((child = gtk_widget_get_first_child(GTK_WIDGET(bar))))
+        gtk_widget_unparent(child);
+    G_OBJECT_CLASS(ghexedit_find_bar_parent_class)->dispose(object);
+}
+
+
+/* ===[ Base GLib ]=== */
+/** Equivalent to C++ constructor. */
+void ghexedit_find_bar_init(GHexEditFindBar *bar)
+{
+    // Create child widgets from class template
+    gtk_widget_init_template(GTK_WIDGET(bar));
+    // Matches list, formatted lazily as rows scroll into view
+    bar->hit_list = ghexedit_hit_list_new();
+    GtkNoSelection *selection = gtk_no_selection_new(G_LIST_MODEL(g_object_ref(bar->hit_list)));
+    gtk_list_view_set_model(GTK_LIST_VIEW(bar->hits), GTK_SELECTION_MODEL(selection));
+    g_object_unref(selection);
+    GtkListItemFactory *factory = gtk_signal_list_item_factory_new();
+    g_signal_connect(factory, "setup", G_CALLBACK(hit_setup), NULL);
+    g_signal_connect(factory, "bind", G_CALLBACK(hit_bind), NULL);
+    gtk_list_view_set_factory(GTK_LIST_VIEW(bar->hits), factory);
+    g_object_unref(factory);
+    g_signal_connect(bar->hits, "activate", G_CALLBACK(hit_activated), bar);
+
+    g_signal_connect(bar->mode, "notify::selected", G_CALLBACK(mode_changed), bar);
+    g_signal_connect(bar->match_case, "toggled", G_CALLBACK(match_case_toggled), bar);
+    g_signal_connect(bar->entry, "activate", G_CALLBACK(entry_activate), bar);
+    g_signal_connect(bar->entry, "search-changed", G_CALLBACK(entry_changed), bar);
+    g_signal_connect(bar->entry, "next-match", G_CALLBACK(next_match), bar);
+    g_signal_connect(bar->entry, "previous-match", G_CALLBACK(previous_match), bar);
+    g_signal_connect(bar->next, "clicked", G_CALLBACK(next_match), bar);
+    g_signal_connect(bar->previous, "clicked", G_CALLBACK(previous_match), bar);
+}
+
+/**
+ * Called upon first instantiation of an object of this class.
+ * Sets/overrides class methods/signals/properties.
+ */
+void ghexedit_find_bar_class_init(GHexEditFindBarClass *class)
+{
+    G_OBJECT_CLASS(class)->dispose = ghexedit_find_bar_dispose;
+    // Set widget template
+    gtk_widget_class_set_template_from_resource(GTK_WIDGET_CLASS(class), GHX_GRESOURCE_PREFIX "FindBar.ui");
+    // Bind class children in template
+    gtk_widget_class_bind_template_child(GTK_WIDGET_CLASS(class), GHexEditFindBar, mode);
+    gtk_widget_class_bind_template_child(GTK_WIDGET_CLASS(class), GHexEditFindBar, entry);
+    gtk_widget_class_bind_template_child(GTK_WIDGET_CLASS(class), GHexEditFindBar, match_case);
+    gtk_widget_class_bind_template_child(GTK_WIDGET_CLASS(class), GHexEditFindBar, status);
+    gtk_widget_class_bind_template_child(GTK_WIDGET_CLASS(class), GHexEditFindBar, previous);
+    gtk_widget_class_bind_template_child(GTK_WIDGET_CLASS(class), GHexEditFindBar, next);
+    gtk_widget_class_bind_template_child(GTK_WIDGET_CLASS(class), GHexEditFindBar, hits_button);
+    gtk_widget_class_bind_template_child(GTK_WIDGET_CLASS(class), GHexEditFindBar, hits);
+}
@@ -0,0 +1,35 @@
+/**
+ * FindBar.h - Find bar searching the current HexView.
+ * Copyright (C) 2022 Trevor Last
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _GHX_FINDBAR_H
+#define _GHX_FINDBAR_H
+
+#include "HexView.h"
+
+#include <gtk/gtk.h>
+
+
+#define GHEXEDIT_TYPE_FIND_BAR ghexedit_find_bar_get_type()
+G_DECLARE_FINAL_TYPE (GHexEditFindBar, ghexedit_find_bar, GHEXEDIT, FIND_BAR, GtkWidget);
+
+GtkWidget *ghexedit_find_bar_new();
+void ghexedit_find_bar_set_view(GHexEditFindBar *bar, GHexEditHexView *view);
+GtkEditable *ghexedit_find_bar_get_entry(GHexEditFindBar *bar);
+void ghexedit_find_bar_jump(GHexEditFindBar *bar, gboolean forward);
+
+#endif
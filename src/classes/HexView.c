@@ -1,5 +1,5 @@
 /**
- * HexView.c - View a text buffer as hexadecimal bytes.
+ * HexView.c - View and edit a document as hexadecimal bytes.
  * Copyright (C) 2022 Trevor Last
  *
  *  This program is free software: you can redistribute it and/or modify
@@ -17,22 +17,71 @@
  */
 
 #include "HexView.h"
+#include "ExportProvider.h"
+#include "engine/Buffer.h"
+#include "engine/Export.h"
+#include "engine/HexFormat.h"
+#include "engine/TemplateNode.h"
+#include "engine/Trace.h"
 
 #include "appid.h"
 
 #include <gtk/gtk.h>
 
 
+/** Screens past the visible one to fetch ahead while scrolling. */
+#define READ_AHEAD_SCREENS 4
+/** Least to fetch ahead, so small views still get whole cache pages. */
+#define READ_AHEAD_MIN (256 * 1024)
+
 struct _GHexEditHexView
 {
-    GtkTextView parent;
+    GtkWidget parent;
     GSettings *settings;
     guint bytes_per_line;
     guint grouping;
-    GBytes *underlying;
+    GHexEditBuffer *underlying;
+    /** Buffer to compare against; differing bytes are highlighted. */
+    GHexEditBuffer *reference;
+    /** Template laid over the buffer; its fields are tinted. */
+    GHexEditTemplateNode *overlay;
+    /** Search matches to highlight. */
+    GHexEditRangeSet *hits;
+    /** Edited bytes in view, refilled each frame. */
+    GHexEditRangeSet *edits;
+    /** Bytes in view that couldn't be read, refilled each frame. */
+    GHexEditRangeSet *unreadable;
+    // Scrolling
+    GtkAdjustment *hadjustment;
+    GtkAdjustment *vadjustment;
+    guint hscroll_policy;
+    guint vscroll_policy;
+    /** Byte to keep at the top across a layout change not yet applied. */
+    guint64 scroll_anchor;
+    gboolean relayout_pending;
+    /** Stay at the end while the buffer grows, as long as the end is in view. */
+    gboolean follow_tail;
+    /** Top byte when last scrolled, to tell which way scrolling is going. */
+    guint64 read_ahead_top;
+    /** What drawing has cost so far, for the performance overlay. */
+    GHexEditHexViewStats stats;
+    /** What is remembered about the file between runs, if anything. */
+    GHexEditSession *session;
+    // Font and its cell size in pixels
+    PangoFontDescription *font;
+    int char_width;
+    int line_height;
+    // Cursor and selection anchor, as byte offsets
+    guint64 cursor;
+    guint64 anchor;
+    // Editing state
+    gboolean overwrite;
+    gboolean ascii_side;
+    gboolean low_nibble;
 };
 
-G_DEFINE_TYPE(GHexEditHexView, ghexedit_hex_view, GTK_TYPE_TEXT_VIEW)
+G_DEFINE_TYPE_WITH_CODE(GHexEditHexView, ghexedit_hex_view, GTK_TYPE_WIDGET,
+    G_IMPLEMENT_INTERFACE(GTK_TYPE_SCROLLABLE, NULL))
 
 
 typedef enum
@@ -40,120 +89,1073 @@ typedef enum
     PROP_BYTES_PER_LINE = 1,
     PROP_GROUPING,
     PROP_UNDERLYING,
+    PROP_FONT,
+    PROP_CURSOR,
+    PROP_OVERWRITE,
+    PROP_FOLLOW_TAIL,
+    PROP_REFERENCE,
+    PROP_OVERLAY,
     N_PROPERTIES,
+    // GtkScrollable
+    PROP_HADJUSTMENT = N_PROPERTIES,
+    PROP_VADJUSTMENT,
+    PROP_HSCROLL_POLICY,
+    PROP_VSCROLL_POLICY,
 } GHexEditHexViewProperty;
 
 GParamSpec *properties[N_PROPERTIES] = {NULL,};
 
 
-char nybble_char(guint8 nybble)
+/* ===[ Layout ]=== */
+/** Size of the underlying buffer, or 0 without one. */
+static guint64 buffer_size(GHexEditHexView *view)
+{
+    return view->underlying ? ghexedit_buffer_get_size(view->underlying) : 0;
+}
+
+/**
+ * Number of rows needed to show the whole document.
+ * The cursor may sit one past the last byte to append, so that slot gets a
+ * row too.
+ */
+static guint64 row_count(GHexEditHexView *view)
+{
+    if (view->underlying == NULL)
+        return 0;
+    return buffer_size(view) / view->bytes_per_line + 1;
+}
+
+/** Row layout for the current document and settings. */
+static GHexEditHexFormat row_format(GHexEditHexView *view)
+{
+    guint64 size = buffer_size(view);
+    GHexEditHexFormat format = {
+        .bytes_per_line = view->bytes_per_line,
+        .grouping = view->grouping,
+        .offset_digits = ghexedit_hex_format_offset_digits(size),
+    };
+    return format;
+}
+
+/** Character column where a byte's hex pair starts. Matches HexFormat. */
+static guint hex_column(GHexEditHexView *view, guint byte)
+{
+    GHexEditHexFormat format = row_format(view);
+    return format.offset_digits + 2 + byte * 3 + byte / view->grouping;
+}
+
+/** Character column where a byte's ASCII character is. Matches HexFormat. */
+static guint ascii_column(GHexEditHexView *view, guint byte)
+{
+    return hex_column(view, view->bytes_per_line - 1) + 3 + 2 + byte;
+}
+
+/** Width of a whole row, in characters. */
+static guint line_columns(GHexEditHexView *view)
+{
+    return ascii_column(view, view->bytes_per_line) + 1;
+}
+
+/** Re-measure the font's cell size. */
+static void update_metrics(GHexEditHexView *view)
+{
+    PangoLayout *layout = gtk_widget_create_pango_layout(GTK_WIDGET(view), "0");
+    pango_layout_set_font_description(layout, view->font);
+    pango_layout_get_pixel_size(layout, &view->char_width, &view->line_height);
+    view->char_width = MAX(view->char_width, 1);
+    view->line_height = MAX(view->line_height, 1);
+    g_object_unref(layout);
+}
+
+/** Fit the adjustments to the document and the widget's size. */
+static void update_adjustments(GHexEditHexView *view)
+{
+    double width = gtk_widget_get_width(GTK_WIDGET(view));
+    double height = gtk_widget_get_height(GTK_WIDGET(view));
+
+    if (view->hadjustment)
+    {
+        double upper = (double)line_columns(view) * view->char_width;
+        double value = CLAMP(gtk_adjustment_get_value(view->hadjustment), 0, MAX(0, upper - width));
+        gtk_adjustment_configure(view->hadjustment, value, 0, upper, view->char_width, width * 0.9, width);
+    }
+    if (view->vadjustment)
+    {
+        double upper = (double)row_count(view) * view->line_height;
+        double value = CLAMP(gtk_adjustment_get_value(view->vadjustment), 0, MAX(0, upper - height));
+        gtk_adjustment_configure(view->vadjustment, value, 0, upper, view->line_height, height * 0.9, height);
+    }
+}
+
+/** Content-affecting state changed. */
+static void relayout(GHexEditHexView *view)
+{
+    update_adjustments(view);
+    gtk_widget_queue_draw(GTK_WIDGET(view));
+}
+
+/** First byte of the top visible row. */
+static guint64 top_byte(GHexEditHexView *view)
+{
+    double vvalue = view->vadjustment ? gtk_adjustment_get_value(view->vadjustment) : 0;
+    return (guint64)(vvalue / view->line_height) * view->bytes_per_line;
+}
+
+/**
+ * Call before changing layout-affecting state: remember which byte is at the
+ * top, so the new layout can scroll back to it.
+ */
+static void begin_relayout(GHexEditHexView *view)
+{
+    if (view->relayout_pending)
+        return;
+    view->scroll_anchor = top_byte(view);
+    view->relayout_pending = TRUE;
+}
+
+/** Apply a pending layout change, with the anchor byte's row at the top. */
+static void apply_relayout(GHexEditHexView *view)
 {
-    nybble &= 0x0F;
-    if (nybble < 0xA)
-        return '0' + nybble;
+    update_adjustments(view);
+    if (!view->relayout_pending)
+        return;
+    view->relayout_pending = FALSE;
+    if (view->vadjustment)
+        gtk_adjustment_set_value(view->vadjustment, (double)(view->scroll_anchor / view->bytes_per_line) * view->line_height);
+    gtk_widget_queue_draw(GTK_WIDGET(view));
+}
+
+/**
+ * Call after changing layout-affecting state. Nothing is drawn per layout,
+ * so only the scroll range changes; hidden views wait until they're mapped,
+ * so every open tab following the settings doesn't work at once.
+ */
+static void finish_relayout(GHexEditHexView *view)
+{
+    if (gtk_widget_get_mapped(GTK_WIDGET(view)))
+        apply_relayout(view);
+}
+
+/** Scroll so the cursor's row is visible. */
+static void scroll_to_cursor(GHexEditHexView *view)
+{
+    if (view->vadjustment == NULL)
+        return;
+    double top = (double)(view->cursor / view->bytes_per_line) * view->line_height;
+    double value = gtk_adjustment_get_value(view->vadjustment);
+    double page = gtk_adjustment_get_page_size(view->vadjustment);
+    if (top < value)
+        gtk_adjustment_set_value(view->vadjustment, top);
+    else if (top + view->line_height > value + page)
+        gtk_adjustment_set_value(view->vadjustment, top + view->line_height - page);
+}
+
+/**
+ * Map a widget coordinate to the byte under it, and whether it fell on the
+ * ASCII side.
+ */
+static guint64 byte_at(GHexEditHexView *view, double x, double y, gboolean *ascii_side)
+{
+    double hvalue = view->hadjustment ? gtk_adjustment_get_value(view->hadjustment) : 0;
+    double vvalue = view->vadjustment ? gtk_adjustment_get_value(view->vadjustment) : 0;
+    guint64 row = MAX(0, vvalue + y) / view->line_height;
+    guint column = MAX(0, hvalue + x) / view->char_width;
+
+    guint byte = view->bytes_per_line - 1;
+    *ascii_side = column >= ascii_column(view, 0) - 1;
+    if (*ascii_side)
+        byte = MIN(MAX(column, ascii_column(view, 0)) - ascii_column(view, 0), view->bytes_per_line - 1);
     else
-        return 'A' + (nybble - 0xA);
+    {
+        for (guint b = 0; b < view->bytes_per_line; ++b)
+        {
+            if (column < hex_column(view, b + 1))
+            {
+                byte = b;
+                break;
+            }
+        }
+    }
+
+    return MIN(row * view->bytes_per_line + byte, buffer_size(view));
 }
 
-char make_printable(char ch)
+
+/* ===[ Drawing ]=== */
+/** Fill the cells of bytes [first, last] in one row. */
+static void draw_byte_run(GHexEditHexView *view, GtkSnapshot *snapshot, double y, guint first, guint last, GdkRGBA const *color)
+{
+    double cw = view->char_width;
+    double hex_x = hex_column(view, first) * cw;
+    double hex_w = (hex_column(view, last) + 2) * cw - hex_x;
+    gtk_snapshot_append_color(snapshot, color, &GRAPHENE_RECT_INIT(hex_x, y, hex_w, view->line_height));
+    double ascii_x = ascii_column(view, first) * cw;
+    double ascii_w = (last - first + 1) * cw;
+    gtk_snapshot_append_color(snapshot, color, &GRAPHENE_RECT_INIT(ascii_x, y, ascii_w, view->line_height));
+}
+
+/**
+ * Draw the cursor on byte `b` of the row at `y`: an underline when
+ * overwriting, a caret when inserting. The side being typed into is stronger.
+ */
+static void draw_cursor(GHexEditHexView *view, GtkSnapshot *snapshot, double y, guint b)
 {
-    if (g_ascii_isprint(ch))
-        return ch;
+    static GdkRGBA const active_color = {0.21, 0.52, 0.89, 0.8};
+    static GdkRGBA const inactive_color = {0.21, 0.52, 0.89, 0.35};
+    GdkRGBA const *hex_color = view->ascii_side ? &inactive_color : &active_color;
+    GdkRGBA const *ascii_color = view->ascii_side ? &active_color : &inactive_color;
+
+    double cw = view->char_width;
+    double hex_x = (hex_column(view, b) + view->low_nibble) * cw;
+    double hex_w = (2 - view->low_nibble) * cw;
+    double ascii_x = ascii_column(view, b) * cw;
+    if (view->overwrite)
+    {
+        double under = y + view->line_height - 2;
+        gtk_snapshot_append_color(snapshot, hex_color, &GRAPHENE_RECT_INIT(hex_x, under, hex_w, 2));
+        gtk_snapshot_append_color(snapshot, ascii_color, &GRAPHENE_RECT_INIT(ascii_x, under, cw, 2));
+    }
     else
-        return '.';
+    {
+        gtk_snapshot_append_color(snapshot, hex_color, &GRAPHENE_RECT_INIT(hex_x, y, 2, view->line_height));
+        gtk_snapshot_append_color(snapshot, ascii_color, &GRAPHENE_RECT_INIT(ascii_x, y, 2, view->line_height));
+    }
 }
 
-/** Convert a buffer to hex format. */
-void hex(guint8 const *data, int data_length, guint8 **out, int *out_length, guint bytes_per_line, guint grouping)
+/** Highlight styles, in the order they are drawn beneath the text. */
+typedef enum
 {
-    if (grouping == 0)
-        grouping = 1;
-    if (bytes_per_line == 0)
-        bytes_per_line = 1;
+    STYLE_UNREADABLE,
+    STYLE_EDITED,
+    STYLE_DIFFERENT,
+    STYLE_HIT,
+    STYLE_SELECTED,
+    N_STYLES
+} GHexEditHexViewStyle;
 
-    gsize groups_size = (bytes_per_line / grouping) + 1;
-    gsize line_size = 10 + bytes_per_line * 3 + groups_size + 3 + bytes_per_line + 1;
+static GdkRGBA const style_colors[N_STYLES] = {
+    {0.5, 0.5, 0.5, 0.3},
+    {0.96, 0.47, 0.0, 0.2},
+    {0.88, 0.11, 0.14, 0.3},
+    {0.96, 0.83, 0.18, 0.45},
+    {0.21, 0.52, 0.89, 0.35},
+};
 
-    gsize line_count = (data_length + bytes_per_line - 1) / bytes_per_line;
-    gsize leftover = bytes_per_line - (data_length % bytes_per_line);
-    if (leftover == 16)
-        leftover = 0;
+/** Template field tints, by index within their struct. */
+static GdkRGBA const field_colors[] = {
+    {0.96, 0.76, 0.07, 0.25},
+    {0.18, 0.76, 0.49, 0.25},
+    {0.75, 0.38, 0.84, 0.25},
+    {0.20, 0.70, 0.84, 0.25},
+    {0.96, 0.47, 0.0, 0.25},
+    {0.55, 0.55, 0.55, 0.25},
+};
 
-    *out_length = line_count * line_size;
-    *out = g_malloc0((*out_length) + 1);
+/**
+ * Highlights go to rows [first_row, end_row), the first at the snapshot's
+ * origin. Every style is a set of byte ranges looked up for just these rows,
+ * so drawing costs what's in view, whatever the file size.
+ */
+typedef struct
+{
+    GHexEditHexView *view;
+    GtkSnapshot *snapshot;
+    guint64 first_row;
+    guint64 end_row;
+    GdkRGBA const *color;
+} Painter;
 
-    guint8 *ptr = *out;
-    gsize i = 0;
-    for (i = 0; i < data_length + leftover; ++i)
+/** Fill bytes [start, end) in the painter's colour, a run per visible row; GHexEditRangeFunc. */
+static gboolean paint_range(guint64 start, guint64 end, gpointer user_data)
+{
+    Painter *painter = user_data;
+    guint bpl = painter->view->bytes_per_line;
+    for (guint64 row = MAX(start / bpl, painter->first_row); row < painter->end_row && row * bpl < end; ++row)
     {
-        if (i % bytes_per_line == 0)
+        guint64 row_start = row * bpl;
+        guint64 lo = MAX(start, row_start);
+        guint64 hi = MIN(end, row_start + bpl);
+        draw_byte_run(painter->view, painter->snapshot, (row - painter->first_row) * painter->view->line_height,
+            lo - row_start, hi - 1 - row_start, painter->color);
+    }
+    return TRUE;
+}
+
+/** Template query callback: tint one field. */
+static void paint_field(guint64 offset, guint64 size, guint color, gpointer user_data)
+{
+    Painter *painter = user_data;
+    painter->color = &field_colors[color % G_N_ELEMENTS(field_colors)];
+    paint_range(offset, offset + size, painter);
+}
+
+/**
+ * Highlight bytes of `data`, read at `offset`, that differ from `other` at
+ * the same offsets, including any past the end of `other`.
+ */
+static void paint_differences(Painter *painter, guint64 offset, guint8 const *data, gsize length, guint8 const *other, gsize other_length)
+{
+    painter->color = &style_colors[STYLE_DIFFERENT];
+    for (gsize i = 0; i < length;)
+    {
+        if (i < other_length && data[i] == other[i])
         {
-            for (int n = 0; n < 8; ++n)
-                *ptr++ = nybble_char((i >> (4 * (7 - n))) & 0xF);
-            *ptr++ = ' ';
-            *ptr++ = ' ';
+            ++i;
+            continue;
         }
-        else if (i % grouping == 0)
-            *ptr++ = ' ';
+        gsize end = i + 1;
+        while (end < length && !(end < other_length && data[end] == other[end]))
+            ++end;
+        paint_range(offset + i, offset + end, painter);
+        i = end;
+    }
+}
+
+/**
+ * Draw every highlight within rows [first_row, first_row + rows), whose
+ * `length` bytes are `data`, then the cursor.
+ */
+static void draw_highlights(GHexEditHexView *view, GtkSnapshot *snapshot, guint64 first_row, guint64 rows, guint8 const *data, gsize length)
+{
+    Painter painter = {view, snapshot, first_row, first_row + rows, NULL};
+    guint bpl = view->bytes_per_line;
+    guint64 start = first_row * bpl;
+    guint64 end = (first_row + rows) * bpl;
+
+    painter.color = &style_colors[STYLE_UNREADABLE];
+    ghexedit_range_set_foreach(view->unreadable, start, end, paint_range, &painter);
+
+    // Edits are looked up in the buffer's pieces, reusing one set between frames
+    ghexedit_range_set_clear(view->edits);
+    ghexedit_buffer_get_edits(view->underlying, start, end - start, view->edits);
+    painter.color = &style_colors[STYLE_EDITED];
+    ghexedit_range_set_foreach(view->edits, start, end, paint_range, &painter);
+
+    if (view->reference)
+    {
+        guint8 *other = g_malloc(length);
+        gssize other_length = ghexedit_buffer_read(view->reference, start, other, length, NULL);
+        paint_differences(&painter, start, data, length, other, MAX(other_length, 0));
+        g_free(other);
+    }
+    if (view->overlay)
+        ghexedit_template_node_query(view->overlay, start, end, paint_field, &painter);
+
+    painter.color = &style_colors[STYLE_HIT];
+    ghexedit_range_set_foreach(view->hits, start, end, paint_range, &painter);
+
+    guint64 selection_start, selection_end;
+    ghexedit_hex_view_get_selection(view, &selection_start, &selection_end);
+    painter.color = &style_colors[STYLE_SELECTED];
+    paint_range(selection_start, selection_end, &painter);
+
+    if (view->cursor >= start && view->cursor < end && gtk_widget_has_focus(GTK_WIDGET(view)))
+        draw_cursor(view, snapshot, (view->cursor / bpl - first_row) * view->line_height, view->cursor % bpl);
+}
+
+/** Formatted rows, for marking unreadable bytes in. */
+typedef struct
+{
+    GHexEditHexView *view;
+    char *text;
+    gsize line_length;
+    guint64 offset;
+} MaskClosure;
+
+/** Show unreadable bytes as `??` and `?`, so they aren't taken for zeroes; GHexEditRangeFunc. */
+static gboolean mask_range(guint64 start, guint64 end, gpointer user_data)
+{
+    MaskClosure *mask = user_data;
+    guint bpl = mask->view->bytes_per_line;
+    for (guint64 b = start; b < end; ++b)
+    {
+        char *line = mask->text + (b - mask->offset) / bpl * mask->line_length;
+        guint column = (b - mask->offset) % bpl;
+        line[hex_column(mask->view, column)] = '?';
+        line[hex_column(mask->view, column) + 1] = '?';
+        line[ascii_column(mask->view, column)] = '?';
+    }
+    return TRUE;
+}
+
+/** Draw only the rows inside the viewport. */
+void ghexedit_hex_view_snapshot(GtkWidget *widget, GtkSnapshot *snapshot)
+{
+    GHexEditHexView *view = GHEXEDIT_HEX_VIEW(widget);
+    if (view->underlying == NULL)
+        return;
+    gint64 start = g_get_monotonic_time();
+
+    int width = gtk_widget_get_width(widget);
+    int height = gtk_widget_get_height(widget);
+    double hvalue = view->hadjustment ? gtk_adjustment_get_value(view->hadjustment) : 0;
+    double vvalue = view->vadjustment ? gtk_adjustment_get_value(view->vadjustment) : 0;
+
+    guint64 total_rows = row_count(view);
+    guint64 first_row = vvalue / view->line_height;
+    if (first_row >= total_rows)
+        return;
+    guint64 rows = MIN((guint64)(height / view->line_height + 2), total_rows - first_row);
+
+    // Fetch and format just the visible rows
+    guint64 offset = first_row * view->bytes_per_line;
+    guint8 *data = g_malloc(rows * view->bytes_per_line);
+    GHEXEDIT_TRACE_BEGIN(read);
+    gssize length = ghexedit_buffer_read(view->underlying, offset, data, rows * view->bytes_per_line, NULL);
+    GHEXEDIT_TRACE_END(read, "%" G_GUINT64_FORMAT " rows", rows);
+    if (length < 0)
+    {
+        g_free(data);
+        return;
+    }
+    GHEXEDIT_TRACE_BEGIN(format);
+    GHexEditHexFormat format = row_format(view);
+    char *out = g_malloc(ghexedit_hex_format_max_length(&format, length));
+    gsize out_length = ghexedit_hex_format(&format, data, length, offset, out);
+    GHEXEDIT_TRACE_END(format, "%" G_GSSIZE_FORMAT " bytes", length);
+    ghexedit_range_set_clear(view->unreadable);
+    ghexedit_buffer_get_unreadable(view->underlying, offset, length, view->unreadable);
+    MaskClosure mask = {view, out, ghexedit_hex_format_line_length(&format), offset};
+    ghexedit_range_set_foreach(view->unreadable, offset, offset + length, mask_range, &mask);
+
+    GHEXEDIT_TRACE_BEGIN(text_layout);
+    PangoLayout *layout = gtk_widget_create_pango_layout(widget, NULL);
+    pango_layout_set_font_description(layout, view->font);
+    pango_layout_set_text(layout, out, out_length);
+    g_free(out);
+
+    GdkRGBA color;
+    gtk_widget_get_color(widget, &color);
+
+    gtk_snapshot_save(snapshot);
+    gtk_snapshot_push_clip(snapshot, &GRAPHENE_RECT_INIT(0, 0, width, height));
+    gtk_snapshot_translate(snapshot, &GRAPHENE_POINT_INIT(-hvalue, first_row * (double)view->line_height - vvalue));
+    GHEXEDIT_TRACE_BEGIN(highlights);
+    draw_highlights(view, snapshot, first_row, rows, data, length);
+    GHEXEDIT_TRACE_END(highlights, "%" G_GUINT64_FORMAT " rows", rows);
+    g_free(data);
+    gtk_snapshot_append_layout(snapshot, layout, &color);
+    gtk_snapshot_pop(snapshot);
+    gtk_snapshot_restore(snapshot);
+
+    g_object_unref(layout);
+    GHEXEDIT_TRACE_END(text_layout, "%" G_GSIZE_FORMAT " chars", out_length);
 
-        if (i < data_length)
+    view->stats.frames += 1;
+    view->stats.frame_time += g_get_monotonic_time() - start;
+    view->stats.bytes_formatted += length;
+}
+
+/** Preferred size: one row high, and as wide as a row if horizontally unscrolled. */
+void ghexedit_hex_view_measure(GtkWidget *widget, GtkOrientation orientation, int for_size, int *minimum, int *natural, int *minimum_baseline, int *natural_baseline)
+{
+    GHexEditHexView *view = GHEXEDIT_HEX_VIEW(widget);
+    if (orientation == GTK_ORIENTATION_HORIZONTAL)
+    {
+        *minimum = 0;
+        *natural = line_columns(view) * view->char_width;
+    }
+    else
+    {
+        *minimum = 0;
+        *natural = view->line_height;
+    }
+}
+
+/** Resized; the viewport changed. */
+void ghexedit_hex_view_size_allocate(GtkWidget *widget, int width, int height, int baseline)
+{
+    GHEXEDIT_TRACE_BEGIN(allocate);
+    apply_relayout(GHEXEDIT_HEX_VIEW(widget));
+    GHEXEDIT_TRACE_END(allocate, "%dx%d", width, height);
+}
+
+/** Shown; catch up on layout changes made while hidden. */
+void ghexedit_hex_view_map(GtkWidget *widget)
+{
+    GTK_WIDGET_CLASS(ghexedit_hex_view_parent_class)->map(widget);
+    if (GHEXEDIT_HEX_VIEW(widget)->relayout_pending)
+        gtk_widget_queue_allocate(widget);
+}
+
+
+/* ===[ Input ]=== */
+/**
+ * Start fetching the screen scrolled to and a few more beyond it in the
+ * direction of scrolling, so slow sources (network mounts) have them
+ * cached by the time they're drawn.
+ */
+static void read_ahead(GHexEditHexView *view)
+{
+    if (view->underlying == NULL)
+        return;
+    guint64 top = top_byte(view);
+    guint64 screen = (guint64)(gtk_widget_get_height(GTK_WIDGET(view)) / view->line_height + 2) * view->bytes_per_line;
+    guint64 ahead = MAX(READ_AHEAD_SCREENS * screen, READ_AHEAD_MIN);
+    if (top >= view->read_ahead_top)
+        ghexedit_buffer_prefetch(view->underlying, top, screen + ahead);
+    else
+    {
+        guint64 start = top > ahead ? top - ahead : 0;
+        ghexedit_buffer_prefetch(view->underlying, start, top - start + screen);
+    }
+    view->read_ahead_top = top;
+}
+
+/** Adjustment::value-changed callback. */
+static void adjustment_value_changed(GtkAdjustment *adjustment, gpointer user_data)
+{
+    GHexEditHexView *view = GHEXEDIT_HEX_VIEW(user_data);
+    if (adjustment == view->vadjustment)
+        read_ahead(view);
+    gtk_widget_queue_draw(GTK_WIDGET(view));
+}
+
+/** GestureDrag::drag-begin callback: place the cursor. */
+static void drag_begin(GtkGestureDrag *gesture, double x, double y, gpointer user_data)
+{
+    GHexEditHexView *view = GHEXEDIT_HEX_VIEW(user_data);
+    if (view->underlying == NULL)
+        return;
+    GdkModifierType state = gtk_event_controller_get_current_event_state(GTK_EVENT_CONTROLLER(gesture));
+    gtk_widget_grab_focus(GTK_WIDGET(view));
+    guint64 offset = byte_at(view, x, y, &view->ascii_side);
+    ghexedit_hex_view_set_cursor(view, offset, state & GDK_SHIFT_MASK);
+}
+
+/** GestureDrag::drag-update callback: extend the selection. */
+static void drag_update(GtkGestureDrag *gesture, double offset_x, double offset_y, gpointer user_data)
+{
+    GHexEditHexView *view = GHEXEDIT_HEX_VIEW(user_data);
+    if (view->underlying == NULL)
+        return;
+    double x, y;
+    gboolean ascii_side;
+    gtk_gesture_drag_get_start_point(gesture, &x, &y);
+    ghexedit_hex_view_set_cursor(view, byte_at(view, x + offset_x, y + offset_y, &ascii_side), TRUE);
+}
+
+/** Remove the selection if it spans more than the cursor byte. */
+static gboolean delete_selection(GHexEditHexView *view)
+{
+    if (view->cursor == view->anchor)
+        return FALSE;
+    guint64 start, end;
+    ghexedit_hex_view_get_selection(view, &start, &end);
+    ghexedit_buffer_delete(view->underlying, start, end - start);
+    ghexedit_hex_view_set_cursor(view, start, FALSE);
+    return TRUE;
+}
+
+/** Byte at the cursor, or 0 on the append slot. */
+static guint8 cursor_byte(GHexEditHexView *view)
+{
+    guint8 byte = 0;
+    ghexedit_buffer_read(view->underlying, view->cursor, &byte, 1, NULL);
+    return byte;
+}
+
+/** Store a byte at the cursor, inserting or overwriting per the mode. */
+static void put_byte(GHexEditHexView *view, guint8 byte, gboolean insert)
+{
+    if (insert || view->cursor >= buffer_size(view))
+        ghexedit_buffer_insert(view->underlying, view->cursor, &byte, 1);
+    else
+        ghexedit_buffer_overwrite(view->underlying, view->cursor, &byte, 1);
+}
+
+/**
+ * Type a character into the side holding the cursor.
+ * Hex digits fill the high nibble then the low one; in insert mode the high
+ * nibble inserts a new byte which the low nibble then completes.
+ */
+static gboolean type_char(GHexEditHexView *view, gunichar c)
+{
+    if (view->ascii_side)
+    {
+        if (c < 0x20 || c >= 0x7f)
+            return FALSE;
+        delete_selection(view);
+        put_byte(view, c, !view->overwrite);
+        ghexedit_hex_view_set_cursor(view, view->cursor + 1, FALSE);
+        return TRUE;
+    }
+
+    int digit = g_unichar_xdigit_value(c);
+    if (digit < 0)
+        return FALSE;
+    if (!view->low_nibble)
+    {
+        gboolean insert = delete_selection(view) || !view->overwrite;
+        put_byte(view, (insert ? 0 : cursor_byte(view) & 0x0f) | digit << 4, insert);
+        view->anchor = view->cursor;
+        view->low_nibble = TRUE;
+        gtk_widget_queue_draw(GTK_WIDGET(view));
+    }
+    else
+    {
+        put_byte(view, (cursor_byte(view) & 0xf0) | digit, FALSE);
+        ghexedit_hex_view_set_cursor(view, view->cursor + 1, FALSE);
+    }
+    return TRUE;
+}
+
+/** Handle editing keys. Returns FALSE if the key isn't one. */
+static gboolean edit_key(GHexEditHexView *view, guint keyval, GdkModifierType state)
+{
+    if (state & (GDK_CONTROL_MASK | GDK_ALT_MASK) || ghexedit_buffer_get_saving(view->underlying))
+        return FALSE;
+
+    switch (keyval)
+    {
+    case GDK_KEY_Insert:
+    case GDK_KEY_KP_Insert:
+        ghexedit_hex_view_set_overwrite(view, !view->overwrite);
+        return TRUE;
+    case GDK_KEY_Tab:
+        view->ascii_side = !view->ascii_side;
+        view->low_nibble = FALSE;
+        gtk_widget_queue_draw(GTK_WIDGET(view));
+        return TRUE;
+    case GDK_KEY_Delete:
+    case GDK_KEY_KP_Delete:
+        if (!delete_selection(view))
         {
-            *ptr++ = nybble_char((data[i] >> 4) & 0x0F);
-            *ptr++ = nybble_char(data[i] & 0x0F);
-            *ptr++ = ' ';
+            ghexedit_buffer_delete(view->underlying, view->cursor, 1);
+            ghexedit_hex_view_set_cursor(view, view->cursor, FALSE);
         }
-        else
+        return TRUE;
+    case GDK_KEY_BackSpace:
+        if (!delete_selection(view) && view->cursor > 0)
         {
-            *ptr++ = ' ';
-            *ptr++ = ' ';
-            *ptr++ = ' ';
+            ghexedit_buffer_delete(view->underlying, view->cursor - 1, 1);
+            ghexedit_hex_view_set_cursor(view, view->cursor - 1, FALSE);
         }
+        return TRUE;
+    default:
+        return type_char(view, gdk_keyval_to_unicode(keyval));
+    }
+}
+
+/** EventControllerKey::key-pressed callback: cursor movement and editing. */
+static gboolean key_pressed(GtkEventControllerKey *controller, guint keyval, guint keycode, GdkModifierType state, gpointer user_data)
+{
+    GHexEditHexView *view = GHEXEDIT_HEX_VIEW(user_data);
+    if (view->underlying == NULL)
+        return GDK_EVENT_PROPAGATE;
+
+    gint64 size = buffer_size(view);
+    gint64 bpl = view->bytes_per_line;
+    gint64 page = 1;
+    if (view->vadjustment)
+        page = MAX(1, gtk_adjustment_get_page_size(view->vadjustment) / view->line_height);
+
+    gint64 cursor = view->cursor;
+    switch (keyval)
+    {
+    case GDK_KEY_Left:
+    case GDK_KEY_KP_Left:
+        cursor -= 1;
+        break;
+    case GDK_KEY_Right:
+    case GDK_KEY_KP_Right:
+        cursor += 1;
+        break;
+    case GDK_KEY_Up:
+    case GDK_KEY_KP_Up:
+        cursor -= bpl;
+        break;
+    case GDK_KEY_Down:
+    case GDK_KEY_KP_Down:
+        cursor += bpl;
+        break;
+    case GDK_KEY_Page_Up:
+    case GDK_KEY_KP_Page_Up:
+        cursor -= page * bpl;
+        break;
+    case GDK_KEY_Page_Down:
+    case GDK_KEY_KP_Page_Down:
+        cursor += page * bpl;
+        break;
+    case GDK_KEY_Home:
+    case GDK_KEY_KP_Home:
+        cursor = (state & GDK_CONTROL_MASK) ? 0 : cursor - cursor % bpl;
+        break;
+    case GDK_KEY_End:
+    case GDK_KEY_KP_End:
+        cursor = (state & GDK_CONTROL_MASK) ? size : cursor - cursor % bpl + bpl - 1;
+        break;
+    default:
+        return edit_key(view, keyval, state) ? GDK_EVENT_STOP : GDK_EVENT_PROPAGATE;
+    }
+
+    cursor = CLAMP(cursor, 0, size);
+    ghexedit_hex_view_set_cursor(view, cursor, state & GDK_SHIFT_MASK);
+    return GDK_EVENT_STOP;
+}
+
+
+/** Buffer::changed callback: keep the cursor in range and redraw. */
+static void buffer_changed(GHexEditBuffer *buffer, guint64 offset, guint64 removed, guint64 added, gpointer user_data)
+{
+    GHexEditHexView *view = GHEXEDIT_HEX_VIEW(user_data);
+    guint64 size = ghexedit_buffer_get_size(buffer);
+    view->cursor = MIN(view->cursor, size);
+    view->anchor = MIN(view->anchor, size);
+    // Scrolling away from the end stops following until scrolled back
+    gboolean at_end = FALSE;
+    if (view->follow_tail && view->vadjustment)
+    {
+        double value = gtk_adjustment_get_value(view->vadjustment);
+        double page = gtk_adjustment_get_page_size(view->vadjustment);
+        at_end = value + page + view->line_height >= gtk_adjustment_get_upper(view->vadjustment);
+    }
+    relayout(view);
+    if (at_end && removed == 0 && offset + added == size)
+    {
+        double upper = gtk_adjustment_get_upper(view->vadjustment);
+        gtk_adjustment_set_value(view->vadjustment, upper - gtk_adjustment_get_page_size(view->vadjustment));
+    }
+}
 
-        if ((i + 1) % bytes_per_line == 0)
+
+/* ===[ Clipboard ]=== */
+/** A paste waiting on the clipboard. */
+typedef struct
+{
+    GHexEditHexView *view;
+    GHexEditBuffer *buffer;
+    gboolean text;
+} PasteData;
+
+static void paste_data_free(PasteData *data)
+{
+    g_object_unref(data->view);
+    g_object_unref(data->buffer);
+    g_free(data);
+}
+
+/** Text of hex digit pairs, optionally spaced, as bytes; NULL if it's anything else. */
+static GBytes *decode_hex(GBytes *text)
+{
+    gsize length;
+    char const *s = g_bytes_get_data(text, &length);
+    GByteArray *out = g_byte_array_sized_new(length / 2);
+    for (gsize i = 0; i < length;)
+    {
+        if (g_ascii_isspace(s[i]))
+        {
+            ++i;
+            continue;
+        }
+        if (i + 1 >= length || !g_ascii_isxdigit(s[i]) || !g_ascii_isxdigit(s[i + 1]))
         {
-            *ptr++ = ' ';
-            *ptr++ = '|';
-            for (gsize b = 0; b < bytes_per_line; ++b)
-                if ((i - 15) + b < data_length)
-                    *ptr++ = make_printable(data[(i - 15) + b]);
-            *ptr++ = '|';
-            *ptr++ = '\n';
+            g_byte_array_unref(out);
+            return NULL;
         }
+        guint8 byte = g_ascii_xdigit_value(s[i]) << 4 | g_ascii_xdigit_value(s[i + 1]);
+        g_byte_array_append(out, &byte, 1);
+        i += 2;
     }
-    *out_length = ptr - *out;
+    return g_byte_array_free_to_bytes(out);
 }
 
-/** Refresh view. */
-void refresh_view(GHexEditHexView *view)
+/**
+ * Put pasted bytes at the cursor as one edit: replacing the selection if
+ * there is one, else inserting or overwriting per the mode.
+ */
+static void paste_bytes(GHexEditHexView *view, guint8 const *data, gsize length)
 {
-    if (view->underlying == NULL)
+    if (length == 0)
         return;
+    guint64 start, end;
+    ghexedit_hex_view_get_selection(view, &start, &end);
+    guint64 removed = view->cursor != view->anchor ? end - start : view->overwrite ? length : 0;
+    ghexedit_buffer_replace(view->underlying, start, removed, data, length);
+    ghexedit_hex_view_set_cursor(view, start + length, FALSE);
+}
+
+/** Splice callback: the whole paste has arrived. */
+static void paste_spliced(GObject *source, GAsyncResult *result, gpointer user_data)
+{
+    PasteData *data = user_data;
+    GError *error = NULL;
+    if (g_output_stream_splice_finish(G_OUTPUT_STREAM(source), result, &error) < 0)
+    {
+        g_warning("Failed to paste: %s", error->message);
+        g_error_free(error);
+    }
+    // Drop it if the view moved on to another buffer or a save began meanwhile
+    else if (data->view->underlying == data->buffer && !ghexedit_buffer_get_saving(data->buffer))
+    {
+        GBytes *bytes = g_memory_output_stream_steal_as_bytes(G_MEMORY_OUTPUT_STREAM(source));
+        GBytes *decoded = data->text ? decode_hex(bytes) : NULL;
+        gsize length;
+        guint8 const *pasted = g_bytes_get_data(decoded ? decoded : bytes, &length);
+        paste_bytes(data->view, pasted, length);
+        g_clear_pointer(&decoded, g_bytes_unref);
+        g_bytes_unref(bytes);
+    }
+    paste_data_free(data);
+}
 
-    gsize buf_length;
-    guint8 const *buf = g_bytes_get_data(view->underlying, &buf_length);
+/** Clipboard read callback: collect the stream. */
+static void paste_read(GObject *source, GAsyncResult *result, gpointer user_data)
+{
+    PasteData *data = user_data;
+    GError *error = NULL;
+    char const *mime_type = NULL;
+    GInputStream *stream = gdk_clipboard_read_finish(GDK_CLIPBOARD(source), result, &mime_type, &error);
+    if (stream == NULL)
+    {
+        g_warning("Failed to paste: %s", error->message);
+        g_error_free(error);
+        paste_data_free(data);
+        return;
+    }
+    // Text is taken as hex digits if it looks like them, else as its own bytes
+    data->text = !g_str_equal(mime_type, GHEXEDIT_MIME_BINARY);
+    GOutputStream *collected = g_memory_output_stream_new_resizable();
+    g_output_stream_splice_async(collected, stream, G_OUTPUT_STREAM_SPLICE_CLOSE_SOURCE | G_OUTPUT_STREAM_SPLICE_CLOSE_TARGET,
+        G_PRIORITY_DEFAULT, NULL, paste_spliced, data);
+    g_object_unref(collected);
+    g_object_unref(stream);
+}
 
-    guint8 *out = NULL;
-    int out_length = 0;
-    hex(buf, buf_length, &out, &out_length, view->bytes_per_line, view->grouping);
+/** clipboard.copy action. */
+static void copy_activated(GtkWidget *widget, char const *action_name, GVariant *parameter)
+{
+    ghexedit_hex_view_copy(GHEXEDIT_HEX_VIEW(widget), GHEXEDIT_EXPORT_RAW);
+}
 
-    gtk_text_buffer_set_text(gtk_text_view_get_buffer(GTK_TEXT_VIEW(view)), out, out_length);
+/** clipboard.paste action. */
+static void paste_activated(GtkWidget *widget, char const *action_name, GVariant *parameter)
+{
+    ghexedit_hex_view_paste(GHEXEDIT_HEX_VIEW(widget));
 }
 
 
 /* ===[ GHexEditHexView ]=== */
 /** Set underlying buffer. */
-void ghexedit_hex_view_set_underlying(GHexEditHexView *view, GBytes *bytes)
+void ghexedit_hex_view_set_underlying(GHexEditHexView *view, GHexEditBuffer *buffer)
 {
-    view->underlying = bytes;
-    refresh_view(view);
+    if (view->underlying == buffer)
+        return;
+    if (view->underlying)
+        g_signal_handlers_disconnect_by_func(view->underlying, buffer_changed, view);
+    g_set_object(&view->underlying, buffer);
+    if (buffer)
+        g_signal_connect(buffer, "changed", G_CALLBACK(buffer_changed), view);
+    view->cursor = view->anchor = 0;
+    view->low_nibble = FALSE;
+    relayout(view);
+    g_object_notify_by_pspec(G_OBJECT(view), properties[PROP_UNDERLYING]);
 }
 
 /** Get underlying buffer. */
-GBytes *ghexedit_hex_view_get_underlying(GHexEditHexView *view)
+GHexEditBuffer *ghexedit_hex_view_get_underlying(GHexEditHexView *view)
 {
     return view->underlying;
 }
 
+/** Reference::changed callback: the highlighted differences may have moved. */
+static void reference_changed(GHexEditBuffer *buffer, guint64 offset, guint64 removed, guint64 added, gpointer view)
+{
+    gtk_widget_queue_draw(GTK_WIDGET(view));
+}
+
+/** Highlight bytes that differ from `buffer` at the same offset, or nothing if NULL. */
+void ghexedit_hex_view_set_reference(GHexEditHexView *view, GHexEditBuffer *buffer)
+{
+    if (view->reference == buffer)
+        return;
+    if (view->reference)
+        g_signal_handlers_disconnect_by_func(view->reference, reference_changed, view);
+    g_set_object(&view->reference, buffer);
+    if (buffer)
+        g_signal_connect(buffer, "changed", G_CALLBACK(reference_changed), view);
+    gtk_widget_queue_draw(GTK_WIDGET(view));
+    g_object_notify_by_pspec(G_OBJECT(view), properties[PROP_REFERENCE]);
+}
+
+GHexEditBuffer *ghexedit_hex_view_get_reference(GHexEditHexView *view)
+{
+    return view->reference;
+}
+
+/** Tint the fields of template tree `overlay`, or nothing if NULL. */
+void ghexedit_hex_view_set_overlay(GHexEditHexView *view, GHexEditTemplateNode *overlay)
+{
+    if (view->overlay == overlay)
+        return;
+    g_set_object(&view->overlay, overlay);
+    gtk_widget_queue_draw(GTK_WIDGET(view));
+    g_object_notify_by_pspec(G_OBJECT(view), properties[PROP_OVERLAY]);
+}
+
+GHexEditTemplateNode *ghexedit_hex_view_get_overlay(GHexEditHexView *view)
+{
+    return view->overlay;
+}
+
+/** Highlight `length` bytes at `offset` as a search match. */
+void ghexedit_hex_view_add_hit(GHexEditHexView *view, guint64 offset, guint64 length)
+{
+    ghexedit_range_set_add(view->hits, offset, offset + length);
+    gtk_widget_queue_draw(GTK_WIDGET(view));
+}
+
+/** Stop highlighting search matches. */
+void ghexedit_hex_view_clear_hits(GHexEditHexView *view)
+{
+    if (ghexedit_range_set_get_n_ranges(view->hits) == 0)
+        return;
+    ghexedit_range_set_clear(view->hits);
+    gtk_widget_queue_draw(GTK_WIDGET(view));
+}
+
+/** Keep the view scrolled to the end as data is appended to the buffer. */
+void ghexedit_hex_view_set_follow_tail(GHexEditHexView *view, gboolean follow_tail)
+{
+    follow_tail = !!follow_tail;
+    if (view->follow_tail == follow_tail)
+        return;
+    view->follow_tail = follow_tail;
+    if (follow_tail && view->vadjustment)
+        gtk_adjustment_set_value(view->vadjustment, gtk_adjustment_get_upper(view->vadjustment));
+    g_object_notify_by_pspec(G_OBJECT(view), properties[PROP_FOLLOW_TAIL]);
+}
+
+gboolean ghexedit_hex_view_get_follow_tail(GHexEditHexView *view)
+{
+    return view->follow_tail;
+}
+
+/** Totals since the view was created; sample twice and subtract for rates. */
+void ghexedit_hex_view_get_stats(GHexEditHexView *view, GHexEditHexViewStats *stats)
+{
+    *stats = view->stats;
+}
+
+/**
+ * Keep the session of the file shown, for others showing the view (the
+ * entropy map) to find saved analyses in. Set it before the buffer.
+ */
+void ghexedit_hex_view_set_session(GHexEditHexView *view, GHexEditSession *session)
+{
+    g_set_object(&view->session, session);
+}
+
+/** The session of the file shown, or NULL. */
+GHexEditSession *ghexedit_hex_view_get_session(GHexEditHexView *view)
+{
+    return view->session;
+}
+
+/** First byte of the top row in view. */
+guint64 ghexedit_hex_view_get_top(GHexEditHexView *view)
+{
+    return view->relayout_pending ? view->scroll_anchor : top_byte(view);
+}
+
+/**
+ * Scroll so the row holding `offset` is at the top. A view not yet shown
+ * scrolls there once it is laid out.
+ */
+void ghexedit_hex_view_scroll_to(GHexEditHexView *view, guint64 offset)
+{
+    view->scroll_anchor = offset;
+    view->relayout_pending = TRUE;
+    finish_relayout(view);
+}
+
+/**
+ * Move the cursor to a byte offset.
+ * If `extend` is set the selection anchor stays put, otherwise it follows the
+ * cursor.
+ */
+void ghexedit_hex_view_set_cursor(GHexEditHexView *view, guint64 offset, gboolean extend)
+{
+    view->cursor = offset;
+    view->low_nibble = FALSE;
+    if (!extend)
+        view->anchor = offset;
+    scroll_to_cursor(view);
+    gtk_widget_queue_draw(GTK_WIDGET(view));
+    g_object_notify_by_pspec(G_OBJECT(view), properties[PROP_CURSOR]);
+}
+
+/** Get the cursor's byte offset. */
+guint64 ghexedit_hex_view_get_cursor(GHexEditHexView *view)
+{
+    return view->cursor;
+}
+
+/**
+ * Get the selected range as [start, end).
+ * The selection always contains at least the byte under the cursor.
+ */
+void ghexedit_hex_view_get_selection(GHexEditHexView *view, guint64 *start, guint64 *end)
+{
+    *start = MIN(view->cursor, view->anchor);
+    *end = MAX(view->cursor, view->anchor) + 1;
+}
+
+/** Freeze the selected bytes for copying or exporting; NULL without a buffer. */
+GHexEditSnapshot *ghexedit_hex_view_get_selection_snapshot(GHexEditHexView *view)
+{
+    if (view->underlying == NULL)
+        return NULL;
+    guint64 start, end;
+    ghexedit_hex_view_get_selection(view, &start, &end);
+    return ghexedit_buffer_snapshot(view->underlying, start, end - start);
+}
+
+/**
+ * Put the selection on the clipboard as `format`. Only a snapshot is taken
+ * now; the bytes are encoded when something pastes them.
+ */
+void ghexedit_hex_view_copy(GHexEditHexView *view, GHexEditExportFormat format)
+{
+    GHexEditSnapshot *snapshot = ghexedit_hex_view_get_selection_snapshot(view);
+    if (snapshot == NULL)
+        return;
+    GdkContentProvider *provider = ghexedit_export_provider_new(snapshot, format);
+    gdk_clipboard_set_content(gtk_widget_get_clipboard(GTK_WIDGET(view)), provider);
+    g_object_unref(provider);
+    ghexedit_snapshot_unref(snapshot);
+}
+
+/** Paste bytes, or hex digits as bytes, from the clipboard at the cursor. */
+void ghexedit_hex_view_paste(GHexEditHexView *view)
+{
+    if (view->underlying == NULL || ghexedit_buffer_get_saving(view->underlying))
+        return;
+    char const *mime_types[] = {GHEXEDIT_MIME_BINARY, GHEXEDIT_MIME_TEXT_UTF8, GHEXEDIT_MIME_TEXT, NULL};
+    PasteData *data = g_new0(PasteData, 1);
+    data->view = g_object_ref(view);
+    data->buffer = g_object_ref(view->underlying);
+    gdk_clipboard_read_async(gtk_widget_get_clipboard(GTK_WIDGET(view)), mime_types, G_PRIORITY_DEFAULT, NULL, paste_read, data);
+}
+
+/** Set whether typing overwrites bytes (TRUE) or inserts them (FALSE). */
+void ghexedit_hex_view_set_overwrite(GHexEditHexView *view, gboolean overwrite)
+{
+    overwrite = !!overwrite;
+    if (view->overwrite != overwrite)
+    {
+        view->overwrite = overwrite;
+        gtk_widget_queue_draw(GTK_WIDGET(view));
+        g_object_notify_by_pspec(G_OBJECT(view), properties[PROP_OVERWRITE]);
+    }
+}
+
+/** Whether typing overwrites bytes. */
+gboolean ghexedit_hex_view_get_overwrite(GHexEditHexView *view)
+{
+    return view->overwrite;
+}
+
 
 /* ===[ GObject ]=== */
 /** Instantiate a new instance of the class. */
@@ -163,6 +1165,23 @@ GtkWidget *ghexedit_hex_view_new()
     return g_object_new(GHEXEDIT_TYPE_HEX_VIEW, NULL);
 }
 
+/** Swap in a new scroll adjustment. */
+static void set_adjustment(GHexEditHexView *view, GtkAdjustment **slot, GtkAdjustment *adjustment)
+{
+    if (adjustment && adjustment == *slot)
+        return;
+    if (adjustment == NULL)
+        adjustment = gtk_adjustment_new(0, 0, 0, 0, 0, 0);
+    if (*slot)
+    {
+        g_signal_handlers_disconnect_by_func(*slot, adjustment_value_changed, view);
+        g_object_unref(*slot);
+    }
+    *slot = g_object_ref_sink(adjustment);
+    g_signal_connect(adjustment, "value-changed", G_CALLBACK(adjustment_value_changed), view);
+    update_adjustments(view);
+}
+
 /** Set a property on an instance. */
 void ghexedit_hex_view_set_property(GObject *object, guint property_id, GValue const *value, GParamSpec *pspec)
 {
@@ -170,12 +1189,53 @@ void ghexedit_hex_view_set_property(GObject *object, guint property_id, GValue c
     switch ((GHexEditHexViewProperty)property_id)
     {
     case PROP_BYTES_PER_LINE:
+        begin_relayout(self);
         self->bytes_per_line = g_value_get_uint(value);
-        refresh_view(self);
+        finish_relayout(self);
         break;
     case PROP_GROUPING:
+        begin_relayout(self);
         self->grouping = g_value_get_uint(value);
-        refresh_view(self);
+        finish_relayout(self);
+        break;
+    case PROP_UNDERLYING:
+        ghexedit_hex_view_set_underlying(self, g_value_get_object(value));
+        break;
+    case PROP_FONT:
+        begin_relayout(self);
+        pango_font_description_free(self->font);
+        self->font = pango_font_description_from_string(g_value_get_string(value));
+        update_metrics(self);
+        finish_relayout(self);
+        break;
+    case PROP_CURSOR:
+        ghexedit_hex_view_set_cursor(self, g_value_get_uint64(value), FALSE);
+        break;
+    case PROP_OVERWRITE:
+        ghexedit_hex_view_set_overwrite(self, g_value_get_boolean(value));
+        break;
+    case PROP_FOLLOW_TAIL:
+        ghexedit_hex_view_set_follow_tail(self, g_value_get_boolean(value));
+        break;
+    case PROP_REFERENCE:
+        ghexedit_hex_view_set_reference(self, g_value_get_object(value));
+        break;
+    case PROP_OVERLAY:
+        ghexedit_hex_view_set_overlay(self, g_value_get_object(value));
+        break;
+    case PROP_HADJUSTMENT:
+        set_adjustment(self, &self->hadjustment, g_value_get_object(value));
+        break;
+    case PROP_VADJUSTMENT:
+        set_adjustment(self, &self->vadjustment, g_value_get_object(value));
+        break;
+    case PROP_HSCROLL_POLICY:
+        self->hscroll_policy = g_value_get_enum(value);
+        gtk_widget_queue_resize(GTK_WIDGET(self));
+        break;
+    case PROP_VSCROLL_POLICY:
+        self->vscroll_policy = g_value_get_enum(value);
+        gtk_widget_queue_resize(GTK_WIDGET(self));
         break;
     default:
         G_OBJECT_WARN_INVALID_PROPERTY_ID(object, property_id, pspec);
@@ -195,18 +1255,106 @@ void ghexedit_hex_view_get_property(GObject *object, guint property_id, GValue *
     case PROP_GROUPING:
         g_value_set_uint(value, self->grouping);
         break;
+    case PROP_UNDERLYING:
+        g_value_set_object(value, self->underlying);
+        break;
+    case PROP_FONT:
+        g_value_take_string(value, pango_font_description_to_string(self->font));
+        break;
+    case PROP_CURSOR:
+        g_value_set_uint64(value, self->cursor);
+        break;
+    case PROP_OVERWRITE:
+        g_value_set_boolean(value, self->overwrite);
+        break;
+    case PROP_FOLLOW_TAIL:
+        g_value_set_boolean(value, self->follow_tail);
+        break;
+    case PROP_REFERENCE:
+        g_value_set_object(value, self->reference);
+        break;
+    case PROP_OVERLAY:
+        g_value_set_object(value, self->overlay);
+        break;
+    case PROP_HADJUSTMENT:
+        g_value_set_object(value, self->hadjustment);
+        break;
+    case PROP_VADJUSTMENT:
+        g_value_set_object(value, self->vadjustment);
+        break;
+    case PROP_HSCROLL_POLICY:
+        g_value_set_enum(value, self->hscroll_policy);
+        break;
+    case PROP_VSCROLL_POLICY:
+        g_value_set_enum(value, self->vscroll_policy);
+        break;
     default:
         G_OBJECT_WARN_INVALID_PROPERTY_ID(object, property_id, pspec);
         break;
     }
 }
 
+/**
+ * Drop held references.
+ * Can be executed more than once!
+ * Should chain up before returning.
+ */
+void ghexedit_hex_view_dispose(GObject *object)
+{
+    GHexEditHexView *view = GHEXEDIT_HEX_VIEW(object);
+    if (view->hadjustment)
+        g_signal_handlers_disconnect_by_func(view->hadjustment, adjustment_value_changed, view);
+    if (view->vadjustment)
+        g_signal_handlers_disconnect_by_func(view->vadjustment, adjustment_value_changed, view);
+    g_clear_object(&view->hadjustment);
+    g_clear_object(&view->vadjustment);
+    if (view->underlying)
+        g_signal_handlers_disconnect_by_func(view->underlying, buffer_changed, view);
+    g_clear_object(&view->underlying);
+    if (view->reference)
+        g_signal_handlers_disconnect_by_func(view->reference, reference_changed, view);
+    g_clear_object(&view->reference);
+    g_clear_object(&view->overlay);
+    g_clear_object(&view->session);
+    g_clear_object(&view->settings);
+    G_OBJECT_CLASS(ghexedit_hex_view_parent_class)->dispose(object);
+}
+
+/** Free remaining resources. */
+void ghexedit_hex_view_finalize(GObject *object)
+{
+    GHexEditHexView *view = GHEXEDIT_HEX_VIEW(object);
+    g_clear_pointer(&view->font, pango_font_description_free);
+    ghexedit_range_set_free(view->hits);
+    ghexedit_range_set_free(view->edits);
+    ghexedit_range_set_free(view->unreadable);
+    G_OBJECT_CLASS(ghexedit_hex_view_parent_class)->finalize(object);
+}
+
 
 /* ===[ Base GLib ]=== */
 /** Equivalent to C++ constructor. */
 void ghexedit_hex_view_init(GHexEditHexView *view)
 {
     view->underlying = NULL;
+    view->overwrite = TRUE;
+    view->font = pango_font_description_from_string("Monospace 12");
+    view->hits = ghexedit_range_set_new();
+    view->edits = ghexedit_range_set_new();
+    view->unreadable = ghexedit_range_set_new();
+    update_metrics(view);
+    gtk_widget_set_focusable(GTK_WIDGET(view), TRUE);
+
+    // Mouse selection
+    GtkGesture *drag = gtk_gesture_drag_new();
+    g_signal_connect(drag, "drag-begin", G_CALLBACK(drag_begin), view);
+    g_signal_connect(drag, "drag-update", G_CALLBACK(drag_update), view);
+    gtk_widget_add_controller(GTK_WIDGET(view), GTK_EVENT_CONTROLLER(drag));
+    // Keyboard navigation and editing
+    GtkEventController *keys = gtk_event_controller_key_new();
+    g_signal_connect(keys, "key-pressed", G_CALLBACK(key_pressed), view);
+    gtk_widget_add_controller(GTK_WIDGET(view), keys);
+
     // Create new Settings object
     view->settings = g_settings_new(GHX_APPLICATION_ID);
     // Bind prefs properties from settings
@@ -214,6 +1362,7 @@ void ghexedit_hex_view_init(GHexEditHexView *view)
     g_settings_bind(view->settings, "bytes-per-line", view, "bytes-per-line", G_SETTINGS_BIND_DEFAULT);
     view->grouping = 8;
     g_settings_bind(view->settings, "grouping", view, "grouping", G_SETTINGS_BIND_DEFAULT);
+    g_settings_bind(view->settings, "font", view, "font", G_SETTINGS_BIND_GET);
 }
 
 /**
@@ -223,12 +1372,34 @@ void ghexedit_hex_view_init(GHexEditHexView *view)
 void ghexedit_hex_view_class_init(GHexEditHexViewClass *class)
 {
     GObjectClass *klass = G_OBJECT_CLASS(class);
+    GtkWidgetClass *widget_class = GTK_WIDGET_CLASS(class);
     // Overrides
     klass->set_property = ghexedit_hex_view_set_property;
     klass->get_property = ghexedit_hex_view_get_property;
+    klass->dispose = ghexedit_hex_view_dispose;
+    klass->finalize = ghexedit_hex_view_finalize;
+    widget_class->snapshot = ghexedit_hex_view_snapshot;
+    widget_class->measure = ghexedit_hex_view_measure;
+    widget_class->size_allocate = ghexedit_hex_view_size_allocate;
+    widget_class->map = ghexedit_hex_view_map;
     // Install properties
     properties[PROP_BYTES_PER_LINE] = g_param_spec_uint("bytes-per-line", "Bytes per line", "Number of bytes per line.", 1, G_MAXUINT, 16, G_PARAM_READWRITE);
     properties[PROP_GROUPING] = g_param_spec_uint("grouping", "Grouping", "Bytes grouping.", 1, G_MAXUINT, 8, G_PARAM_READWRITE);
-    properties[PROP_UNDERLYING] = g_param_spec_pointer("underlying", "Underlying", "The raw data buffer.", G_PARAM_READWRITE);
+    properties[PROP_UNDERLYING] = g_param_spec_object("underlying", "Underlying", "The buffer being viewed.", GHEXEDIT_TYPE_BUFFER, G_PARAM_READWRITE);
+    properties[PROP_FONT] = g_param_spec_string("font", "Font", "The font to draw content with.", "Monospace 12", G_PARAM_READWRITE);
+    properties[PROP_CURSOR] = g_param_spec_uint64("cursor", "Cursor", "Byte offset of the cursor.", 0, G_MAXUINT64, 0, G_PARAM_READWRITE);
+    properties[PROP_OVERWRITE] = g_param_spec_boolean("overwrite", "Overwrite", "Whether typing overwrites bytes rather than inserting them.", TRUE, G_PARAM_READWRITE);
+    properties[PROP_FOLLOW_TAIL] = g_param_spec_boolean("follow-tail", "Follow tail", "Whether to stay scrolled to the end as the buffer grows.", FALSE, G_PARAM_READWRITE);
+    properties[PROP_REFERENCE] = g_param_spec_object("reference", "Reference", "Buffer to highlight differences from.", GHEXEDIT_TYPE_BUFFER, G_PARAM_READWRITE);
+    properties[PROP_OVERLAY] = g_param_spec_object("overlay", "Overlay", "Template tree whose fields are tinted.", GHEXEDIT_TYPE_TEMPLATE_NODE, G_PARAM_READWRITE);
     g_object_class_install_properties(klass, N_PROPERTIES, properties);
+    g_object_class_override_property(klass, PROP_HADJUSTMENT, "hadjustment");
+    g_object_class_override_property(klass, PROP_VADJUSTMENT, "vadjustment");
+    g_object_class_override_property(klass, PROP_HSCROLL_POLICY, "hscroll-policy");
+    g_object_class_override_property(klass, PROP_VSCROLL_POLICY, "vscroll-policy");
+    // Clipboard
+    gtk_widget_class_install_action(widget_class, "clipboard.copy", NULL, copy_activated);
+    gtk_widget_class_install_action(widget_class, "clipboard.paste", NULL, paste_activated);
+    gtk_widget_class_add_binding_action(widget_class, GDK_KEY_c, GDK_CONTROL_MASK, "clipboard.copy", NULL);
+    gtk_widget_class_add_binding_action(widget_class, GDK_KEY_v, GDK_CONTROL_MASK, "clipboard.paste", NULL);
 }
@@ -1,5 +1,5 @@
 /**
- * HexView.h - View a text buffer as hexadecimal bytes.
+ * HexView.h - View and edit a document as hexadecimal bytes.
  * Copyright (C) 2022 Trevor Last
  *
  *  This program is free software: you can redistribute it and/or modify
@@ -19,14 +19,50 @@
 #ifndef _GHX_HEXVIEW_H
 #define _GHX_HEXVIEW_H
 
+#include "engine/Buffer.h"
+#include "engine/Export.h"
+#include "engine/Session.h"
+#include "engine/TemplateNode.h"
+
 #include <gtk/gtk.h>
 
 
 #define GHEXEDIT_TYPE_HEX_VIEW ghexedit_hex_view_get_type()
-G_DECLARE_FINAL_TYPE (GHexEditHexView, ghexedit_hex_view, GHEXEDIT, HEX_VIEW, GtkTextView);
+G_DECLARE_FINAL_TYPE (GHexEditHexView, ghexedit_hex_view, GHEXEDIT, HEX_VIEW, GtkWidget);
+
+/** Running totals of what drawing the view has cost. */
+typedef struct
+{
+    guint64 frames;
+    /** Time spent building frames, in microseconds. */
+    gint64 frame_time;
+    /** Bytes read and formatted for display. */
+    guint64 bytes_formatted;
+} GHexEditHexViewStats;
 
 GtkWidget *ghexedit_hex_view_new();
-void ghexedit_hex_view_set_underlying(GHexEditHexView *view, GBytes *bytes);
-GBytes *ghexedit_hex_view_get_underlying(GHexEditHexView *view);
+void ghexedit_hex_view_set_underlying(GHexEditHexView *view, GHexEditBuffer *buffer);
+GHexEditBuffer *ghexedit_hex_view_get_underlying(GHexEditHexView *view);
+void ghexedit_hex_view_set_reference(GHexEditHexView *view, GHexEditBuffer *buffer);
+GHexEditBuffer *ghexedit_hex_view_get_reference(GHexEditHexView *view);
+void ghexedit_hex_view_set_overlay(GHexEditHexView *view, GHexEditTemplateNode *overlay);
+GHexEditTemplateNode *ghexedit_hex_view_get_overlay(GHexEditHexView *view);
+void ghexedit_hex_view_add_hit(GHexEditHexView *view, guint64 offset, guint64 length);
+void ghexedit_hex_view_clear_hits(GHexEditHexView *view);
+void ghexedit_hex_view_set_cursor(GHexEditHexView *view, guint64 offset, gboolean extend);
+guint64 ghexedit_hex_view_get_cursor(GHexEditHexView *view);
+void ghexedit_hex_view_get_selection(GHexEditHexView *view, guint64 *start, guint64 *end);
+GHexEditSnapshot *ghexedit_hex_view_get_selection_snapshot(GHexEditHexView *view);
+void ghexedit_hex_view_copy(GHexEditHexView *view, GHexEditExportFormat format);
+void ghexedit_hex_view_paste(GHexEditHexView *view);
+void ghexedit_hex_view_set_overwrite(GHexEditHexView *view, gboolean overwrite);
+gboolean ghexedit_hex_view_get_overwrite(GHexEditHexView *view);
+void ghexedit_hex_view_set_follow_tail(GHexEditHexView *view, gboolean follow_tail);
+gboolean ghexedit_hex_view_get_follow_tail(GHexEditHexView *view);
+void ghexedit_hex_view_get_stats(GHexEditHexView *view, GHexEditHexViewStats *stats);
+void ghexedit_hex_view_set_session(GHexEditHexView *view, GHexEditSession *session);
+GHexEditSession *ghexedit_hex_view_get_session(GHexEditHexView *view);
+guint64 ghexedit_hex_view_get_top(GHexEditHexView *view);
+void ghexedit_hex_view_scroll_to(GHexEditHexView *view, guint64 offset);
 
 #endif
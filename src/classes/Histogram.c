@@ -0,0 +1,216 @@
+/**
+ * Histogram.c - Byte value histogram of an entropy analysis.
+ * Copyright (C) 2022 Trevor Last
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "Histogram.h"
+
+#include <gtk/gtk.h>
+#include <math.h>
+
+
+/** Preferred height, in pixels. */
+#define HISTOGRAM_HEIGHT 120
+
+/**
+ * One bar per byte value, left to right, heights on a log scale so rare
+ * values still show next to a dominant zero byte.
+ */
+struct _GHexEditHistogram
+{
+    GtkWidget parent;
+    GHexEditEntropy *analysis;
+    /** Copied from the analysis once it finishes. */
+    guint64 counts[256];
+    guint64 total;
+    gboolean ready;
+};
+
+G_DEFINE_TYPE(GHexEditHistogram, ghexedit_histogram, GTK_TYPE_WIDGET)
+
+typedef enum
+{
+    PROP_ANALYSIS = 1,
+    N_PROPERTIES
+} GHexEditHistogramProperty;
+
+static GParamSpec *properties[N_PROPERTIES] = {NULL,};
+
+
+/* ===[ Drawing ]=== */
+/** Draw the bars, in the foreground colour. */
+void ghexedit_histogram_snapshot(GtkWidget *widget, GtkSnapshot *snapshot)
+{
+    GHexEditHistogram *histogram = GHEXEDIT_HISTOGRAM(widget);
+    if (!histogram->ready)
+        return;
+    double width = gtk_widget_get_width(widget);
+    double height = gtk_widget_get_height(widget);
+    guint64 peak = 0;
+    for (guint b = 0; b < 256; ++b)
+        peak = MAX(peak, histogram->counts[b]);
+    if (peak == 0)
+        return;
+
+    GdkRGBA color;
+    gtk_widget_get_color(widget, &color);
+    double scale = log1p((double)peak);
+    for (guint b = 0; b < 256; ++b)
+    {
+        if (histogram->counts[b] == 0)
+            continue;
+        double x0 = b * width / 256;
+        double x1 = (b + 1) * width / 256;
+        double h = MAX(log1p((double)histogram->counts[b]) / scale * height, 1);
+        gtk_snapshot_append_color(snapshot, &color, &GRAPHENE_RECT_INIT(x0, height - h, MAX(x1 - x0, 1), h));
+    }
+}
+
+/** As wide as allowed, HISTOGRAM_HEIGHT high. */
+void ghexedit_histogram_measure(GtkWidget *widget, GtkOrientation orientation, int for_size, int *minimum, int *natural, int *minimum_baseline, int *natural_baseline)
+{
+    if (orientation == GTK_ORIENTATION_HORIZONTAL)
+        *minimum = *natural = 0;
+    else
+        *minimum = *natural = HISTOGRAM_HEIGHT;
+}
+
+/** Widget::query-tooltip callback: the count under the pointer, and the overall entropy. */
+static gboolean query_tooltip(GtkWidget *widget, int x, int y, gboolean keyboard_mode, GtkTooltip *tooltip, gpointer user_data)
+{
+    GHexEditHistogram *histogram = GHEXEDIT_HISTOGRAM(widget);
+    if (!histogram->ready || histogram->total == 0)
+        return FALSE;
+    guint b = CLAMP(x * 256 / MAX(gtk_widget_get_width(widget), 1), 0, 255);
+    char *text = g_strdup_printf("0x%02x %c: %" G_GUINT64_FORMAT " (%.2f%%)\nWhole file: %.2f bits/byte",
+        b, g_ascii_isprint(b) ? b : '.', histogram->counts[b], histogram->counts[b] * 100.0 / histogram->total,
+        ghexedit_histogram_entropy(histogram->counts));
+    gtk_tooltip_set_text(tooltip, text);
+    g_free(text);
+    return TRUE;
+}
+
+
+/* ===[ GHexEditHistogram ]=== */
+/** Entropy::notify::finished callback: take the totals. */
+static void analysis_finished(GHexEditEntropy *analysis, GParamSpec *pspec, gpointer user_data)
+{
+    GHexEditHistogram *histogram = GHEXEDIT_HISTOGRAM(user_data);
+    histogram->ready = analysis && ghexedit_entropy_get_histogram(analysis, histogram->counts);
+    histogram->total = 0;
+    for (guint b = 0; histogram->ready && b < 256; ++b)
+        histogram->total += histogram->counts[b];
+    gtk_widget_queue_draw(GTK_WIDGET(histogram));
+}
+
+/** Show the histogram of `analysis` once it finishes; NULL to clear. */
+void ghexedit_histogram_set_analysis(GHexEditHistogram *histogram, GHexEditEntropy *analysis)
+{
+    if (histogram->analysis == analysis)
+        return;
+    if (histogram->analysis)
+        g_signal_handlers_disconnect_by_func(histogram->analysis, analysis_finished, histogram);
+    g_set_object(&histogram->analysis, analysis);
+    if (analysis)
+        g_signal_connect(analysis, "notify::finished", G_CALLBACK(analysis_finished), histogram);
+    analysis_finished(analysis, NULL, histogram);
+    g_object_notify_by_pspec(G_OBJECT(histogram), properties[PROP_ANALYSIS]);
+}
+
+GHexEditEntropy *ghexedit_histogram_get_analysis(GHexEditHistogram *histogram)
+{
+    return histogram->analysis;
+}
+
+
+/* ===[ GObject ]=== */
+/** Instantiate a new instance of the class. */
+GtkWidget *ghexedit_histogram_new()
+{
+    return g_object_new(GHEXEDIT_TYPE_HISTOGRAM, NULL);
+}
+
+/** Called when a property is set with g_object_set. */
+void ghexedit_histogram_set_property(GObject *object, guint property_id, GValue const *value, GParamSpec *pspec)
+{
+    GHexEditHistogram *histogram = GHEXEDIT_HISTOGRAM(object);
+    switch ((GHexEditHistogramProperty)property_id)
+    {
+    case PROP_ANALYSIS:
+        ghexedit_histogram_set_analysis(histogram, g_value_get_object(value));
+        break;
+    default:
+        G_OBJECT_WARN_INVALID_PROPERTY_ID(object, property_id, pspec);
+        break;
+    }
+}
+
+/** Called when a property is read with g_object_get. */
+void ghexedit_histogram_get_property(GObject *object, guint property_id, GValue *value, GParamSpec *pspec)
+{
+    GHexEditHistogram *histogram = GHEXEDIT_HISTOGRAM(object);
+    switch ((GHexEditHistogramProperty)property_id)
+    {
+    case PROP_ANALYSIS:
+        g_value_set_object(value, histogram->analysis);
+        break;
+    default:
+        G_OBJECT_WARN_INVALID_PROPERTY_ID(object, property_id, pspec);
+        break;
+    }
+}
+
+/**
+ * Drop held references.
+ * Can be executed more than once!
+ * Should chain up before returning.
+ */
+void ghexedit_histogram_dispose(GObject *object)
+{
+    GHexEditHistogram *histogram = GHEXEDIT_HISTOGRAM(object);
+    if (histogram->analysis)
+        g_signal_handlers_disconnect_by_func(histogram->analysis, analysis_finished, histogram);
+    g_clear_object(&histogram->analysis);
+    G_OBJECT_CLASS(ghexedit_histogram_parent_class)->dispose(object);
+}
+
+
+/* ===[ Base GLib ]=== */
+/** Equivalent to C++ constructor. */
+void ghexedit_histogram_init(GHexEditHistogram *histogram)
+{
+    gtk_widget_set_has_tooltip(GTK_WIDGET(histogram), TRUE);
+    g_signal_connect(histogram, "query-tooltip", G_CALLBACK(query_tooltip), NULL);
+}
+
+/**
+ * Called upon first instantiation of an object of this class.
+ * Sets/overrides class methods/signals/properties.
+ */
+void ghexedit_histogram_class_init(GHexEditHistogramClass *class)
+{
+    GObjectClass *klass = G_OBJECT_CLASS(class);
+    GtkWidgetClass *widget_class = GTK_WIDGET_CLASS(class);
+    // Overrides
+    klass->set_property = ghexedit_histogram_set_property;
+    klass->get_property = ghexedit_histogram_get_property;
+    klass->dispose = ghexedit_histogram_dispose;
+    widget_class->snapshot = ghexedit_histogram_snapshot;
+    widget_class->measure = ghexedit_histogram_measure;
+    // Install properties
+    properties[PROP_ANALYSIS] = g_param_spec_object("analysis", "Analysis", "Entropy analysis to show the byte counts of.", GHEXEDIT_TYPE_ENTROPY, G_PARAM_READWRITE);
+    g_object_class_install_properties(klass, N_PROPERTIES, properties);
+}
@@ -0,0 +1,34 @@
+/**
+ * Histogram.h - Byte value histogram of an entropy analysis.
+ * Copyright (C) 2022 Trevor Last
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _GHX_HISTOGRAM_H
+#define _GHX_HISTOGRAM_H
+
+#include "engine/Entropy.h"
+
+#include <gtk/gtk.h>
+
+
+#define GHEXEDIT_TYPE_HISTOGRAM ghexedit_histogram_get_type()
+G_DECLARE_FINAL_TYPE (GHexEditHistogram, ghexedit_histogram, GHEXEDIT, HISTOGRAM, GtkWidget);
+
+GtkWidget *ghexedit_histogram_new();
+void ghexedit_histogram_set_analysis(GHexEditHistogram *histogram, GHexEditEntropy *analysis);
+GHexEditEntropy *ghexedit_histogram_get_analysis(GHexEditHistogram *histogram);
+
+#endif
@@ -0,0 +1,148 @@
+/**
+ * HitList.c - List model of search matches.
+ * Copyright (C) 2022 Trevor Last
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "HitList.h"
+
+#include <gtk/gtk.h>
+
+
+/** Bytes of each match shown in its row. */
+#define PREVIEW_BYTES 8
+
+/**
+ * Exposes a search's matches as a GListModel of GtkStringObject rows.
+ * Rows are only formatted when a view asks for them, so a search with
+ * millions of matches costs nothing until it's scrolled through.
+ */
+struct _GHexEditHitList
+{
+    GObject parent;
+    GHexEditSearch *search;
+};
+
+static void ghexedit_hit_list_model_init(GListModelInterface *iface);
+
+G_DEFINE_TYPE_WITH_CODE(GHexEditHitList, ghexedit_hit_list, G_TYPE_OBJECT,
+    G_IMPLEMENT_INTERFACE(G_TYPE_LIST_MODEL, ghexedit_hit_list_model_init))
+
+
+/** Search::matches-added callback: announce the new rows. */
+static void matches_added(GHexEditSearch *search, guint position, guint added, gpointer list)
+{
+    g_list_model_items_changed(G_LIST_MODEL(list), position, 0, added);
+}
+
+/** "offset  hex bytes  text" for one match. */
+static char *describe(GHexEditSearch *search, GHexEditMatch const *match)
+{
+    guint8 data[PREVIEW_BYTES];
+    gssize got = ghexedit_buffer_read(ghexedit_search_get_buffer(search), match->offset, data, MIN(match->length, PREVIEW_BYTES), NULL);
+    GString *text = g_string_new(NULL);
+    g_string_append_printf(text, "%08" G_GINT64_MODIFIER "X ", match->offset);
+    for (gssize i = 0; i < got; ++i)
+        g_string_append_printf(text, " %02X", data[i]);
+    g_string_append(text, match->length > PREVIEW_BYTES ? "…  " : "  ");
+    for (gssize i = 0; i < got; ++i)
+        g_string_append_c(text, g_ascii_isprint(data[i]) ? data[i] : '.');
+    return g_string_free(text, FALSE);
+}
+
+
+/* ===[ GListModel ]=== */
+GType ghexedit_hit_list_get_item_type(GListModel *model)
+{
+    return GTK_TYPE_STRING_OBJECT;
+}
+
+guint ghexedit_hit_list_get_n_items(GListModel *model)
+{
+    GHexEditHitList *list = GHEXEDIT_HIT_LIST(model);
+    return list->search ? ghexedit_search_get_n_matches(list->search) : 0;
+}
+
+gpointer ghexedit_hit_list_get_item(GListModel *model, guint position)
+{
+    GHexEditHitList *list = GHEXEDIT_HIT_LIST(model);
+    if (position >= ghexedit_hit_list_get_n_items(model))
+        return NULL;
+    char *text = describe(list->search, ghexedit_search_get_match(list->search, position));
+    GtkStringObject *item = gtk_string_object_new(text);
+    g_free(text);
+    return item;
+}
+
+static void ghexedit_hit_list_model_init(GListModelInterface *iface)
+{
+    iface->get_item_type = ghexedit_hit_list_get_item_type;
+    iface->get_n_items = ghexedit_hit_list_get_n_items;
+    iface->get_item = ghexedit_hit_list_get_item;
+}
+
+
+/* ===[ GHexEditHitList ]=== */
+/** List the matches of `search`, or nothing if NULL. */
+void ghexedit_hit_list_set_search(GHexEditHitList *list, GHexEditSearch *search)
+{
+    if (list->search == search)
+        return;
+    guint removed = ghexedit_hit_list_get_n_items(G_LIST_MODEL(list));
+    if (list->search)
+        g_signal_handlers_disconnect_by_func(list->search, matches_added, list);
+    g_set_object(&list->search, search);
+    if (list->search)
+        g_signal_connect(list->search, "matches-added", G_CALLBACK(matches_added), list);
+    g_list_model_items_changed(G_LIST_MODEL(list), 0, removed, ghexedit_hit_list_get_n_items(G_LIST_MODEL(list)));
+}
+
+
+/* ===[ GObject ]=== */
+/** Instantiate a new instance of the class. */
+GHexEditHitList *ghexedit_hit_list_new()
+{
+    return g_object_new(GHEXEDIT_TYPE_HIT_LIST, NULL);
+}
+
+/**
+ * Drop held references.
+ * Can be executed more than once!
+ * Should chain up before returning.
+ */
+void ghexedit_hit_list_dispose(GObject *object)
+{
+    GHexEditHitList *list = GHEXEDIT_HIT_LIST(object);
+    if (list->search)
+        g_signal_handlers_disconnect_by_func(list->search, matches_added, list);
+    g_clear_object(&list->search);
+    G_OBJECT_CLASS(ghexedit_hit_list_parent_class)->dispose(object);
+}
+
+
+/* ===[ Base GLib ]=== */
+/** Equivalent to C++ constructor. */
+void ghexedit_hit_list_init(GHexEditHitList *list)
+{
+}
+
+/**
+ * Called upon first instantiation of an object of this class.
+ * Sets/overrides class methods/signals/properties.
+ */
+void ghexedit_hit_list_class_init(GHexEditHitListClass *class)
+{
+    G_OBJECT_CLASS(class)->dispose = ghexedit_hit_list_dispose;
+}
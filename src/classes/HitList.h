@@ -0,0 +1,33 @@
+/**
+ * HitList.h - List model of search matches.
+ * Copyright (C) 2022 Trevor Last
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _GHX_HITLIST_H
+#define _GHX_HITLIST_H
+
+#include "engine/Search.h"
+
+#include <gio/gio.h>
+
+
+#define GHEXEDIT_TYPE_HIT_LIST ghexedit_hit_list_get_type()
+G_DECLARE_FINAL_TYPE(GHexEditHitList, ghexedit_hit_list, GHEXEDIT, HIT_LIST, GObject);
+
+GHexEditHitList *ghexedit_hit_list_new();
+void ghexedit_hit_list_set_search(GHexEditHitList *list, GHexEditSearch *search);
+
+#endif
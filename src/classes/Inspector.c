@@ -0,0 +1,201 @@
+/**
+ * Inspector.c - Typed values at the cursor of the current HexView.
+ * Copyright (C) 2022 Trevor Last
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "Inspector.h"
+#include "engine/Buffer.h"
+#include "engine/Inspect.h"
+
+#include "appid.h"
+
+#include <gtk/gtk.h>
+
+
+/** Entries of the byte order drop-down, in order. */
+typedef enum
+{
+    BYTE_ORDER_LITTLE,
+    BYTE_ORDER_BIG,
+} GHexEditByteOrder;
+
+/**
+ * Only GHEXEDIT_INSPECT_MAX_BYTES at the cursor are ever read, and at most
+ * once a frame however fast the cursor moves, so file size doesn't matter.
+ */
+struct _GHexEditInspector
+{
+    GtkWidget parent;
+    GtkWidget *byte_order;
+    GtkWidget *grid;
+    GtkWidget *values[GHEXEDIT_N_INSPECT_KINDS];
+    // What is being inspected
+    GHexEditHexView *view;
+    GHexEditBuffer *buffer;
+    guint tick_id;
+};
+
+G_DEFINE_TYPE(GHexEditInspector, ghexedit_inspector, GTK_TYPE_WIDGET)
+
+
+/* ===[ Decoding ]=== */
+/** Decode the bytes at the cursor into every row. */
+static void update(GHexEditInspector *inspector)
+{
+    guint8 data[GHEXEDIT_INSPECT_MAX_BYTES];
+    gssize length = -1;
+    if (inspector->buffer)
+        length = ghexedit_buffer_read(inspector->buffer, ghexedit_hex_view_get_cursor(inspector->view), data, sizeof(data), NULL);
+    gboolean big_endian = gtk_drop_down_get_selected(GTK_DROP_DOWN(inspector->byte_order)) == BYTE_ORDER_BIG;
+    for (int i = 0; i < GHEXEDIT_N_INSPECT_KINDS; ++i)
+    {
+        char *text = length > 0 ? ghexedit_inspect_format(i, data, length, big_endian) : NULL;
+        gtk_label_set_text(GTK_LABEL(inspector->values[i]), text ? text : "");
+        g_free(text);
+    }
+}
+
+/** Tick callback: decode once for this frame. */
+static gboolean update_tick(GtkWidget *widget, GdkFrameClock *clock, gpointer user_data)
+{
+    GHexEditInspector *inspector = GHEXEDIT_INSPECTOR(widget);
+    inspector->tick_id = 0;
+    update(inspector);
+    return G_SOURCE_REMOVE;
+}
+
+/** Decode again before the next frame, however often this is called until then. */
+static void queue_update(GHexEditInspector *inspector)
+{
+    if (inspector->tick_id == 0)
+        inspector->tick_id = gtk_widget_add_tick_callback(GTK_WIDGET(inspector), update_tick, NULL, NULL);
+}
+
+/** HexView::notify::cursor and DropDown::notify::selected callback. */
+static void cursor_moved(GObject *object, GParamSpec *pspec, gpointer inspector)
+{
+    queue_update(GHEXEDIT_INSPECTOR(inspector));
+}
+
+/** Buffer::changed callback: the bytes at the cursor may have changed. */
+static void buffer_changed(GHexEditBuffer *buffer, guint64 offset, guint64 removed, guint64 added, gpointer inspector)
+{
+    queue_update(GHEXEDIT_INSPECTOR(inspector));
+}
+
+/** HexView::notify::underlying callback: follow the view to its new buffer. */
+static void view_underlying(GHexEditHexView *view, GParamSpec *pspec, gpointer user_data)
+{
+    GHexEditInspector *inspector = GHEXEDIT_INSPECTOR(user_data);
+    if (inspector->buffer)
+        g_signal_handlers_disconnect_by_func(inspector->buffer, buffer_changed, inspector);
+    g_set_object(&inspector->buffer, view ? ghexedit_hex_view_get_underlying(view) : NULL);
+    if (inspector->buffer)
+        g_signal_connect(inspector->buffer, "changed", G_CALLBACK(buffer_changed), inspector);
+    queue_update(inspector);
+}
+
+
+/* ===[ GHexEditInspector ]=== */
+/** Inspect the cursor of `view` from now on. */
+void ghexedit_inspector_set_view(GHexEditInspector *inspector, GHexEditHexView *view)
+{
+    if (inspector->view == view)
+        return;
+    if (inspector->view)
+    {
+        g_signal_handlers_disconnect_by_func(inspector->view, view_underlying, inspector);
+        g_signal_handlers_disconnect_by_func(inspector->view, cursor_moved, inspector);
+    }
+    g_set_object(&inspector->view, view);
+    if (inspector->view)
+    {
+        g_signal_connect(inspector->view, "notify::underlying", G_CALLBACK(view_underlying), inspector);
+        g_signal_connect(inspector->view, "notify::cursor", G_CALLBACK(cursor_moved), inspector);
+    }
+    view_underlying(view, NULL, inspector);
+}
+
+
+/* ===[ GObject ]=== */
+/** Instantiate a new instance of the class. */
+GtkWidget *ghexedit_inspector_new()
+{
+    return g_object_new(GHEXEDIT_TYPE_INSPECTOR, NULL);
+}
+
+/**
+ * Drop held references.
+ * Can be executed more than once!
+ * Should chain up before returning.
+ */
+void ghexedit_inspector_dispose(GObject *object)
+{
+    GHexEditInspector *inspector = GHEXEDIT_INSPECTOR(object);
+    ghexedit_inspector_set_view(inspector, NULL);
+    if (inspector->tick_id)
+    {
+        gtk_widget_remove_tick_callback(GTK_WIDGET(inspector), inspector->tick_id);
+        inspector->tick_id = 0;
+    }
+    GtkWidget *child;
+    while ((child = gtk_widget_get_first_child(GTK_WIDGET(inspector))))
+        gtk_widget_unparent(child);
+    G_OBJECT_CLASS(ghexedit_inspector_parent_class)->dispose(object);
+}
+
+
+/* ===[ Base GLib ]=== */
+/** Equivalent to C++ constructor. */
+void ghexedit_inspector_init(GHexEditInspector *inspector)
+{
+    // Create child widgets from class template
+    gtk_widget_init_template(GTK_WIDGET(inspector));
+
+    // A name and a value per type
+    for (int i = 0; i < GHEXEDIT_N_INSPECT_KINDS; ++i)
+    {
+        GtkWidget *name = gtk_label_new(ghexedit_inspect_kind_get_name(i));
+        gtk_label_set_xalign(GTK_LABEL(name), 0);
+        gtk_widget_add_css_class(name, "dim-label");
+        gtk_grid_attach(GTK_GRID(inspector->grid), name, 0, i, 1, 1);
+
+        GtkWidget *value = gtk_label_new(NULL);
+        gtk_label_set_xalign(GTK_LABEL(value), 0);
+        gtk_label_set_selectable(GTK_LABEL(value), TRUE);
+        gtk_label_set_ellipsize(GTK_LABEL(value), PANGO_ELLIPSIZE_END);
+        gtk_widget_set_hexpand(value, TRUE);
+        gtk_widget_add_css_class(value, "monospace");
+        gtk_grid_attach(GTK_GRID(inspector->grid), value, 1, i, 1, 1);
+        inspector->values[i] = value;
+    }
+
+    g_signal_connect(inspector->byte_order, "notify::selected", G_CALLBACK(cursor_moved), inspector);
+}
+
+/**
+ * Called upon first instantiation of an object of this class.
+ * Sets/overrides class methods/signals/properties.
+ */
+void ghexedit_inspector_class_init(GHexEditInspectorClass *class)
+{
+    G_OBJECT_CLASS(class)->dispose = ghexedit_inspector_dispose;
+    // Set widget template
+    gtk_widget_class_set_template_from_resource(GTK_WIDGET_CLASS(class), GHX_GRESOURCE_PREFIX "Inspector.ui");
+    // Bind class children in template
+    gtk_widget_class_bind_template_child(GTK_WIDGET_CLASS(class), GHexEditInspector, byte_order);
+    gtk_widget_class_bind_template_child(GTK_WIDGET_CLASS(class), GHexEditInspector, grid);
+}
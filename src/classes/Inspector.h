@@ -0,0 +1,33 @@
+/**
+ * Inspector.h - Typed values at the cursor of the current HexView.
+ * Copyright (C) 2022 Trevor Last
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _GHX_INSPECTOR_H
+#define _GHX_INSPECTOR_H
+
+#include "HexView.h"
+
+#include <gtk/gtk.h>
+
+
+#define GHEXEDIT_TYPE_INSPECTOR ghexedit_inspector_get_type()
+G_DECLARE_FINAL_TYPE (GHexEditInspector, ghexedit_inspector, GHEXEDIT, INSPECTOR, GtkWidget);
+
+GtkWidget *ghexedit_inspector_new();
+void ghexedit_inspector_set_view(GHexEditInspector *inspector, GHexEditHexView *view);
+
+#endif
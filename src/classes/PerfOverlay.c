@@ -0,0 +1,218 @@
+/**
+ * PerfOverlay.c - Live drawing, cache and memory figures.
+ * Copyright (C) 2022 Trevor Last
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "PerfOverlay.h"
+#include "engine/PageCache.h"
+
+#include <gtk/gtk.h>
+#include <string.h>
+
+
+/** Milliseconds between refreshes; figures are averaged over this. */
+#define SAMPLE_INTERVAL 500
+
+/**
+ * A few lines of figures for performance bug reports, drawn over the
+ * corner of the window: the current view's frame cost and throughput, the
+ * shared page cache's hit rate, and the process's resident memory.
+ * Rates cover the last sample interval only, so they follow what's being
+ * done now rather than since startup.
+ */
+struct _GHexEditPerfOverlay
+{
+    GtkWidget parent;
+    GHexEditHexView *view;
+    /** Totals at the previous sample. */
+    GHexEditHexViewStats last_view;
+    GHexEditPageCacheStats last_cache;
+    PangoLayout *layout;
+    guint timeout_id;
+};
+
+G_DEFINE_TYPE(GHexEditPerfOverlay, ghexedit_perf_overlay, GTK_TYPE_WIDGET)
+
+
+/* ===[ Sampling ]=== */
+/** Resident set size in bytes, or 0 where /proc doesn't say. */
+static guint64 resident_size(void)
+{
+    char *status = NULL;
+    if (!g_file_get_contents("/proc/self/status", &status, NULL, NULL))
+        return 0;
+    guint64 kib = 0;
+    char const *line = strstr(status, "\nVmRSS:");
+    if (line)
+        kib = g_ascii_strtoull(line + strlen("\nVmRSS:"), NULL, 10);
+    g_free(status);
+    return kib * 1024;
+}
+
+/** Take new figures and lay them out. */
+static void sample(GHexEditPerfOverlay *overlay)
+{
+    GString *text = g_string_new(NULL);
+
+    GHexEditHexViewStats view = {0};
+    if (overlay->view)
+        ghexedit_hex_view_get_stats(overlay->view, &view);
+    guint64 frames = view.frames - overlay->last_view.frames;
+    if (frames)
+    {
+        GdkFrameClock *clock = gtk_widget_get_frame_clock(GTK_WIDGET(overlay->view));
+        g_string_append_printf(text, "Frame   %.2f ms (%.0f fps)\nFormat  %" G_GUINT64_FORMAT " B/frame",
+            (view.frame_time - overlay->last_view.frame_time) / 1000.0 / frames,
+            clock ? gdk_frame_clock_get_fps(clock) : 0.0,
+            (view.bytes_formatted - overlay->last_view.bytes_formatted) / frames);
+    }
+    else
+        g_string_append(text, "Frame   idle\nFormat  idle");
+    overlay->last_view = view;
+
+    GHexEditPageCacheStats cache;
+    ghexedit_page_cache_get_stats(ghexedit_page_cache_get_default(), &cache);
+    guint64 hits = cache.hits - overlay->last_cache.hits;
+    guint64 lookups = hits + cache.misses - overlay->last_cache.misses;
+    char *used = g_format_size_full(cache.used, G_FORMAT_SIZE_IEC_UNITS);
+    char *budget = g_format_size_full(cache.budget, G_FORMAT_SIZE_IEC_UNITS);
+    if (lookups)
+        g_string_append_printf(text, "\nCache   %.1f%% hits, %s of %s", hits * 100.0 / lookups, used, budget);
+    else
+        g_string_append_printf(text, "\nCache   idle, %s of %s", used, budget);
+    g_free(used);
+    g_free(budget);
+    overlay->last_cache = cache;
+
+    guint64 rss = resident_size();
+    char *resident = rss ? g_format_size_full(rss, G_FORMAT_SIZE_IEC_UNITS) : g_strdup("unknown");
+    g_string_append_printf(text, "\nRSS     %s", resident);
+    g_free(resident);
+
+    pango_layout_set_text(overlay->layout, text->str, text->len);
+    g_string_free(text, TRUE);
+    gtk_widget_queue_resize(GTK_WIDGET(overlay));
+}
+
+/** Timeout callback: refresh while shown. */
+static gboolean sample_timeout(gpointer user_data)
+{
+    sample(GHEXEDIT_PERF_OVERLAY(user_data));
+    return G_SOURCE_CONTINUE;
+}
+
+
+/* ===[ Drawing ]=== */
+/** Draw the figures, over the theme's OSD background. */
+void ghexedit_perf_overlay_snapshot(GtkWidget *widget, GtkSnapshot *snapshot)
+{
+    GHexEditPerfOverlay *overlay = GHEXEDIT_PERF_OVERLAY(widget);
+    GdkRGBA color;
+    gtk_widget_get_color(widget, &color);
+    gtk_snapshot_append_layout(snapshot, overlay->layout, &color);
+}
+
+/** Exactly the size of the text. */
+void ghexedit_perf_overlay_measure(GtkWidget *widget, GtkOrientation orientation, int for_size, int *minimum, int *natural, int *minimum_baseline, int *natural_baseline)
+{
+    int width, height;
+    pango_layout_get_pixel_size(GHEXEDIT_PERF_OVERLAY(widget)->layout, &width, &height);
+    *minimum = *natural = orientation == GTK_ORIENTATION_HORIZONTAL ? width : height;
+}
+
+/** Shown; start sampling, discarding whatever happened while hidden. */
+void ghexedit_perf_overlay_map(GtkWidget *widget)
+{
+    GHexEditPerfOverlay *overlay = GHEXEDIT_PERF_OVERLAY(widget);
+    GTK_WIDGET_CLASS(ghexedit_perf_overlay_parent_class)->map(widget);
+    sample(overlay);
+    overlay->timeout_id = g_timeout_add(SAMPLE_INTERVAL, sample_timeout, overlay);
+}
+
+/** Hidden; stop sampling. */
+void ghexedit_perf_overlay_unmap(GtkWidget *widget)
+{
+    GHexEditPerfOverlay *overlay = GHEXEDIT_PERF_OVERLAY(widget);
+    g_clear_handle_id(&overlay->timeout_id, g_source_remove);
+    GTK_WIDGET_CLASS(ghexedit_perf_overlay_parent_class)->unmap(widget);
+}
+
+
+/* ===[ GHexEditPerfOverlay ]=== */
+/** Report on `view`; NULL for none. */
+void ghexedit_perf_overlay_set_view(GHexEditPerfOverlay *overlay, GHexEditHexView *view)
+{
+    if (overlay->view == view)
+        return;
+    g_set_object(&overlay->view, view);
+    // Start the new view's rates from now
+    overlay->last_view = (GHexEditHexViewStats){0};
+    if (view)
+        ghexedit_hex_view_get_stats(view, &overlay->last_view);
+}
+
+
+/* ===[ GObject ]=== */
+/** Instantiate a new instance of the class. */
+GtkWidget *ghexedit_perf_overlay_new()
+{
+    return g_object_new(GHEXEDIT_TYPE_PERF_OVERLAY, NULL);
+}
+
+/**
+ * Drop held references.
+ * Can be executed more than once!
+ * Should chain up before returning.
+ */
+void ghexedit_perf_overlay_dispose(GObject *object)
+{
+    GHexEditPerfOverlay *overlay = GHEXEDIT_PERF_OVERLAY(object);
+    g_clear_handle_id(&overlay->timeout_id, g_source_remove);
+    g_clear_object(&overlay->view);
+    g_clear_object(&overlay->layout);
+    G_OBJECT_CLASS(ghexedit_perf_overlay_parent_class)->dispose(object);
+}
+
+
+/* ===[ Base GLib ]=== */
+/** Equivalent to C++ constructor. */
+void ghexedit_perf_overlay_init(GHexEditPerfOverlay *overlay)
+{
+    overlay->view = NULL;
+    overlay->timeout_id = 0;
+    overlay->layout = gtk_widget_create_pango_layout(GTK_WIDGET(overlay), NULL);
+    PangoFontDescription *font = pango_font_description_from_string("Monospace 9");
+    pango_layout_set_font_description(overlay->layout, font);
+    pango_font_description_free(font);
+    gtk_widget_add_css_class(GTK_WIDGET(overlay), "osd");
+    gtk_widget_set_can_target(GTK_WIDGET(overlay), FALSE);
+}
+
+/**
+ * Called upon first instantiation of an object of this class.
+ * Sets/overrides class methods/signals/properties.
+ */
+void ghexedit_perf_overlay_class_init(GHexEditPerfOverlayClass *class)
+{
+    GObjectClass *klass = G_OBJECT_CLASS(class);
+    GtkWidgetClass *widget_class = GTK_WIDGET_CLASS(class);
+    // Overrides
+    klass->dispose = ghexedit_perf_overlay_dispose;
+    widget_class->snapshot = ghexedit_perf_overlay_snapshot;
+    widget_class->measure = ghexedit_perf_overlay_measure;
+    widget_class->map = ghexedit_perf_overlay_map;
+    widget_class->unmap = ghexedit_perf_overlay_unmap;
+}
@@ -0,0 +1,335 @@
+/**
+ * TemplatePanel.c - Binary template fields of the current HexView.
+ * Copyright (C) 2022 Trevor Last
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "TemplatePanel.h"
+#include "engine/Buffer.h"
+#include "engine/Template.h"
+#include "engine/TemplateNode.h"
+
+#include "appid.h"
+
+#include <gtk/gtk.h>
+
+
+/** Milliseconds to wait after an edit before laying the template out again. */
+#define RELAYOUT_DELAY 250
+
+/**
+ * A tree of the template's fields over the current buffer, also tinted in
+ * the view. Rows are only evaluated as they are expanded or scrolled to.
+ */
+struct _GHexEditTemplatePanel
+{
+    GtkWidget parent;
+    GtkWidget *load;
+    GtkWidget *status;
+    GtkWidget *fields;
+    GHexEditTemplate *template;
+    // What the template is laid over
+    GHexEditHexView *view;
+    GHexEditBuffer *buffer;
+    GCancellable *loading;
+    guint relayout_source;
+};
+
+G_DEFINE_TYPE(GHexEditTemplatePanel, ghexedit_template_panel, GTK_TYPE_WIDGET)
+
+
+/* ===[ Field Tree ]=== */
+/** GtkTreeListModel create function: structs and arrays expand into their children. */
+static GListModel *node_children(gpointer item, gpointer user_data)
+{
+    GHexEditTemplateNode *node = GHEXEDIT_TEMPLATE_NODE(item);
+    return ghexedit_template_node_has_children(node) ? g_object_ref(G_LIST_MODEL(node)) : NULL;
+}
+
+/** Lay the template over the buffer afresh, or clear the tree if either is missing. */
+static void relayout(GHexEditTemplatePanel *panel)
+{
+    if (panel->template == NULL || panel->buffer == NULL)
+    {
+        gtk_list_view_set_model(GTK_LIST_VIEW(panel->fields), NULL);
+        if (panel->view)
+            ghexedit_hex_view_set_overlay(panel->view, NULL);
+        return;
+    }
+    GHexEditTemplateNode *root = ghexedit_template_node_new(panel->template, panel->buffer);
+    ghexedit_hex_view_set_overlay(panel->view, root);
+    // The tree takes the root
+    GtkTreeListModel *tree = gtk_tree_list_model_new(G_LIST_MODEL(root), FALSE, FALSE, node_children, NULL, NULL);
+    GtkSingleSelection *selection = gtk_single_selection_new(G_LIST_MODEL(tree));
+    gtk_list_view_set_model(GTK_LIST_VIEW(panel->fields), GTK_SELECTION_MODEL(selection));
+    g_object_unref(selection);
+}
+
+/** SignalListItemFactory::setup callback: an expander holding name, type and value. */
+static void row_setup(GtkSignalListItemFactory *factory, GtkListItem *item, gpointer user_data)
+{
+    GtkWidget *box = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 12);
+    GtkWidget *name = gtk_label_new(NULL);
+    gtk_label_set_xalign(GTK_LABEL(name), 0);
+    gtk_box_append(GTK_BOX(box), name);
+    GtkWidget *type = gtk_label_new(NULL);
+    gtk_label_set_xalign(GTK_LABEL(type), 0);
+    gtk_widget_add_css_class(type, "dim-label");
+    gtk_box_append(GTK_BOX(box), type);
+    GtkWidget *value = gtk_label_new(NULL);
+    gtk_label_set_xalign(GTK_LABEL(value), 1);
+    gtk_label_set_ellipsize(GTK_LABEL(value), PANGO_ELLIPSIZE_END);
+    gtk_widget_set_hexpand(value, TRUE);
+    gtk_widget_add_css_class(value, "monospace");
+    gtk_box_append(GTK_BOX(box), value);
+
+    GtkWidget *expander = gtk_tree_expander_new();
+    gtk_tree_expander_set_child(GTK_TREE_EXPANDER(expander), box);
+    gtk_list_item_set_child(item, expander);
+}
+
+/** SignalListItemFactory::bind callback: show a node, reading its value now that it's in view. */
+static void row_bind(GtkSignalListItemFactory *factory, GtkListItem *item, gpointer user_data)
+{
+    GtkTreeListRow *row = gtk_list_item_get_item(item);
+    GtkWidget *expander = gtk_list_item_get_child(item);
+    gtk_tree_expander_set_list_row(GTK_TREE_EXPANDER(expander), row);
+    GHexEditTemplateNode *node = gtk_tree_list_row_get_item(row);
+
+    GtkWidget *name = gtk_widget_get_first_child(gtk_tree_expander_get_child(GTK_TREE_EXPANDER(expander)));
+    GtkWidget *type = gtk_widget_get_next_sibling(name);
+    GtkWidget *value = gtk_widget_get_next_sibling(type);
+    gtk_label_set_text(GTK_LABEL(name), ghexedit_template_node_get_name(node));
+    gtk_label_set_text(GTK_LABEL(type), ghexedit_template_node_get_type_name(node));
+    char *text = ghexedit_template_node_format_value(node);
+    gtk_label_set_text(GTK_LABEL(value), text ? text : "");
+    g_free(text);
+    char *tooltip = g_strdup_printf("Offset 0x%" G_GINT64_MODIFIER "x", ghexedit_template_node_get_offset(node));
+    gtk_widget_set_tooltip_text(expander, tooltip);
+    g_free(tooltip);
+    g_object_unref(node);
+}
+
+/** SignalListItemFactory::unbind callback: let go of the row. */
+static void row_unbind(GtkSignalListItemFactory *factory, GtkListItem *item, gpointer user_data)
+{
+    gtk_tree_expander_set_list_row(GTK_TREE_EXPANDER(gtk_list_item_get_child(item)), NULL);
+}
+
+/** ListView::activate callback: select the field's bytes in the view. */
+static void row_activated(GtkListView *list, guint position, gpointer user_data)
+{
+    GHexEditTemplatePanel *panel = GHEXEDIT_TEMPLATE_PANEL(user_data);
+    GtkTreeListRow *row = g_list_model_get_item(G_LIST_MODEL(gtk_list_view_get_model(list)), position);
+    if (row == NULL || panel->view == NULL)
+    {
+        g_clear_object(&row);
+        return;
+    }
+    GHexEditTemplateNode *node = gtk_tree_list_row_get_item(row);
+    guint64 offset = ghexedit_template_node_get_offset(node);
+    guint64 size = ghexedit_template_node_get_size(node);
+    guint64 end = MIN(offset + size, ghexedit_buffer_get_size(panel->buffer));
+    if (offset < end)
+    {
+        ghexedit_hex_view_set_cursor(panel->view, end - 1, FALSE);
+        ghexedit_hex_view_set_cursor(panel->view, offset, TRUE);
+    }
+    g_object_unref(node);
+    g_object_unref(row);
+}
+
+
+/* ===[ Loading ]=== */
+/** Show `text` under the heading. */
+static void set_status(GHexEditTemplatePanel *panel, char const *text)
+{
+    gtk_label_set_text(GTK_LABEL(panel->status), text);
+}
+
+/** g_file_load_contents_async() callback: compile the template and apply it. */
+static void template_loaded(GObject *source, GAsyncResult *result, gpointer user_data)
+{
+    GFile *file = G_FILE(source);
+    GError *error = NULL;
+    char *contents = NULL;
+    gboolean loaded = g_file_load_contents_finish(file, result, &contents, NULL, NULL, &error);
+    // Cancelled means the panel is going away or loading something else
+    if (!loaded && g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+    {
+        g_error_free(error);
+        return;
+    }
+    GHexEditTemplatePanel *panel = GHEXEDIT_TEMPLATE_PANEL(user_data);
+    g_clear_object(&panel->loading);
+
+    GHexEditTemplate *template = loaded ? ghexedit_template_new(contents, &error) : NULL;
+    g_free(contents);
+    if (template == NULL)
+    {
+        set_status(panel, error->message);
+        g_error_free(error);
+        return;
+    }
+    g_clear_pointer(&panel->template, ghexedit_template_unref);
+    panel->template = template;
+    char *basename = g_file_get_basename(file);
+    set_status(panel, basename);
+    g_free(basename);
+    relayout(panel);
+}
+
+/** Load dialog callback; the panel is held until the dialog closes. */
+static void template_picked(GObject *source, GAsyncResult *result, gpointer user_data)
+{
+    GHexEditTemplatePanel *panel = GHEXEDIT_TEMPLATE_PANEL(user_data);
+    GFile *file = gtk_file_dialog_open_finish(GTK_FILE_DIALOG(source), result, NULL);
+    if (file)
+    {
+        if (panel->loading)
+            g_cancellable_cancel(panel->loading);
+        g_clear_object(&panel->loading);
+        panel->loading = g_cancellable_new();
+        g_file_load_contents_async(file, panel->loading, template_loaded, panel);
+        g_object_unref(file);
+    }
+    g_object_unref(panel);
+}
+
+/** Load button callback: pick a template file. */
+static void load_clicked(GtkButton *button, gpointer panel)
+{
+    GtkWindow *win = GTK_WINDOW(gtk_widget_get_root(GTK_WIDGET(panel)));
+    GtkFileDialog *dialog = gtk_file_dialog_new();
+    gtk_file_dialog_set_title(dialog, "Load Template");
+    gtk_file_dialog_set_accept_label(dialog, "Load");
+    gtk_file_dialog_open(dialog, win, NULL, template_picked, g_object_ref(panel));
+    g_object_unref(dialog);
+}
+
+/* ===[ Following the View ]=== */
+/** Timeout callback: editing paused, so lay the template out again. */
+static gboolean relayout_timeout(gpointer user_data)
+{
+    GHexEditTemplatePanel *panel = GHEXEDIT_TEMPLATE_PANEL(user_data);
+    panel->relayout_source = 0;
+    relayout(panel);
+    return G_SOURCE_REMOVE;
+}
+
+/** Buffer::changed callback: the tree is a snapshot; redo it once editing pauses. */
+static void buffer_changed(GHexEditBuffer *buffer, guint64 offset, guint64 removed, guint64 added, gpointer user_data)
+{
+    GHexEditTemplatePanel *panel = GHEXEDIT_TEMPLATE_PANEL(user_data);
+    if (panel->relayout_source)
+        g_source_remove(panel->relayout_source);
+    panel->relayout_source = g_timeout_add(RELAYOUT_DELAY, relayout_timeout, panel);
+}
+
+/** HexView::notify::underlying callback: follow the view to its new buffer. */
+static void view_underlying(GHexEditHexView *view, GParamSpec *pspec, gpointer user_data)
+{
+    GHexEditTemplatePanel *panel = GHEXEDIT_TEMPLATE_PANEL(user_data);
+    if (panel->buffer)
+        g_signal_handlers_disconnect_by_func(panel->buffer, buffer_changed, panel);
+    g_set_object(&panel->buffer, view ? ghexedit_hex_view_get_underlying(view) : NULL);
+    if (panel->buffer)
+        g_signal_connect(panel->buffer, "changed", G_CALLBACK(buffer_changed), panel);
+    if (panel->relayout_source)
+    {
+        g_source_remove(panel->relayout_source);
+        panel->relayout_source = 0;
+    }
+    relayout(panel);
+}
+
+
+/* ===[ GHexEditTemplatePanel ]=== */
+/** Lay the template over the buffer of `view` from now on. */
+void ghexedit_template_panel_set_view(GHexEditTemplatePanel *panel, GHexEditHexView *view)
+{
+    if (panel->view == view)
+        return;
+    if (panel->view)
+    {
+        g_signal_handlers_disconnect_by_func(panel->view, view_underlying, panel);
+        ghexedit_hex_view_set_overlay(panel->view, NULL);
+    }
+    g_set_object(&panel->view, view);
+    if (panel->view)
+        g_signal_connect(panel->view, "notify::underlying", G_CALLBACK(view_underlying), panel);
+    view_underlying(view, NULL, panel);
+}
+
+
+/* ===[ GObject ]=== */
+/** Instantiate a new instance of the class. */
+GtkWidget *ghexedit_template_panel_new()
+{
+    return g_object_new(GHEXEDIT_TYPE_TEMPLATE_PANEL, NULL);
+}
+
+/**
+ * Drop held references.
+ * Can be executed more than once!
+ * Should chain up before returning.
+ */
+void ghexedit_template_panel_dispose(GObject *object)
+{
+    GHexEditTemplatePanel *panel = GHEXEDIT_TEMPLATE_PANEL(object);
+    if (panel->loading)
+        g_cancellable_cancel(panel->loading);
+    g_clear_object(&panel->loading);
+    ghexedit_template_panel_set_view(panel, NULL);
+    g_clear_pointer(&panel->template, ghexedit_template_unref);
+    GtkWidget *child;
+    while ((child = gtk_widget_get_first_child(GTK_WIDGET(panel))))
+        gtk_widget_unparent(child);
+    G_OBJECT_CLASS(ghexedit_template_panel_parent_class)->dispose(object);
+}
+
+
+/* ===[ Base GLib ]=== */
+/** Equivalent to C++ constructor. */
+void ghexedit_template_panel_init(GHexEditTemplatePanel *panel)
+{
+    // Create child widgets from class template
+    gtk_widget_init_template(GTK_WIDGET(panel));
+
+    GtkListItemFactory *factory = gtk_signal_list_item_factory_new();
+    g_signal_connect(factory, "setup", G_CALLBACK(row_setup), NULL);
+    g_signal_connect(factory, "bind", G_CALLBACK(row_bind), NULL);
+    g_signal_connect(factory, "unbind", G_CALLBACK(row_unbind), NULL);
+    gtk_list_view_set_factory(GTK_LIST_VIEW(panel->fields), factory);
+    g_object_unref(factory);
+
+    g_signal_connect(panel->fields, "activate", G_CALLBACK(row_activated), panel);
+    g_signal_connect(panel->load, "clicked", G_CALLBACK(load_clicked), panel);
+}
+
+/**
+ * Called upon first instantiation of an object of this class.
+ * Sets/overrides class methods/signals/properties.
+ */
+void ghexedit_template_panel_class_init(GHexEditTemplatePanelClass *class)
+{
+    G_OBJECT_CLASS(class)->dispose = ghexedit_template_panel_dispose;
+    // Set widget template
+    gtk_widget_class_set_template_from_resource(GTK_WIDGET_CLASS(class), GHX_GRESOURCE_PREFIX "TemplatePanel.ui");
+    // Bind class children in template
+    gtk_widget_class_bind_template_child(GTK_WIDGET_CLASS(class), GHexEditTemplatePanel, load);
+    gtk_widget_class_bind_template_child(GTK_WIDGET_CLASS(class), GHexEditTemplatePanel, status);
+    gtk_widget_class_bind_template_child(GTK_WIDGET_CLASS(class), GHexEditTemplatePanel, fields);
+}
@@ -0,0 +1,221 @@
+/**
+ * AddBuffer.c - Storage for bytes typed or pasted into a buffer.
+ * Copyright (C) 2022 Trevor Last
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "AddBuffer.h"
+
+#include <string.h>
+
+
+/**
+ * Bytes are appended to fixed-size chunks that never move, so a range of the
+ * add buffer means the same bytes for as long as anything holds it.
+ */
+#define CHUNK_SHIFT 20
+#define CHUNK_SIZE (1u << CHUNK_SHIFT)
+
+typedef struct
+{
+    /** One for the add buffer while it keeps the chunk, plus one per view. */
+    gint ref_count;
+    /** Bytes in the chunk the piece table or undo history still point at. */
+    gsize held;
+    guint8 data[];
+} Chunk;
+
+/**
+ * Chunks are indexed by start >> CHUNK_SHIFT. A chunk is dropped once none
+ * of its bytes are held, leaving a NULL slot; offsets are never reused.
+ */
+struct _GHexEditAddBuffer
+{
+    GPtrArray *chunks;
+    guint64 length;
+};
+
+struct _GHexEditAddView
+{
+    guint n_chunks;
+    Chunk *chunks[];
+};
+
+
+static void chunk_unref(Chunk *chunk)
+{
+    if (chunk && g_atomic_int_dec_and_test(&chunk->ref_count))
+        g_free(chunk);
+}
+
+/** Call `func` on each run of `chunks` backing a range, without copying. */
+static gboolean chunks_foreach_run(Chunk *const *chunks, guint64 start, guint64 length, GHexEditAddRunFunc func, gpointer user_data)
+{
+    while (length > 0)
+    {
+        gsize within = start & (CHUNK_SIZE - 1);
+        gsize n = MIN(length, CHUNK_SIZE - within);
+        if (!func(chunks[start >> CHUNK_SHIFT]->data + within, n, user_data))
+            return FALSE;
+        start += n;
+        length -= n;
+    }
+    return TRUE;
+}
+
+static void chunks_copy(Chunk *const *chunks, guint64 start, guint8 *dest, gsize length)
+{
+    while (length > 0)
+    {
+        gsize within = start & (CHUNK_SIZE - 1);
+        gsize n = MIN(length, CHUNK_SIZE - within);
+        memcpy(dest, chunks[start >> CHUNK_SHIFT]->data + within, n);
+        start += n;
+        dest += n;
+        length -= n;
+    }
+}
+
+
+/* ===[ GHexEditAddBuffer ]=== */
+GHexEditAddBuffer *ghexedit_add_buffer_new(void)
+{
+    GHexEditAddBuffer *add = g_new0(GHexEditAddBuffer, 1);
+    add->chunks = g_ptr_array_new_with_free_func((GDestroyNotify)chunk_unref);
+    return add;
+}
+
+/** Views taken earlier keep the chunks they need. */
+void ghexedit_add_buffer_free(GHexEditAddBuffer *add)
+{
+    if (add == NULL)
+        return;
+    g_ptr_array_unref(add->chunks);
+    g_free(add);
+}
+
+/** Append bytes, held once, returning where they start. */
+guint64 ghexedit_add_buffer_append(GHexEditAddBuffer *add, guint8 const *data, gsize length)
+{
+    guint64 start = add->length;
+    while (length > 0)
+    {
+        guint64 index = add->length >> CHUNK_SHIFT;
+        gsize within = add->length & (CHUNK_SIZE - 1);
+        if (index == add->chunks->len)
+        {
+            Chunk *chunk = g_malloc(sizeof(Chunk) + CHUNK_SIZE);
+            chunk->ref_count = 1;
+            chunk->held = 0;
+            g_ptr_array_add(add->chunks, chunk);
+        }
+        Chunk *chunk = g_ptr_array_index(add->chunks, index);
+        gsize n = MIN(length, CHUNK_SIZE - within);
+        memcpy(chunk->data + within, data, n);
+        chunk->held += n;
+        add->length += n;
+        data += n;
+        length -= n;
+    }
+    return start;
+}
+
+/** Hold a range once more, for a second piece pointing at it. */
+void ghexedit_add_buffer_hold(GHexEditAddBuffer *add, guint64 start, guint64 length)
+{
+    while (length > 0)
+    {
+        Chunk *chunk = g_ptr_array_index(add->chunks, start >> CHUNK_SHIFT);
+        gsize n = MIN(length, CHUNK_SIZE - (start & (CHUNK_SIZE - 1)));
+        g_return_if_fail(chunk != NULL);
+        chunk->held += n;
+        start += n;
+        length -= n;
+    }
+}
+
+/**
+ * Let go of a range held by a piece that is gone. Chunks left with nothing
+ * held are freed, except the one still being appended to.
+ */
+void ghexedit_add_buffer_release(GHexEditAddBuffer *add, guint64 start, guint64 length)
+{
+    while (length > 0)
+    {
+        guint64 index = start >> CHUNK_SHIFT;
+        Chunk *chunk = g_ptr_array_index(add->chunks, index);
+        gsize n = MIN(length, CHUNK_SIZE - (start & (CHUNK_SIZE - 1)));
+        g_return_if_fail(chunk != NULL && chunk->held >= n);
+        chunk->held -= n;
+        if (chunk->held == 0 && (index + 1) << CHUNK_SHIFT <= add->length)
+        {
+            chunk_unref(chunk);
+            add->chunks->pdata[index] = NULL;
+        }
+        start += n;
+        length -= n;
+    }
+}
+
+void ghexedit_add_buffer_copy(GHexEditAddBuffer *add, guint64 start, guint8 *dest, gsize length)
+{
+    chunks_copy((Chunk *const *)add->chunks->pdata, start, dest, length);
+}
+
+/** Call `func` on each run backing a range, without copying. */
+gboolean ghexedit_add_buffer_foreach_run(GHexEditAddBuffer *add, guint64 start, guint64 length, GHexEditAddRunFunc func, gpointer user_data)
+{
+    return chunks_foreach_run((Chunk *const *)add->chunks->pdata, start, length, func, user_data);
+}
+
+/**
+ * Freeze the bytes appended so far for reading from any thread. Later
+ * appends don't touch them, and the view keeps every chunk alive however
+ * many of its bytes are released meanwhile.
+ */
+GHexEditAddView *ghexedit_add_buffer_view(GHexEditAddBuffer *add)
+{
+    GHexEditAddView *view = g_malloc(sizeof(GHexEditAddView) + add->chunks->len * sizeof(Chunk *));
+    view->n_chunks = add->chunks->len;
+    for (guint i = 0; i < view->n_chunks; ++i)
+    {
+        Chunk *chunk = g_ptr_array_index(add->chunks, i);
+        if (chunk)
+            g_atomic_int_inc(&chunk->ref_count);
+        view->chunks[i] = chunk;
+    }
+    return view;
+}
+
+
+/* ===[ GHexEditAddView ]=== */
+void ghexedit_add_view_free(GHexEditAddView *view)
+{
+    if (view == NULL)
+        return;
+    for (guint i = 0; i < view->n_chunks; ++i)
+        chunk_unref(view->chunks[i]);
+    g_free(view);
+}
+
+void ghexedit_add_view_copy(GHexEditAddView *view, guint64 start, guint8 *dest, gsize length)
+{
+    chunks_copy(view->chunks, start, dest, length);
+}
+
+gboolean ghexedit_add_view_foreach_run(GHexEditAddView *view, guint64 start, guint64 length, GHexEditAddRunFunc func, gpointer user_data)
+{
+    return chunks_foreach_run(view->chunks, start, length, func, user_data);
+}
@@ -0,0 +1,50 @@
+/**
+ * AddBuffer.h - Storage for bytes typed or pasted into a buffer.
+ * Copyright (C) 2022 Trevor Last
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _GHX_ADDBUFFER_H
+#define _GHX_ADDBUFFER_H
+
+#include <glib.h>
+
+
+/**
+ * Bytes typed or pasted into a buffer. Not thread-safe: the owning buffer's
+ * lock guards it. Views are the exception, and can be read from any thread.
+ */
+typedef struct _GHexEditAddBuffer GHexEditAddBuffer;
+
+/** The bytes an add buffer had at one moment, kept alive until freed. */
+typedef struct _GHexEditAddView GHexEditAddView;
+
+/** Called for each contiguous run of bytes in a range. Return FALSE to stop. */
+typedef gboolean (*GHexEditAddRunFunc)(guint8 const *data, gsize length, gpointer user_data);
+
+GHexEditAddBuffer *ghexedit_add_buffer_new(void);
+void ghexedit_add_buffer_free(GHexEditAddBuffer *add);
+guint64 ghexedit_add_buffer_append(GHexEditAddBuffer *add, guint8 const *data, gsize length);
+void ghexedit_add_buffer_hold(GHexEditAddBuffer *add, guint64 start, guint64 length);
+void ghexedit_add_buffer_release(GHexEditAddBuffer *add, guint64 start, guint64 length);
+void ghexedit_add_buffer_copy(GHexEditAddBuffer *add, guint64 start, guint8 *dest, gsize length);
+gboolean ghexedit_add_buffer_foreach_run(GHexEditAddBuffer *add, guint64 start, guint64 length, GHexEditAddRunFunc func, gpointer user_data);
+GHexEditAddView *ghexedit_add_buffer_view(GHexEditAddBuffer *add);
+
+void ghexedit_add_view_free(GHexEditAddView *view);
+void ghexedit_add_view_copy(GHexEditAddView *view, guint64 start, guint8 *dest, gsize length);
+gboolean ghexedit_add_view_foreach_run(GHexEditAddView *view, guint64 start, guint64 length, GHexEditAddRunFunc func, gpointer user_data);
+
+#endif
@@ -0,0 +1,448 @@
+/**
+ * Batch.c - Headless dump, search, checksum and patch over streams.
+ * Copyright (C) 2022 Trevor Last
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "Batch.h"
+#include "Checksum.h"
+#include "Digest.h"
+#include "Trace.h"
+
+#include <string.h>
+
+
+/** Bytes read per block; large enough that formatting and hashing, not calls, dominate. */
+#define BLOCK_SIZE (4 * 1024 * 1024)
+
+/** Names of the checksum kinds, as given on the command line and printed. */
+static char const *const checksum_ids[GHEXEDIT_N_CHECKSUMS] = {
+    [GHEXEDIT_CHECKSUM_CRC32] = "crc32",
+    [GHEXEDIT_CHECKSUM_ADLER32] = "adler32",
+    [GHEXEDIT_CHECKSUM_SHA256] = "sha256",
+    [GHEXEDIT_CHECKSUM_BLAKE3] = "blake3",
+};
+
+/** What one line of a patch script does. */
+typedef enum
+{
+    PATCH_WRITE,
+    PATCH_INSERT,
+    PATCH_DELETE,
+} PatchKind;
+
+typedef struct
+{
+    PatchKind kind;
+    guint64 offset;
+    /** Bytes to delete, for PATCH_DELETE. */
+    guint64 length;
+    /** Bytes to write or insert; NULL for PATCH_DELETE. */
+    GBytes *data;
+} PatchEdit;
+
+
+/* ===[ Reading ]=== */
+/**
+ * Move `input` on by `offset` bytes: seeking where it can, reading past
+ * them where it can't (pipes). Stopping short at the end isn't an error;
+ * there's just nothing left to read.
+ */
+static gboolean skip_to(GInputStream *input, guint64 offset, GCancellable *cancellable, GError **error)
+{
+    if (offset == 0)
+        return TRUE;
+    if (G_IS_SEEKABLE(input) && g_seekable_can_seek(G_SEEKABLE(input)))
+        return g_seekable_seek(G_SEEKABLE(input), offset, G_SEEK_CUR, cancellable, error);
+    while (offset > 0)
+    {
+        gssize skipped = g_input_stream_skip(input, MIN(offset, BLOCK_SIZE), cancellable, error);
+        if (skipped < 0)
+            return FALSE;
+        if (skipped == 0)
+            break;
+        offset -= skipped;
+    }
+    return TRUE;
+}
+
+/**
+ * Fill `block` with up to `size` bytes of what's left of the range,
+ * counting them off `remaining`. Short only at the end of the range or of
+ * the input. Returns -1 on error.
+ */
+static gssize read_block(GInputStream *input, guint8 *block, gsize size, guint64 *remaining, GCancellable *cancellable, GError **error)
+{
+    gsize got = 0;
+    if (!g_input_stream_read_all(input, block, MIN(size, *remaining), &got, cancellable, error))
+        return -1;
+    *remaining -= got;
+    return got;
+}
+
+
+/* ===[ Dump ]=== */
+/**
+ * Write `length` bytes of `input` from `offset` (GHEXEDIT_BATCH_TO_END for
+ * all of it) to `output` as hex rows laid out like the editor's. The input
+ * is read a block at a time, so it may be a pipe of any size.
+ */
+gboolean ghexedit_batch_dump(GInputStream *input, guint64 offset, guint64 length, GHexEditHexFormat const *format, GOutputStream *output, GCancellable *cancellable, GError **error)
+{
+    g_return_val_if_fail(format->bytes_per_line > 0, FALSE);
+    if (!skip_to(input, offset, cancellable, error))
+        return FALSE;
+    // Whole rows per block, so each block starts a row
+    gsize block_size = BLOCK_SIZE - BLOCK_SIZE % format->bytes_per_line;
+    guint8 *block = g_malloc(block_size);
+    char *out = g_malloc(ghexedit_hex_format_max_length(format, block_size));
+    guint64 remaining = length;
+    guint64 base = offset;
+    gboolean ok = TRUE;
+    for (;;)
+    {
+        gssize got = read_block(input, block, block_size, &remaining, cancellable, error);
+        if (got <= 0)
+        {
+            ok = got == 0;
+            break;
+        }
+        GHEXEDIT_TRACE_BEGIN(batch_format);
+        gsize out_length = ghexedit_hex_format(format, block, got, base, out);
+        GHEXEDIT_TRACE_END(batch_format, "%" G_GSSIZE_FORMAT " bytes", got);
+        if (!g_output_stream_write_all(output, out, out_length, NULL, cancellable, error))
+        {
+            ok = FALSE;
+            break;
+        }
+        base += got;
+    }
+    g_free(out);
+    g_free(block);
+    return ok;
+}
+
+
+/* ===[ Search ]=== */
+/**
+ * Write a line for each match of `pattern` starting within `length` bytes
+ * of `input` from `offset`: its offset in hex and its length. Blocks
+ * overlap by as much as the pattern needs, as in a parallel search, so no
+ * match straddling two is missed. The number found goes in `n_matches`.
+ */
+gboolean ghexedit_batch_search(GInputStream *input, guint64 offset, guint64 length, GHexEditPattern *pattern, GOutputStream *output, guint64 *n_matches, GCancellable *cancellable, GError **error)
+{
+    *n_matches = 0;
+    if (!skip_to(input, offset, cancellable, error))
+        return FALSE;
+    gsize overlap = ghexedit_pattern_get_overlap(pattern);
+    guint8 *window = g_malloc(overlap + BLOCK_SIZE);
+    GArray *matches = g_array_new(FALSE, FALSE, sizeof(GHexEditMatch));
+    GString *text = g_string_new(NULL);
+    guint64 remaining = length;
+    guint64 base = offset;
+    /** Bytes carried over from the end of the previous block. */
+    gsize held = 0;
+    gboolean ok = TRUE;
+    gboolean end = FALSE;
+    while (!end)
+    {
+        gsize want = MIN((guint64)BLOCK_SIZE, remaining);
+        gssize got = read_block(input, window + held, want, &remaining, cancellable, error);
+        if (got < 0)
+        {
+            ok = FALSE;
+            break;
+        }
+        end = (gsize)got < want || remaining == 0;
+        gsize size = held + got;
+        // Matches starting in the overlap are left for the next block, which can see all of them
+        gsize limit = end ? size : size - MIN(overlap, size);
+
+        g_array_set_size(matches, 0);
+        ghexedit_pattern_scan(pattern, window, size, limit, base, matches, G_MAXUINT);
+        for (guint i = 0; i < matches->len; ++i)
+        {
+            GHexEditMatch const *match = &g_array_index(matches, GHexEditMatch, i);
+            g_string_append_printf(text, "%08" G_GINT64_MODIFIER "x %" G_GUINT64_FORMAT "\n", match->offset, match->length);
+        }
+        *n_matches += matches->len;
+        if (text->len && !g_output_stream_write_all(output, text->str, text->len, NULL, cancellable, error))
+        {
+            ok = FALSE;
+            break;
+        }
+        g_string_truncate(text, 0);
+
+        memmove(window, window + limit, size - limit);
+        held = size - limit;
+        base += limit;
+    }
+    g_string_free(text, TRUE);
+    g_array_unref(matches);
+    g_free(window);
+    return ok;
+}
+
+
+/* ===[ Checksum ]=== */
+/**
+ * Parse a comma-separated list of checksum names (crc32, adler32, sha256,
+ * blake3), or "all", into a mask of `1 << kind`.
+ */
+gboolean ghexedit_batch_parse_checksums(char const *list, guint *kinds, GError **error)
+{
+    *kinds = 0;
+    if (g_strcmp0(list, "all") == 0)
+    {
+        *kinds = (1u << GHEXEDIT_N_CHECKSUMS) - 1;
+        return TRUE;
+    }
+    char **names = g_strsplit(list, ",", -1);
+    gboolean ok = TRUE;
+    for (char **name = names; ok && *name; ++name)
+    {
+        guint kind = 0;
+        while (kind < GHEXEDIT_N_CHECKSUMS && g_ascii_strcasecmp(g_strstrip(*name), checksum_ids[kind]) != 0)
+            ++kind;
+        if (kind == GHEXEDIT_N_CHECKSUMS)
+        {
+            g_set_error(error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT, "Unknown checksum \"%s\"; expected crc32, adler32, sha256, blake3 or all", *name);
+            ok = FALSE;
+        }
+        else
+            *kinds |= 1u << kind;
+    }
+    g_strfreev(names);
+    return ok && *kinds != 0;
+}
+
+/**
+ * Write the digests in `kinds` of `length` bytes of `input` from `offset`,
+ * one "name digest" line each. All are computed in one pass, so the input
+ * can be a pipe.
+ */
+gboolean ghexedit_batch_checksum(GInputStream *input, guint64 offset, guint64 length, guint kinds, GOutputStream *output, GCancellable *cancellable, GError **error)
+{
+    if (!skip_to(input, offset, cancellable, error))
+        return FALSE;
+    guint32 crc = 0, adler = 1;
+    GHexEditBlake3 blake3;
+    ghexedit_blake3_init(&blake3);
+    GChecksum *sha = g_checksum_new(G_CHECKSUM_SHA256);
+    guint8 *block = g_malloc(BLOCK_SIZE);
+    guint64 remaining = length;
+    gssize got;
+    while ((got = read_block(input, block, BLOCK_SIZE, &remaining, cancellable, error)) > 0)
+    {
+        GHEXEDIT_TRACE_BEGIN(batch_hash);
+        if (kinds & (1u << GHEXEDIT_CHECKSUM_CRC32))
+            crc = ghexedit_crc32_update(crc, block, got);
+        if (kinds & (1u << GHEXEDIT_CHECKSUM_ADLER32))
+            adler = ghexedit_adler32_update(adler, block, got);
+        if (kinds & (1u << GHEXEDIT_CHECKSUM_SHA256))
+            g_checksum_update(sha, block, got);
+        if (kinds & (1u << GHEXEDIT_CHECKSUM_BLAKE3))
+            ghexedit_blake3_update(&blake3, block, got);
+        GHEXEDIT_TRACE_END(batch_hash, "%" G_GSSIZE_FORMAT " bytes", got);
+    }
+    g_free(block);
+
+    gboolean ok = got == 0;
+    if (ok)
+    {
+        GString *text = g_string_new(NULL);
+        if (kinds & (1u << GHEXEDIT_CHECKSUM_CRC32))
+            g_string_append_printf(text, "%s %08x\n", checksum_ids[GHEXEDIT_CHECKSUM_CRC32], crc);
+        if (kinds & (1u << GHEXEDIT_CHECKSUM_ADLER32))
+            g_string_append_printf(text, "%s %08x\n", checksum_ids[GHEXEDIT_CHECKSUM_ADLER32], adler);
+        if (kinds & (1u << GHEXEDIT_CHECKSUM_SHA256))
+            g_string_append_printf(text, "%s %s\n", checksum_ids[GHEXEDIT_CHECKSUM_SHA256], g_checksum_get_string(sha));
+        if (kinds & (1u << GHEXEDIT_CHECKSUM_BLAKE3))
+        {
+            guint8 out[GHEXEDIT_BLAKE3_OUT_LEN];
+            ghexedit_blake3_finish(&blake3, out);
+            g_string_append_printf(text, "%s ", checksum_ids[GHEXEDIT_CHECKSUM_BLAKE3]);
+            for (gsize i = 0; i < sizeof(out); ++i)
+                g_string_append_printf(text, "%02x", out[i]);
+            g_string_append_c(text, '\n');
+        }
+        ok = g_output_stream_write_all(output, text->str, text->len, NULL, cancellable, error);
+        g_string_free(text, TRUE);
+    }
+    g_checksum_free(sha);
+    return ok;
+}
+
+
+/* ===[ Patch ]=== */
+/** A number in decimal, or in hex after 0x. */
+static gboolean parse_number(char const *word, guint64 *value)
+{
+    gboolean hex = g_str_has_prefix(word, "0x") || g_str_has_prefix(word, "0X");
+    char const *digits = hex ? word + 2 : word;
+    if (!(hex ? g_ascii_isxdigit(*digits) : g_ascii_isdigit(*digits)))
+        return FALSE;
+    char *end;
+    *value = g_ascii_strtoull(digits, &end, hex ? 16 : 10);
+    return *end == '\0';
+}
+
+/** Hex digit pairs, spread over any number of words, as bytes; NULL if they aren't. */
+static GBytes *parse_hex(char **words, guint n_words)
+{
+    GByteArray *out = g_byte_array_new();
+    for (guint w = 0; w < n_words; ++w)
+    {
+        char const *s = words[w];
+        gsize length = strlen(s);
+        if (length % 2)
+        {
+            g_byte_array_unref(out);
+            return NULL;
+        }
+        for (gsize i = 0; i < length; i += 2)
+        {
+            if (!g_ascii_isxdigit(s[i]) || !g_ascii_isxdigit(s[i + 1]))
+            {
+                g_byte_array_unref(out);
+                return NULL;
+            }
+            guint8 byte = g_ascii_xdigit_value(s[i]) << 4 | g_ascii_xdigit_value(s[i + 1]);
+            g_byte_array_append(out, &byte, 1);
+        }
+    }
+    return g_byte_array_free_to_bytes(out);
+}
+
+static void patch_edit_clear(gpointer data)
+{
+    PatchEdit *edit = data;
+    g_clear_pointer(&edit->data, g_bytes_unref);
+}
+
+/**
+ * Parse one line into `edit`, checking it against the buffer's size as the
+ * lines before will have left it, and updating that. Blank lines and
+ * comments set `skip` instead.
+ */
+static gboolean parse_line(char *line, guint number, guint64 *size, PatchEdit *edit, gboolean *skip, GError **error)
+{
+    *skip = FALSE;
+    char **split = g_strsplit_set(line, " \t\r", -1);
+    // g_strsplit_set leaves empty strings between runs of spaces
+    GPtrArray *words = g_ptr_array_new();
+    for (char **word = split; *word; ++word)
+        if (**word)
+            g_ptr_array_add(words, *word);
+
+    gboolean ok = FALSE;
+    char const *problem = NULL;
+    if (words->len == 0 || *(char *)words->pdata[0] == '#')
+        *skip = ok = TRUE;
+    else if (words->len < 3)
+        problem = "expected a command, an offset and data";
+    else if (!parse_number(words->pdata[1], &edit->offset))
+        problem = "bad offset";
+    else if (edit->offset > *size)
+        problem = "offset past the end";
+    else if (g_strcmp0(words->pdata[0], "delete") == 0)
+    {
+        edit->kind = PATCH_DELETE;
+        if (words->len != 3 || !parse_number(words->pdata[2], &edit->length))
+            problem = "bad length";
+        else if (edit->length > *size - edit->offset)
+            problem = "deletes past the end";
+        else
+        {
+            *size -= edit->length;
+            ok = TRUE;
+        }
+    }
+    else if (g_strcmp0(words->pdata[0], "write") == 0 || g_strcmp0(words->pdata[0], "insert") == 0)
+    {
+        edit->kind = g_strcmp0(words->pdata[0], "write") == 0 ? PATCH_WRITE : PATCH_INSERT;
+        edit->data = parse_hex((char **)words->pdata + 2, words->len - 2);
+        if (edit->data == NULL)
+            problem = "bad hex bytes";
+        else
+        {
+            guint64 n = g_bytes_get_size(edit->data);
+            *size = edit->kind == PATCH_WRITE ? MAX(*size, edit->offset + n) : *size + n;
+            ok = TRUE;
+        }
+    }
+    else
+        problem = "unknown command; expected write, insert or delete";
+
+    if (problem)
+        g_set_error(error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA, "Patch line %u: %s", number, problem);
+    g_ptr_array_unref(words);
+    g_strfreev(split);
+    return ok;
+}
+
+/**
+ * Apply a patch script to `buffer`, a line at a time:
+ *
+ *     write OFFSET HEX...     overwrite bytes at OFFSET, growing at the end
+ *     insert OFFSET HEX...    insert bytes before OFFSET
+ *     delete OFFSET LENGTH    delete LENGTH bytes at OFFSET
+ *
+ * Offsets are as each line finds the buffer, after the lines before it.
+ * Numbers are decimal, or hex after 0x; hex bytes may be spaced. Blank
+ * lines and lines starting with # are skipped. The whole script is checked
+ * first, so a bad line leaves the buffer untouched.
+ */
+gboolean ghexedit_batch_patch(GHexEditBuffer *buffer, char const *script, GError **error)
+{
+    GArray *edits = g_array_new(FALSE, TRUE, sizeof(PatchEdit));
+    g_array_set_clear_func(edits, patch_edit_clear);
+    char **lines = g_strsplit(script, "\n", -1);
+    guint64 size = ghexedit_buffer_get_size(buffer);
+    gboolean ok = TRUE;
+    for (guint i = 0; ok && lines[i]; ++i)
+    {
+        PatchEdit edit = {0};
+        gboolean skip;
+        ok = parse_line(lines[i], i + 1, &size, &edit, &skip, error);
+        if (ok && !skip)
+            g_array_append_val(edits, edit);
+        else
+            patch_edit_clear(&edit);
+    }
+    g_strfreev(lines);
+
+    for (guint i = 0; ok && i < edits->len; ++i)
+    {
+        PatchEdit const *edit = &g_array_index(edits, PatchEdit, i);
+        gsize length = edit->data ? g_bytes_get_size(edit->data) : 0;
+        guint8 const *data = edit->data ? g_bytes_get_data(edit->data, NULL) : NULL;
+        switch (edit->kind)
+        {
+        case PATCH_WRITE:
+            ghexedit_buffer_overwrite(buffer, edit->offset, data, length);
+            break;
+        case PATCH_INSERT:
+            ghexedit_buffer_insert(buffer, edit->offset, data, length);
+            break;
+        case PATCH_DELETE:
+            ghexedit_buffer_delete(buffer, edit->offset, edit->length);
+            break;
+        }
+    }
+    g_array_unref(edits);
+    return ok;
+}
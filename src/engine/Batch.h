@@ -0,0 +1,38 @@
+/**
+ * Batch.h - Headless dump, search, checksum and patch over streams.
+ * Copyright (C) 2022 Trevor Last
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _GHX_BATCH_H
+#define _GHX_BATCH_H
+
+#include <gio/gio.h>
+
+#include "Buffer.h"
+#include "HexFormat.h"
+#include "Pattern.h"
+
+
+/** Length meaning "to the end of the input". */
+#define GHEXEDIT_BATCH_TO_END G_MAXUINT64
+
+gboolean ghexedit_batch_dump(GInputStream *input, guint64 offset, guint64 length, GHexEditHexFormat const *format, GOutputStream *output, GCancellable *cancellable, GError **error);
+gboolean ghexedit_batch_search(GInputStream *input, guint64 offset, guint64 length, GHexEditPattern *pattern, GOutputStream *output, guint64 *n_matches, GCancellable *cancellable, GError **error);
+gboolean ghexedit_batch_checksum(GInputStream *input, guint64 offset, guint64 length, guint kinds, GOutputStream *output, GCancellable *cancellable, GError **error);
+gboolean ghexedit_batch_parse_checksums(char const *list, guint *kinds, GError **error);
+gboolean ghexedit_batch_patch(GHexEditBuffer *buffer, char const *script, GError **error);
+
+#endif
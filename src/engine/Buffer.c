@@ -0,0 +1,1429 @@
+/**
+ * Buffer.c - Editable view of a document.
+ * Copyright (C) 2022 Trevor Last
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#define _GNU_SOURCE
+
+#include "Buffer.h"
+
+#include <glib/gstdio.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "AddBuffer.h"
+#include "Journal.h"
+#include "PieceTable.h"
+
+
+/** Saving writes in blocks of this size. */
+#define SAVE_BLOCK_SIZE (4 * 1024 * 1024)
+
+/** Least time between refreshes while following a file, in milliseconds. */
+#define FOLLOW_RATE_LIMIT 100
+
+/**
+ * One version of the file the buffer has read from; each save starts one.
+ * Original pieces point into a single space in which each generation's bytes
+ * start at `base`, so undo history keeps reading the file as it was before a
+ * save replaced or patched it.
+ */
+typedef struct
+{
+    guint64 base;
+    /** Most bytes the document has had, all of which pieces may point at. */
+    guint64 length;
+    GHexEditDocument *document;
+    /** Shared by generations reading the same file on disk, which saving in place patches under all of them. */
+    guint file;
+} Generation;
+
+struct _GHexEditBuffer
+{
+    GObject parent;
+    /** The newest generation's document. */
+    GHexEditDocument *document;
+    /** Oldest first; the last is the file being edited now. */
+    GArray *generations;
+    guint n_files;
+    GHexEditPieceTable *table;
+    GHexEditAddBuffer *add;
+    GHexEditJournal *journal;
+    /** Journal state when last saved, or G_MAXUINT64 if never reachable. */
+    guint64 saved_state;
+    gboolean modified;
+    gboolean can_undo;
+    gboolean can_redo;
+    /** A save is in flight; edits are refused until it finishes. */
+    gboolean saving;
+    /** Watching the file for appended data. */
+    gboolean follow;
+    GFileMonitor *monitor;
+    /** Cancels the re-open in flight while following, if any. */
+    GCancellable *refresh;
+    /** The file changed again while it was being re-opened. */
+    gboolean refresh_again;
+    /** Guards the table, add buffer and journal; readers may be on other threads. */
+    GRWLock lock;
+};
+
+G_DEFINE_TYPE(GHexEditBuffer, ghexedit_buffer, G_TYPE_OBJECT)
+
+enum
+{
+    PROP_DOCUMENT = 1,
+    PROP_SIZE,
+    PROP_MODIFIED,
+    PROP_CAN_UNDO,
+    PROP_CAN_REDO,
+    PROP_UNDO_LIMIT,
+    PROP_SAVING,
+    PROP_FOLLOW,
+    N_PROPERTIES
+};
+
+static GParamSpec *properties[N_PROPERTIES] = {NULL,};
+
+enum
+{
+    SIGNAL_CHANGED,
+    N_SIGNALS
+};
+
+static guint signals[N_SIGNALS];
+
+
+static void generation_clear(Generation *generation)
+{
+    g_clear_object(&generation->document);
+}
+
+/**
+ * The generation original byte `start` belongs to. A piece never spans two,
+ * so the whole of one lies in the generation of its first byte.
+ */
+static Generation const *locate(Generation const *generations, guint n_generations, guint64 start)
+{
+    guint i = n_generations - 1;
+    while (i > 0 && generations[i].base > start)
+        --i;
+    return &generations[i];
+}
+
+static Generation const *buffer_locate(GHexEditBuffer *buffer, guint64 start)
+{
+    return locate((Generation const *)buffer->generations->data, buffer->generations->len, start);
+}
+
+static Generation *current_generation(GHexEditBuffer *buffer)
+{
+    return &g_array_index(buffer->generations, Generation, buffer->generations->len - 1);
+}
+
+/**
+ * Start reading the file from `document`, as a generation after all the
+ * others. `same_file` says it reads the file on disk the newest one did.
+ * Called with the write lock held.
+ */
+static void push_generation(GHexEditBuffer *buffer, GHexEditDocument *document, gboolean same_file)
+{
+    Generation generation = {0, ghexedit_document_get_size(document), g_object_ref(document), 0};
+    if (buffer->generations->len > 0)
+    {
+        // The gap stops the piece table fusing pieces of two generations
+        Generation const *last = current_generation(buffer);
+        generation.base = last->base + last->length + 1;
+        generation.file = last->file;
+    }
+    if (!same_file || buffer->generations->len == 0)
+        generation.file = buffer->n_files++;
+    g_array_append_val(buffer->generations, generation);
+    g_set_object(&buffer->document, document);
+}
+
+/**
+ * Swap the newest generation's document for `document`, a re-opened copy of
+ * the same file. Called with the write lock held.
+ */
+static void renew_generation(GHexEditBuffer *buffer, GHexEditDocument *document)
+{
+    Generation *current = current_generation(buffer);
+    g_set_object(&current->document, document);
+    current->length = MAX(current->length, ghexedit_document_get_size(document));
+    g_set_object(&buffer->document, document);
+}
+
+static gboolean release_piece(GHexEditPiece const *piece, guint64 offset, gpointer add)
+{
+    if (piece->source == GHEXEDIT_PIECE_ADD)
+        ghexedit_add_buffer_release(add, piece->start, piece->length);
+    return TRUE;
+}
+
+/**
+ * Make the table the whole of the newest generation, letting go of the added
+ * bytes it held, and forget older generations if no history can point into
+ * them; snapshots hold their own. Called with the write lock held.
+ */
+static void reset_table(GHexEditBuffer *buffer)
+{
+    ghexedit_piece_table_foreach(buffer->table, 0, G_MAXUINT64, release_piece, buffer->add);
+    ghexedit_piece_table_free(buffer->table);
+    Generation const *current = current_generation(buffer);
+    GHexEditPiece piece = {GHEXEDIT_PIECE_ORIGINAL, current->base, ghexedit_document_get_size(current->document)};
+    buffer->table = ghexedit_piece_table_new(0);
+    ghexedit_piece_table_insert(buffer->table, 0, &piece, 1);
+    if (!ghexedit_journal_can_undo(buffer->journal) && !ghexedit_journal_can_redo(buffer->journal))
+        g_array_remove_range(buffer->generations, 0, buffer->generations->len - 1);
+}
+
+/**
+ * Read a run of original bytes, showing any the file no longer has as
+ * zeroes. Returns FALSE on error.
+ */
+static gboolean original_copy(Generation const *generations, guint n_generations, guint64 start, guint8 *dest, gsize length, GError **error)
+{
+    Generation const *generation = locate(generations, n_generations, start);
+    gssize got = ghexedit_document_read_into(generation->document, start - generation->base, dest, length, error);
+    if (got < 0)
+        return FALSE;
+    if ((gsize)got < length)
+        memset(dest + got, 0, length - got);
+    return TRUE;
+}
+
+typedef struct
+{
+    GHexEditBuffer *buffer;
+    guint64 offset;
+    guint8 *dest;
+    GError **error;
+    gboolean failed;
+} ReadClosure;
+
+static gboolean read_piece(GHexEditPiece const *piece, guint64 offset, gpointer user_data)
+{
+    ReadClosure *read = user_data;
+    guint8 *dest = read->dest + (offset - read->offset);
+    if (piece->source == GHEXEDIT_PIECE_ADD)
+    {
+        ghexedit_add_buffer_copy(read->buffer->add, piece->start, dest, piece->length);
+        return TRUE;
+    }
+    // The file may have shrunk underneath us
+    GArray *generations = read->buffer->generations;
+    if (!original_copy((Generation const *)generations->data, generations->len, piece->start, dest, piece->length, read->error))
+    {
+        read->failed = TRUE;
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/** Refresh the properties derived from the journal. Called without the lock held. */
+static void update_state(GHexEditBuffer *buffer)
+{
+    g_rw_lock_reader_lock(&buffer->lock);
+    gboolean modified = ghexedit_journal_get_state(buffer->journal) != buffer->saved_state;
+    gboolean can_undo = ghexedit_journal_can_undo(buffer->journal);
+    gboolean can_redo = ghexedit_journal_can_redo(buffer->journal);
+    g_rw_lock_reader_unlock(&buffer->lock);
+
+    if (buffer->modified != modified)
+    {
+        buffer->modified = modified;
+        g_object_notify_by_pspec(G_OBJECT(buffer), properties[PROP_MODIFIED]);
+    }
+    if (buffer->can_undo != can_undo)
+    {
+        buffer->can_undo = can_undo;
+        g_object_notify_by_pspec(G_OBJECT(buffer), properties[PROP_CAN_UNDO]);
+    }
+    if (buffer->can_redo != can_redo)
+    {
+        buffer->can_redo = can_redo;
+        g_object_notify_by_pspec(G_OBJECT(buffer), properties[PROP_CAN_REDO]);
+    }
+}
+
+/** Tell listeners that `removed` bytes at `offset` became `added` bytes. */
+static void emit_changed(GHexEditBuffer *buffer, guint64 offset, guint64 removed, guint64 added)
+{
+    g_object_freeze_notify(G_OBJECT(buffer));
+    g_signal_emit(buffer, signals[SIGNAL_CHANGED], 0, offset, removed, added);
+    if (removed != added)
+        g_object_notify_by_pspec(G_OBJECT(buffer), properties[PROP_SIZE]);
+    update_state(buffer);
+    g_object_thaw_notify(G_OBJECT(buffer));
+}
+
+/**
+ * Replace `length` bytes at `offset` with `data`, all under one write lock,
+ * journal it, then tell listeners what changed.
+ */
+static void replace(GHexEditBuffer *buffer, guint64 offset, guint64 length, guint8 const *data, gsize data_length)
+{
+    g_return_if_fail(!buffer->saving);
+    g_rw_lock_writer_lock(&buffer->lock);
+    guint64 size = ghexedit_piece_table_get_length(buffer->table);
+    if (offset > size)
+    {
+        g_rw_lock_writer_unlock(&buffer->lock);
+        g_return_if_reached();
+    }
+    length = MIN(length, size - offset);
+    if (length == 0 && data_length == 0)
+    {
+        g_rw_lock_writer_unlock(&buffer->lock);
+        return;
+    }
+    GArray *removed = g_array_new(FALSE, FALSE, sizeof(GHexEditPiece));
+    ghexedit_piece_table_remove(buffer->table, offset, length, removed);
+    if (data_length > 0)
+    {
+        GHexEditPiece piece = {GHEXEDIT_PIECE_ADD, ghexedit_add_buffer_append(buffer->add, data, data_length), data_length};
+        ghexedit_piece_table_insert(buffer->table, offset, &piece, 1);
+    }
+    ghexedit_journal_record(buffer->journal, buffer->table, offset, removed, data_length);
+    g_rw_lock_writer_unlock(&buffer->lock);
+
+    emit_changed(buffer, offset, length, data_length);
+}
+
+
+/** FileMonitor::changed callback: pick up whatever was appended. */
+static void file_changed(GFileMonitor *monitor, GFile *file, GFile *other_file, GFileMonitorEvent event, gpointer user_data)
+{
+    if (event != G_FILE_MONITOR_EVENT_CHANGED && event != G_FILE_MONITOR_EVENT_CHANGES_DONE_HINT)
+        return;
+    ghexedit_buffer_refresh_tail(GHEXEDIT_BUFFER(user_data));
+}
+
+/** Watch the current document's file, if following. */
+static void update_monitor(GHexEditBuffer *buffer)
+{
+    if (buffer->monitor)
+    {
+        g_signal_handlers_disconnect_by_func(buffer->monitor, file_changed, buffer);
+        g_file_monitor_cancel(buffer->monitor);
+        g_clear_object(&buffer->monitor);
+    }
+    if (buffer->refresh)
+    {
+        g_cancellable_cancel(buffer->refresh);
+        g_clear_object(&buffer->refresh);
+    }
+    if (!buffer->follow || buffer->document == NULL)
+        return;
+    GError *error = NULL;
+    buffer->monitor = g_file_monitor_file(ghexedit_document_get_file(buffer->document), G_FILE_MONITOR_NONE, NULL, &error);
+    if (buffer->monitor == NULL)
+    {
+        g_warning("Failed to follow file: %s", error->message);
+        g_error_free(error);
+        return;
+    }
+    g_file_monitor_set_rate_limit(buffer->monitor, FOLLOW_RATE_LIMIT);
+    g_signal_connect(buffer->monitor, "changed", G_CALLBACK(file_changed), buffer);
+}
+
+
+/* ===[ GHexEditBuffer ]=== */
+/** The document this buffer edits. */
+GHexEditDocument *ghexedit_buffer_get_document(GHexEditBuffer *buffer)
+{
+    return buffer->document;
+}
+
+/** Size of the buffer in bytes, including edits. */
+guint64 ghexedit_buffer_get_size(GHexEditBuffer *buffer)
+{
+    g_rw_lock_reader_lock(&buffer->lock);
+    guint64 size = ghexedit_piece_table_get_length(buffer->table);
+    g_rw_lock_reader_unlock(&buffer->lock);
+    return size;
+}
+
+/** Whether the buffer differs from when it was opened or last saved. */
+gboolean ghexedit_buffer_get_modified(GHexEditBuffer *buffer)
+{
+    return buffer->modified;
+}
+
+/**
+ * Clearing the flag marks the current content as saved, so undoing or
+ * redoing back to it clears the flag again. Setting it marks the buffer
+ * modified until the next save.
+ */
+void ghexedit_buffer_set_modified(GHexEditBuffer *buffer, gboolean modified)
+{
+    modified = !!modified;
+    g_rw_lock_writer_lock(&buffer->lock);
+    buffer->saved_state = modified ? G_MAXUINT64 : ghexedit_journal_get_state(buffer->journal);
+    ghexedit_journal_seal(buffer->journal);
+    g_rw_lock_writer_unlock(&buffer->lock);
+    if (buffer->modified != modified)
+    {
+        buffer->modified = modified;
+        g_object_notify_by_pspec(G_OBJECT(buffer), properties[PROP_MODIFIED]);
+    }
+}
+
+gboolean ghexedit_buffer_can_undo(GHexEditBuffer *buffer)
+{
+    return buffer->can_undo;
+}
+
+gboolean ghexedit_buffer_can_redo(GHexEditBuffer *buffer)
+{
+    return buffer->can_redo;
+}
+
+/**
+ * Undo the newest edit. If `offset` isn't NULL it receives where the change
+ * happened. Returns FALSE if there was nothing to undo.
+ */
+gboolean ghexedit_buffer_undo(GHexEditBuffer *buffer, guint64 *offset)
+{
+    g_return_val_if_fail(!buffer->saving, FALSE);
+    guint64 at, removed, added;
+    g_rw_lock_writer_lock(&buffer->lock);
+    gboolean done = ghexedit_journal_undo(buffer->journal, buffer->table, &at, &removed, &added);
+    g_rw_lock_writer_unlock(&buffer->lock);
+    if (!done)
+        return FALSE;
+    emit_changed(buffer, at, removed, added);
+    if (offset)
+        *offset = at;
+    return TRUE;
+}
+
+/** Redo the most recently undone edit; see ghexedit_buffer_undo. */
+gboolean ghexedit_buffer_redo(GHexEditBuffer *buffer, guint64 *offset)
+{
+    g_return_val_if_fail(!buffer->saving, FALSE);
+    guint64 at, removed, added;
+    g_rw_lock_writer_lock(&buffer->lock);
+    gboolean done = ghexedit_journal_redo(buffer->journal, buffer->table, &at, &removed, &added);
+    g_rw_lock_writer_unlock(&buffer->lock);
+    if (!done)
+        return FALSE;
+    emit_changed(buffer, at, removed, added);
+    if (offset)
+        *offset = at;
+    return TRUE;
+}
+
+/** Cap the memory undo history may use before older edits go to disk. */
+void ghexedit_buffer_set_undo_limit(GHexEditBuffer *buffer, guint64 limit)
+{
+    g_rw_lock_writer_lock(&buffer->lock);
+    ghexedit_journal_set_limit(buffer->journal, limit);
+    g_rw_lock_writer_unlock(&buffer->lock);
+    g_object_notify_by_pspec(G_OBJECT(buffer), properties[PROP_UNDO_LIMIT]);
+}
+
+guint64 ghexedit_buffer_get_undo_limit(GHexEditBuffer *buffer)
+{
+    return ghexedit_journal_get_limit(buffer->journal);
+}
+
+/**
+ * Copy up to `length` bytes at `offset` into `dest`.
+ * Returns the number of bytes copied, which is short only at the end of the
+ * buffer, or -1 on error. Safe to call from any thread.
+ */
+gssize ghexedit_buffer_read(GHexEditBuffer *buffer, guint64 offset, guint8 *dest, gsize length, GError **error)
+{
+    ReadClosure read = {buffer, offset, dest, error, FALSE};
+    g_rw_lock_reader_lock(&buffer->lock);
+    guint64 size = ghexedit_piece_table_get_length(buffer->table);
+    length = offset < size ? MIN(length, size - offset) : 0;
+    ghexedit_piece_table_foreach(buffer->table, offset, length, read_piece, &read);
+    g_rw_lock_reader_unlock(&buffer->lock);
+    return read.failed ? -1 : (gssize)length;
+}
+
+typedef struct
+{
+    GHexEditPiece piece;
+    guint count;
+} SingleClosure;
+
+static gboolean single_piece(GHexEditPiece const *piece, guint64 offset, gpointer user_data)
+{
+    SingleClosure *single = user_data;
+    single->piece = *piece;
+    return ++single->count < 2;
+}
+
+/**
+ * Get up to `length` bytes at `offset`. A window lying inside one unedited
+ * stretch of a mapped file is handed out without copying.
+ */
+GBytes *ghexedit_buffer_read_bytes(GHexEditBuffer *buffer, guint64 offset, gsize length, GError **error)
+{
+    SingleClosure single = {{0}, 0};
+    GBytes *bytes = NULL;
+    g_rw_lock_reader_lock(&buffer->lock);
+    ghexedit_piece_table_foreach(buffer->table, offset, length, single_piece, &single);
+    gboolean direct = single.count == 1 && single.piece.source == GHEXEDIT_PIECE_ORIGINAL;
+    if (direct)
+    {
+        Generation const *generation = buffer_locate(buffer, single.piece.start);
+        bytes = ghexedit_document_read(generation->document, single.piece.start - generation->base, single.piece.length, error);
+    }
+    g_rw_lock_reader_unlock(&buffer->lock);
+    if (direct)
+        return bytes;
+
+    guint8 *data = g_malloc(length);
+    gssize got = ghexedit_buffer_read(buffer, offset, data, length, error);
+    if (got < 0)
+    {
+        g_free(data);
+        return NULL;
+    }
+    return g_bytes_new_take(data, got);
+}
+
+static gboolean edited_piece(GHexEditPiece const *piece, guint64 offset, gpointer edits)
+{
+    if (piece->source == GHEXEDIT_PIECE_ADD)
+        ghexedit_range_set_add(edits, offset, offset + piece->length);
+    return TRUE;
+}
+
+/**
+ * Add the bytes within `length` at `offset` that were typed or pasted
+ * since the file was opened or saved to `edits`. Only the pieces in the
+ * window are visited.
+ */
+void ghexedit_buffer_get_edits(GHexEditBuffer *buffer, guint64 offset, guint64 length, GHexEditRangeSet *edits)
+{
+    g_rw_lock_reader_lock(&buffer->lock);
+    ghexedit_piece_table_foreach(buffer->table, offset, length, edited_piece, edits);
+    g_rw_lock_reader_unlock(&buffer->lock);
+}
+
+/**
+ * Replace `length` bytes at `offset` with `data` as a single edit. `length`
+ * and `data_length` may differ.
+ */
+void ghexedit_buffer_replace(GHexEditBuffer *buffer, guint64 offset, guint64 length, guint8 const *data, gsize data_length)
+{
+    replace(buffer, offset, length, data, data_length);
+}
+
+typedef struct
+{
+    GHexEditBuffer *buffer;
+    GHexEditRangeSet *found;
+    GHexEditRangeSet *unreadable;
+    /** Logical offset minus document offset for the piece being visited. */
+    gint64 shift;
+} UnreadableClosure;
+
+static gboolean shift_range(guint64 start, guint64 end, gpointer user_data)
+{
+    UnreadableClosure *closure = user_data;
+    ghexedit_range_set_add(closure->unreadable, start + closure->shift, end + closure->shift);
+    return TRUE;
+}
+
+static gboolean unreadable_piece(GHexEditPiece const *piece, guint64 offset, gpointer user_data)
+{
+    UnreadableClosure *closure = user_data;
+    if (piece->source != GHEXEDIT_PIECE_ORIGINAL)
+        return TRUE;
+    Generation const *generation = buffer_locate(closure->buffer, piece->start);
+    guint64 start = piece->start - generation->base;
+    ghexedit_range_set_clear(closure->found);
+    ghexedit_document_get_unreadable(generation->document, start, piece->length, closure->found);
+    closure->shift = (gint64)(offset - start);
+    ghexedit_range_set_foreach(closure->found, start, start + piece->length, shift_range, closure);
+    return TRUE;
+}
+
+/**
+ * Add the bytes within `length` at `offset` that the document couldn't
+ * read to `unreadable`. Bytes typed over them since are readable again.
+ */
+void ghexedit_buffer_get_unreadable(GHexEditBuffer *buffer, guint64 offset, guint64 length, GHexEditRangeSet *unreadable)
+{
+    UnreadableClosure closure = {buffer, ghexedit_range_set_new(), unreadable, 0};
+    g_rw_lock_reader_lock(&buffer->lock);
+    ghexedit_piece_table_foreach(buffer->table, offset, length, unreadable_piece, &closure);
+    g_rw_lock_reader_unlock(&buffer->lock);
+    ghexedit_range_set_free(closure.found);
+}
+
+/** Note where the first range starts; GHexEditRangeFunc. */
+static gboolean first_start(guint64 start, guint64 end, gpointer user_data)
+{
+    *(guint64 *)user_data = start;
+    return FALSE;
+}
+
+/**
+ * Fail if any of `length` bytes at `offset` are known to be unreadable, for
+ * work that can't skip them: their stand-in zeroes would be taken for data.
+ */
+gboolean ghexedit_buffer_check_readable(GHexEditBuffer *buffer, guint64 offset, guint64 length, GError **error)
+{
+    GHexEditRangeSet *unreadable = ghexedit_range_set_new();
+    ghexedit_buffer_get_unreadable(buffer, offset, length, unreadable);
+    guint64 first = 0;
+    gboolean readable = ghexedit_range_set_foreach(unreadable, offset, offset + length, first_start, &first);
+    ghexedit_range_set_free(unreadable);
+    if (!readable)
+        g_set_error(error, G_IO_ERROR, G_IO_ERROR_FAILED, "The bytes at 0x%" G_GINT64_MODIFIER "x can't be read", first);
+    return readable;
+}
+
+static gboolean prefetch_piece(GHexEditPiece const *piece, guint64 offset, gpointer user_data)
+{
+    if (piece->source != GHEXEDIT_PIECE_ORIGINAL)
+        return TRUE;
+    Generation const *generation = buffer_locate(user_data, piece->start);
+    ghexedit_document_prefetch(generation->document, piece->start - generation->base, piece->length);
+    return TRUE;
+}
+
+/**
+ * Start fetching the original bytes behind `length` at `offset` in the
+ * background, ahead of a read. Edited bytes are in memory already.
+ */
+void ghexedit_buffer_prefetch(GHexEditBuffer *buffer, guint64 offset, guint64 length)
+{
+    g_rw_lock_reader_lock(&buffer->lock);
+    ghexedit_piece_table_foreach(buffer->table, offset, length, prefetch_piece, buffer);
+    g_rw_lock_reader_unlock(&buffer->lock);
+}
+
+/** Insert bytes before `offset`. */
+void ghexedit_buffer_insert(GHexEditBuffer *buffer, guint64 offset, guint8 const *data, gsize length)
+{
+    replace(buffer, offset, 0, data, length);
+}
+
+/** Delete up to `length` bytes at `offset`. */
+void ghexedit_buffer_delete(GHexEditBuffer *buffer, guint64 offset, guint64 length)
+{
+    replace(buffer, offset, length, NULL, 0);
+}
+
+/** Overwrite bytes at `offset`, growing the buffer if they run past the end. */
+void ghexedit_buffer_overwrite(GHexEditBuffer *buffer, guint64 offset, guint8 const *data, gsize length)
+{
+    replace(buffer, offset, length, data, length);
+}
+
+
+/* ===[ Snapshots ]=== */
+/**
+ * A range frozen as the pieces it was made of. Original bytes are read from
+ * the documents the buffer had then, and added bytes from a view of its add
+ * buffer, which keeps them alive; neither is ever overwritten, so later
+ * edits can't reach it. Saving in place is the exception: it patches the
+ * file the document reads from.
+ */
+struct _GHexEditSnapshot
+{
+    gint ref_count;
+    Generation *generations;
+    guint n_generations;
+    GHexEditAddView *add;
+    GArray *pieces;
+    /** Where each piece starts, relative to the snapshot. */
+    guint64 *starts;
+    guint64 offset;
+    guint64 length;
+};
+
+/**
+ * Freeze `length` bytes at `offset` for reading later, from any thread,
+ * without copying them. Costs one entry per piece in the range.
+ */
+GHexEditSnapshot *ghexedit_buffer_snapshot(GHexEditBuffer *buffer, guint64 offset, guint64 length)
+{
+    GHexEditSnapshot *snapshot = g_new0(GHexEditSnapshot, 1);
+    snapshot->ref_count = 1;
+    snapshot->pieces = g_array_new(FALSE, FALSE, sizeof(GHexEditPiece));
+
+    g_rw_lock_reader_lock(&buffer->lock);
+    guint64 size = ghexedit_piece_table_get_length(buffer->table);
+    offset = MIN(offset, size);
+    length = MIN(length, size - offset);
+    ghexedit_piece_table_get_pieces(buffer->table, offset, length, snapshot->pieces);
+    snapshot->n_generations = buffer->generations->len;
+    snapshot->generations = g_new(Generation, snapshot->n_generations);
+    for (guint i = 0; i < snapshot->n_generations; ++i)
+    {
+        snapshot->generations[i] = g_array_index(buffer->generations, Generation, i);
+        g_object_ref(snapshot->generations[i].document);
+    }
+    snapshot->add = ghexedit_add_buffer_view(buffer->add);
+    g_rw_lock_reader_unlock(&buffer->lock);
+
+    snapshot->offset = offset;
+    snapshot->length = length;
+    snapshot->starts = g_new(guint64, snapshot->pieces->len + 1);
+    snapshot->starts[0] = 0;
+    for (guint i = 0; i < snapshot->pieces->len; ++i)
+        snapshot->starts[i + 1] = snapshot->starts[i] + g_array_index(snapshot->pieces, GHexEditPiece, i).length;
+    return snapshot;
+}
+
+GHexEditSnapshot *ghexedit_snapshot_ref(GHexEditSnapshot *snapshot)
+{
+    g_atomic_int_inc(&snapshot->ref_count);
+    return snapshot;
+}
+
+void ghexedit_snapshot_unref(GHexEditSnapshot *snapshot)
+{
+    if (snapshot == NULL || !g_atomic_int_dec_and_test(&snapshot->ref_count))
+        return;
+    for (guint i = 0; i < snapshot->n_generations; ++i)
+        generation_clear(&snapshot->generations[i]);
+    g_free(snapshot->generations);
+    ghexedit_add_view_free(snapshot->add);
+    g_array_unref(snapshot->pieces);
+    g_free(snapshot->starts);
+    g_free(snapshot);
+}
+
+/** Buffer offset the snapshot was taken at. */
+guint64 ghexedit_snapshot_get_offset(GHexEditSnapshot *snapshot)
+{
+    return snapshot->offset;
+}
+
+guint64 ghexedit_snapshot_get_length(GHexEditSnapshot *snapshot)
+{
+    return snapshot->length;
+}
+
+/**
+ * Copy up to `length` bytes starting `position` bytes into the snapshot.
+ * Returns the number copied, short only at the end, or -1 on error.
+ */
+gssize ghexedit_snapshot_read(GHexEditSnapshot *snapshot, guint64 position, guint8 *dest, gsize length, GError **error)
+{
+    length = position < snapshot->length ? MIN(length, snapshot->length - position) : 0;
+    if (length == 0)
+        return 0;
+
+    // Last piece starting at or before the position
+    guint lo = 0, hi = snapshot->pieces->len;
+    while (hi - lo > 1)
+    {
+        guint mid = lo + (hi - lo) / 2;
+        if (snapshot->starts[mid] <= position)
+            lo = mid;
+        else
+            hi = mid;
+    }
+
+    gsize done = 0;
+    for (guint i = lo; done < length; ++i)
+    {
+        GHexEditPiece const *piece = &g_array_index(snapshot->pieces, GHexEditPiece, i);
+        guint64 within = position + done - snapshot->starts[i];
+        gsize n = MIN(length - done, piece->length - within);
+        if (piece->source == GHEXEDIT_PIECE_ADD)
+            ghexedit_add_view_copy(snapshot->add, piece->start + within, dest + done, n);
+        else if (!original_copy(snapshot->generations, snapshot->n_generations, piece->start + within, dest + done, n, error))
+            return -1;
+        done += n;
+    }
+    return length;
+}
+
+
+/* ===[ Saving ]=== */
+/** Original bytes at `offset` that saving in place overwrote. */
+typedef struct
+{
+    guint64 offset;
+    GBytes *bytes;
+} Overwritten;
+
+static void overwritten_clear(Overwritten *overwritten)
+{
+    g_bytes_unref(overwritten->bytes);
+}
+
+/** Everything the save thread needs, plus what it hands back. */
+typedef struct
+{
+    /** The whole buffer, so the save runs without holding its lock. */
+    GHexEditSnapshot *snapshot;
+    GFile *target;
+    /** Undo history may still need the original bytes a save overwrites. */
+    gboolean keep_overwritten;
+    gboolean in_place;
+    /** What an in-place save overwrote, if kept. */
+    GArray *overwritten;
+    GHexEditDocument *saved;
+} SaveData;
+
+static void save_data_free(SaveData *data)
+{
+    ghexedit_snapshot_unref(data->snapshot);
+    g_object_unref(data->target);
+    if (data->overwritten)
+        g_array_unref(data->overwritten);
+    g_clear_object(&data->saved);
+    g_free(data);
+}
+
+/** Call `func` on each piece of a snapshot, with where it starts in the snapshot. */
+static gboolean snapshot_foreach(GHexEditSnapshot *snapshot, GHexEditPieceFunc func, gpointer user_data)
+{
+    for (guint i = 0; i < snapshot->pieces->len; ++i)
+        if (!func(&g_array_index(snapshot->pieces, GHexEditPiece, i), snapshot->starts[i], user_data))
+            return FALSE;
+    return TRUE;
+}
+
+/**
+ * A same-size save can patch the file in place if every original byte still
+ * sits at its own offset; only the add-buffer pieces then differ from disk.
+ */
+static gboolean original_in_place(GHexEditPiece const *piece, guint64 offset, gpointer user_data)
+{
+    Generation const *current = user_data;
+    return piece->source != GHEXEDIT_PIECE_ORIGINAL || piece->start == current->base + offset;
+}
+
+static gboolean can_save_in_place(GHexEditSnapshot *snapshot, GFile *target)
+{
+    Generation *current = &snapshot->generations[snapshot->n_generations - 1];
+    if (!g_file_equal(target, ghexedit_document_get_file(current->document)) || !g_file_is_native(target))
+        return FALSE;
+    return snapshot->length == ghexedit_document_get_size(current->document)
+        && snapshot_foreach(snapshot, original_in_place, current);
+}
+
+typedef struct
+{
+    GHexEditSnapshot *snapshot;
+    GArray *overwritten;
+    int fd;
+    guint64 position;
+    GCancellable *cancellable;
+    GError **error;
+} PatchClosure;
+
+static gboolean patch_run(guint8 const *data, gsize length, gpointer user_data)
+{
+    PatchClosure *patch = user_data;
+    while (length > 0)
+    {
+        ssize_t n = pwrite(patch->fd, data, length, patch->position);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0)
+        {
+            int saved = errno;
+            g_set_error(patch->error, G_IO_ERROR, g_io_error_from_errno(saved), "%s", g_strerror(saved));
+            return FALSE;
+        }
+        data += n;
+        length -= n;
+        patch->position += n;
+    }
+    return TRUE;
+}
+
+/** Copy the bytes about to be overwritten at `offset`, for undo history. */
+static gboolean keep_run(PatchClosure *patch, guint64 offset, gsize length)
+{
+    guint8 *data = g_malloc(length);
+    gsize done = 0;
+    while (done < length)
+    {
+        ssize_t n = pread(patch->fd, data + done, length - done, offset + done);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0)
+        {
+            int saved = errno;
+            g_set_error(patch->error, G_IO_ERROR, g_io_error_from_errno(saved), "%s", g_strerror(saved));
+            g_free(data);
+            return FALSE;
+        }
+        // Cut short underneath us; there is nothing left to keep
+        if (n == 0)
+            break;
+        done += n;
+    }
+    memset(data + done, 0, length - done);
+    Overwritten overwritten = {offset, g_bytes_new_take(data, length)};
+    g_array_append_val(patch->overwritten, overwritten);
+    return TRUE;
+}
+
+static gboolean patch_piece(GHexEditPiece const *piece, guint64 offset, gpointer user_data)
+{
+    PatchClosure *patch = user_data;
+    if (piece->source != GHEXEDIT_PIECE_ADD)
+        return TRUE;
+    if (g_cancellable_set_error_if_cancelled(patch->cancellable, patch->error))
+        return FALSE;
+    if (patch->overwritten && !keep_run(patch, offset, piece->length))
+        return FALSE;
+    patch->position = offset;
+    return ghexedit_add_view_foreach_run(patch->snapshot->add, piece->start, piece->length, patch_run, patch);
+}
+
+/**
+ * Write only the edited extents back into the file, then flush them to disk.
+ * If `overwritten` isn't NULL, the bytes each extent replaced are copied to
+ * it first.
+ */
+static gboolean save_in_place(GHexEditSnapshot *snapshot, GFile *target, GArray *overwritten, GCancellable *cancellable, GError **error)
+{
+    char *path = g_file_get_path(target);
+    int flags = overwritten ? O_RDWR : O_WRONLY;
+    PatchClosure patch = {snapshot, overwritten, g_open(path, flags | O_CLOEXEC, 0), 0, cancellable, error};
+    if (patch.fd < 0)
+    {
+        int saved = errno;
+        g_set_error(error, G_IO_ERROR, g_io_error_from_errno(saved), "%s: %s", path, g_strerror(saved));
+        g_free(path);
+        return FALSE;
+    }
+    g_free(path);
+
+    gboolean ok = snapshot_foreach(snapshot, patch_piece, &patch);
+    if (ok && fdatasync(patch.fd) != 0)
+    {
+        int saved = errno;
+        g_set_error(error, G_IO_ERROR, g_io_error_from_errno(saved), "%s", g_strerror(saved));
+        ok = FALSE;
+    }
+    return g_close(patch.fd, ok ? error : NULL) && ok;
+}
+
+/** Gathers small runs into large sequential writes. */
+typedef struct
+{
+    GHexEditSnapshot *snapshot;
+    GOutputStream *out;
+    guint8 *stage;
+    gsize staged;
+    GCancellable *cancellable;
+    GError **error;
+} StreamClosure;
+
+static gboolean stream_flush(StreamClosure *stream)
+{
+    gboolean ok = g_output_stream_write_all(stream->out, stream->stage, stream->staged, NULL, stream->cancellable, stream->error);
+    stream->staged = 0;
+    return ok;
+}
+
+static gboolean stream_run(guint8 const *data, gsize length, gpointer user_data)
+{
+    StreamClosure *stream = user_data;
+    if (stream->staged + length > SAVE_BLOCK_SIZE && !stream_flush(stream))
+        return FALSE;
+    // Big runs skip the staging copy
+    if (length >= SAVE_BLOCK_SIZE / 2)
+        return g_output_stream_write_all(stream->out, data, length, NULL, stream->cancellable, stream->error);
+    memcpy(stream->stage + stream->staged, data, length);
+    stream->staged += length;
+    return TRUE;
+}
+
+static gboolean stream_piece(GHexEditPiece const *piece, guint64 offset, gpointer user_data)
+{
+    StreamClosure *stream = user_data;
+    if (piece->source == GHEXEDIT_PIECE_ADD)
+        return ghexedit_add_view_foreach_run(stream->snapshot->add, piece->start, piece->length, stream_run, stream);
+
+    Generation const *generation = locate(stream->snapshot->generations, stream->snapshot->n_generations, piece->start);
+    for (guint64 done = 0; done < piece->length;)
+    {
+        gsize n = MIN(piece->length - done, SAVE_BLOCK_SIZE);
+        GBytes *block = ghexedit_document_read(generation->document, piece->start - generation->base + done, n, stream->error);
+        if (block == NULL)
+            return FALSE;
+        gsize got;
+        guint8 const *data = g_bytes_get_data(block, &got);
+        gboolean ok = got == n;
+        if (!ok)
+            g_set_error(stream->error, G_IO_ERROR, G_IO_ERROR_FAILED, "The original file was truncated while saving");
+        ok = ok && stream_run(data, got, stream);
+        g_bytes_unref(block);
+        if (!ok)
+            return FALSE;
+        done += n;
+    }
+    return TRUE;
+}
+
+/**
+ * Stream the whole buffer into a replacement for `target`. GIO writes it to
+ * a temporary file, syncs it and renames it over the target on close, so a
+ * crash leaves either the old file or the new one.
+ */
+static gboolean save_stream(GHexEditSnapshot *snapshot, GFile *target, GCancellable *cancellable, GError **error)
+{
+    GFileOutputStream *out = g_file_replace(target, NULL, FALSE, G_FILE_CREATE_NONE, cancellable, error);
+    if (out == NULL)
+        return FALSE;
+
+    StreamClosure stream = {snapshot, G_OUTPUT_STREAM(out), g_malloc(SAVE_BLOCK_SIZE), 0, cancellable, error};
+    gboolean ok = snapshot_foreach(snapshot, stream_piece, &stream)
+        && stream_flush(&stream);
+    g_free(stream.stage);
+
+    if (ok)
+        ok = g_output_stream_close(G_OUTPUT_STREAM(out), cancellable, error);
+    else
+    {
+        // Closing with a cancelled cancellable drops the temporary file and
+        // leaves the target untouched
+        GCancellable *abort = g_cancellable_new();
+        g_cancellable_cancel(abort);
+        g_output_stream_close(G_OUTPUT_STREAM(out), abort, NULL);
+        g_object_unref(abort);
+    }
+    g_object_unref(out);
+    return ok;
+}
+
+/** GTask thread: write the file, then open what was written. */
+static void save_thread(GTask *task, gpointer source_object, gpointer task_data, GCancellable *cancellable)
+{
+    SaveData *data = task_data;
+    GError *error = NULL;
+
+    // Working from the snapshot leaves the buffer unlocked, so the main
+    // thread never waits on the disk
+    data->in_place = can_save_in_place(data->snapshot, data->target);
+    if (data->in_place && data->keep_overwritten)
+    {
+        data->overwritten = g_array_new(FALSE, FALSE, sizeof(Overwritten));
+        g_array_set_clear_func(data->overwritten, (GDestroyNotify)overwritten_clear);
+    }
+    gboolean ok = data->in_place
+        ? save_in_place(data->snapshot, data->target, data->overwritten, cancellable, &error)
+        : save_stream(data->snapshot, data->target, cancellable, &error);
+
+    // Re-opened even after patching in place, as a source's cached pages
+    // may hold what was overwritten
+    if (ok)
+        data->saved = ghexedit_document_new(data->target, &error);
+    if (data->saved)
+        g_task_return_boolean(task, TRUE);
+    else
+        g_task_return_error(task, error);
+}
+
+static void set_saving(GHexEditBuffer *buffer, gboolean saving)
+{
+    buffer->saving = saving;
+    g_object_notify_by_pspec(G_OBJECT(buffer), properties[PROP_SAVING]);
+}
+
+/**
+ * Hand undo history the original bytes an in-place save overwrote, for every
+ * generation reading the patched file. Called with the write lock held.
+ */
+static void keep_overwritten(GHexEditBuffer *buffer, GArray *overwritten)
+{
+    guint file = current_generation(buffer)->file;
+    for (guint g = 0; g < buffer->generations->len; ++g)
+    {
+        Generation const *generation = &g_array_index(buffer->generations, Generation, g);
+        if (generation->file != file)
+            continue;
+        for (guint i = 0; i < overwritten->len; ++i)
+        {
+            Overwritten const *run = &g_array_index(overwritten, Overwritten, i);
+            gsize length;
+            guint8 const *data = g_bytes_get_data(run->bytes, &length);
+            if (run->offset < generation->length)
+                ghexedit_journal_displace(buffer->journal, generation->base + run->offset, data, MIN(length, generation->length - run->offset));
+        }
+    }
+}
+
+/**
+ * Make the saved file a new generation, read as one piece, and mark the
+ * buffer saved. Undo history stays: its pieces keep pointing at the
+ * generations they came from.
+ */
+static void rebase(GHexEditBuffer *buffer, GHexEditDocument *document, gboolean in_place)
+{
+    g_rw_lock_writer_lock(&buffer->lock);
+    push_generation(buffer, document, in_place);
+    reset_table(buffer);
+    g_rw_lock_writer_unlock(&buffer->lock);
+
+    // Save As moves the buffer to another file
+    update_monitor(buffer);
+
+    g_object_freeze_notify(G_OBJECT(buffer));
+    g_object_notify_by_pspec(G_OBJECT(buffer), properties[PROP_DOCUMENT]);
+    ghexedit_buffer_set_modified(buffer, FALSE);
+    g_object_thaw_notify(G_OBJECT(buffer));
+}
+
+/** Inner GTask callback: back on the main thread, adopt the saved file. */
+static void save_done(GObject *source_object, GAsyncResult *result, gpointer user_data)
+{
+    GHexEditBuffer *buffer = GHEXEDIT_BUFFER(source_object);
+    GTask *outer = user_data;
+    SaveData *data = g_task_get_task_data(G_TASK(result));
+    GError *error = NULL;
+
+    gboolean saved = g_task_propagate_boolean(G_TASK(result), &error);
+    // Even a failed in-place save may have overwritten some of them
+    if (data->overwritten)
+    {
+        g_rw_lock_writer_lock(&buffer->lock);
+        keep_overwritten(buffer, data->overwritten);
+        g_rw_lock_writer_unlock(&buffer->lock);
+    }
+    if (saved)
+        rebase(buffer, data->saved, data->in_place);
+    set_saving(buffer, FALSE);
+    // The saved file was opened mapped; go back to reading it with pread
+    if (buffer->follow)
+        ghexedit_buffer_refresh_tail(buffer);
+    if (error)
+        g_task_return_error(outer, error);
+    else
+        g_task_return_boolean(outer, TRUE);
+    g_object_unref(outer);
+}
+
+/**
+ * Save the buffer to `target` on a worker thread.
+ * Same-size edits saved back to the buffer's own local file are written in
+ * place, touching only the edited extents. Anything else streams the buffer
+ * into a temporary file that atomically replaces `target`. Edits are refused
+ * until the save finishes; afterwards the buffer reads from the saved file.
+ * Undo history survives the save, reaching back past it.
+ */
+void ghexedit_buffer_save_async(GHexEditBuffer *buffer, GFile *target, GCancellable *cancellable, GAsyncReadyCallback callback, gpointer user_data)
+{
+    GTask *outer = g_task_new(buffer, cancellable, callback, user_data);
+    g_task_set_source_tag(outer, ghexedit_buffer_save_async);
+    if (buffer->saving)
+    {
+        g_task_return_new_error(outer, G_IO_ERROR, G_IO_ERROR_BUSY, "A save is already in progress");
+        g_object_unref(outer);
+        return;
+    }
+    set_saving(buffer, TRUE);
+
+    SaveData *data = g_new0(SaveData, 1);
+    data->snapshot = ghexedit_buffer_snapshot(buffer, 0, G_MAXUINT64);
+    data->target = g_object_ref(target);
+    // Edits are refused while saving, so nothing can become history meanwhile
+    data->keep_overwritten = buffer->can_undo || buffer->can_redo;
+    GTask *inner = g_task_new(buffer, cancellable, save_done, outer);
+    g_task_set_task_data(inner, data, (GDestroyNotify)save_data_free);
+    g_task_run_in_thread(inner, save_thread);
+    g_object_unref(inner);
+}
+
+gboolean ghexedit_buffer_save_finish(GHexEditBuffer *buffer, GAsyncResult *result, GError **error)
+{
+    g_return_val_if_fail(g_task_is_valid(result, buffer), FALSE);
+    return g_task_propagate_boolean(G_TASK(result), error);
+}
+
+/** Whether a save is in progress, during which edits are refused. */
+gboolean ghexedit_buffer_get_saving(GHexEditBuffer *buffer)
+{
+    return buffer->saving;
+}
+
+/** Watch the file and append whatever is written to its end, like `tail -f`. */
+void ghexedit_buffer_set_follow(GHexEditBuffer *buffer, gboolean follow)
+{
+    follow = !!follow;
+    if (buffer->follow == follow)
+        return;
+    buffer->follow = follow;
+    update_monitor(buffer);
+    // Catch up on anything written before the monitor started, and move off
+    // any mapping of the file, which faults if the file shrinks
+    if (follow)
+        ghexedit_buffer_refresh_tail(buffer);
+    g_object_notify_by_pspec(G_OBJECT(buffer), properties[PROP_FOLLOW]);
+}
+
+gboolean ghexedit_buffer_get_follow(GHexEditBuffer *buffer)
+{
+    return buffer->follow;
+}
+
+/**
+ * Adopt a re-opened copy of the followed file. Bytes past the end of the old
+ * document are added as one piece at the end of the buffer; nothing already
+ * loaded is read again. Bytes cut off the end are dropped as well if the
+ * buffer was never edited, when its table is the file itself. Edits may sit
+ * anywhere in what was cut, so an edited buffer stops following instead and
+ * shows the lost bytes as zeroes. Appends and cuts aren't edits, so they
+ * can't be undone and don't mark the buffer modified.
+ */
+static void adopt_tail(GHexEditBuffer *buffer, GHexEditDocument *reopened)
+{
+    guint64 old_size = ghexedit_document_get_size(buffer->document);
+    guint64 new_size = ghexedit_document_get_size(reopened);
+    guint64 offset = 0, removed = 0, added = 0;
+
+    g_rw_lock_writer_lock(&buffer->lock);
+    gboolean edited = ghexedit_journal_can_undo(buffer->journal) || ghexedit_journal_can_redo(buffer->journal);
+    if (new_size < old_size && !edited)
+    {
+        offset = new_size;
+        removed = old_size - new_size;
+        push_generation(buffer, reopened, TRUE);
+        reset_table(buffer);
+    }
+    else
+    {
+        // Bytes a cut took may live on in history, so bytes regrown at their
+        // offsets need a generation of their own. Otherwise offsets below the
+        // smaller size mean the same bytes in both documents.
+        if (new_size > old_size && old_size < current_generation(buffer)->length)
+            push_generation(buffer, reopened, TRUE);
+        else
+            renew_generation(buffer, reopened);
+        if (new_size > old_size)
+        {
+            offset = ghexedit_piece_table_get_length(buffer->table);
+            added = new_size - old_size;
+            GHexEditPiece piece = {GHEXEDIT_PIECE_ORIGINAL, current_generation(buffer)->base + old_size, added};
+            ghexedit_piece_table_insert(buffer->table, offset, &piece, 1);
+        }
+    }
+    g_rw_lock_writer_unlock(&buffer->lock);
+
+    g_object_freeze_notify(G_OBJECT(buffer));
+    g_object_notify_by_pspec(G_OBJECT(buffer), properties[PROP_DOCUMENT]);
+    if (removed > 0 || added > 0)
+        emit_changed(buffer, offset, removed, added);
+    if (new_size < old_size && edited)
+    {
+        char *name = g_file_get_parse_name(ghexedit_document_get_file(reopened));
+        g_warning("%s shrank under unsaved edits; no longer following it", name);
+        g_free(name);
+        ghexedit_buffer_set_follow(buffer, FALSE);
+    }
+    g_object_thaw_notify(G_OBJECT(buffer));
+}
+
+/** Document::new_unmapped_async callback: adopt the file as it is now. */
+static void tail_reopened(GObject *source_object, GAsyncResult *result, gpointer user_data)
+{
+    GHexEditBuffer *buffer = GHEXEDIT_BUFFER(user_data);
+    GError *error = NULL;
+    GHexEditDocument *reopened = ghexedit_document_new_finish(result, &error);
+    // Cancelled when following stopped; a newer refresh may be running
+    if (g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+    {
+        g_error_free(error);
+        g_object_unref(buffer);
+        return;
+    }
+
+    g_clear_object(&buffer->refresh);
+    if (reopened == NULL)
+    {
+        g_warning("Failed to follow file: %s", error->message);
+        g_error_free(error);
+    }
+    // A save that started meanwhile brings its own document
+    else if (!buffer->saving)
+        adopt_tail(buffer, reopened);
+    g_clear_object(&reopened);
+
+    if (buffer->refresh_again && buffer->follow)
+        ghexedit_buffer_refresh_tail(buffer);
+    g_object_unref(buffer);
+}
+
+/**
+ * Re-open the file on a worker thread and bring the buffer up to date with
+ * its size: appended bytes are added, and bytes cut off the end dropped, as
+ * described for adopt_tail. The re-opened file is read with pread rather than
+ * mapped, so it can keep changing size safely. Changes arriving while a
+ * re-open is in flight are picked up by one more once it finishes.
+ */
+void ghexedit_buffer_refresh_tail(GHexEditBuffer *buffer)
+{
+    if (buffer->saving || buffer->document == NULL)
+        return;
+    if (buffer->refresh)
+    {
+        buffer->refresh_again = TRUE;
+        return;
+    }
+    buffer->refresh_again = FALSE;
+    buffer->refresh = g_cancellable_new();
+    ghexedit_document_new_unmapped_async(ghexedit_document_get_file(buffer->document), buffer->refresh, tail_reopened, g_object_ref(buffer));
+}
+
+
+/* ===[ GObject ]=== */
+/** Start editing a document. The document itself is never written to. */
+GHexEditBuffer *ghexedit_buffer_new(GHexEditDocument *document)
+{
+    return g_object_new(GHEXEDIT_TYPE_BUFFER, "document", document, NULL);
+}
+
+/** Called when a property is set with g_object_set. */
+void ghexedit_buffer_set_property(GObject *object, guint property_id, GValue const *value, GParamSpec *pspec)
+{
+    GHexEditBuffer *buffer = GHEXEDIT_BUFFER(object);
+    switch (property_id)
+    {
+    case PROP_DOCUMENT:
+        push_generation(buffer, g_value_get_object(value), FALSE);
+        reset_table(buffer);
+        break;
+    case PROP_MODIFIED:
+        ghexedit_buffer_set_modified(buffer, g_value_get_boolean(value));
+        break;
+    case PROP_UNDO_LIMIT:
+        ghexedit_buffer_set_undo_limit(buffer, g_value_get_uint64(value));
+        break;
+    case PROP_FOLLOW:
+        ghexedit_buffer_set_follow(buffer, g_value_get_boolean(value));
+        break;
+    default:
+        G_OBJECT_WARN_INVALID_PROPERTY_ID(object, property_id, pspec);
+        break;
+    }
+}
+
+/** Called when a property is read with g_object_get. */
+void ghexedit_buffer_get_property(GObject *object, guint property_id, GValue *value, GParamSpec *pspec)
+{
+    GHexEditBuffer *buffer = GHEXEDIT_BUFFER(object);
+    switch (property_id)
+    {
+    case PROP_DOCUMENT:
+        g_value_set_object(value, buffer->document);
+        break;
+    case PROP_SIZE:
+        g_value_set_uint64(value, ghexedit_buffer_get_size(buffer));
+        break;
+    case PROP_MODIFIED:
+        g_value_set_boolean(value, buffer->modified);
+        break;
+    case PROP_CAN_UNDO:
+        g_value_set_boolean(value, buffer->can_undo);
+        break;
+    case PROP_CAN_REDO:
+        g_value_set_boolean(value, buffer->can_redo);
+        break;
+    case PROP_UNDO_LIMIT:
+        g_value_set_uint64(value, ghexedit_buffer_get_undo_limit(buffer));
+        break;
+    case PROP_SAVING:
+        g_value_set_boolean(value, buffer->saving);
+        break;
+    case PROP_FOLLOW:
+        g_value_set_boolean(value, buffer->follow);
+        break;
+    default:
+        G_OBJECT_WARN_INVALID_PROPERTY_ID(object, property_id, pspec);
+        break;
+    }
+}
+
+/**
+ * Drop held references.
+ * Can be executed more than once!
+ * Should chain up before returning.
+ */
+void ghexedit_buffer_dispose(GObject *object)
+{
+    GHexEditBuffer *buffer = GHEXEDIT_BUFFER(object);
+    buffer->follow = FALSE;
+    update_monitor(buffer);
+    g_clear_object(&buffer->document);
+    g_array_set_size(buffer->generations, 0);
+    G_OBJECT_CLASS(ghexedit_buffer_parent_class)->dispose(object);
+}
+
+/** Free remaining resources. */
+void ghexedit_buffer_finalize(GObject *object)
+{
+    GHexEditBuffer *buffer = GHEXEDIT_BUFFER(object);
+    ghexedit_journal_free(buffer->journal);
+    ghexedit_piece_table_free(buffer->table);
+    ghexedit_add_buffer_free(buffer->add);
+    g_array_unref(buffer->generations);
+    g_rw_lock_clear(&buffer->lock);
+    G_OBJECT_CLASS(ghexedit_buffer_parent_class)->finalize(object);
+}
+
+
+/* ===[ Base GLib ]=== */
+/** Equivalent to C++ constructor. */
+void ghexedit_buffer_init(GHexEditBuffer *buffer)
+{
+    buffer->generations = g_array_new(FALSE, FALSE, sizeof(Generation));
+    g_array_set_clear_func(buffer->generations, (GDestroyNotify)generation_clear);
+    buffer->table = ghexedit_piece_table_new(0);
+    buffer->add = ghexedit_add_buffer_new();
+    buffer->journal = ghexedit_journal_new(buffer->add);
+    g_rw_lock_init(&buffer->lock);
+}
+
+/**
+ * Called upon first instantiation of an object of this class.
+ * Sets/overrides class methods/signals/properties.
+ */
+void ghexedit_buffer_class_init(GHexEditBufferClass *class)
+{
+    GObjectClass *klass = G_OBJECT_CLASS(class);
+    klass->set_property = ghexedit_buffer_set_property;
+    klass->get_property = ghexedit_buffer_get_property;
+    klass->dispose = ghexedit_buffer_dispose;
+    klass->finalize = ghexedit_buffer_finalize;
+
+    properties[PROP_DOCUMENT] = g_param_spec_object("document", "Document", "The document being edited.", GHEXEDIT_TYPE_DOCUMENT, G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY);
+    properties[PROP_SIZE] = g_param_spec_uint64("size", "Size", "Size in bytes, including edits.", 0, G_MAXUINT64, 0, G_PARAM_READABLE);
+    properties[PROP_MODIFIED] = g_param_spec_boolean("modified", "Modified", "Whether there are unsaved edits.", FALSE, G_PARAM_READWRITE);
+    properties[PROP_CAN_UNDO] = g_param_spec_boolean("can-undo", "Can undo", "Whether there is an edit to undo.", FALSE, G_PARAM_READABLE);
+    properties[PROP_CAN_REDO] = g_param_spec_boolean("can-redo", "Can redo", "Whether there is an edit to redo.", FALSE, G_PARAM_READABLE);
+    properties[PROP_UNDO_LIMIT] = g_param_spec_uint64("undo-limit", "Undo limit", "Memory undo history may use before spilling to disk, in bytes.", 0, G_MAXUINT64, GHEXEDIT_JOURNAL_DEFAULT_LIMIT, G_PARAM_READWRITE);
+    properties[PROP_SAVING] = g_param_spec_boolean("saving", "Saving", "Whether a save is in progress.", FALSE, G_PARAM_READABLE);
+    properties[PROP_FOLLOW] = g_param_spec_boolean("follow", "Follow", "Whether data appended to the file is added to the buffer.", FALSE, G_PARAM_READWRITE);
+    g_object_class_install_properties(klass, N_PROPERTIES, properties);
+
+    /**
+     * Emitted after `removed` bytes at `offset` were replaced by `added` bytes.
+     */
+    signals[SIGNAL_CHANGED] = g_signal_new("changed", G_TYPE_FROM_CLASS(class), G_SIGNAL_RUN_LAST, 0, NULL, NULL, NULL, G_TYPE_NONE, 3, G_TYPE_UINT64, G_TYPE_UINT64, G_TYPE_UINT64);
+}
@@ -0,0 +1,69 @@
+/**
+ * Buffer.h - Editable view of a document.
+ * Copyright (C) 2022 Trevor Last
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _GHX_BUFFER_H
+#define _GHX_BUFFER_H
+
+#include <gio/gio.h>
+
+#include "Document.h"
+#include "RangeSet.h"
+
+
+#define GHEXEDIT_TYPE_BUFFER ghexedit_buffer_get_type()
+G_DECLARE_FINAL_TYPE(GHexEditBuffer, ghexedit_buffer, GHEXEDIT, BUFFER, GObject);
+
+/** A range of a buffer as it was at one moment; readable from any thread. */
+typedef struct _GHexEditSnapshot GHexEditSnapshot;
+
+GHexEditBuffer *ghexedit_buffer_new(GHexEditDocument *document);
+GHexEditDocument *ghexedit_buffer_get_document(GHexEditBuffer *buffer);
+guint64 ghexedit_buffer_get_size(GHexEditBuffer *buffer);
+gboolean ghexedit_buffer_get_modified(GHexEditBuffer *buffer);
+void ghexedit_buffer_set_modified(GHexEditBuffer *buffer, gboolean modified);
+gboolean ghexedit_buffer_can_undo(GHexEditBuffer *buffer);
+gboolean ghexedit_buffer_can_redo(GHexEditBuffer *buffer);
+gboolean ghexedit_buffer_undo(GHexEditBuffer *buffer, guint64 *offset);
+gboolean ghexedit_buffer_redo(GHexEditBuffer *buffer, guint64 *offset);
+void ghexedit_buffer_set_undo_limit(GHexEditBuffer *buffer, guint64 limit);
+guint64 ghexedit_buffer_get_undo_limit(GHexEditBuffer *buffer);
+void ghexedit_buffer_save_async(GHexEditBuffer *buffer, GFile *target, GCancellable *cancellable, GAsyncReadyCallback callback, gpointer user_data);
+gboolean ghexedit_buffer_save_finish(GHexEditBuffer *buffer, GAsyncResult *result, GError **error);
+gboolean ghexedit_buffer_get_saving(GHexEditBuffer *buffer);
+void ghexedit_buffer_set_follow(GHexEditBuffer *buffer, gboolean follow);
+gboolean ghexedit_buffer_get_follow(GHexEditBuffer *buffer);
+void ghexedit_buffer_refresh_tail(GHexEditBuffer *buffer);
+gssize ghexedit_buffer_read(GHexEditBuffer *buffer, guint64 offset, guint8 *dest, gsize length, GError **error);
+GBytes *ghexedit_buffer_read_bytes(GHexEditBuffer *buffer, guint64 offset, gsize length, GError **error);
+void ghexedit_buffer_get_edits(GHexEditBuffer *buffer, guint64 offset, guint64 length, GHexEditRangeSet *edits);
+void ghexedit_buffer_prefetch(GHexEditBuffer *buffer, guint64 offset, guint64 length);
+void ghexedit_buffer_get_unreadable(GHexEditBuffer *buffer, guint64 offset, guint64 length, GHexEditRangeSet *unreadable);
+gboolean ghexedit_buffer_check_readable(GHexEditBuffer *buffer, guint64 offset, guint64 length, GError **error);
+void ghexedit_buffer_replace(GHexEditBuffer *buffer, guint64 offset, guint64 length, guint8 const *data, gsize data_length);
+void ghexedit_buffer_insert(GHexEditBuffer *buffer, guint64 offset, guint8 const *data, gsize length);
+void ghexedit_buffer_delete(GHexEditBuffer *buffer, guint64 offset, guint64 length);
+void ghexedit_buffer_overwrite(GHexEditBuffer *buffer, guint64 offset, guint8 const *data, gsize length);
+GHexEditSnapshot *ghexedit_buffer_snapshot(GHexEditBuffer *buffer, guint64 offset, guint64 length);
+
+GHexEditSnapshot *ghexedit_snapshot_ref(GHexEditSnapshot *snapshot);
+void ghexedit_snapshot_unref(GHexEditSnapshot *snapshot);
+guint64 ghexedit_snapshot_get_offset(GHexEditSnapshot *snapshot);
+guint64 ghexedit_snapshot_get_length(GHexEditSnapshot *snapshot);
+gssize ghexedit_snapshot_read(GHexEditSnapshot *snapshot, guint64 position, guint8 *dest, gsize length, GError **error);
+
+#endif
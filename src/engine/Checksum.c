@@ -0,0 +1,402 @@
+/**
+ * Checksum.c - Parallel checksums over a buffer.
+ * Copyright (C) 2022 Trevor Last
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "Checksum.h"
+#include "Digest.h"
+#include "Trace.h"
+#include "Workers.h"
+
+
+/** Bytes per parallel job; a power of two number of BLAKE3 chunks. */
+#define SEGMENT_SIZE (1024 * 1024)
+#define SEGMENT_CHUNKS (SEGMENT_SIZE / GHEXEDIT_BLAKE3_CHUNK_LEN)
+
+/** Digests that can be split into segments and joined afterwards. */
+#define PARALLEL_KINDS ((1u << GHEXEDIT_CHECKSUM_CRC32) | (1u << GHEXEDIT_CHECKSUM_ADLER32) | (1u << GHEXEDIT_CHECKSUM_BLAKE3))
+
+/** What a worker found for one segment. */
+typedef struct
+{
+    guint32 crc;
+    guint32 adler;
+    guint32 cv[8];
+} SegmentResult;
+
+/**
+ * The range is cut into segments that workers claim one at a time, computing
+ * every splittable digest of each in one read. SHA-256 can't be split, so the
+ * first worker to start streams the whole range for it instead. The last
+ * worker to stop reads the final segment and joins the results in order.
+ */
+struct _GHexEditChecksum
+{
+    GObject parent;
+    GHexEditBuffer *buffer;
+    guint64 offset;
+    guint64 length;
+    guint kinds;
+    GCancellable *cancellable;
+    /** Segments before the last, which is left for joining. */
+    guint n_segments;
+    SegmentResult *segments;
+    // Shared with workers
+    gint next_segment;
+    gint streaming;
+    GMutex lock;
+    guint64 done;
+    guint64 work;
+    /** Progress and the end, reported on the main context. */
+    GHexEditDrain drain;
+    guint active;
+    gboolean stopped;
+    GError *error;
+    char *digests[GHEXEDIT_N_CHECKSUMS];
+    // Main thread only
+    gboolean finished;
+};
+
+G_DEFINE_TYPE(GHexEditChecksum, ghexedit_checksum, G_TYPE_OBJECT)
+
+enum
+{
+    PROP_PROGRESS = 1,
+    PROP_FINISHED,
+    N_PROPERTIES
+};
+
+static GParamSpec *properties[N_PROPERTIES] = {NULL,};
+
+
+/** Main loop: report progress, and notice the end. */
+static void drain(gpointer object)
+{
+    GHexEditChecksum *checksum = GHEXEDIT_CHECKSUM(object);
+    g_mutex_lock(&checksum->lock);
+    gboolean finished = !checksum->finished && checksum->stopped;
+    g_mutex_unlock(&checksum->lock);
+
+    g_object_freeze_notify(G_OBJECT(checksum));
+    g_object_notify_by_pspec(G_OBJECT(checksum), properties[PROP_PROGRESS]);
+    if (finished)
+    {
+        checksum->finished = TRUE;
+        g_object_notify_by_pspec(G_OBJECT(checksum), properties[PROP_FINISHED]);
+    }
+    g_object_thaw_notify(G_OBJECT(checksum));
+}
+
+/** Count `length` more bytes processed. */
+static void add_progress(GHexEditChecksum *checksum, guint64 length)
+{
+    g_mutex_lock(&checksum->lock);
+    checksum->done += length;
+    ghexedit_drain_schedule(&checksum->drain);
+    g_mutex_unlock(&checksum->lock);
+}
+
+/** Read part of the range, stopping everything on failure. */
+static GBytes *read_range(GHexEditChecksum *checksum, guint64 start, gsize length)
+{
+    GError *error = NULL;
+    GBytes *bytes = ghexedit_buffer_read_bytes(checksum->buffer, checksum->offset + start, length, &error);
+    // Pages refused while reading are only known now
+    if (bytes && !ghexedit_buffer_check_readable(checksum->buffer, checksum->offset + start, g_bytes_get_size(bytes), &error))
+        g_clear_pointer(&bytes, g_bytes_unref);
+    if (bytes == NULL)
+    {
+        g_mutex_lock(&checksum->lock);
+        if (checksum->error == NULL)
+            checksum->error = g_steal_pointer(&error);
+        g_mutex_unlock(&checksum->lock);
+        g_clear_error(&error);
+        g_cancellable_cancel(checksum->cancellable);
+    }
+    return bytes;
+}
+
+/** Stream the whole range through SHA-256. */
+static void stream_sha256(GHexEditChecksum *checksum)
+{
+    GChecksum *sha = g_checksum_new(G_CHECKSUM_SHA256);
+    for (guint64 start = 0; start < checksum->length; start += SEGMENT_SIZE)
+    {
+        if (g_cancellable_is_cancelled(checksum->cancellable))
+            break;
+        gsize length = MIN(SEGMENT_SIZE, checksum->length - start);
+        GBytes *bytes = read_range(checksum, start, length);
+        if (bytes == NULL)
+            break;
+        g_checksum_update(sha, g_bytes_get_data(bytes, NULL), g_bytes_get_size(bytes));
+        g_bytes_unref(bytes);
+        add_progress(checksum, length);
+    }
+    if (!g_cancellable_is_cancelled(checksum->cancellable))
+        checksum->digests[GHEXEDIT_CHECKSUM_SHA256] = g_strdup(g_checksum_get_string(sha));
+    g_checksum_free(sha);
+}
+
+/** Compute the splittable digests of one whole segment. */
+static void hash_segment(GHexEditChecksum *checksum, guint index)
+{
+    GHEXEDIT_TRACE_BEGIN(hash_segment);
+    GBytes *bytes = read_range(checksum, (guint64)index * SEGMENT_SIZE, SEGMENT_SIZE);
+    if (bytes == NULL)
+        return;
+    gsize length;
+    guint8 const *data = g_bytes_get_data(bytes, &length);
+    SegmentResult *result = &checksum->segments[index];
+    if (checksum->kinds & (1u << GHEXEDIT_CHECKSUM_CRC32))
+        result->crc = ghexedit_crc32_update(0, data, length);
+    if (checksum->kinds & (1u << GHEXEDIT_CHECKSUM_ADLER32))
+        result->adler = ghexedit_adler32_update(1, data, length);
+    if (checksum->kinds & (1u << GHEXEDIT_CHECKSUM_BLAKE3))
+        ghexedit_blake3_subtree(data, length, (guint64)index * SEGMENT_CHUNKS, result->cv);
+    g_bytes_unref(bytes);
+    add_progress(checksum, length);
+    GHEXEDIT_TRACE_END(hash_segment, "segment %u", index);
+}
+
+/** Join the segments' results with the final segment. Every worker has stopped. */
+static void join_segments(GHexEditChecksum *checksum)
+{
+    guint32 crc = 0, adler = 1;
+    GHexEditBlake3 blake3;
+    ghexedit_blake3_init(&blake3);
+    for (guint i = 0; i < checksum->n_segments; ++i)
+    {
+        SegmentResult const *result = &checksum->segments[i];
+        crc = ghexedit_crc32_combine(crc, result->crc, SEGMENT_SIZE);
+        adler = ghexedit_adler32_combine(adler, result->adler, SEGMENT_SIZE);
+        ghexedit_blake3_push_subtree(&blake3, result->cv, SEGMENT_CHUNKS);
+    }
+
+    guint64 start = (guint64)checksum->n_segments * SEGMENT_SIZE;
+    if (start < checksum->length)
+    {
+        GBytes *bytes = read_range(checksum, start, checksum->length - start);
+        if (bytes == NULL)
+            return;
+        gsize length;
+        guint8 const *data = g_bytes_get_data(bytes, &length);
+        crc = ghexedit_crc32_update(crc, data, length);
+        adler = ghexedit_adler32_update(adler, data, length);
+        if (checksum->kinds & (1u << GHEXEDIT_CHECKSUM_BLAKE3))
+            ghexedit_blake3_update(&blake3, data, length);
+        g_bytes_unref(bytes);
+        add_progress(checksum, length);
+    }
+
+    if (checksum->kinds & (1u << GHEXEDIT_CHECKSUM_CRC32))
+        checksum->digests[GHEXEDIT_CHECKSUM_CRC32] = g_strdup_printf("%08x", crc);
+    if (checksum->kinds & (1u << GHEXEDIT_CHECKSUM_ADLER32))
+        checksum->digests[GHEXEDIT_CHECKSUM_ADLER32] = g_strdup_printf("%08x", adler);
+    if (checksum->kinds & (1u << GHEXEDIT_CHECKSUM_BLAKE3))
+    {
+        guint8 out[GHEXEDIT_BLAKE3_OUT_LEN];
+        ghexedit_blake3_finish(&blake3, out);
+        GString *hex = g_string_sized_new(2 * sizeof(out));
+        for (gsize i = 0; i < sizeof(out); ++i)
+            g_string_append_printf(hex, "%02x", out[i]);
+        checksum->digests[GHEXEDIT_CHECKSUM_BLAKE3] = g_string_free(hex, FALSE);
+    }
+}
+
+/** Pool worker: take the SHA-256 stream or claim segments until none are left. */
+static void worker(gpointer object)
+{
+    GHexEditChecksum *checksum = object;
+
+    if ((checksum->kinds & (1u << GHEXEDIT_CHECKSUM_SHA256)) && g_atomic_int_compare_and_exchange(&checksum->streaming, FALSE, TRUE))
+        stream_sha256(checksum);
+    for (;;)
+    {
+        guint segment = g_atomic_int_add(&checksum->next_segment, 1);
+        if (segment >= checksum->n_segments || g_cancellable_is_cancelled(checksum->cancellable))
+            break;
+        hash_segment(checksum, segment);
+    }
+
+    g_mutex_lock(&checksum->lock);
+    gboolean last = --checksum->active == 0;
+    g_mutex_unlock(&checksum->lock);
+    if (last)
+    {
+        if ((checksum->kinds & PARALLEL_KINDS) && !g_cancellable_is_cancelled(checksum->cancellable))
+            join_segments(checksum);
+        g_mutex_lock(&checksum->lock);
+        if (checksum->error == NULL)
+            g_cancellable_set_error_if_cancelled(checksum->cancellable, &checksum->error);
+        // Partial results would look like real ones
+        if (checksum->error)
+            for (int i = 0; i < GHEXEDIT_N_CHECKSUMS; ++i)
+                g_clear_pointer(&checksum->digests[i], g_free);
+        checksum->stopped = TRUE;
+        ghexedit_drain_schedule(&checksum->drain);
+        g_mutex_unlock(&checksum->lock);
+    }
+}
+
+
+/* ===[ GHexEditChecksum ]=== */
+/**
+ * Start computing on the worker pool. Progress and the end are reported on
+ * the calling thread's main context through the properties.
+ */
+void ghexedit_checksum_start(GHexEditChecksum *checksum, GCancellable *cancellable)
+{
+    g_return_if_fail(checksum->cancellable == NULL);
+    checksum->cancellable = cancellable ? g_object_ref(cancellable) : g_cancellable_new();
+
+    // Known gaps, like those between a process's mappings, fail at once
+    // rather than after queueing work for every segment
+    if (!ghexedit_buffer_check_readable(checksum->buffer, checksum->offset, checksum->length, &checksum->error))
+        g_cancellable_cancel(checksum->cancellable);
+
+    // The segment holding the last byte is joined at the end, never split off
+    gboolean parallel = (checksum->kinds & PARALLEL_KINDS) != 0;
+    gboolean streaming = (checksum->kinds & (1u << GHEXEDIT_CHECKSUM_SHA256)) != 0;
+    checksum->n_segments = parallel && checksum->length && checksum->error == NULL ? (checksum->length - 1) / SEGMENT_SIZE : 0;
+    checksum->segments = g_new0(SegmentResult, checksum->n_segments);
+    checksum->work = (parallel ? checksum->length : 0) + (streaming ? checksum->length : 0);
+
+    ghexedit_drain_init(&checksum->drain, checksum, drain, &checksum->lock, 0);
+    checksum->active = ghexedit_workers_wanted(checksum->n_segments + streaming);
+    ghexedit_workers_start(checksum, worker, checksum->active);
+}
+
+/** Stop computing; no digests will be produced. */
+void ghexedit_checksum_cancel(GHexEditChecksum *checksum)
+{
+    if (checksum->cancellable)
+        g_cancellable_cancel(checksum->cancellable);
+}
+
+/** Whether every worker has stopped, with digests or an error. */
+gboolean ghexedit_checksum_get_finished(GHexEditChecksum *checksum)
+{
+    return checksum->finished;
+}
+
+/** Fraction of the work done. */
+double ghexedit_checksum_get_progress(GHexEditChecksum *checksum)
+{
+    if (checksum->finished)
+        return 1.0;
+    g_mutex_lock(&checksum->lock);
+    double progress = checksum->work ? (double)checksum->done / checksum->work : 0;
+    g_mutex_unlock(&checksum->lock);
+    return progress;
+}
+
+/** Why no digests were produced, once finished; NULL on success. */
+GError const *ghexedit_checksum_get_error(GHexEditChecksum *checksum)
+{
+    return checksum->finished ? checksum->error : NULL;
+}
+
+/** The digest as lowercase hex once finished, or NULL if it wasn't requested or failed. */
+char const *ghexedit_checksum_get_digest(GHexEditChecksum *checksum, GHexEditChecksumKind kind)
+{
+    g_return_val_if_fail(kind < GHEXEDIT_N_CHECKSUMS, NULL);
+    return checksum->finished ? checksum->digests[kind] : NULL;
+}
+
+
+/* ===[ GObject ]=== */
+/**
+ * Prepare digests of `length` bytes of `buffer` at `offset`. `kinds` is a mask
+ * of `1 << GHexEditChecksumKind`. Digests are of the buffer's bytes, as edited.
+ */
+GHexEditChecksum *ghexedit_checksum_new(GHexEditBuffer *buffer, guint64 offset, guint64 length, guint kinds)
+{
+    GHexEditChecksum *checksum = g_object_new(GHEXEDIT_TYPE_CHECKSUM, NULL);
+    checksum->buffer = g_object_ref(buffer);
+    checksum->offset = offset;
+    checksum->length = length;
+    checksum->kinds = kinds & ((1u << GHEXEDIT_N_CHECKSUMS) - 1);
+    return checksum;
+}
+
+/** Called when a property is read with g_object_get. */
+void ghexedit_checksum_get_property(GObject *object, guint property_id, GValue *value, GParamSpec *pspec)
+{
+    GHexEditChecksum *checksum = GHEXEDIT_CHECKSUM(object);
+    switch (property_id)
+    {
+    case PROP_PROGRESS:
+        g_value_set_double(value, ghexedit_checksum_get_progress(checksum));
+        break;
+    case PROP_FINISHED:
+        g_value_set_boolean(value, checksum->finished);
+        break;
+    default:
+        G_OBJECT_WARN_INVALID_PROPERTY_ID(object, property_id, pspec);
+        break;
+    }
+}
+
+/**
+ * Drop held references.
+ * Can be executed more than once!
+ * Should chain up before returning.
+ */
+void ghexedit_checksum_dispose(GObject *object)
+{
+    GHexEditChecksum *checksum = GHEXEDIT_CHECKSUM(object);
+    // Workers hold references, so none are running by now
+    g_clear_object(&checksum->buffer);
+    g_clear_object(&checksum->cancellable);
+    G_OBJECT_CLASS(ghexedit_checksum_parent_class)->dispose(object);
+}
+
+/** Free remaining resources. */
+void ghexedit_checksum_finalize(GObject *object)
+{
+    GHexEditChecksum *checksum = GHEXEDIT_CHECKSUM(object);
+    for (int i = 0; i < GHEXEDIT_N_CHECKSUMS; ++i)
+        g_free(checksum->digests[i]);
+    g_free(checksum->segments);
+    g_clear_error(&checksum->error);
+    ghexedit_drain_clear(&checksum->drain, NULL);
+    g_mutex_clear(&checksum->lock);
+    G_OBJECT_CLASS(ghexedit_checksum_parent_class)->finalize(object);
+}
+
+
+/* ===[ Base GLib ]=== */
+/** Equivalent to C++ constructor. */
+void ghexedit_checksum_init(GHexEditChecksum *checksum)
+{
+    g_mutex_init(&checksum->lock);
+}
+
+/**
+ * Called upon first instantiation of an object of this class.
+ * Sets/overrides class methods/signals/properties.
+ */
+void ghexedit_checksum_class_init(GHexEditChecksumClass *class)
+{
+    GObjectClass *klass = G_OBJECT_CLASS(class);
+    klass->get_property = ghexedit_checksum_get_property;
+    klass->dispose = ghexedit_checksum_dispose;
+    klass->finalize = ghexedit_checksum_finalize;
+
+    properties[PROP_PROGRESS] = g_param_spec_double("progress", "Progress", "Fraction of the work done.", 0, 1, 0, G_PARAM_READABLE);
+    properties[PROP_FINISHED] = g_param_spec_boolean("finished", "Finished", "Whether computing has stopped.", FALSE, G_PARAM_READABLE);
+    g_object_class_install_properties(klass, N_PROPERTIES, properties);
+}
@@ -0,0 +1,48 @@
+/**
+ * Checksum.h - Parallel checksums over a buffer.
+ * Copyright (C) 2022 Trevor Last
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _GHX_CHECKSUM_H
+#define _GHX_CHECKSUM_H
+
+#include <gio/gio.h>
+
+#include "Buffer.h"
+
+
+/** Digests that can be computed; requested as a mask of `1 << kind`. */
+typedef enum
+{
+    GHEXEDIT_CHECKSUM_CRC32,
+    GHEXEDIT_CHECKSUM_ADLER32,
+    GHEXEDIT_CHECKSUM_SHA256,
+    GHEXEDIT_CHECKSUM_BLAKE3,
+    GHEXEDIT_N_CHECKSUMS,
+} GHexEditChecksumKind;
+
+#define GHEXEDIT_TYPE_CHECKSUM ghexedit_checksum_get_type()
+G_DECLARE_FINAL_TYPE(GHexEditChecksum, ghexedit_checksum, GHEXEDIT, CHECKSUM, GObject);
+
+GHexEditChecksum *ghexedit_checksum_new(GHexEditBuffer *buffer, guint64 offset, guint64 length, guint kinds);
+void ghexedit_checksum_start(GHexEditChecksum *checksum, GCancellable *cancellable);
+void ghexedit_checksum_cancel(GHexEditChecksum *checksum);
+gboolean ghexedit_checksum_get_finished(GHexEditChecksum *checksum);
+double ghexedit_checksum_get_progress(GHexEditChecksum *checksum);
+GError const *ghexedit_checksum_get_error(GHexEditChecksum *checksum);
+char const *ghexedit_checksum_get_digest(GHexEditChecksum *checksum, GHexEditChecksumKind kind);
+
+#endif
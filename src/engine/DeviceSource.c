@@ -0,0 +1,157 @@
+/**
+ * DeviceSource.c - Block devices read with aligned, uncached I/O.
+ * Copyright (C) 2022 Trevor Last
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#define _GNU_SOURCE
+
+#include "Source.h"
+
+#include <glib/gstdio.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/fs.h>
+#endif
+
+
+/** Sector size assumed where the device can't be asked. */
+#define DEFAULT_SECTOR_SIZE 512
+
+/**
+ * A disk or partition. The size comes from the driver rather than stat,
+ * which reports 0 for devices. Reads bypass the kernel's cache where
+ * O_DIRECT is allowed, since the page cache already holds what's shown,
+ * and are made in whole sectors into buffers aligned to them.
+ */
+typedef struct
+{
+    GHexEditSource parent;
+    int fd;
+    guint sector_size;
+} DeviceSource;
+
+
+/** pread one aligned run; -1 with errno set on failure. */
+static gssize read_run(DeviceSource *device, guint64 offset, guint8 *dest, gsize length)
+{
+    gsize total = 0;
+    while (total < length)
+    {
+        ssize_t got = pread(device->fd, dest + total, length - total, offset + total);
+        if (got < 0 && errno == EINTR)
+            continue;
+        if (got < 0)
+            return -1;
+        if (got == 0)
+            break;
+        total += got;
+    }
+    return total;
+}
+
+/**
+ * Read a page. If it fails with a media error, go again a sector at a time
+ * so that only the bad sectors are shown as unreadable.
+ */
+static gssize device_read(GHexEditSource *source, guint64 offset, guint8 *dest, gsize length, GHexEditRangeSet *unreadable, GError **error)
+{
+    DeviceSource *device = (DeviceSource *)source;
+    length = offset < source->size ? MIN(length, source->size - offset) : 0;
+    gssize got = read_run(device, offset, dest, length);
+    if (got >= 0)
+    {
+        memset(dest + got, 0, length - got);
+        return length;
+    }
+    if (errno != EIO)
+    {
+        int saved = errno;
+        g_set_error(error, G_IO_ERROR, g_io_error_from_errno(saved), "%s", g_strerror(saved));
+        return -1;
+    }
+
+    for (gsize at = 0; at < length; at += device->sector_size)
+    {
+        gsize n = MIN(device->sector_size, length - at);
+        if (read_run(device, offset + at, dest + at, n) != (gssize)n)
+        {
+            memset(dest + at, 0, n);
+            ghexedit_range_set_add(unreadable, offset + at, offset + at + n);
+        }
+    }
+    return length;
+}
+
+static void device_free(GHexEditSource *source)
+{
+    DeviceSource *device = (DeviceSource *)source;
+    g_close(device->fd, NULL);
+    g_free(device);
+}
+
+static GHexEditSourceClass const device_class = {
+    .read = device_read,
+    .get_unreadable = NULL,
+    .free = device_free,
+};
+
+/** Open a block device such as /dev/sda or /dev/nvme0n1p2. */
+GHexEditSource *ghexedit_source_open_device(char const *path, GError **error)
+{
+    int fd = -1;
+#ifdef O_DIRECT
+    fd = g_open(path, O_RDONLY | O_CLOEXEC | O_DIRECT, 0);
+#endif
+    // Some drivers and filesystems refuse O_DIRECT; buffered reads still work
+    if (fd < 0)
+        fd = g_open(path, O_RDONLY | O_CLOEXEC, 0);
+    if (fd < 0)
+    {
+        int saved = errno;
+        g_set_error(error, G_IO_ERROR, g_io_error_from_errno(saved), "%s: %s", path, g_strerror(saved));
+        return NULL;
+    }
+
+    guint64 size = 0;
+    int sector_size = DEFAULT_SECTOR_SIZE;
+#ifdef BLKGETSIZE64
+    if (ioctl(fd, BLKGETSIZE64, &size) != 0)
+        size = 0;
+#endif
+#ifdef BLKSSZGET
+    if (ioctl(fd, BLKSSZGET, &sector_size) != 0 || sector_size <= 0)
+        sector_size = DEFAULT_SECTOR_SIZE;
+#endif
+    if (size == 0)
+    {
+        off_t end = lseek(fd, 0, SEEK_END);
+        size = end > 0 ? (guint64)end : 0;
+    }
+
+    DeviceSource *device = g_new0(DeviceSource, 1);
+    device->parent.klass = &device_class;
+    device->parent.size = size;
+    device->parent.alignment = sector_size;
+    device->fd = fd;
+    device->sector_size = sector_size;
+    return &device->parent;
+}
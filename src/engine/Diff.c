@@ -0,0 +1,573 @@
+/**
+ * Diff.c - Parallel byte-wise comparison of two buffers.
+ * Copyright (C) 2022 Trevor Last
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "Diff.h"
+#include "HexFormat.h"
+#include "Workers.h"
+
+#include <string.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define GHX_HAVE_X86_KERNELS 1
+#include <immintrin.h>
+#endif
+
+
+/** Bytes compared per job. */
+#define CHUNK_SIZE (4 * 1024 * 1024)
+
+/** Index of the first byte where `a` and `b` differ (or agree), or `length`. */
+typedef gsize (*ScanFunc)(guint8 const *a, guint8 const *b, gsize length);
+
+/** One chunk's windows, compared a run readable in both at a time. */
+typedef struct
+{
+    GHexEditDiff *diff;
+    guint64 start;
+    guint8 const *a;
+    guint8 const *b;
+    GArray *found;
+} CompareClosure;
+
+/**
+ * Both buffers are cut into chunks over the stretches of their common length
+ * that both can read, which workers claim one at a time. Bytes either
+ * couldn't read are never compared. Each chunk is read straight from the mapped files
+ * where unedited, so neither buffer is ever held in memory whole. Finished
+ * chunks are handed to the main loop, which publishes them strictly in order
+ * and joins ranges that meet across a chunk boundary.
+ */
+struct _GHexEditDiff
+{
+    GObject parent;
+    GHexEditBuffer *a;
+    GHexEditBuffer *b;
+    GCancellable *cancellable;
+    /** Bytes present in both buffers. */
+    guint64 common;
+    /** Readable stretches present in only the longer buffer, reported at the end. */
+    GArray *excess;
+    /** Chunks in order, as GHexEditRange. */
+    GArray *chunks;
+    guint n_chunks;
+    ScanFunc first_difference;
+    ScanFunc first_equal;
+    // Shared with workers
+    gint next_chunk;
+    GMutex lock;
+    /** Each chunk's ranges, in an array. */
+    GHexEditDrain drain;
+    guint active;
+    /** The first read that failed; comparing stops there. */
+    GError *error;
+    // Main thread only
+    GArray *ranges;
+    gboolean truncated;
+    gboolean finished;
+};
+
+G_DEFINE_TYPE(GHexEditDiff, ghexedit_diff, G_TYPE_OBJECT)
+
+enum
+{
+    PROP_PROGRESS = 1,
+    PROP_FINISHED,
+    N_PROPERTIES
+};
+
+static GParamSpec *properties[N_PROPERTIES] = {NULL,};
+
+enum
+{
+    SIGNAL_RANGES_ADDED,
+    N_SIGNALS
+};
+
+static guint signals[N_SIGNALS];
+
+
+/* ===[ Scanning ]=== */
+static gsize first_difference_scalar(guint8 const *a, guint8 const *b, gsize length)
+{
+    gsize i = 0;
+    for (; i + 8 <= length; i += 8)
+    {
+        guint64 x, y;
+        memcpy(&x, a + i, 8);
+        memcpy(&y, b + i, 8);
+        if (x != y)
+            break;
+    }
+    while (i < length && a[i] == b[i])
+        ++i;
+    return i;
+}
+
+static gsize first_equal_scalar(guint8 const *a, guint8 const *b, gsize length)
+{
+    gsize i = 0;
+    while (i < length && a[i] != b[i])
+        ++i;
+    return i;
+}
+
+#ifdef GHX_HAVE_X86_KERNELS
+__attribute__((target("sse2")))
+static gsize first_difference_sse2(guint8 const *a, guint8 const *b, gsize length)
+{
+    gsize i = 0;
+    for (; i + 16 <= length; i += 16)
+    {
+        __m128i eq = _mm_cmpeq_epi8(_mm_loadu_si128((__m128i const *)(a + i)), _mm_loadu_si128((__m128i const *)(b + i)));
+        guint mask = _mm_movemask_epi8(eq);
+        if (mask != 0xffff)
+            return i + __builtin_ctz(~mask);
+    }
+    return i + first_difference_scalar(a + i, b + i, length - i);
+}
+
+__attribute__((target("sse2")))
+static gsize first_equal_sse2(guint8 const *a, guint8 const *b, gsize length)
+{
+    gsize i = 0;
+    for (; i + 16 <= length; i += 16)
+    {
+        __m128i eq = _mm_cmpeq_epi8(_mm_loadu_si128((__m128i const *)(a + i)), _mm_loadu_si128((__m128i const *)(b + i)));
+        guint mask = _mm_movemask_epi8(eq);
+        if (mask)
+            return i + __builtin_ctz(mask);
+    }
+    return i + first_equal_scalar(a + i, b + i, length - i);
+}
+
+__attribute__((target("avx2")))
+static gsize first_difference_avx2(guint8 const *a, guint8 const *b, gsize length)
+{
+    gsize i = 0;
+    for (; i + 32 <= length; i += 32)
+    {
+        __m256i eq = _mm256_cmpeq_epi8(_mm256_loadu_si256((__m256i const *)(a + i)), _mm256_loadu_si256((__m256i const *)(b + i)));
+        guint32 mask = _mm256_movemask_epi8(eq);
+        if (mask != 0xffffffffu)
+            return i + __builtin_ctz(~mask);
+    }
+    return i + first_difference_scalar(a + i, b + i, length - i);
+}
+
+__attribute__((target("avx2")))
+static gsize first_equal_avx2(guint8 const *a, guint8 const *b, gsize length)
+{
+    gsize i = 0;
+    for (; i + 32 <= length; i += 32)
+    {
+        __m256i eq = _mm256_cmpeq_epi8(_mm256_loadu_si256((__m256i const *)(a + i)), _mm256_loadu_si256((__m256i const *)(b + i)));
+        guint32 mask = _mm256_movemask_epi8(eq);
+        if (mask)
+            return i + __builtin_ctz(mask);
+    }
+    return i + first_equal_scalar(a + i, b + i, length - i);
+}
+#endif
+
+/** Add a range, joining it to the last one if they are close enough. */
+static void append_range(GArray *ranges, guint64 offset, guint64 length)
+{
+    if (ranges->len)
+    {
+        GHexEditDiffRange *last = &g_array_index(ranges, GHexEditDiffRange, ranges->len - 1);
+        if (last->offset + last->length + GHEXEDIT_DIFF_GAP > offset)
+        {
+            last->length = offset + length - last->offset;
+            return;
+        }
+    }
+    GHexEditDiffRange range = {offset, length};
+    g_array_append_val(ranges, range);
+}
+
+/** Collect the differing ranges of two equally long blocks starting at `base`. */
+static void compare_block(GHexEditDiff *diff, guint8 const *a, guint8 const *b, gsize length, guint64 base, GArray *ranges)
+{
+    gsize i = 0;
+    while (ranges->len < GHEXEDIT_DIFF_MAX_RANGES)
+    {
+        i += diff->first_difference(a + i, b + i, length - i);
+        if (i >= length)
+            break;
+        gsize start = i;
+        // The range ends at the first run of GHEXEDIT_DIFF_GAP equal bytes
+        for (;;)
+        {
+            i += diff->first_equal(a + i, b + i, length - i);
+            if (i >= length)
+                break;
+            gsize run = MIN(GHEXEDIT_DIFF_GAP, length - i);
+            gsize same = diff->first_difference(a + i, b + i, run);
+            if (same == run)
+                break;
+            i += same;
+        }
+        append_range(ranges, base + start, i - start);
+    }
+}
+
+
+/* ===[ Workers ]=== */
+/** Main loop: publish finished chunks in order, and notice the end. */
+static void drain(gpointer object)
+{
+    GHexEditDiff *diff = GHEXEDIT_DIFF(object);
+    guint position = diff->ranges->len;
+
+    g_mutex_lock(&diff->lock);
+    GArray *chunk;
+    while (!diff->truncated && (chunk = ghexedit_drain_next(&diff->drain)))
+    {
+        for (guint i = 0; i < chunk->len && diff->ranges->len < GHEXEDIT_DIFF_MAX_RANGES; ++i)
+        {
+            GHexEditDiffRange const *range = &g_array_index(chunk, GHexEditDiffRange, i);
+            append_range(diff->ranges, range->offset, range->length);
+        }
+        if (diff->ranges->len >= GHEXEDIT_DIFF_MAX_RANGES)
+            diff->truncated = TRUE;
+        g_array_unref(chunk);
+    }
+    gboolean finished = !diff->finished && diff->active == 0;
+    g_mutex_unlock(&diff->lock);
+
+    if (diff->truncated)
+        g_cancellable_cancel(diff->cancellable);
+    // Whatever only one buffer has differs by definition
+    if (finished && !diff->truncated && diff->drain.published == diff->n_chunks)
+        for (guint i = 0; i < diff->excess->len && diff->ranges->len < GHEXEDIT_DIFF_MAX_RANGES; ++i)
+        {
+            GHexEditDiffRange const *range = &g_array_index(diff->excess, GHexEditDiffRange, i);
+            append_range(diff->ranges, range->offset, range->length);
+        }
+
+    g_object_freeze_notify(G_OBJECT(diff));
+    if (diff->ranges->len > position)
+        g_signal_emit(diff, signals[SIGNAL_RANGES_ADDED], 0, position, diff->ranges->len - position);
+    g_object_notify_by_pspec(G_OBJECT(diff), properties[PROP_PROGRESS]);
+    if (finished)
+    {
+        diff->finished = TRUE;
+        g_object_notify_by_pspec(G_OBJECT(diff), properties[PROP_FINISHED]);
+    }
+    g_object_thaw_notify(G_OBJECT(diff));
+}
+
+/** Compare one run both buffers could read; GHexEditRangeFunc. */
+static gboolean compare_run(guint64 start, guint64 end, gpointer user_data)
+{
+    CompareClosure *closure = user_data;
+    gsize at = start - closure->start;
+    compare_block(closure->diff, closure->a + at, closure->b + at, end - start, start, closure->found);
+    return closure->found->len < GHEXEDIT_DIFF_MAX_RANGES;
+}
+
+/** Pool worker: claim and compare chunks until none are left. */
+static void worker(gpointer object)
+{
+    GHexEditDiff *diff = object;
+    GHexEditRangeSet *unreadable = ghexedit_range_set_new();
+
+    for (;;)
+    {
+        guint chunk = g_atomic_int_add(&diff->next_chunk, 1);
+        if (chunk >= diff->n_chunks || g_cancellable_is_cancelled(diff->cancellable))
+            break;
+
+        GHexEditRange const *range = &g_array_index(diff->chunks, GHexEditRange, chunk);
+        guint64 start = range->start;
+        gsize limit = range->end - range->start;
+        GArray *found = g_array_new(FALSE, FALSE, sizeof(GHexEditDiffRange));
+        GError *error = NULL;
+        GBytes *a = ghexedit_buffer_read_bytes(diff->a, start, limit, &error);
+        GBytes *b = a ? ghexedit_buffer_read_bytes(diff->b, start, limit, &error) : NULL;
+        gboolean read = a && b;
+        if (read)
+        {
+            gsize a_length, b_length;
+            guint8 const *a_data = g_bytes_get_data(a, &a_length);
+            guint8 const *b_data = g_bytes_get_data(b, &b_length);
+            gsize length = MIN(a_length, b_length);
+            // Pages refused while reading are only known now
+            ghexedit_range_set_clear(unreadable);
+            ghexedit_buffer_get_unreadable(diff->a, start, length, unreadable);
+            ghexedit_buffer_get_unreadable(diff->b, start, length, unreadable);
+            CompareClosure closure = {diff, start, a_data, b_data, found};
+            ghexedit_range_set_foreach_gap(unreadable, start, start + length, compare_run, &closure);
+        }
+        g_clear_pointer(&a, g_bytes_unref);
+        g_clear_pointer(&b, g_bytes_unref);
+        if (!read)
+        {
+            // An unread chunk would look identical, so nothing after it is published
+            g_array_unref(found);
+            g_mutex_lock(&diff->lock);
+            if (diff->error == NULL)
+                diff->error = g_steal_pointer(&error);
+            g_mutex_unlock(&diff->lock);
+            g_clear_error(&error);
+            g_cancellable_cancel(diff->cancellable);
+            break;
+        }
+
+        g_mutex_lock(&diff->lock);
+        ghexedit_drain_put(&diff->drain, chunk, found);
+        g_mutex_unlock(&diff->lock);
+    }
+
+    g_mutex_lock(&diff->lock);
+    if (--diff->active == 0)
+        ghexedit_drain_schedule(&diff->drain);
+    g_mutex_unlock(&diff->lock);
+    ghexedit_range_set_free(unreadable);
+}
+
+/** Cut a run both buffers can read into chunks; GHexEditRangeFunc. */
+static gboolean plan_run(guint64 start, guint64 end, gpointer user_data)
+{
+    GArray *chunks = user_data;
+    for (guint64 at = start; at < end; at += CHUNK_SIZE)
+    {
+        GHexEditRange chunk = {at, MIN(at + CHUNK_SIZE, end)};
+        g_array_append_val(chunks, chunk);
+    }
+    return TRUE;
+}
+
+/** Note a readable stretch only the longer buffer has; GHexEditRangeFunc. */
+static gboolean add_excess(guint64 start, guint64 end, gpointer user_data)
+{
+    GHexEditDiffRange range = {start, end - start};
+    g_array_append_val(user_data, range);
+    return TRUE;
+}
+
+
+/* ===[ GHexEditDiff ]=== */
+/**
+ * Start comparing on the worker pool. Ranges are published on the calling
+ * thread's main context as they are found, through ::ranges-added.
+ */
+void ghexedit_diff_start(GHexEditDiff *diff, GCancellable *cancellable)
+{
+    g_return_if_fail(diff->cancellable == NULL);
+    diff->cancellable = cancellable ? g_object_ref(cancellable) : g_cancellable_new();
+
+    guint64 a_size = ghexedit_buffer_get_size(diff->a);
+    guint64 b_size = ghexedit_buffer_get_size(diff->b);
+    diff->common = MIN(a_size, b_size);
+    // Stretches known to be unreadable in either, like the gaps between a
+    // process's mappings, are left out before any work is queued
+    GHexEditRangeSet *unreadable = ghexedit_range_set_new();
+    ghexedit_buffer_get_unreadable(diff->a, 0, diff->common, unreadable);
+    ghexedit_buffer_get_unreadable(diff->b, 0, diff->common, unreadable);
+    ghexedit_range_set_foreach_gap(unreadable, 0, diff->common, plan_run, diff->chunks);
+    ghexedit_range_set_clear(unreadable);
+    GHexEditBuffer *longer = a_size > b_size ? diff->a : diff->b;
+    guint64 longer_size = MAX(a_size, b_size);
+    ghexedit_buffer_get_unreadable(longer, diff->common, longer_size - diff->common, unreadable);
+    ghexedit_range_set_foreach_gap(unreadable, diff->common, longer_size, add_excess, diff->excess);
+    ghexedit_range_set_free(unreadable);
+    diff->n_chunks = diff->chunks->len;
+    ghexedit_drain_init(&diff->drain, diff, drain, &diff->lock, diff->n_chunks);
+
+    diff->active = ghexedit_workers_wanted(diff->n_chunks);
+    ghexedit_workers_start(diff, worker, diff->active);
+}
+
+/** Stop comparing; ranges found so far are kept. */
+void ghexedit_diff_cancel(GHexEditDiff *diff)
+{
+    if (diff->cancellable)
+        g_cancellable_cancel(diff->cancellable);
+}
+
+/** Whether every worker has stopped and all ranges are published. */
+gboolean ghexedit_diff_get_finished(GHexEditDiff *diff)
+{
+    return diff->finished;
+}
+
+/** Why comparing stopped early, once finished; NULL if it did not fail. */
+GError const *ghexedit_diff_get_error(GHexEditDiff *diff)
+{
+    return diff->finished ? diff->error : NULL;
+}
+
+/** Whether comparing stopped at GHEXEDIT_DIFF_MAX_RANGES. */
+gboolean ghexedit_diff_get_truncated(GHexEditDiff *diff)
+{
+    return diff->truncated;
+}
+
+/** Fraction of the buffers whose differences have been published. */
+double ghexedit_diff_get_progress(GHexEditDiff *diff)
+{
+    if (diff->finished || diff->n_chunks == 0)
+        return 1.0;
+    return (double)diff->drain.published / diff->n_chunks;
+}
+
+guint ghexedit_diff_get_n_ranges(GHexEditDiff *diff)
+{
+    return diff->ranges->len;
+}
+
+GHexEditDiffRange const *ghexedit_diff_get_range(GHexEditDiff *diff, guint index)
+{
+    g_return_val_if_fail(index < diff->ranges->len, NULL);
+    return &g_array_index(diff->ranges, GHexEditDiffRange, index);
+}
+
+/**
+ * The first published range starting after `offset` going forward, or the
+ * last starting before it going backward. NULL if there is none.
+ */
+GHexEditDiffRange const *ghexedit_diff_find(GHexEditDiff *diff, guint64 offset, gboolean forward)
+{
+    // First range starting after offset
+    guint lo = 0, hi = diff->ranges->len;
+    while (lo < hi)
+    {
+        guint mid = lo + (hi - lo) / 2;
+        if (g_array_index(diff->ranges, GHexEditDiffRange, mid).offset <= offset)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    if (forward)
+        return lo < diff->ranges->len ? &g_array_index(diff->ranges, GHexEditDiffRange, lo) : NULL;
+    // Step back over a range starting exactly at offset
+    while (lo > 0 && g_array_index(diff->ranges, GHexEditDiffRange, lo - 1).offset >= offset)
+        --lo;
+    return lo > 0 ? &g_array_index(diff->ranges, GHexEditDiffRange, lo - 1) : NULL;
+}
+
+
+/* ===[ GObject ]=== */
+/** Prepare a comparison of `a` with `b`, byte for byte at equal offsets. */
+GHexEditDiff *ghexedit_diff_new(GHexEditBuffer *a, GHexEditBuffer *b)
+{
+    GHexEditDiff *diff = g_object_new(GHEXEDIT_TYPE_DIFF, NULL);
+    diff->a = g_object_ref(a);
+    diff->b = g_object_ref(b);
+    return diff;
+}
+
+/** Called when a property is read with g_object_get. */
+void ghexedit_diff_get_property(GObject *object, guint property_id, GValue *value, GParamSpec *pspec)
+{
+    GHexEditDiff *diff = GHEXEDIT_DIFF(object);
+    switch (property_id)
+    {
+    case PROP_PROGRESS:
+        g_value_set_double(value, ghexedit_diff_get_progress(diff));
+        break;
+    case PROP_FINISHED:
+        g_value_set_boolean(value, diff->finished);
+        break;
+    default:
+        G_OBJECT_WARN_INVALID_PROPERTY_ID(object, property_id, pspec);
+        break;
+    }
+}
+
+/**
+ * Drop held references.
+ * Can be executed more than once!
+ * Should chain up before returning.
+ */
+void ghexedit_diff_dispose(GObject *object)
+{
+    GHexEditDiff *diff = GHEXEDIT_DIFF(object);
+    // Workers hold references, so none are running by now
+    g_clear_object(&diff->a);
+    g_clear_object(&diff->b);
+    g_clear_object(&diff->cancellable);
+    G_OBJECT_CLASS(ghexedit_diff_parent_class)->dispose(object);
+}
+
+/** Free remaining resources. */
+void ghexedit_diff_finalize(GObject *object)
+{
+    GHexEditDiff *diff = GHEXEDIT_DIFF(object);
+    ghexedit_drain_clear(&diff->drain, (GDestroyNotify)g_array_unref);
+    g_clear_error(&diff->error);
+    g_array_unref(diff->chunks);
+    g_array_unref(diff->excess);
+    g_array_unref(diff->ranges);
+    g_mutex_clear(&diff->lock);
+    G_OBJECT_CLASS(ghexedit_diff_parent_class)->finalize(object);
+}
+
+
+/* ===[ Base GLib ]=== */
+/** Equivalent to C++ constructor. */
+void ghexedit_diff_init(GHexEditDiff *diff)
+{
+    diff->ranges = g_array_new(FALSE, FALSE, sizeof(GHexEditDiffRange));
+    diff->excess = g_array_new(FALSE, FALSE, sizeof(GHexEditDiffRange));
+    diff->chunks = g_array_new(FALSE, FALSE, sizeof(GHexEditRange));
+    g_mutex_init(&diff->lock);
+
+    // Use the vector width the hex formatter settled on
+    diff->first_difference = first_difference_scalar;
+    diff->first_equal = first_equal_scalar;
+#ifdef GHX_HAVE_X86_KERNELS
+    switch (ghexedit_hex_kernel_get_default())
+    {
+    case GHEXEDIT_HEX_KERNEL_AVX2:
+        diff->first_difference = first_difference_avx2;
+        diff->first_equal = first_equal_avx2;
+        break;
+    case GHEXEDIT_HEX_KERNEL_SSE2:
+        diff->first_difference = first_difference_sse2;
+        diff->first_equal = first_equal_sse2;
+        break;
+    default:
+        break;
+    }
+#endif
+}
+
+/**
+ * Called upon first instantiation of an object of this class.
+ * Sets/overrides class methods/signals/properties.
+ */
+void ghexedit_diff_class_init(GHexEditDiffClass *class)
+{
+    GObjectClass *klass = G_OBJECT_CLASS(class);
+    klass->get_property = ghexedit_diff_get_property;
+    klass->dispose = ghexedit_diff_dispose;
+    klass->finalize = ghexedit_diff_finalize;
+
+    properties[PROP_PROGRESS] = g_param_spec_double("progress", "Progress", "Fraction of the buffers compared.", 0, 1, 0, G_PARAM_READABLE);
+    properties[PROP_FINISHED] = g_param_spec_boolean("finished", "Finished", "Whether the comparison has stopped.", FALSE, G_PARAM_READABLE);
+    g_object_class_install_properties(klass, N_PROPERTIES, properties);
+
+    /**
+     * Emitted on the main context when `added` ranges were published,
+     * starting at index `position`. The range before `position` may have
+     * grown too.
+     */
+    signals[SIGNAL_RANGES_ADDED] = g_signal_new("ranges-added", G_TYPE_FROM_CLASS(class), G_SIGNAL_RUN_LAST, 0, NULL, NULL, NULL, G_TYPE_NONE, 2, G_TYPE_UINT, G_TYPE_UINT);
+}
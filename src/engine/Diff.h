@@ -0,0 +1,54 @@
+/**
+ * Diff.h - Parallel byte-wise comparison of two buffers.
+ * Copyright (C) 2022 Trevor Last
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _GHX_DIFF_H
+#define _GHX_DIFF_H
+
+#include <gio/gio.h>
+
+#include "Buffer.h"
+
+
+/** Stop collecting ranges past this many. */
+#define GHEXEDIT_DIFF_MAX_RANGES (1u << 22)
+
+/** Differences closer together than this many equal bytes form one range. */
+#define GHEXEDIT_DIFF_GAP 8
+
+/** A run of `length` bytes at `offset` that differ, give or take short equal gaps. */
+typedef struct
+{
+    guint64 offset;
+    guint64 length;
+} GHexEditDiffRange;
+
+#define GHEXEDIT_TYPE_DIFF ghexedit_diff_get_type()
+G_DECLARE_FINAL_TYPE(GHexEditDiff, ghexedit_diff, GHEXEDIT, DIFF, GObject);
+
+GHexEditDiff *ghexedit_diff_new(GHexEditBuffer *a, GHexEditBuffer *b);
+void ghexedit_diff_start(GHexEditDiff *diff, GCancellable *cancellable);
+void ghexedit_diff_cancel(GHexEditDiff *diff);
+gboolean ghexedit_diff_get_finished(GHexEditDiff *diff);
+gboolean ghexedit_diff_get_truncated(GHexEditDiff *diff);
+GError const *ghexedit_diff_get_error(GHexEditDiff *diff);
+double ghexedit_diff_get_progress(GHexEditDiff *diff);
+guint ghexedit_diff_get_n_ranges(GHexEditDiff *diff);
+GHexEditDiffRange const *ghexedit_diff_get_range(GHexEditDiff *diff, guint index);
+GHexEditDiffRange const *ghexedit_diff_find(GHexEditDiff *diff, guint64 offset, gboolean forward);
+
+#endif
@@ -0,0 +1,394 @@
+/**
+ * Digest.c - Checksum and hash primitives.
+ * Copyright (C) 2022 Trevor Last
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "Digest.h"
+
+#include <string.h>
+
+
+/** Reflected CRC-32 polynomial, as used by zlib, PNG and Ethernet. */
+#define CRC32_POLY 0xedb88320u
+
+#define ADLER_BASE 65521u
+/** Most bytes summed before the Adler-32 sums could overflow 32 bits. */
+#define ADLER_NMAX 5552
+
+#define BLAKE3_BLOCK_LEN 64
+#define BLAKE3_CHUNK_START (1u << 0)
+#define BLAKE3_CHUNK_END (1u << 1)
+#define BLAKE3_PARENT (1u << 2)
+#define BLAKE3_ROOT (1u << 3)
+
+/** Slice-by-8 lookup tables. */
+static guint32 crc_table[8][256];
+/** x^(2^n) modulo the CRC polynomial, for combining. */
+static guint32 crc_x2n_table[32];
+
+static guint32 const blake3_iv[8] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+};
+
+static guint8 const blake3_permutation[16] = {2, 6, 3, 10, 7, 0, 4, 13, 1, 11, 12, 5, 9, 14, 15, 8};
+
+
+/* ===[ CRC-32 ]=== */
+/** Multiply two polynomials modulo the CRC polynomial. `a` must be non-zero. */
+static guint32 crc_multiply(guint32 a, guint32 b)
+{
+    guint32 m = 1u << 31, product = 0;
+    for (;;)
+    {
+        if (a & m)
+        {
+            product ^= b;
+            if ((a & (m - 1)) == 0)
+                break;
+        }
+        m >>= 1;
+        b = b & 1 ? (b >> 1) ^ CRC32_POLY : b >> 1;
+    }
+    return product;
+}
+
+/** x^(n * 2^k) modulo the CRC polynomial. */
+static guint32 crc_x2n(guint64 n, guint k)
+{
+    guint32 p = 1u << 31;
+    for (; n; n >>= 1, ++k)
+        if (n & 1)
+            p = crc_multiply(crc_x2n_table[k & 31], p);
+    return p;
+}
+
+static void crc_init_tables(void)
+{
+    static gsize initialized = 0;
+    if (!g_once_init_enter(&initialized))
+        return;
+    for (guint n = 0; n < 256; ++n)
+    {
+        guint32 c = n;
+        for (int k = 0; k < 8; ++k)
+            c = c & 1 ? CRC32_POLY ^ (c >> 1) : c >> 1;
+        crc_table[0][n] = c;
+    }
+    for (guint n = 0; n < 256; ++n)
+        for (int k = 1; k < 8; ++k)
+            crc_table[k][n] = crc_table[0][crc_table[k - 1][n] & 0xff] ^ (crc_table[k - 1][n] >> 8);
+    guint32 p = 1u << 30;
+    crc_x2n_table[0] = p;
+    for (int n = 1; n < 32; ++n)
+        crc_x2n_table[n] = p = crc_multiply(p, p);
+    g_once_init_leave(&initialized, 1);
+}
+
+/** Continue a CRC-32 (initially 0) over `data`. */
+guint32 ghexedit_crc32_update(guint32 crc, guint8 const *data, gsize length)
+{
+    crc_init_tables();
+    crc = ~crc;
+    while (length && ((guintptr)data & 7))
+    {
+        crc = crc_table[0][(crc ^ *data++) & 0xff] ^ (crc >> 8);
+        --length;
+    }
+    for (; length >= 8; data += 8, length -= 8)
+    {
+        guint32 one, two;
+        memcpy(&one, data, 4);
+        memcpy(&two, data + 4, 4);
+        one = GUINT32_FROM_LE(one) ^ crc;
+        two = GUINT32_FROM_LE(two);
+        crc = crc_table[7][one & 0xff] ^ crc_table[6][(one >> 8) & 0xff] ^ crc_table[5][(one >> 16) & 0xff] ^ crc_table[4][one >> 24]
+            ^ crc_table[3][two & 0xff] ^ crc_table[2][(two >> 8) & 0xff] ^ crc_table[1][(two >> 16) & 0xff] ^ crc_table[0][two >> 24];
+    }
+    while (length--)
+        crc = crc_table[0][(crc ^ *data++) & 0xff] ^ (crc >> 8);
+    return ~crc;
+}
+
+/** The CRC-32 of two runs back to back, from each run's CRC and the second's length. */
+guint32 ghexedit_crc32_combine(guint32 crc1, guint32 crc2, guint64 length2)
+{
+    crc_init_tables();
+    return crc_multiply(crc_x2n(length2, 3), crc1) ^ crc2;
+}
+
+
+/* ===[ Adler-32 ]=== */
+/** Continue an Adler-32 (initially 1) over `data`. */
+guint32 ghexedit_adler32_update(guint32 adler, guint8 const *data, gsize length)
+{
+    guint32 a = adler & 0xffff, b = adler >> 16;
+    while (length)
+    {
+        gsize n = MIN(length, ADLER_NMAX);
+        length -= n;
+        while (n--)
+        {
+            a += *data++;
+            b += a;
+        }
+        a %= ADLER_BASE;
+        b %= ADLER_BASE;
+    }
+    return a | (b << 16);
+}
+
+/** The Adler-32 of two runs back to back, from each run's Adler-32 and the second's length. */
+guint32 ghexedit_adler32_combine(guint32 adler1, guint32 adler2, guint64 length2)
+{
+    guint32 rem = length2 % ADLER_BASE;
+    guint32 a = adler1 & 0xffff;
+    guint32 b = (guint32)(((guint64)rem * a) % ADLER_BASE);
+    a += (adler2 & 0xffff) + ADLER_BASE - 1;
+    b += (adler1 >> 16) + (adler2 >> 16) + ADLER_BASE - rem;
+    if (a >= ADLER_BASE)
+        a -= ADLER_BASE;
+    if (a >= ADLER_BASE)
+        a -= ADLER_BASE;
+    if (b >= ADLER_BASE << 1)
+        b -= ADLER_BASE << 1;
+    if (b >= ADLER_BASE)
+        b -= ADLER_BASE;
+    return a | (b << 16);
+}
+
+
+/* ===[ BLAKE3 ]=== */
+static inline guint32 rotr(guint32 x, int n)
+{
+    return (x >> n) | (x << (32 - n));
+}
+
+static inline void g(guint32 *s, int a, int b, int c, int d, guint32 x, guint32 y)
+{
+    s[a] += s[b] + x;
+    s[d] = rotr(s[d] ^ s[a], 16);
+    s[c] += s[d];
+    s[b] = rotr(s[b] ^ s[c], 12);
+    s[a] += s[b] + y;
+    s[d] = rotr(s[d] ^ s[a], 8);
+    s[c] += s[d];
+    s[b] = rotr(s[b] ^ s[c], 7);
+}
+
+/** The compression function; fills all 16 words of `out`. */
+static void compress(guint32 const cv[8], guint32 const block[16], guint64 counter, guint32 block_len, guint32 flags, guint32 out[16])
+{
+    guint32 s[16] = {
+        cv[0], cv[1], cv[2], cv[3], cv[4], cv[5], cv[6], cv[7],
+        blake3_iv[0], blake3_iv[1], blake3_iv[2], blake3_iv[3],
+        (guint32)counter, (guint32)(counter >> 32), block_len, flags,
+    };
+    guint32 m[16], permuted[16];
+    memcpy(m, block, sizeof(m));
+    for (int round = 0; round < 7; ++round)
+    {
+        g(s, 0, 4, 8, 12, m[0], m[1]);
+        g(s, 1, 5, 9, 13, m[2], m[3]);
+        g(s, 2, 6, 10, 14, m[4], m[5]);
+        g(s, 3, 7, 11, 15, m[6], m[7]);
+        g(s, 0, 5, 10, 15, m[8], m[9]);
+        g(s, 1, 6, 11, 12, m[10], m[11]);
+        g(s, 2, 7, 8, 13, m[12], m[13]);
+        g(s, 3, 4, 9, 14, m[14], m[15]);
+        for (int i = 0; i < 16; ++i)
+            permuted[i] = m[blake3_permutation[i]];
+        memcpy(m, permuted, sizeof(m));
+    }
+    for (int i = 0; i < 8; ++i)
+    {
+        out[i] = s[i] ^ s[i + 8];
+        out[i + 8] = s[i + 8] ^ cv[i];
+    }
+}
+
+static void block_words(guint8 const bytes[BLAKE3_BLOCK_LEN], guint32 words[16])
+{
+    for (int i = 0; i < 16; ++i)
+    {
+        guint32 w;
+        memcpy(&w, bytes + 4 * i, 4);
+        words[i] = GUINT32_FROM_LE(w);
+    }
+}
+
+/** Compress one block into `cv`. */
+static void compress_cv(guint32 cv[8], guint8 const block[BLAKE3_BLOCK_LEN], guint64 counter, guint32 block_len, guint32 flags)
+{
+    guint32 words[16], out[16];
+    block_words(block, words);
+    compress(cv, words, counter, block_len, flags, out);
+    memcpy(cv, out, 8 * sizeof(guint32));
+}
+
+/** Chaining value of a parent node over two children. */
+static void parent_cv(guint32 const key[8], guint32 const left[8], guint32 const right[8], guint32 flags, guint32 cv[8])
+{
+    guint32 words[16], out[16];
+    memcpy(words, left, 8 * sizeof(guint32));
+    memcpy(words + 8, right, 8 * sizeof(guint32));
+    compress(key, words, 0, BLAKE3_BLOCK_LEN, BLAKE3_PARENT | flags, out);
+    memcpy(cv, out, 8 * sizeof(guint32));
+}
+
+/** Chaining value of one whole chunk that isn't the root. */
+static void chunk_cv(guint32 const key[8], guint8 const *chunk, guint64 counter, guint32 cv[8])
+{
+    memcpy(cv, key, 8 * sizeof(guint32));
+    for (int i = 0; i < GHEXEDIT_BLAKE3_CHUNK_LEN / BLAKE3_BLOCK_LEN; ++i)
+    {
+        guint32 flags = (i == 0 ? BLAKE3_CHUNK_START : 0) | (i == GHEXEDIT_BLAKE3_CHUNK_LEN / BLAKE3_BLOCK_LEN - 1 ? BLAKE3_CHUNK_END : 0);
+        compress_cv(cv, chunk + i * BLAKE3_BLOCK_LEN, counter, BLAKE3_BLOCK_LEN, flags);
+    }
+}
+
+/**
+ * Push the chaining value of a subtree that ends `total` subtrees of its size
+ * into the input, merging completed pairs. Only called with more input to come,
+ * so no parent formed here can be the root.
+ */
+static void push_cv(GHexEditBlake3 *hasher, guint32 const cv[8], guint64 total)
+{
+    guint32 merged[8];
+    memcpy(merged, cv, sizeof(merged));
+    for (; (total & 1) == 0; total >>= 1)
+        parent_cv(hasher->key, hasher->cv_stack[--hasher->cv_stack_len], merged, 0, merged);
+    memcpy(hasher->cv_stack[hasher->cv_stack_len++], merged, sizeof(merged));
+}
+
+static gsize chunk_len(GHexEditBlake3 const *hasher)
+{
+    return (gsize)hasher->blocks_compressed * BLAKE3_BLOCK_LEN + hasher->block_len;
+}
+
+static void start_chunk(GHexEditBlake3 *hasher, guint64 counter)
+{
+    memcpy(hasher->cv, hasher->key, sizeof(hasher->cv));
+    hasher->chunk_counter = counter;
+    memset(hasher->block, 0, sizeof(hasher->block));
+    hasher->block_len = 0;
+    hasher->blocks_compressed = 0;
+}
+
+/** Start hashing in the default (unkeyed) mode. */
+void ghexedit_blake3_init(GHexEditBlake3 *hasher)
+{
+    memcpy(hasher->key, blake3_iv, sizeof(hasher->key));
+    hasher->cv_stack_len = 0;
+    start_chunk(hasher, 0);
+}
+
+void ghexedit_blake3_update(GHexEditBlake3 *hasher, guint8 const *data, gsize length)
+{
+    while (length)
+    {
+        // A full chunk is finished only once more input shows it isn't the last
+        if (chunk_len(hasher) == GHEXEDIT_BLAKE3_CHUNK_LEN)
+        {
+            compress_cv(hasher->cv, hasher->block, hasher->chunk_counter, BLAKE3_BLOCK_LEN, BLAKE3_CHUNK_END);
+            push_cv(hasher, hasher->cv, hasher->chunk_counter + 1);
+            start_chunk(hasher, hasher->chunk_counter + 1);
+        }
+        // Whole chunks straight from the input, keeping the last one back
+        while (chunk_len(hasher) == 0 && length > GHEXEDIT_BLAKE3_CHUNK_LEN)
+        {
+            guint32 cv[8];
+            chunk_cv(hasher->key, data, hasher->chunk_counter, cv);
+            push_cv(hasher, cv, hasher->chunk_counter + 1);
+            start_chunk(hasher, hasher->chunk_counter + 1);
+            data += GHEXEDIT_BLAKE3_CHUNK_LEN;
+            length -= GHEXEDIT_BLAKE3_CHUNK_LEN;
+        }
+        // Likewise a full block is compressed once more input follows
+        if (hasher->block_len == BLAKE3_BLOCK_LEN)
+        {
+            guint32 flags = hasher->blocks_compressed == 0 ? BLAKE3_CHUNK_START : 0;
+            compress_cv(hasher->cv, hasher->block, hasher->chunk_counter, BLAKE3_BLOCK_LEN, flags);
+            ++hasher->blocks_compressed;
+            memset(hasher->block, 0, sizeof(hasher->block));
+            hasher->block_len = 0;
+        }
+        gsize take = MIN(length, (gsize)(BLAKE3_BLOCK_LEN - hasher->block_len));
+        memcpy(hasher->block + hasher->block_len, data, take);
+        hasher->block_len += take;
+        data += take;
+        length -= take;
+    }
+}
+
+/** The 32-byte hash of everything passed so far; the hasher can carry on. */
+void ghexedit_blake3_finish(GHexEditBlake3 const *hasher, guint8 out[GHEXEDIT_BLAKE3_OUT_LEN])
+{
+    // The last chunk's final block, and the parents up the right edge
+    guint32 cv[8], words[16], state[16];
+    memcpy(cv, hasher->cv, sizeof(cv));
+    block_words(hasher->block, words);
+    guint64 counter = hasher->chunk_counter;
+    guint32 block_len = hasher->block_len;
+    guint32 flags = (hasher->blocks_compressed == 0 ? BLAKE3_CHUNK_START : 0) | BLAKE3_CHUNK_END;
+    for (int i = hasher->cv_stack_len; i-- > 0;)
+    {
+        compress(cv, words, counter, block_len, flags, state);
+        memcpy(words, hasher->cv_stack[i], 8 * sizeof(guint32));
+        memcpy(words + 8, state, 8 * sizeof(guint32));
+        memcpy(cv, hasher->key, sizeof(cv));
+        counter = 0;
+        block_len = BLAKE3_BLOCK_LEN;
+        flags = BLAKE3_PARENT;
+    }
+    compress(cv, words, counter, block_len, flags | BLAKE3_ROOT, state);
+    for (int i = 0; i < 8; ++i)
+    {
+        guint32 w = GUINT32_TO_LE(state[i]);
+        memcpy(out + 4 * i, &w, 4);
+    }
+}
+
+/**
+ * Chaining value of the subtree over `length` bytes of whole chunks starting
+ * at chunk `chunk_counter`. The number of chunks must be a power of two and
+ * `chunk_counter` a multiple of it, and more input must follow, so subtrees can
+ * be hashed independently and joined with ghexedit_blake3_push_subtree.
+ */
+void ghexedit_blake3_subtree(guint8 const *data, gsize length, guint64 chunk_counter, guint32 cv[8])
+{
+    GHexEditBlake3 hasher;
+    ghexedit_blake3_init(&hasher);
+    guint64 n_chunks = length / GHEXEDIT_BLAKE3_CHUNK_LEN;
+    g_return_if_fail(n_chunks > 0 && (n_chunks & (n_chunks - 1)) == 0 && length % GHEXEDIT_BLAKE3_CHUNK_LEN == 0);
+    for (guint64 i = 0; i < n_chunks; ++i)
+    {
+        guint32 leaf[8];
+        chunk_cv(hasher.key, data + i * GHEXEDIT_BLAKE3_CHUNK_LEN, chunk_counter + i, leaf);
+        push_cv(&hasher, leaf, i + 1);
+    }
+    memcpy(cv, hasher.cv_stack[0], 8 * sizeof(guint32));
+}
+
+/**
+ * Append a subtree of `n_chunks` chunks hashed by ghexedit_blake3_subtree.
+ * The hasher must be at a multiple of `n_chunks` chunks, with no partial chunk.
+ */
+void ghexedit_blake3_push_subtree(GHexEditBlake3 *hasher, guint32 const cv[8], guint64 n_chunks)
+{
+    g_return_if_fail(chunk_len(hasher) == 0 && hasher->chunk_counter % n_chunks == 0);
+    push_cv(hasher, cv, hasher->chunk_counter / n_chunks + 1);
+    start_chunk(hasher, hasher->chunk_counter + n_chunks);
+}
@@ -0,0 +1,54 @@
+/**
+ * Digest.h - Checksum and hash primitives.
+ * Copyright (C) 2022 Trevor Last
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _GHX_DIGEST_H
+#define _GHX_DIGEST_H
+
+#include <glib.h>
+
+
+#define GHEXEDIT_BLAKE3_CHUNK_LEN 1024
+#define GHEXEDIT_BLAKE3_OUT_LEN 32
+
+/** Incremental BLAKE3 hasher; see ghexedit_blake3_init. */
+typedef struct
+{
+    guint32 key[8];
+    // Chunk being filled
+    guint32 cv[8];
+    guint64 chunk_counter;
+    guint8 block[64];
+    guint8 block_len;
+    guint8 blocks_compressed;
+    // Chaining values of completed subtrees, largest first
+    guint32 cv_stack[54][8];
+    guint8 cv_stack_len;
+} GHexEditBlake3;
+
+guint32 ghexedit_crc32_update(guint32 crc, guint8 const *data, gsize length);
+guint32 ghexedit_crc32_combine(guint32 crc1, guint32 crc2, guint64 length2);
+guint32 ghexedit_adler32_update(guint32 adler, guint8 const *data, gsize length);
+guint32 ghexedit_adler32_combine(guint32 adler1, guint32 adler2, guint64 length2);
+
+void ghexedit_blake3_init(GHexEditBlake3 *hasher);
+void ghexedit_blake3_update(GHexEditBlake3 *hasher, guint8 const *data, gsize length);
+void ghexedit_blake3_finish(GHexEditBlake3 const *hasher, guint8 out[GHEXEDIT_BLAKE3_OUT_LEN]);
+void ghexedit_blake3_subtree(guint8 const *data, gsize length, guint64 chunk_counter, guint32 cv[8]);
+void ghexedit_blake3_push_subtree(GHexEditBlake3 *hasher, guint32 const cv[8], guint64 n_chunks);
+
+#endif
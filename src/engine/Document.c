@@ -0,0 +1,461 @@
+/**
+ * Document.c - Lazily paged file backing store.
+ * Copyright (C) 2022 Trevor Last
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#define _GNU_SOURCE
+
+#include "Document.h"
+#include "PageCache.h"
+#include "Source.h"
+#include "Trace.h"
+
+#include <gio/gio.h>
+#include <glib/gstdio.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+/** Bytes copied per read when spooling a stream. */
+#define SPOOL_BLOCK_SIZE (1024 * 1024)
+/** Least time between progress reports, in microseconds. */
+#define PROGRESS_INTERVAL (100 * 1000)
+
+/** How the document's bytes are fetched. */
+typedef enum
+{
+    /** Local regular file, mapped into memory. */
+    DOCUMENT_BACKEND_MAPPED,
+    /**
+     * Local file that can't or shouldn't be mapped (sparse, a block device,
+     * process memory), or a non-local file that can seek, read through a
+     * source and the shared page cache.
+     */
+    DOCUMENT_BACKEND_SOURCE,
+} GHexEditDocumentBackend;
+
+struct _GHexEditDocument
+{
+    GObject parent;
+    GFile *file;
+    guint64 size;
+    GHexEditDocumentBackend backend;
+    // DOCUMENT_BACKEND_MAPPED
+    GMappedFile *mapped;
+    GBytes *mapped_bytes;
+    // DOCUMENT_BACKEND_SOURCE
+    GHexEditSource *source;
+};
+
+G_DEFINE_TYPE(GHexEditDocument, ghexedit_document, G_TYPE_OBJECT)
+
+/** An open running on a worker thread, reporting back to `context`. */
+typedef struct
+{
+    GFile *file;
+    GFileProgressCallback progress;
+    gpointer progress_data;
+    GMainContext *context;
+    gint64 reported;
+    /** Read local files with pread even if they could be mapped. */
+    gboolean unmapped;
+} OpenJob;
+
+/** One progress report in flight to the main context. */
+typedef struct
+{
+    GFileProgressCallback progress;
+    gpointer progress_data;
+    goffset current;
+    goffset total;
+} ProgressReport;
+
+
+/**
+ * Try to map a local file. Returns FALSE if it isn't mappable, or is sparse:
+ * a source skips the holes of those without reading them.
+ */
+static gboolean open_mapped(GHexEditDocument *doc, char const *path)
+{
+    GStatBuf st;
+    if (g_stat(path, &st) != 0 || !S_ISREG(st.st_mode) || (guint64)st.st_blocks * 512 < (guint64)st.st_size)
+        return FALSE;
+    // The mapping is lazy; pages are only faulted in as they're read
+    doc->mapped = g_mapped_file_new(path, FALSE, NULL);
+    if (doc->mapped == NULL)
+        return FALSE;
+    doc->mapped_bytes = g_mapped_file_get_bytes(doc->mapped);
+    doc->size = g_mapped_file_get_length(doc->mapped);
+    doc->backend = DOCUMENT_BACKEND_MAPPED;
+    return TRUE;
+}
+
+/**
+ * Open a local file, device or process through a source.
+ * Returns FALSE without setting `error` if the file can't seek (a pipe or a
+ * character device), so that it can be spooled instead.
+ */
+static gboolean open_source(GHexEditDocument *doc, char const *path, GError **error)
+{
+    doc->source = ghexedit_source_open(path, error);
+    if (doc->source == NULL)
+        return FALSE;
+    doc->size = ghexedit_source_get_size(doc->source);
+    doc->backend = DOCUMENT_BACKEND_SOURCE;
+    return TRUE;
+}
+
+/** Main context: deliver a progress report. */
+static gboolean deliver_progress(gpointer user_data)
+{
+    ProgressReport *report = user_data;
+    report->progress(report->current, report->total, report->progress_data);
+    return G_SOURCE_REMOVE;
+}
+
+/** Worker: tell the opener how far along it is, at most every PROGRESS_INTERVAL. */
+static void report_progress(OpenJob *job, goffset current, goffset total, gboolean force)
+{
+    if (job == NULL || job->progress == NULL)
+        return;
+    gint64 now = g_get_monotonic_time();
+    if (!force && now - job->reported < PROGRESS_INTERVAL)
+        return;
+    job->reported = now;
+    ProgressReport *report = g_new(ProgressReport, 1);
+    *report = (ProgressReport){job->progress, job->progress_data, current, total};
+    g_main_context_invoke_full(job->context, G_PRIORITY_DEFAULT, deliver_progress, report, g_free);
+}
+
+/** write until all of `length` is written. */
+static gboolean write_fd(int fd, guint8 const *data, gsize length, GError **error)
+{
+    while (length > 0)
+    {
+        ssize_t put = write(fd, data, length);
+        if (put < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            int saved = errno;
+            g_set_error(error, G_IO_ERROR, g_io_error_from_errno(saved), "%s", g_strerror(saved));
+            return FALSE;
+        }
+        data += put;
+        length -= put;
+    }
+    return TRUE;
+}
+
+/**
+ * Copy a stream that can't seek into an unlinked temporary file and map it,
+ * so random access works and memory use doesn't grow with the stream.
+ */
+static gboolean open_spooled(GHexEditDocument *doc, GFileInputStream *stream, GCancellable *cancellable, OpenJob *job, GError **error)
+{
+    // The size is only a hint for progress; pipes don't know theirs (0)
+    GFileInfo *info = g_file_input_stream_query_info(stream, G_FILE_ATTRIBUTE_STANDARD_SIZE, cancellable, NULL);
+    goffset total = info ? g_file_info_get_size(info) : 0;
+    g_clear_object(&info);
+
+    char *path;
+    int fd = g_file_open_tmp("ghexedit-XXXXXX", &path, error);
+    if (fd < 0)
+        return FALSE;
+    g_unlink(path);
+    g_free(path);
+
+    guint8 *block = g_malloc(SPOOL_BLOCK_SIZE);
+    guint64 size = 0;
+    gboolean ok = TRUE;
+    for (;;)
+    {
+        gssize got = g_input_stream_read(G_INPUT_STREAM(stream), block, SPOOL_BLOCK_SIZE, cancellable, error);
+        if (got <= 0 || !write_fd(fd, block, got, error))
+        {
+            ok = got == 0;
+            break;
+        }
+        size += got;
+        report_progress(job, size, total, FALSE);
+    }
+    g_free(block);
+
+    if (ok)
+        doc->mapped = g_mapped_file_new_from_fd(fd, FALSE, error);
+    g_close(fd, NULL);
+    if (doc->mapped == NULL)
+        return FALSE;
+    doc->mapped_bytes = g_mapped_file_get_bytes(doc->mapped);
+    doc->size = size;
+    doc->backend = DOCUMENT_BACKEND_MAPPED;
+    report_progress(job, size, size, TRUE);
+    return TRUE;
+}
+
+/** Open a file through GIO, spooling it if the stream can't seek. */
+static gboolean open_stream(GHexEditDocument *doc, GCancellable *cancellable, OpenJob *job, GError **error)
+{
+    GFileInputStream *stream = g_file_read(doc->file, cancellable, error);
+    if (stream == NULL)
+        return FALSE;
+    if (!g_seekable_can_seek(G_SEEKABLE(stream)))
+    {
+        gboolean ok = open_spooled(doc, stream, cancellable, job, error);
+        g_object_unref(stream);
+        return ok;
+    }
+    GFileInfo *info = g_file_input_stream_query_info(stream, G_FILE_ATTRIBUTE_STANDARD_SIZE, cancellable, error);
+    if (info == NULL)
+    {
+        g_object_unref(stream);
+        return FALSE;
+    }
+    doc->size = g_file_info_get_size(info);
+    g_object_unref(info);
+    doc->source = ghexedit_source_open_stream(G_INPUT_STREAM(stream), doc->size);
+    g_object_unref(stream);
+    doc->backend = DOCUMENT_BACKEND_SOURCE;
+    return TRUE;
+}
+
+
+/* ===[ GHexEditDocument ]=== */
+/** The file backing this document. */
+GFile *ghexedit_document_get_file(GHexEditDocument *doc)
+{
+    return doc->file;
+}
+
+/** Size of the document in bytes. */
+guint64 ghexedit_document_get_size(GHexEditDocument *doc)
+{
+    return doc->size;
+}
+
+/**
+ * Copy up to `length` bytes at `offset` into `dest`.
+ * Returns the number of bytes copied, which is short only at the end of the
+ * document, or -1 on error.
+ */
+gssize ghexedit_document_read_into(GHexEditDocument *doc, guint64 offset, guint8 *dest, gsize length, GError **error)
+{
+    if (offset >= doc->size)
+        return 0;
+    length = MIN(length, doc->size - offset);
+
+    switch (doc->backend)
+    {
+    case DOCUMENT_BACKEND_MAPPED:
+        memcpy(dest, g_mapped_file_get_contents(doc->mapped) + offset, length);
+        return length;
+    default:
+        return ghexedit_page_cache_read(ghexedit_page_cache_get_default(), doc->source, offset, dest, length, error);
+    }
+}
+
+/**
+ * Start fetching `length` bytes at `offset` in the background, so that a
+ * later read finds them cached. Mapped files are left to the kernel's own
+ * read-ahead.
+ */
+void ghexedit_document_prefetch(GHexEditDocument *doc, guint64 offset, guint64 length)
+{
+    if (doc->backend == DOCUMENT_BACKEND_SOURCE && offset < doc->size)
+        ghexedit_page_cache_prefetch(ghexedit_page_cache_get_default(), doc->source, offset, MIN(length, doc->size - offset));
+}
+
+/**
+ * Add the bytes within `length` at `offset` that couldn't be read, and are
+ * zeroes only as a stand-in, to `unreadable`: bad sectors, and the gaps
+ * between a process's mappings.
+ */
+void ghexedit_document_get_unreadable(GHexEditDocument *doc, guint64 offset, guint64 length, GHexEditRangeSet *unreadable)
+{
+    if (doc->backend == DOCUMENT_BACKEND_SOURCE && offset < doc->size)
+        ghexedit_page_cache_get_unreadable(ghexedit_page_cache_get_default(), doc->source, offset, MIN(length, doc->size - offset), unreadable);
+}
+
+/**
+ * Get a window of the document's data.
+ * The window is clamped to the end of the document, so it may be shorter than
+ * `length`. Mapped documents return a view into the mapping without copying.
+ */
+GBytes *ghexedit_document_read(GHexEditDocument *doc, guint64 offset, gsize length, GError **error)
+{
+    if (offset >= doc->size)
+        return g_bytes_new(NULL, 0);
+    length = MIN(length, doc->size - offset);
+
+    if (doc->backend == DOCUMENT_BACKEND_MAPPED)
+        return g_bytes_new_from_bytes(doc->mapped_bytes, offset, length);
+
+    guint8 *data = g_malloc(length);
+    gssize got = ghexedit_document_read_into(doc, offset, data, length, error);
+    if (got < 0)
+    {
+        g_free(data);
+        return NULL;
+    }
+    return g_bytes_new_take(data, got);
+}
+
+
+/**
+ * Open `file` on the calling thread, reporting progress to `job` if given.
+ * An `unmapped` document never maps the file, so it can shrink underneath
+ * without reads faulting.
+ */
+static GHexEditDocument *open_document(GFile *file, gboolean unmapped, GCancellable *cancellable, OpenJob *job, GError **error)
+{
+    GHEXEDIT_TRACE_BEGIN(load);
+    GHexEditDocument *doc = g_object_new(GHEXEDIT_TYPE_DOCUMENT, NULL);
+    doc->file = g_object_ref(file);
+
+    gboolean ok = FALSE;
+    GError *local_error = NULL;
+    char *path = g_file_get_path(file);
+    // Process memory looks like an empty regular file to stat
+    if (path)
+        ok = (!unmapped && !ghexedit_source_is_process_path(path) && open_mapped(doc, path)) || open_source(doc, path, &local_error);
+    // Remote files, and local ones that can't seek, go through a stream
+    if (!ok && local_error == NULL)
+        ok = open_stream(doc, cancellable, job, &local_error);
+    GHEXEDIT_TRACE_END(load, "%s", path ? path : "(remote)");
+    g_free(path);
+
+    if (!ok)
+    {
+        g_propagate_error(error, local_error);
+        g_clear_object(&doc);
+    }
+    return doc;
+}
+
+static void open_job_free(OpenJob *job)
+{
+    g_object_unref(job->file);
+    g_main_context_unref(job->context);
+    g_free(job);
+}
+
+/** GTask thread: open the document. */
+static void open_thread(GTask *task, gpointer source_object, gpointer task_data, GCancellable *cancellable)
+{
+    OpenJob *job = task_data;
+    GError *error = NULL;
+    GHexEditDocument *doc = open_document(job->file, job->unmapped, cancellable, job, &error);
+    if (doc)
+        g_task_return_pointer(task, doc, g_object_unref);
+    else
+        g_task_return_error(task, error);
+}
+
+
+/* ===[ GObject ]=== */
+/**
+ * Open a document for a file.
+ * Only the file's metadata is touched here; data is paged in on demand by
+ * ghexedit_document_read. Streams that can't seek are the exception, and are
+ * copied in full first.
+ */
+GHexEditDocument *ghexedit_document_new(GFile *file, GError **error)
+{
+    return open_document(file, FALSE, NULL, NULL, error);
+}
+
+/** Run open_document on a worker thread. */
+static void open_async(GFile *file, gboolean unmapped, GCancellable *cancellable, GFileProgressCallback progress, gpointer progress_data, GAsyncReadyCallback callback, gpointer user_data)
+{
+    OpenJob *job = g_new0(OpenJob, 1);
+    job->file = g_object_ref(file);
+    job->progress = progress;
+    job->progress_data = progress_data;
+    job->context = g_main_context_ref_thread_default();
+    job->unmapped = unmapped;
+
+    GTask *task = g_task_new(NULL, cancellable, callback, user_data);
+    g_task_set_source_tag(task, ghexedit_document_new_async);
+    g_task_set_task_data(task, job, (GDestroyNotify)open_job_free);
+    g_task_run_in_thread(task, open_thread);
+    g_object_unref(task);
+}
+
+/**
+ * Open a document for a file on a worker thread.
+ * `progress`, if given, is called on the calling thread's main context while
+ * a stream is being copied in. Cancelling abandons the open.
+ */
+void ghexedit_document_new_async(GFile *file, GCancellable *cancellable, GFileProgressCallback progress, gpointer progress_data, GAsyncReadyCallback callback, gpointer user_data)
+{
+    open_async(file, FALSE, cancellable, progress, progress_data, callback, user_data);
+}
+
+/**
+ * Like ghexedit_document_new_async, but a local file is always read with
+ * pread rather than mapped, for files expected to change size while open.
+ * Finish with ghexedit_document_new_finish.
+ */
+void ghexedit_document_new_unmapped_async(GFile *file, GCancellable *cancellable, GAsyncReadyCallback callback, gpointer user_data)
+{
+    open_async(file, TRUE, cancellable, NULL, NULL, callback, user_data);
+}
+
+GHexEditDocument *ghexedit_document_new_finish(GAsyncResult *result, GError **error)
+{
+    g_return_val_if_fail(g_task_is_valid(result, NULL), NULL);
+    return g_task_propagate_pointer(G_TASK(result), error);
+}
+
+/**
+ * Drop held references.
+ * Can be executed more than once!
+ * Should chain up before returning.
+ */
+void ghexedit_document_dispose(GObject *object)
+{
+    GHexEditDocument *doc = GHEXEDIT_DOCUMENT(object);
+    g_clear_pointer(&doc->mapped_bytes, g_bytes_unref);
+    g_clear_pointer(&doc->mapped, g_mapped_file_unref);
+    g_clear_object(&doc->file);
+    if (doc->source)
+    {
+        ghexedit_page_cache_forget(ghexedit_page_cache_get_default(), doc->source);
+        g_clear_pointer(&doc->source, ghexedit_source_free);
+    }
+    G_OBJECT_CLASS(ghexedit_document_parent_class)->dispose(object);
+}
+
+
+/* ===[ Base GLib ]=== */
+/** Equivalent to C++ constructor. */
+void ghexedit_document_init(GHexEditDocument *doc)
+{
+    doc->source = NULL;
+}
+
+/**
+ * Called upon first instantiation of an object of this class.
+ * Sets/overrides class methods/signals/properties.
+ */
+void ghexedit_document_class_init(GHexEditDocumentClass *class)
+{
+    G_OBJECT_CLASS(class)->dispose = ghexedit_document_dispose;
+}
@@ -0,0 +1,44 @@
+/**
+ * Document.h - Lazily paged file backing store.
+ * Copyright (C) 2022 Trevor Last
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _GHX_DOCUMENT_H
+#define _GHX_DOCUMENT_H
+
+#include <gio/gio.h>
+
+#include "RangeSet.h"
+
+
+/** Size of the windows handed out by ghexedit_document_read. */
+#define GHEXEDIT_DOCUMENT_PAGE_SIZE (64 * 1024)
+
+#define GHEXEDIT_TYPE_DOCUMENT ghexedit_document_get_type()
+G_DECLARE_FINAL_TYPE(GHexEditDocument, ghexedit_document, GHEXEDIT, DOCUMENT, GObject);
+
+GHexEditDocument *ghexedit_document_new(GFile *file, GError **error);
+void ghexedit_document_new_async(GFile *file, GCancellable *cancellable, GFileProgressCallback progress, gpointer progress_data, GAsyncReadyCallback callback, gpointer user_data);
+void ghexedit_document_new_unmapped_async(GFile *file, GCancellable *cancellable, GAsyncReadyCallback callback, gpointer user_data);
+GHexEditDocument *ghexedit_document_new_finish(GAsyncResult *result, GError **error);
+GFile *ghexedit_document_get_file(GHexEditDocument *doc);
+guint64 ghexedit_document_get_size(GHexEditDocument *doc);
+GBytes *ghexedit_document_read(GHexEditDocument *doc, guint64 offset, gsize length, GError **error);
+gssize ghexedit_document_read_into(GHexEditDocument *doc, guint64 offset, guint8 *dest, gsize length, GError **error);
+void ghexedit_document_prefetch(GHexEditDocument *doc, guint64 offset, guint64 length);
+void ghexedit_document_get_unreadable(GHexEditDocument *doc, guint64 offset, guint64 length, GHexEditRangeSet *unreadable);
+
+#endif
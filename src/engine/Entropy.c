@@ -0,0 +1,642 @@
+/**
+ * Entropy.c - Background byte statistics over a buffer.
+ * Copyright (C) 2022 Trevor Last
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "Entropy.h"
+#include "HexFormat.h"
+#include "Workers.h"
+
+#include <math.h>
+#include <string.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define GHX_HAVE_X86_KERNELS 1
+#include <immintrin.h>
+#endif
+
+
+/** Levels of blocks within one segment, a parallel job; a segment is one block of the last. */
+#define SEGMENT_LEVEL 8
+#define SEGMENT_BLOCKS (1u << SEGMENT_LEVEL)
+/** Most bytes read at once; segments of large buffers take several reads. */
+#define READ_SIZE (4 * 1024 * 1024)
+/** Size, totals, and each level's floats as bytes, for ghexedit_entropy_save. */
+#define SAVED_TYPE "(tataay)"
+
+/** Add the byte values of `data` to `counts`. */
+typedef void (*CountFunc)(guint8 const *data, gsize length, guint32 counts[256]);
+
+/**
+ * A mipmap of block entropies: level 0 has one value per block and each
+ * level above halves that, up to a single value for the whole buffer.
+ * Blocks are GHEXEDIT_ENTROPY_BLOCK bytes, doubled as often as it takes to
+ * keep level 0 within GHEXEDIT_ENTROPY_MAX_BLOCKS, so storage is bounded
+ * however big the buffer. Every level is built from the
+ * histograms of the one below, never from the data again, so any zoom is a
+ * lookup.
+ *
+ * Workers claim segments and fill in the levels up to SEGMENT_LEVEL for
+ * theirs, keeping only the segment's histogram. The last worker to stop
+ * builds the levels above from those.
+ */
+struct _GHexEditEntropy
+{
+    GObject parent;
+    GHexEditBuffer *buffer;
+    guint64 size;
+    /** Bytes per block at level 0. */
+    guint64 block;
+    GCancellable *cancellable;
+    guint n_segments;
+    guint n_levels;
+    /** Bits per byte of each block, level by level. */
+    float **levels;
+    guint64 (*histograms)[256];
+    // Shared with workers
+    gint next_segment;
+    /** Set once a segment's levels are filled in. */
+    gint *segment_done;
+    GMutex lock;
+    guint64 done;
+    /** Progress and the end, reported on the main context. */
+    GHexEditDrain drain;
+    guint active;
+    gboolean stopped;
+    GError *error;
+    guint64 totals[256];
+    // Main thread only
+    gboolean finished;
+};
+
+G_DEFINE_TYPE(GHexEditEntropy, ghexedit_entropy, G_TYPE_OBJECT)
+
+enum
+{
+    PROP_PROGRESS = 1,
+    PROP_FINISHED,
+    N_PROPERTIES
+};
+
+static GParamSpec *properties[N_PROPERTIES] = {NULL,};
+
+
+/* ===[ Counting ]=== */
+/**
+ * Count into four tables in turn, so consecutive equal bytes don't wait on
+ * each other's increments.
+ */
+static void count_scalar(guint8 const *data, gsize length, guint32 counts[256])
+{
+    guint32 tables[3][256];
+    memset(tables, 0, sizeof(tables));
+    gsize i = 0;
+    for (; i + 4 <= length; i += 4)
+    {
+        ++counts[data[i]];
+        ++tables[0][data[i + 1]];
+        ++tables[1][data[i + 2]];
+        ++tables[2][data[i + 3]];
+    }
+    for (; i < length; ++i)
+        ++counts[data[i]];
+    for (guint b = 0; b < 256; ++b)
+        counts[b] += tables[0][b] + tables[1][b] + tables[2][b];
+}
+
+#ifdef GHX_HAVE_X86_KERNELS
+/*
+ * There is no vector scatter-increment, so the vector kernels only take a
+ * shortcut for runs of one value (padding, zero fill), counting a whole
+ * vector at once, and hand everything else to the scalar kernel.
+ */
+__attribute__((target("sse2")))
+static void count_sse2(guint8 const *data, gsize length, guint32 counts[256])
+{
+    gsize i = 0, mixed = 0;
+    for (; i + 16 <= length; i += 16)
+    {
+        __m128i v = _mm_loadu_si128((__m128i const *)(data + i));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8(data[i]))) != 0xffff)
+            continue;
+        count_scalar(data + mixed, i - mixed, counts);
+        counts[data[i]] += 16;
+        mixed = i + 16;
+    }
+    count_scalar(data + mixed, length - mixed, counts);
+}
+
+__attribute__((target("avx2")))
+static void count_avx2(guint8 const *data, gsize length, guint32 counts[256])
+{
+    gsize i = 0, mixed = 0;
+    for (; i + 32 <= length; i += 32)
+    {
+        __m256i v = _mm256_loadu_si256((__m256i const *)(data + i));
+        if ((guint32)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(data[i]))) != 0xffffffffu)
+            continue;
+        count_scalar(data + mixed, i - mixed, counts);
+        counts[data[i]] += 32;
+        mixed = i + 32;
+    }
+    count_scalar(data + mixed, length - mixed, counts);
+}
+#endif
+
+/** The counting kernel for the vector width the hex formatter settled on. */
+static CountFunc get_count_func(void)
+{
+    static gsize chosen = 0;
+    if (g_once_init_enter(&chosen))
+    {
+        CountFunc count = count_scalar;
+#ifdef GHX_HAVE_X86_KERNELS
+        switch (ghexedit_hex_kernel_get_default())
+        {
+        case GHEXEDIT_HEX_KERNEL_AVX2:
+            count = count_avx2;
+            break;
+        case GHEXEDIT_HEX_KERNEL_SSE2:
+            count = count_sse2;
+            break;
+        default:
+            break;
+        }
+#endif
+        g_once_init_leave(&chosen, (gsize)count);
+    }
+    return (CountFunc)chosen;
+}
+
+/** Shannon entropy, in bits per byte, of `n` bytes with `sum` = Σ c·log2(c). */
+static float entropy_bits(double n, double sum)
+{
+    return n > 0 ? (float)MAX(log2(n) - sum / n, 0) : 0;
+}
+
+
+
+/* ===[ Workers ]=== */
+/** Main loop: report progress, and notice the end. */
+static void drain(gpointer object)
+{
+    GHexEditEntropy *entropy = GHEXEDIT_ENTROPY(object);
+    g_mutex_lock(&entropy->lock);
+    gboolean finished = !entropy->finished && entropy->stopped;
+    g_mutex_unlock(&entropy->lock);
+
+    g_object_freeze_notify(G_OBJECT(entropy));
+    g_object_notify_by_pspec(G_OBJECT(entropy), properties[PROP_PROGRESS]);
+    if (finished)
+    {
+        entropy->finished = TRUE;
+        g_object_notify_by_pspec(G_OBJECT(entropy), properties[PROP_FINISHED]);
+    }
+    g_object_thaw_notify(G_OBJECT(entropy));
+}
+
+/** Number of blocks at `level`. */
+static guint64 level_length(GHexEditEntropy *entropy, guint level)
+{
+    guint64 block = entropy->block << level;
+    return (entropy->size + block - 1) / block;
+}
+
+/** Keep the first error, and stop every worker. */
+static void fail(GHexEditEntropy *entropy, GError *error)
+{
+    g_mutex_lock(&entropy->lock);
+    if (entropy->error == NULL)
+        entropy->error = g_steal_pointer(&error);
+    g_mutex_unlock(&entropy->lock);
+    g_clear_error(&error);
+    g_cancellable_cancel(entropy->cancellable);
+}
+
+/** Count one segment block by block, and fill in its levels. */
+static void analyse_segment(GHexEditEntropy *entropy, guint index)
+{
+    guint64 segment = entropy->block << SEGMENT_LEVEL;
+    guint64 start = (guint64)index * segment;
+    guint64 length = MIN(segment, entropy->size - start);
+    CountFunc count = get_count_func();
+    guint64 (*nodes)[256] = g_malloc0_n(SEGMENT_BLOCKS, sizeof(*nodes));
+
+    // Level 0 from the data, a read at a time
+    for (guint64 position = 0; position < length;)
+    {
+        GError *error = NULL;
+        GBytes *bytes = ghexedit_buffer_read_bytes(entropy->buffer, start + position, MIN(READ_SIZE, length - position), &error);
+        // Pages refused while reading are only known now
+        if (bytes && !ghexedit_buffer_check_readable(entropy->buffer, start + position, g_bytes_get_size(bytes), &error))
+            g_clear_pointer(&bytes, g_bytes_unref);
+        if (bytes == NULL || g_bytes_get_size(bytes) == 0 || g_cancellable_is_cancelled(entropy->cancellable))
+        {
+            if (bytes == NULL)
+                fail(entropy, error);
+            g_clear_pointer(&bytes, g_bytes_unref);
+            g_free(nodes);
+            return;
+        }
+        gsize got;
+        guint8 const *data = g_bytes_get_data(bytes, &got);
+        for (gsize at = 0; at < got;)
+        {
+            guint64 offset = position + at;
+            guint i = offset / entropy->block;
+            gsize run = MIN(got - at, (i + 1) * entropy->block - offset);
+            guint32 counts[256] = {0};
+            count(data + at, run, counts);
+            for (guint b = 0; b < 256; ++b)
+                nodes[i][b] += counts[b];
+            at += run;
+        }
+        g_bytes_unref(bytes);
+        position += got;
+
+        g_mutex_lock(&entropy->lock);
+        entropy->done += got;
+        ghexedit_drain_schedule(&entropy->drain);
+        g_mutex_unlock(&entropy->lock);
+    }
+    guint n = (length + entropy->block - 1) / entropy->block;
+    for (guint i = 0; i < n; ++i)
+        entropy->levels[0][(guint64)index * SEGMENT_BLOCKS + i] = ghexedit_histogram_entropy(nodes[i]);
+
+    // Each level above from pairs below, in place
+    for (guint level = 1; level <= SEGMENT_LEVEL && level < entropy->n_levels; ++level)
+    {
+        guint pairs = n / 2;
+        for (guint i = 0; i < pairs; ++i)
+            for (guint b = 0; b < 256; ++b)
+                nodes[i][b] = nodes[2 * i][b] + nodes[2 * i + 1][b];
+        if (n % 2)
+            memcpy(nodes[pairs], nodes[n - 1], sizeof(nodes[0]));
+        n = pairs + n % 2;
+        for (guint i = 0; i < n; ++i)
+            entropy->levels[level][((guint64)index * SEGMENT_BLOCKS >> level) + i] = ghexedit_histogram_entropy(nodes[i]);
+    }
+    // Whatever is left is the whole segment
+    for (guint i = 1; i < n; ++i)
+        for (guint b = 0; b < 256; ++b)
+            nodes[0][b] += nodes[i][b];
+    memcpy(entropy->histograms[index], nodes[0], sizeof(nodes[0]));
+    g_free(nodes);
+
+    g_atomic_int_set(&entropy->segment_done[index], TRUE);
+    g_mutex_lock(&entropy->lock);
+    ghexedit_drain_schedule(&entropy->drain);
+    g_mutex_unlock(&entropy->lock);
+}
+
+/** Build the levels above SEGMENT_LEVEL, and the totals. Every worker has stopped. */
+static void join_segments(GHexEditEntropy *entropy)
+{
+    guint64 n = entropy->n_segments;
+    guint64 (*nodes)[256] = g_malloc0_n(MAX(n, 1), sizeof(*nodes));
+    memcpy(nodes, entropy->histograms, n * sizeof(*nodes));
+
+    for (guint level = SEGMENT_LEVEL + 1; level < entropy->n_levels; ++level)
+    {
+        guint64 pairs = n / 2;
+        for (guint64 i = 0; i < pairs; ++i)
+            for (guint b = 0; b < 256; ++b)
+                nodes[i][b] = nodes[2 * i][b] + nodes[2 * i + 1][b];
+        if (n % 2)
+            memcpy(nodes[pairs], nodes[n - 1], sizeof(nodes[0]));
+        n = pairs + n % 2;
+        for (guint64 i = 0; i < n; ++i)
+            entropy->levels[level][i] = ghexedit_histogram_entropy(nodes[i]);
+    }
+    for (guint64 i = 0; i < n; ++i)
+        for (guint b = 0; b < 256; ++b)
+            entropy->totals[b] += nodes[i][b];
+    g_free(nodes);
+}
+
+/** Pool worker: claim segments until none are left. */
+static void worker(gpointer object)
+{
+    GHexEditEntropy *entropy = object;
+
+    for (;;)
+    {
+        guint segment = g_atomic_int_add(&entropy->next_segment, 1);
+        if (segment >= entropy->n_segments || g_cancellable_is_cancelled(entropy->cancellable))
+            break;
+        analyse_segment(entropy, segment);
+    }
+
+    g_mutex_lock(&entropy->lock);
+    gboolean last = --entropy->active == 0;
+    g_mutex_unlock(&entropy->lock);
+    if (last)
+    {
+        if (!g_cancellable_is_cancelled(entropy->cancellable))
+            join_segments(entropy);
+        g_mutex_lock(&entropy->lock);
+        if (entropy->error == NULL)
+            g_cancellable_set_error_if_cancelled(entropy->cancellable, &entropy->error);
+        entropy->stopped = TRUE;
+        ghexedit_drain_schedule(&entropy->drain);
+        g_mutex_unlock(&entropy->lock);
+    }
+}
+
+
+/* ===[ GHexEditEntropy ]=== */
+/** Make room for the levels of a buffer of `size` bytes. */
+static void allocate_levels(GHexEditEntropy *entropy, guint64 size)
+{
+    entropy->size = size;
+    entropy->block = GHEXEDIT_ENTROPY_BLOCK;
+    while (level_length(entropy, 0) > GHEXEDIT_ENTROPY_MAX_BLOCKS)
+        entropy->block <<= 1;
+    guint64 segment = entropy->block << SEGMENT_LEVEL;
+    entropy->n_segments = (entropy->size + segment - 1) / segment;
+    entropy->segment_done = g_new0(gint, entropy->n_segments);
+    // Up to and including the first level with a single block
+    entropy->n_levels = 0;
+    while (entropy->size && (entropy->n_levels == 0 || level_length(entropy, entropy->n_levels - 1) > 1))
+        ++entropy->n_levels;
+    entropy->levels = g_new0(float *, entropy->n_levels);
+    for (guint level = 0; level < entropy->n_levels; ++level)
+        entropy->levels[level] = g_new0(float, level_length(entropy, level));
+}
+
+/**
+ * Start analysing on the worker pool. Progress and the end are reported on
+ * the calling thread's main context through the properties; finished parts
+ * can be looked up before then.
+ */
+void ghexedit_entropy_start(GHexEditEntropy *entropy, GCancellable *cancellable)
+{
+    g_return_if_fail(entropy->cancellable == NULL && !entropy->finished);
+    entropy->cancellable = cancellable ? g_object_ref(cancellable) : g_cancellable_new();
+
+    // Gaps, like those between a process's mappings, would be counted as
+    // zeroes and could be most of an address space: don't analyse at all
+    guint64 size = ghexedit_buffer_get_size(entropy->buffer);
+    if (ghexedit_buffer_check_readable(entropy->buffer, 0, size, &entropy->error))
+        allocate_levels(entropy, size);
+    else
+    {
+        entropy->size = size;
+        entropy->block = GHEXEDIT_ENTROPY_BLOCK;
+        g_cancellable_cancel(entropy->cancellable);
+    }
+    entropy->histograms = g_malloc0_n(entropy->n_segments, sizeof(*entropy->histograms));
+
+    ghexedit_drain_init(&entropy->drain, entropy, drain, &entropy->lock, 0);
+    entropy->active = ghexedit_workers_wanted(entropy->n_segments);
+    ghexedit_workers_start(entropy, worker, entropy->active);
+}
+
+/** Stop analysing; finished segments can still be looked up. */
+void ghexedit_entropy_cancel(GHexEditEntropy *entropy)
+{
+    if (entropy->cancellable)
+        g_cancellable_cancel(entropy->cancellable);
+}
+
+/** Whether every worker has stopped. */
+gboolean ghexedit_entropy_get_finished(GHexEditEntropy *entropy)
+{
+    return entropy->finished;
+}
+
+/** Fraction of the buffer analysed. */
+double ghexedit_entropy_get_progress(GHexEditEntropy *entropy)
+{
+    if (entropy->finished)
+        return 1.0;
+    g_mutex_lock(&entropy->lock);
+    double progress = entropy->size ? (double)entropy->done / entropy->size : 0;
+    g_mutex_unlock(&entropy->lock);
+    return progress;
+}
+
+/** Why analysis stopped short, once finished; NULL on success. */
+GError const *ghexedit_entropy_get_error(GHexEditEntropy *entropy)
+{
+    return entropy->finished ? entropy->error : NULL;
+}
+
+/** Bytes per block at the finest level. */
+guint64 ghexedit_entropy_get_block_size(GHexEditEntropy *entropy)
+{
+    return entropy->block;
+}
+
+/** Size of the buffer when analysis started. */
+guint64 ghexedit_entropy_get_size(GHexEditEntropy *entropy)
+{
+    return entropy->size;
+}
+
+/**
+ * Entropy in bits per byte (0 to 8) of the block holding `offset`, at the
+ * coarsest level whose blocks are no bigger than `span` bytes. FALSE if that
+ * block hasn't been analysed yet.
+ */
+gboolean ghexedit_entropy_lookup(GHexEditEntropy *entropy, guint64 offset, guint64 span, float *bits)
+{
+    if (offset >= entropy->size || entropy->n_levels == 0)
+        return FALSE;
+    guint level = 0;
+    while (level + 1 < entropy->n_levels && (entropy->block << (level + 1)) <= span)
+        ++level;
+    if (level > SEGMENT_LEVEL)
+    {
+        if (!entropy->finished || entropy->error)
+            return FALSE;
+    }
+    else if (!g_atomic_int_get(&entropy->segment_done[offset / (entropy->block << SEGMENT_LEVEL)]))
+        return FALSE;
+    *bits = entropy->levels[level][offset / (entropy->block << level)];
+    return TRUE;
+}
+
+/** How often each byte value occurs in the whole buffer. FALSE until finished. */
+gboolean ghexedit_entropy_get_histogram(GHexEditEntropy *entropy, guint64 counts[256])
+{
+    if (!entropy->finished || entropy->error)
+        return FALSE;
+    memcpy(counts, entropy->totals, sizeof(entropy->totals));
+    return TRUE;
+}
+
+/** Add how often each byte value occurs in `data` to `counts`. */
+void ghexedit_byte_histogram(guint8 const *data, gsize length, guint32 counts[256])
+{
+    get_count_func()(data, length, counts);
+}
+
+/** Shannon entropy of a histogram, in bits per byte. */
+float ghexedit_histogram_entropy(guint64 const counts[256])
+{
+    double n = 0, sum = 0;
+    for (guint b = 0; b < 256; ++b)
+        if (counts[b])
+        {
+            n += counts[b];
+            sum += counts[b] * log2(counts[b]);
+        }
+    return entropy_bits(n, sum);
+}
+
+
+/**
+ * A finished analysis as a GVariant, to keep with the file's session and
+ * read back with ghexedit_entropy_new_saved; NULL if it didn't finish.
+ */
+GVariant *ghexedit_entropy_save(GHexEditEntropy *entropy)
+{
+    if (!entropy->finished || entropy->error)
+        return NULL;
+    GVariantBuilder levels;
+    g_variant_builder_init(&levels, G_VARIANT_TYPE("aay"));
+    for (guint level = 0; level < entropy->n_levels; ++level)
+        g_variant_builder_add_value(&levels, g_variant_new_fixed_array(G_VARIANT_TYPE_BYTE, entropy->levels[level], level_length(entropy, level) * sizeof(float), 1));
+    return g_variant_new("(t@at@aay)", entropy->size,
+        g_variant_new_fixed_array(G_VARIANT_TYPE_UINT64, entropy->totals, 256, sizeof(guint64)), g_variant_builder_end(&levels));
+}
+
+
+/* ===[ GObject ]=== */
+/** Prepare an analysis of `buffer` as it is when started. */
+GHexEditEntropy *ghexedit_entropy_new(GHexEditBuffer *buffer)
+{
+    GHexEditEntropy *entropy = g_object_new(GHEXEDIT_TYPE_ENTROPY, NULL);
+    entropy->buffer = g_object_ref(buffer);
+    return entropy;
+}
+
+/**
+ * An analysis of `buffer` read back from ghexedit_entropy_save, finished
+ * already and not to be started; NULL if `saved` isn't one of a buffer its
+ * size. That it is of the same bytes is up to the caller.
+ */
+GHexEditEntropy *ghexedit_entropy_new_saved(GHexEditBuffer *buffer, GVariant *saved)
+{
+    if (!g_variant_is_of_type(saved, G_VARIANT_TYPE(SAVED_TYPE)))
+        return NULL;
+    guint64 size;
+    GVariant *totals, *levels;
+    g_variant_get(saved, "(t@at@aay)", &size, &totals, &levels);
+    GHexEditEntropy *entropy = NULL;
+    gsize n_totals;
+    guint64 const *counts = g_variant_get_fixed_array(totals, &n_totals, sizeof(guint64));
+    if (size == ghexedit_buffer_get_size(buffer) && n_totals == 256)
+    {
+        entropy = ghexedit_entropy_new(buffer);
+        allocate_levels(entropy, size);
+        memcpy(entropy->totals, counts, sizeof(entropy->totals));
+        gboolean ok = g_variant_n_children(levels) == entropy->n_levels;
+        for (guint level = 0; ok && level < entropy->n_levels; ++level)
+        {
+            GVariant *floats = g_variant_get_child_value(levels, level);
+            gsize length;
+            guint8 const *data = g_variant_get_fixed_array(floats, &length, 1);
+            ok = length == level_length(entropy, level) * sizeof(float);
+            if (ok)
+                memcpy(entropy->levels[level], data, length);
+            g_variant_unref(floats);
+        }
+        if (ok)
+        {
+            for (guint i = 0; i < entropy->n_segments; ++i)
+                entropy->segment_done[i] = TRUE;
+            entropy->stopped = entropy->finished = TRUE;
+        }
+        else
+            g_clear_object(&entropy);
+    }
+    g_variant_unref(levels);
+    g_variant_unref(totals);
+    return entropy;
+}
+
+/** Called when a property is read with g_object_get. */
+void ghexedit_entropy_get_property(GObject *object, guint property_id, GValue *value, GParamSpec *pspec)
+{
+    GHexEditEntropy *entropy = GHEXEDIT_ENTROPY(object);
+    switch (property_id)
+    {
+    case PROP_PROGRESS:
+        g_value_set_double(value, ghexedit_entropy_get_progress(entropy));
+        break;
+    case PROP_FINISHED:
+        g_value_set_boolean(value, entropy->finished);
+        break;
+    default:
+        G_OBJECT_WARN_INVALID_PROPERTY_ID(object, property_id, pspec);
+        break;
+    }
+}
+
+/**
+ * Drop held references.
+ * Can be executed more than once!
+ * Should chain up before returning.
+ */
+void ghexedit_entropy_dispose(GObject *object)
+{
+    GHexEditEntropy *entropy = GHEXEDIT_ENTROPY(object);
+    // Workers hold references, so none are running by now
+    g_clear_object(&entropy->buffer);
+    g_clear_object(&entropy->cancellable);
+    G_OBJECT_CLASS(ghexedit_entropy_parent_class)->dispose(object);
+}
+
+/** Free remaining resources. */
+void ghexedit_entropy_finalize(GObject *object)
+{
+    GHexEditEntropy *entropy = GHEXEDIT_ENTROPY(object);
+    for (guint level = 0; level < entropy->n_levels; ++level)
+        g_free(entropy->levels[level]);
+    g_free(entropy->levels);
+    g_free(entropy->histograms);
+    g_free(entropy->segment_done);
+    g_clear_error(&entropy->error);
+    ghexedit_drain_clear(&entropy->drain, NULL);
+    g_mutex_clear(&entropy->lock);
+    G_OBJECT_CLASS(ghexedit_entropy_parent_class)->finalize(object);
+}
+
+
+/* ===[ Base GLib ]=== */
+/** Equivalent to C++ constructor. */
+void ghexedit_entropy_init(GHexEditEntropy *entropy)
+{
+    g_mutex_init(&entropy->lock);
+}
+
+/**
+ * Called upon first instantiation of an object of this class.
+ * Sets/overrides class methods/signals/properties.
+ */
+void ghexedit_entropy_class_init(GHexEditEntropyClass *class)
+{
+    GObjectClass *klass = G_OBJECT_CLASS(class);
+    klass->get_property = ghexedit_entropy_get_property;
+    klass->dispose = ghexedit_entropy_dispose;
+    klass->finalize = ghexedit_entropy_finalize;
+
+    properties[PROP_PROGRESS] = g_param_spec_double("progress", "Progress", "Fraction of the buffer analysed.", 0, 1, 0, G_PARAM_READABLE);
+    properties[PROP_FINISHED] = g_param_spec_boolean("finished", "Finished", "Whether analysis has stopped.", FALSE, G_PARAM_READABLE);
+    g_object_class_install_properties(klass, N_PROPERTIES, properties);
+}
@@ -0,0 +1,51 @@
+/**
+ * Entropy.h - Background byte statistics over a buffer.
+ * Copyright (C) 2022 Trevor Last
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _GHX_ENTROPY_H
+#define _GHX_ENTROPY_H
+
+#include <gio/gio.h>
+
+#include "Buffer.h"
+
+
+/** Bytes in the finest blocks of small buffers; each coarser level doubles it. */
+#define GHEXEDIT_ENTROPY_BLOCK 4096
+/** Most finest blocks; larger buffers get larger blocks instead. */
+#define GHEXEDIT_ENTROPY_MAX_BLOCKS (1u << 20)
+
+#define GHEXEDIT_TYPE_ENTROPY ghexedit_entropy_get_type()
+G_DECLARE_FINAL_TYPE(GHexEditEntropy, ghexedit_entropy, GHEXEDIT, ENTROPY, GObject);
+
+GHexEditEntropy *ghexedit_entropy_new(GHexEditBuffer *buffer);
+GHexEditEntropy *ghexedit_entropy_new_saved(GHexEditBuffer *buffer, GVariant *saved);
+void ghexedit_entropy_start(GHexEditEntropy *entropy, GCancellable *cancellable);
+void ghexedit_entropy_cancel(GHexEditEntropy *entropy);
+gboolean ghexedit_entropy_get_finished(GHexEditEntropy *entropy);
+double ghexedit_entropy_get_progress(GHexEditEntropy *entropy);
+GError const *ghexedit_entropy_get_error(GHexEditEntropy *entropy);
+guint64 ghexedit_entropy_get_block_size(GHexEditEntropy *entropy);
+guint64 ghexedit_entropy_get_size(GHexEditEntropy *entropy);
+gboolean ghexedit_entropy_lookup(GHexEditEntropy *entropy, guint64 offset, guint64 span, float *bits);
+gboolean ghexedit_entropy_get_histogram(GHexEditEntropy *entropy, guint64 counts[256]);
+GVariant *ghexedit_entropy_save(GHexEditEntropy *entropy);
+
+void ghexedit_byte_histogram(guint8 const *data, gsize length, guint32 counts[256]);
+float ghexedit_histogram_entropy(guint64 const counts[256]);
+
+#endif
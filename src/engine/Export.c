@@ -0,0 +1,484 @@
+/**
+ * Export.c - Streaming encoders for copying and exporting bytes.
+ * Copyright (C) 2022 Trevor Last
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "Export.h"
+
+#include <string.h>
+
+
+/** Bytes read from the snapshot at a time. */
+#define READ_BLOCK_SIZE (1024 * 1024)
+/** Encoded text is written out once this much has piled up. */
+#define WRITE_THRESHOLD (64 * 1024)
+/** Elements per line of a C array. */
+#define C_ARRAY_PER_LINE 12
+/** Data bytes per Intel HEX or S-record line. */
+#define RECORD_SIZE 16
+/** Both record formats carry 32-bit addresses. */
+#define RECORD_ADDRESS_LIMIT (G_GUINT64_CONSTANT(1) << 32)
+
+static char const digits[] = "0123456789ABCDEF";
+
+static char const *const format_ids[GHEXEDIT_N_EXPORT_FORMATS] = {
+    [GHEXEDIT_EXPORT_RAW] = "raw",
+    [GHEXEDIT_EXPORT_HEX] = "hex",
+    [GHEXEDIT_EXPORT_C_ARRAY] = "c",
+    [GHEXEDIT_EXPORT_BASE64] = "base64",
+    [GHEXEDIT_EXPORT_INTEL_HEX] = "ihex",
+    [GHEXEDIT_EXPORT_SREC] = "srec",
+};
+
+static char const *const format_names[GHEXEDIT_N_EXPORT_FORMATS] = {
+    [GHEXEDIT_EXPORT_RAW] = "Raw Bytes",
+    [GHEXEDIT_EXPORT_HEX] = "Hex String",
+    [GHEXEDIT_EXPORT_C_ARRAY] = "C Array",
+    [GHEXEDIT_EXPORT_BASE64] = "Base64",
+    [GHEXEDIT_EXPORT_INTEL_HEX] = "Intel HEX",
+    [GHEXEDIT_EXPORT_SREC] = "Motorola S-Record",
+};
+
+/**
+ * Encoding state carried from one block to the next. Only a partial record
+ * and a few Base64 bits outlive a block, so memory use doesn't depend on
+ * how much is written.
+ */
+typedef struct
+{
+    GHexEditExportFormat format;
+    GOutputStream *stream;
+    GCancellable *cancellable;
+    GString *out;
+    guint64 length;
+    /** Bytes encoded so far. */
+    guint64 done;
+    // Base64
+    gint base64_state;
+    gint base64_save;
+    // Intel HEX and S-records
+    guint8 record[RECORD_SIZE];
+    guint record_length;
+    guint64 record_address;
+    /** Upper address half last announced in Intel HEX. */
+    guint64 segment;
+} Writer;
+
+
+/* ===[ Formats ]=== */
+/** Short name used in action targets and settings. */
+char const *ghexedit_export_format_get_id(GHexEditExportFormat format)
+{
+    g_return_val_if_fail(format < GHEXEDIT_N_EXPORT_FORMATS, NULL);
+    return format_ids[format];
+}
+
+/** Name to show in menus. */
+char const *ghexedit_export_format_get_name(GHexEditExportFormat format)
+{
+    g_return_val_if_fail(format < GHEXEDIT_N_EXPORT_FORMATS, NULL);
+    return format_names[format];
+}
+
+/** Look up a format by its short name. */
+gboolean ghexedit_export_format_from_id(char const *id, GHexEditExportFormat *format)
+{
+    for (guint i = 0; i < GHEXEDIT_N_EXPORT_FORMATS; ++i)
+    {
+        if (g_strcmp0(id, format_ids[i]) == 0)
+        {
+            *format = i;
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+
+/* ===[ Encoding ]=== */
+static void append_hex(GString *out, guint64 value, guint n_digits)
+{
+    while (n_digits-- > 0)
+        g_string_append_c(out, digits[(value >> (4 * n_digits)) & 0xF]);
+}
+
+/** Reserve room for `n` more characters, returning where they go. */
+static char *reserve(GString *out, gsize n)
+{
+    gsize at = out->len;
+    g_string_set_size(out, at + n);
+    return out->str + at;
+}
+
+/** Give back what reserve() handed out but wasn't used. */
+static void commit(GString *out, char const *end)
+{
+    g_string_truncate(out, end - out->str);
+}
+
+static void encode_hex(Writer *writer, guint8 const *data, gsize length)
+{
+    char *p = reserve(writer->out, length * 3);
+    for (gsize i = 0; i < length; ++i)
+    {
+        if (writer->done + i > 0)
+            *p++ = ' ';
+        *p++ = digits[data[i] >> 4];
+        *p++ = digits[data[i] & 0xF];
+    }
+    commit(writer->out, p);
+}
+
+static void encode_c_array(Writer *writer, guint8 const *data, gsize length)
+{
+    // At most ",\n    0xAB" per byte
+    char *p = reserve(writer->out, length * 10);
+    for (gsize i = 0; i < length; ++i)
+    {
+        guint64 k = writer->done + i;
+        if (k > 0)
+            *p++ = ',';
+        if (k % C_ARRAY_PER_LINE == 0)
+        {
+            if (k > 0)
+                *p++ = '\n';
+            memcpy(p, "    ", 4);
+            p += 4;
+        }
+        else
+            *p++ = ' ';
+        *p++ = '0';
+        *p++ = 'x';
+        *p++ = digits[data[i] >> 4];
+        *p++ = digits[data[i] & 0xF];
+    }
+    commit(writer->out, p);
+}
+
+static void encode_base64(Writer *writer, guint8 const *data, gsize length)
+{
+    char *p = reserve(writer->out, (length / 3 + 1) * 4 + 4);
+    p += g_base64_encode_step(data, length, FALSE, p, &writer->base64_state, &writer->base64_save);
+    commit(writer->out, p);
+}
+
+/** One Intel HEX line: `:LLAAAATT<data>CC`, checksummed to zero. */
+static void intel_hex_line(GString *out, guint type, guint address, guint8 const *data, guint length)
+{
+    guint sum = length + (address >> 8) + (address & 0xFF) + type;
+    g_string_append_c(out, ':');
+    append_hex(out, length, 2);
+    append_hex(out, address, 4);
+    append_hex(out, type, 2);
+    for (guint i = 0; i < length; ++i)
+    {
+        append_hex(out, data[i], 2);
+        sum += data[i];
+    }
+    append_hex(out, -sum & 0xFF, 2);
+    g_string_append_c(out, '\n');
+}
+
+/** One S-record line: `S<type><count><address><data><checksum>`. */
+static void srec_line(GString *out, char type, guint64 address, guint address_bytes, guint8 const *data, guint length)
+{
+    guint count = address_bytes + length + 1;
+    guint sum = count;
+    g_string_append_c(out, 'S');
+    g_string_append_c(out, type);
+    append_hex(out, count, 2);
+    append_hex(out, address, address_bytes * 2);
+    for (guint i = 0; i < address_bytes; ++i)
+        sum += (address >> (8 * i)) & 0xFF;
+    for (guint i = 0; i < length; ++i)
+    {
+        append_hex(out, data[i], 2);
+        sum += data[i];
+    }
+    append_hex(out, ~sum & 0xFF, 2);
+    g_string_append_c(out, '\n');
+}
+
+/** Data bytes the pending record can hold; Intel HEX records can't cross 64 KiB. */
+static guint record_room(Writer *writer)
+{
+    if (writer->format == GHEXEDIT_EXPORT_INTEL_HEX)
+        return MIN(RECORD_SIZE, 0x10000 - (writer->record_address & 0xFFFF));
+    return RECORD_SIZE;
+}
+
+static void flush_record(Writer *writer)
+{
+    if (writer->record_length == 0)
+        return;
+    if (writer->format == GHEXEDIT_EXPORT_INTEL_HEX)
+    {
+        guint64 segment = writer->record_address >> 16;
+        if (segment != writer->segment)
+        {
+            // Extended linear address record
+            guint8 upper[2] = {segment >> 8, segment & 0xFF};
+            intel_hex_line(writer->out, 0x04, 0, upper, 2);
+            writer->segment = segment;
+        }
+        intel_hex_line(writer->out, 0x00, writer->record_address & 0xFFFF, writer->record, writer->record_length);
+    }
+    else
+        srec_line(writer->out, '3', writer->record_address, 4, writer->record, writer->record_length);
+    writer->record_address += writer->record_length;
+    writer->record_length = 0;
+}
+
+static void encode_records(Writer *writer, guint8 const *data, gsize length)
+{
+    while (length > 0)
+    {
+        guint n = MIN(length, record_room(writer) - writer->record_length);
+        memcpy(writer->record + writer->record_length, data, n);
+        writer->record_length += n;
+        data += n;
+        length -= n;
+        if (writer->record_length == record_room(writer))
+            flush_record(writer);
+    }
+}
+
+static void begin(Writer *writer)
+{
+    switch (writer->format)
+    {
+    case GHEXEDIT_EXPORT_C_ARRAY:
+        g_string_append_printf(writer->out, "unsigned char data[%" G_GUINT64_FORMAT "] = {\n", writer->length);
+        break;
+    case GHEXEDIT_EXPORT_SREC:
+        srec_line(writer->out, '0', 0, 2, NULL, 0);
+        break;
+    default:
+        break;
+    }
+}
+
+static void encode(Writer *writer, guint8 const *data, gsize length)
+{
+    switch (writer->format)
+    {
+    case GHEXEDIT_EXPORT_RAW:
+        g_string_append_len(writer->out, (char const *)data, length);
+        break;
+    case GHEXEDIT_EXPORT_HEX:
+        encode_hex(writer, data, length);
+        break;
+    case GHEXEDIT_EXPORT_C_ARRAY:
+        encode_c_array(writer, data, length);
+        break;
+    case GHEXEDIT_EXPORT_BASE64:
+        encode_base64(writer, data, length);
+        break;
+    case GHEXEDIT_EXPORT_INTEL_HEX:
+    case GHEXEDIT_EXPORT_SREC:
+        encode_records(writer, data, length);
+        break;
+    default:
+        g_return_if_reached();
+    }
+    writer->done += length;
+}
+
+static void end(Writer *writer)
+{
+    switch (writer->format)
+    {
+    case GHEXEDIT_EXPORT_C_ARRAY:
+        g_string_append(writer->out, "\n};\n");
+        break;
+    case GHEXEDIT_EXPORT_BASE64:
+    {
+        char *p = reserve(writer->out, 8);
+        p += g_base64_encode_close(FALSE, p, &writer->base64_state, &writer->base64_save);
+        commit(writer->out, p);
+        break;
+    }
+    case GHEXEDIT_EXPORT_INTEL_HEX:
+        flush_record(writer);
+        intel_hex_line(writer->out, 0x01, 0, NULL, 0);
+        break;
+    case GHEXEDIT_EXPORT_SREC:
+        flush_record(writer);
+        srec_line(writer->out, '7', 0, 4, NULL, 0);
+        break;
+    default:
+        break;
+    }
+}
+
+static gboolean flush(Writer *writer, GError **error)
+{
+    gboolean ok = g_output_stream_write_all(writer->stream, writer->out->str, writer->out->len, NULL, writer->cancellable, error);
+    g_string_truncate(writer->out, 0);
+    return ok;
+}
+
+
+/* ===[ Writing ]=== */
+/**
+ * Encode the snapshot into `stream`, a block at a time, so output of any
+ * size passes through a bounded amount of memory. Blocks; run it off the
+ * main thread. The stream is left open.
+ */
+gboolean ghexedit_export_write(GHexEditSnapshot *snapshot, GHexEditExportFormat format, GOutputStream *stream, GCancellable *cancellable, GError **error)
+{
+    g_return_val_if_fail(format < GHEXEDIT_N_EXPORT_FORMATS, FALSE);
+    guint64 offset = ghexedit_snapshot_get_offset(snapshot);
+    guint64 length = ghexedit_snapshot_get_length(snapshot);
+    if ((format == GHEXEDIT_EXPORT_INTEL_HEX || format == GHEXEDIT_EXPORT_SREC) && offset + length > RECORD_ADDRESS_LIMIT)
+    {
+        g_set_error(error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT, "%s addresses stop at 4 GiB", format_names[format]);
+        return FALSE;
+    }
+
+    Writer writer = {
+        .format = format,
+        .stream = stream,
+        .cancellable = cancellable,
+        .out = g_string_sized_new(WRITE_THRESHOLD + RECORD_SIZE * 4),
+        .length = length,
+        .record_address = offset,
+    };
+    guint8 *block = g_malloc(READ_BLOCK_SIZE);
+    gboolean ok = TRUE;
+    begin(&writer);
+    while (ok && writer.done < length)
+    {
+        gssize got = ghexedit_snapshot_read(snapshot, writer.done, block, READ_BLOCK_SIZE, error);
+        if (got < 0)
+        {
+            ok = FALSE;
+            break;
+        }
+        if (format == GHEXEDIT_EXPORT_RAW)
+        {
+            // Nothing to encode; skip the copy
+            ok = g_output_stream_write_all(stream, block, got, NULL, cancellable, error);
+            writer.done += got;
+            continue;
+        }
+        // Encoded text is up to five times the input; write it in pieces
+        for (gssize i = 0; ok && i < got; i += WRITE_THRESHOLD / 8)
+        {
+            encode(&writer, block + i, MIN(WRITE_THRESHOLD / 8, got - i));
+            if (writer.out->len >= WRITE_THRESHOLD)
+                ok = flush(&writer, error);
+        }
+    }
+    if (ok)
+    {
+        end(&writer);
+        ok = flush(&writer, error);
+    }
+    g_free(block);
+    g_string_free(writer.out, TRUE);
+    return ok;
+}
+
+/** What an export thread needs. */
+typedef struct
+{
+    GHexEditSnapshot *snapshot;
+    GHexEditExportFormat format;
+    GOutputStream *stream;
+    GFile *file;
+} ExportData;
+
+static void export_data_free(ExportData *data)
+{
+    ghexedit_snapshot_unref(data->snapshot);
+    g_clear_object(&data->stream);
+    g_clear_object(&data->file);
+    g_free(data);
+}
+
+static void export_thread(GTask *task, gpointer source_object, gpointer task_data, GCancellable *cancellable)
+{
+    ExportData *data = task_data;
+    GError *error = NULL;
+    gboolean ok;
+    if (data->file)
+    {
+        GFileOutputStream *stream = g_file_replace(data->file, NULL, FALSE, G_FILE_CREATE_REPLACE_DESTINATION, cancellable, &error);
+        ok = stream != NULL;
+        if (ok)
+        {
+            ok = ghexedit_export_write(data->snapshot, data->format, G_OUTPUT_STREAM(stream), cancellable, &error);
+            if (ok)
+                ok = g_output_stream_close(G_OUTPUT_STREAM(stream), cancellable, &error);
+            else
+            {
+                // A cancelled close leaves whatever was there before in place
+                GCancellable *abandon = g_cancellable_new();
+                g_cancellable_cancel(abandon);
+                g_output_stream_close(G_OUTPUT_STREAM(stream), abandon, NULL);
+                g_object_unref(abandon);
+            }
+            g_object_unref(stream);
+        }
+    }
+    else
+        ok = ghexedit_export_write(data->snapshot, data->format, data->stream, cancellable, &error);
+
+    if (ok)
+        g_task_return_boolean(task, TRUE);
+    else
+        g_task_return_error(task, error);
+}
+
+static void export_start(ExportData *data, int io_priority, GCancellable *cancellable, GAsyncReadyCallback callback, gpointer user_data)
+{
+    GTask *task = g_task_new(NULL, cancellable, callback, user_data);
+    g_task_set_source_tag(task, ghexedit_export_async);
+    g_task_set_priority(task, io_priority);
+    g_task_set_task_data(task, data, (GDestroyNotify)export_data_free);
+    g_task_run_in_thread(task, export_thread);
+    g_object_unref(task);
+}
+
+/** Encode the snapshot into `stream` on a worker thread. */
+void ghexedit_export_async(GHexEditSnapshot *snapshot, GHexEditExportFormat format, GOutputStream *stream, int io_priority, GCancellable *cancellable, GAsyncReadyCallback callback, gpointer user_data)
+{
+    ExportData *data = g_new0(ExportData, 1);
+    data->snapshot = ghexedit_snapshot_ref(snapshot);
+    data->format = format;
+    data->stream = g_object_ref(stream);
+    export_start(data, io_priority, cancellable, callback, user_data);
+}
+
+/**
+ * Encode the snapshot into `file` on a worker thread. The file is only
+ * replaced once everything has been written.
+ */
+void ghexedit_export_to_file_async(GHexEditSnapshot *snapshot, GHexEditExportFormat format, GFile *file, GCancellable *cancellable, GAsyncReadyCallback callback, gpointer user_data)
+{
+    ExportData *data = g_new0(ExportData, 1);
+    data->snapshot = ghexedit_snapshot_ref(snapshot);
+    data->format = format;
+    data->file = g_object_ref(file);
+    export_start(data, G_PRIORITY_DEFAULT, cancellable, callback, user_data);
+}
+
+gboolean ghexedit_export_finish(GAsyncResult *result, GError **error)
+{
+    g_return_val_if_fail(g_task_is_valid(result, NULL), FALSE);
+    return g_task_propagate_boolean(G_TASK(result), error);
+}
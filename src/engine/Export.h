@@ -0,0 +1,48 @@
+/**
+ * Export.h - Streaming encoders for copying and exporting bytes.
+ * Copyright (C) 2022 Trevor Last
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _GHX_EXPORT_H
+#define _GHX_EXPORT_H
+
+#include <gio/gio.h>
+
+#include "Buffer.h"
+
+
+/** Encodings a range of bytes can be written out in. */
+typedef enum
+{
+    GHEXEDIT_EXPORT_RAW,
+    GHEXEDIT_EXPORT_HEX,
+    GHEXEDIT_EXPORT_C_ARRAY,
+    GHEXEDIT_EXPORT_BASE64,
+    GHEXEDIT_EXPORT_INTEL_HEX,
+    GHEXEDIT_EXPORT_SREC,
+    GHEXEDIT_N_EXPORT_FORMATS,
+} GHexEditExportFormat;
+
+char const *ghexedit_export_format_get_id(GHexEditExportFormat format);
+char const *ghexedit_export_format_get_name(GHexEditExportFormat format);
+gboolean ghexedit_export_format_from_id(char const *id, GHexEditExportFormat *format);
+
+gboolean ghexedit_export_write(GHexEditSnapshot *snapshot, GHexEditExportFormat format, GOutputStream *stream, GCancellable *cancellable, GError **error);
+void ghexedit_export_async(GHexEditSnapshot *snapshot, GHexEditExportFormat format, GOutputStream *stream, int io_priority, GCancellable *cancellable, GAsyncReadyCallback callback, gpointer user_data);
+void ghexedit_export_to_file_async(GHexEditSnapshot *snapshot, GHexEditExportFormat format, GFile *file, GCancellable *cancellable, GAsyncReadyCallback callback, gpointer user_data);
+gboolean ghexedit_export_finish(GAsyncResult *result, GError **error);
+
+#endif
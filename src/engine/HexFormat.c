@@ -0,0 +1,448 @@
+/**
+ * HexFormat.c - Format bytes as rows of hex and ASCII.
+ * Copyright (C) 2022 Trevor Last
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "HexFormat.h"
+
+#include <glib.h>
+
+#include <string.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define GHX_HAVE_X86_KERNELS 1
+#include <immintrin.h>
+#endif
+
+
+static char const *const kernel_names[GHEXEDIT_N_HEX_KERNELS] = {"scalar", "sse2", "avx2"};
+
+
+/** Copy of `format` with zero sizes replaced by 1. */
+static GHexEditHexFormat normalize(GHexEditHexFormat const *format)
+{
+    GHexEditHexFormat f = *format;
+    if (f.bytes_per_line == 0)
+        f.bytes_per_line = 1;
+    if (f.grouping == 0)
+        f.grouping = 1;
+    if (f.offset_digits == 0)
+        f.offset_digits = 8;
+    return f;
+}
+
+/** Column right after the last hex pair's trailing space. */
+static gsize hex_end(GHexEditHexFormat const *f)
+{
+    return f->offset_digits + 2 + 3 * f->bytes_per_line + (f->bytes_per_line - 1) / f->grouping;
+}
+
+
+/* ===[ Scalar reference ]=== */
+static char nybble_char(guint8 nybble)
+{
+    nybble &= 0x0F;
+    if (nybble < 0xA)
+        return '0' + nybble;
+    else
+        return 'A' + (nybble - 0xA);
+}
+
+static char make_printable(char ch)
+{
+    if (g_ascii_isprint(ch))
+        return ch;
+    else
+        return '.';
+}
+
+/**
+ * Reference implementation: one byte at a time.
+ * The last row may be partial; its missing hex pairs are padded with spaces
+ * and its ASCII gutter is only as long as the bytes present.
+ */
+static gsize format_scalar(GHexEditHexFormat const *f, guint8 const *data, gsize length, guint64 base, char *out)
+{
+    guint bytes_per_line = f->bytes_per_line;
+    guint grouping = f->grouping;
+
+    gsize leftover = bytes_per_line - (length % bytes_per_line);
+    if (leftover == bytes_per_line)
+        leftover = 0;
+
+    char *ptr = out;
+    for (gsize i = 0; i < length + leftover; ++i)
+    {
+        if (i % bytes_per_line == 0)
+        {
+            for (guint n = 0; n < f->offset_digits; ++n)
+                *ptr++ = nybble_char((base + i) >> (4 * (f->offset_digits - 1 - n)));
+            *ptr++ = ' ';
+            *ptr++ = ' ';
+        }
+        else if (i % bytes_per_line % grouping == 0)
+            *ptr++ = ' ';
+
+        if (i < length)
+        {
+            *ptr++ = nybble_char((data[i] >> 4) & 0x0F);
+            *ptr++ = nybble_char(data[i] & 0x0F);
+            *ptr++ = ' ';
+        }
+        else
+        {
+            *ptr++ = ' ';
+            *ptr++ = ' ';
+            *ptr++ = ' ';
+        }
+
+        if ((i + 1) % bytes_per_line == 0)
+        {
+            gsize line_start = i + 1 - bytes_per_line;
+            *ptr++ = ' ';
+            *ptr++ = '|';
+            for (gsize b = 0; b < bytes_per_line; ++b)
+                if (line_start + b < length)
+                    *ptr++ = make_printable(data[line_start + b]);
+            *ptr++ = '|';
+            *ptr++ = '\n';
+        }
+    }
+    return ptr - out;
+}
+
+
+/* ===[ Row-at-a-time kernels ]=== */
+/**
+ * Write `n` bytes as "XX " triples starting at `dest`.
+ * Kernels may store up to TRIPLES_SPILL bytes past the last triple; callers
+ * overwrite that afterwards. `end` is the end of the input, which kernels
+ * must not load past.
+ */
+typedef void (*TriplesFunc)(guint8 const *src, gsize n, guint8 const *end, char *dest);
+/** Write `n` bytes as printable ASCII. */
+typedef void (*AsciiFunc)(guint8 const *src, gsize n, char *dest);
+
+#define TRIPLES_SPILL 48
+
+/** A group of bytes whose triples are contiguous in the output row. */
+typedef struct
+{
+    guint first;
+    guint count;
+    guint column;
+} Group;
+
+/**
+ * Format whole rows with the given kernels; any partial last row goes through
+ * the scalar path. Group positions are worked out once per call, so each row
+ * is just stores: no divisions and no per-byte branches. Always inlined into
+ * the per-kernel wrappers so the kernels are direct calls.
+ */
+static inline __attribute__((always_inline)) gsize format_rows(GHexEditHexFormat const *f, guint8 const *data, gsize length, guint64 base, char *out, TriplesFunc triples, AsciiFunc ascii)
+{
+    guint bpl = f->bytes_per_line;
+    guint digits = f->offset_digits;
+    gsize line_length = ghexedit_hex_format_line_length(f);
+    gsize ascii_bar = hex_end(f) + 1;
+    gsize full_rows = length / bpl;
+
+    guint n_groups = (bpl + f->grouping - 1) / f->grouping;
+    Group *groups = g_new(Group, n_groups);
+    for (guint g = 0; g < n_groups; ++g)
+    {
+        groups[g].first = g * f->grouping;
+        groups[g].count = MIN(f->grouping, bpl - groups[g].first);
+        groups[g].column = digits + 2 + 3 * groups[g].first + g;
+    }
+
+    // Rows too close to the end of `out` to absorb the spill go via a copy
+    char *spill_limit = out + full_rows * line_length;
+    char *scratch = g_malloc(line_length + TRIPLES_SPILL);
+
+    char *ptr = out;
+    guint64 offset = base;
+    for (gsize row = 0; row < full_rows; ++row)
+    {
+        guint8 const *src = data + row * bpl;
+        char *dest = (ptr + line_length + TRIPLES_SPILL <= spill_limit) ? ptr : scratch;
+
+        for (guint n = 0; n < digits; ++n)
+            dest[digits - 1 - n] = "0123456789ABCDEF"[(offset >> (4 * n)) & 0xF];
+        dest[digits] = ' ';
+        for (guint g = 0; g < n_groups; ++g)
+        {
+            // Separator goes in after the previous group's spill
+            dest[groups[g].column - 1] = ' ';
+            triples(src + groups[g].first, groups[g].count, data + length, dest + groups[g].column);
+        }
+        dest[ascii_bar - 1] = ' ';
+        dest[ascii_bar] = '|';
+        ascii(src, bpl, dest + ascii_bar + 1);
+        dest[line_length - 2] = '|';
+        dest[line_length - 1] = '\n';
+
+        if (dest != ptr)
+            memcpy(ptr, dest, line_length);
+        ptr += line_length;
+        offset += bpl;
+    }
+
+    g_free(scratch);
+    g_free(groups);
+
+    gsize done = full_rows * bpl;
+    if (done < length)
+        ptr += format_scalar(f, data + done, length - done, base + done, ptr);
+    return ptr - out;
+}
+
+#ifdef GHX_HAVE_X86_KERNELS
+/** Map nybbles (0-15 per byte) to uppercase hex characters. */
+__attribute__((target("sse2")))
+static inline __m128i hex_chars_sse2(__m128i nybbles)
+{
+    __m128i letters = _mm_and_si128(_mm_cmpgt_epi8(nybbles, _mm_set1_epi8(9)), _mm_set1_epi8('A' - '0' - 10));
+    return _mm_add_epi8(_mm_add_epi8(nybbles, _mm_set1_epi8('0')), letters);
+}
+
+/** Map bytes to themselves if printable ASCII, otherwise '.'. */
+__attribute__((target("sse2")))
+static inline __m128i printable_sse2(__m128i v)
+{
+    __m128i printable = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8(0x1F)), _mm_cmplt_epi8(v, _mm_set1_epi8(0x7F)));
+    return _mm_or_si128(_mm_and_si128(printable, v), _mm_andnot_si128(printable, _mm_set1_epi8('.')));
+}
+
+/** Load 16 bytes, going through a zeroed copy if that would pass `end`. */
+__attribute__((target("sse2")))
+static inline __m128i load_16(guint8 const *src, guint8 const *end)
+{
+    if (end - src >= 16)
+        return _mm_loadu_si128((__m128i const *)src);
+    guint8 block[16] = {0};
+    memcpy(block, src, end - src);
+    return _mm_loadu_si128((__m128i const *)block);
+}
+
+__attribute__((target("sse2")))
+static inline void triples_sse2(guint8 const *src, gsize n, guint8 const *end, char *dest)
+{
+    __m128i const low_nybble = _mm_set1_epi8(0x0F);
+    for (gsize k = 0; k < n; k += 16, dest += 48)
+    {
+        __m128i v = load_16(src + k, end);
+        __m128i hi = hex_chars_sse2(_mm_and_si128(_mm_srli_epi16(v, 4), low_nybble));
+        __m128i lo = hex_chars_sse2(_mm_and_si128(v, low_nybble));
+        guint16 pairs[16];
+        _mm_storeu_si128((__m128i *)pairs, _mm_unpacklo_epi8(hi, lo));
+        _mm_storeu_si128((__m128i *)(pairs + 8), _mm_unpackhi_epi8(hi, lo));
+        gsize m = MIN(16, n - k);
+        for (gsize i = 0; i < m; ++i)
+        {
+            memcpy(dest + 3 * i, &pairs[i], 2);
+            dest[3 * i + 2] = ' ';
+        }
+    }
+}
+
+__attribute__((target("sse2")))
+static inline void ascii_sse2(guint8 const *src, gsize n, char *dest)
+{
+    gsize b = 0;
+    for (; b + 16 <= n; b += 16)
+        _mm_storeu_si128((__m128i *)(dest + b), printable_sse2(_mm_loadu_si128((__m128i const *)(src + b))));
+    for (; b < n; ++b)
+        dest[b] = make_printable(src[b]);
+}
+
+__attribute__((target("avx2")))
+static inline void triples_avx2(guint8 const *src, gsize n, guint8 const *end, char *dest)
+{
+    // Shuffles spreading 16 high/low nybble characters over 48 bytes of triples
+    __m128i const low_nybble = _mm_set1_epi8(0x0F);
+    __m128i const hi_mask[3] = {
+        _mm_setr_epi8(0, -1, -1, 1, -1, -1, 2, -1, -1, 3, -1, -1, 4, -1, -1, 5),
+        _mm_setr_epi8(-1, -1, 6, -1, -1, 7, -1, -1, 8, -1, -1, 9, -1, -1, 10, -1),
+        _mm_setr_epi8(-1, 11, -1, -1, 12, -1, -1, 13, -1, -1, 14, -1, -1, 15, -1, -1),
+    };
+    __m128i const lo_mask[3] = {
+        _mm_setr_epi8(-1, 0, -1, -1, 1, -1, -1, 2, -1, -1, 3, -1, -1, 4, -1, -1),
+        _mm_setr_epi8(5, -1, -1, 6, -1, -1, 7, -1, -1, 8, -1, -1, 9, -1, -1, 10),
+        _mm_setr_epi8(-1, -1, 11, -1, -1, 12, -1, -1, 13, -1, -1, 14, -1, -1, 15, -1),
+    };
+    __m128i const spaces[3] = {
+        _mm_setr_epi8(0, 0, ' ', 0, 0, ' ', 0, 0, ' ', 0, 0, ' ', 0, 0, ' ', 0),
+        _mm_setr_epi8(0, ' ', 0, 0, ' ', 0, 0, ' ', 0, 0, ' ', 0, 0, ' ', 0, 0),
+        _mm_setr_epi8(' ', 0, 0, ' ', 0, 0, ' ', 0, 0, ' ', 0, 0, ' ', 0, 0, ' '),
+    };
+
+    for (gsize k = 0; k < n; k += 16, dest += 48)
+    {
+        __m128i v = load_16(src + k, end);
+        __m128i hi = hex_chars_sse2(_mm_and_si128(_mm_srli_epi16(v, 4), low_nybble));
+        __m128i lo = hex_chars_sse2(_mm_and_si128(v, low_nybble));
+        // Only as many stores as the triples need
+        int stores = (3 * MIN(16, n - k) + 15) / 16;
+        for (int j = 0; j < stores; ++j)
+        {
+            __m128i t = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(hi, hi_mask[j]), _mm_shuffle_epi8(lo, lo_mask[j])), spaces[j]);
+            _mm_storeu_si128((__m128i *)(dest + 16 * j), t);
+        }
+    }
+}
+
+__attribute__((target("avx2")))
+static inline void ascii_avx2(guint8 const *src, gsize n, char *dest)
+{
+    __m256i const low = _mm256_set1_epi8(0x1F);
+    __m256i const high = _mm256_set1_epi8(0x7F);
+    __m256i const dot = _mm256_set1_epi8('.');
+    gsize b = 0;
+    for (; b + 32 <= n; b += 32)
+    {
+        __m256i v = _mm256_loadu_si256((__m256i const *)(src + b));
+        __m256i printable = _mm256_and_si256(_mm256_cmpgt_epi8(v, low), _mm256_cmpgt_epi8(high, v));
+        _mm256_storeu_si256((__m256i *)(dest + b), _mm256_blendv_epi8(dot, v, printable));
+    }
+    for (; b + 16 <= n; b += 16)
+        _mm_storeu_si128((__m128i *)(dest + b), printable_sse2(_mm_loadu_si128((__m128i const *)(src + b))));
+    for (; b < n; ++b)
+        dest[b] = make_printable(src[b]);
+}
+
+/* Kernel instantiations of format_rows. */
+__attribute__((target("sse2")))
+static gsize format_rows_sse2(GHexEditHexFormat const *f, guint8 const *data, gsize length, guint64 base, char *out)
+{
+    return format_rows(f, data, length, base, out, triples_sse2, ascii_sse2);
+}
+
+__attribute__((target("avx2")))
+static gsize format_rows_avx2(GHexEditHexFormat const *f, guint8 const *data, gsize length, guint64 base, char *out)
+{
+    return format_rows(f, data, length, base, out, triples_avx2, ascii_avx2);
+}
+#endif
+
+
+/* ===[ Kernel selection ]=== */
+/** Whether the running CPU can use a kernel. */
+gboolean ghexedit_hex_kernel_is_supported(GHexEditHexKernel kernel)
+{
+    switch (kernel)
+    {
+    case GHEXEDIT_HEX_KERNEL_SCALAR:
+        return TRUE;
+#ifdef GHX_HAVE_X86_KERNELS
+    case GHEXEDIT_HEX_KERNEL_SSE2:
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("sse2");
+    case GHEXEDIT_HEX_KERNEL_AVX2:
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2");
+#endif
+    default:
+        return FALSE;
+    }
+}
+
+/** Short name of a kernel, as accepted by GHEXEDIT_HEX_KERNEL. */
+char const *ghexedit_hex_kernel_get_name(GHexEditHexKernel kernel)
+{
+    g_return_val_if_fail(kernel < GHEXEDIT_N_HEX_KERNELS, NULL);
+    return kernel_names[kernel];
+}
+
+/**
+ * The fastest supported kernel, picked once per process.
+ * The GHEXEDIT_HEX_KERNEL environment variable can force a specific one.
+ */
+GHexEditHexKernel ghexedit_hex_kernel_get_default(void)
+{
+    static gsize chosen = 0;
+    if (g_once_init_enter(&chosen))
+    {
+        GHexEditHexKernel best = GHEXEDIT_HEX_KERNEL_SCALAR;
+        for (GHexEditHexKernel k = GHEXEDIT_HEX_KERNEL_SCALAR; k < GHEXEDIT_N_HEX_KERNELS; ++k)
+            if (ghexedit_hex_kernel_is_supported(k))
+                best = k;
+
+        char const *forced = g_getenv("GHEXEDIT_HEX_KERNEL");
+        for (GHexEditHexKernel k = GHEXEDIT_HEX_KERNEL_SCALAR; forced && k < GHEXEDIT_N_HEX_KERNELS; ++k)
+            if (g_str_equal(forced, kernel_names[k]) && ghexedit_hex_kernel_is_supported(k))
+                best = k;
+
+        // Stored off by one since g_once_init_leave can't take 0
+        g_once_init_leave(&chosen, best + 1);
+    }
+    return chosen - 1;
+}
+
+
+/* ===[ GHexEditHexFormat ]=== */
+/** Offset digits needed to label every byte of a `size`-byte document. */
+guint ghexedit_hex_format_offset_digits(guint64 size)
+{
+    guint64 last = size ? size - 1 : 0;
+    guint digits = 8;
+    while (digits < 16 && (last >> (4 * digits)) != 0)
+        ++digits;
+    return digits;
+}
+
+/** Length of a full row, including the newline. */
+gsize ghexedit_hex_format_line_length(GHexEditHexFormat const *format)
+{
+    GHexEditHexFormat f = normalize(format);
+    return hex_end(&f) + 2 + f.bytes_per_line + 2;
+}
+
+/** Output buffer size needed to format `length` bytes. */
+gsize ghexedit_hex_format_max_length(GHexEditHexFormat const *format, gsize length)
+{
+    GHexEditHexFormat f = normalize(format);
+    gsize rows = (length + f.bytes_per_line - 1) / f.bytes_per_line;
+    return rows * ghexedit_hex_format_line_length(&f);
+}
+
+/**
+ * Format `length` bytes with a specific kernel.
+ * Offsets are printed relative to `base`. `out` must hold at least
+ * ghexedit_hex_format_max_length bytes. Returns the number of bytes written;
+ * the output is not NUL-terminated.
+ */
+gsize ghexedit_hex_format_with(GHexEditHexKernel kernel, GHexEditHexFormat const *format, guint8 const *data, gsize length, guint64 base, char *out)
+{
+    GHexEditHexFormat f = normalize(format);
+    switch (kernel)
+    {
+#ifdef GHX_HAVE_X86_KERNELS
+    case GHEXEDIT_HEX_KERNEL_SSE2:
+        return format_rows_sse2(&f, data, length, base, out);
+    case GHEXEDIT_HEX_KERNEL_AVX2:
+        return format_rows_avx2(&f, data, length, base, out);
+#endif
+    default:
+        return format_scalar(&f, data, length, base, out);
+    }
+}
+
+/** Format `length` bytes with the default kernel. */
+gsize ghexedit_hex_format(GHexEditHexFormat const *format, guint8 const *data, gsize length, guint64 base, char *out)
+{
+    return ghexedit_hex_format_with(ghexedit_hex_kernel_get_default(), format, data, length, base, out);
+}
@@ -0,0 +1,57 @@
+/**
+ * HexFormat.h - Format bytes as rows of hex and ASCII.
+ * Copyright (C) 2022 Trevor Last
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _GHX_HEXFORMAT_H
+#define _GHX_HEXFORMAT_H
+
+#include <glib.h>
+
+
+/**
+ * Row layout.
+ * A row is `offset_digits` hex digits of offset, two spaces, each byte as a
+ * hex pair and a space (with an extra space before every `grouping` bytes),
+ * then the bytes as ASCII between bars: ` |...|\n`.
+ */
+typedef struct
+{
+    guint bytes_per_line;
+    guint grouping;
+    guint offset_digits;
+} GHexEditHexFormat;
+
+/** Formatting implementations. */
+typedef enum
+{
+    GHEXEDIT_HEX_KERNEL_SCALAR,
+    GHEXEDIT_HEX_KERNEL_SSE2,
+    GHEXEDIT_HEX_KERNEL_AVX2,
+    GHEXEDIT_N_HEX_KERNELS,
+} GHexEditHexKernel;
+
+guint ghexedit_hex_format_offset_digits(guint64 size);
+gsize ghexedit_hex_format_line_length(GHexEditHexFormat const *format);
+gsize ghexedit_hex_format_max_length(GHexEditHexFormat const *format, gsize length);
+gsize ghexedit_hex_format(GHexEditHexFormat const *format, guint8 const *data, gsize length, guint64 base, char *out);
+gsize ghexedit_hex_format_with(GHexEditHexKernel kernel, GHexEditHexFormat const *format, guint8 const *data, gsize length, guint64 base, char *out);
+
+GHexEditHexKernel ghexedit_hex_kernel_get_default(void);
+gboolean ghexedit_hex_kernel_is_supported(GHexEditHexKernel kernel);
+char const *ghexedit_hex_kernel_get_name(GHexEditHexKernel kernel);
+
+#endif
@@ -0,0 +1,211 @@
+/**
+ * Inspect.c - Decoding bytes as typed values.
+ * Copyright (C) 2022 Trevor Last
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "Inspect.h"
+
+#include <glib.h>
+
+#include <string.h>
+
+
+/** Seconds from 1601-01-01 (FILETIME's epoch) to 1970-01-01. */
+#define FILETIME_UNIX_OFFSET G_GINT64_CONSTANT(11644473600)
+/** A 64-bit LEB128 value takes at most this many bytes. */
+#define LEB128_MAX_BYTES 10
+
+static char const *const kind_names[GHEXEDIT_N_INSPECT_KINDS] = {
+    "Binary",
+    "Int8",
+    "UInt8",
+    "Int16",
+    "UInt16",
+    "Int32",
+    "UInt32",
+    "Int64",
+    "UInt64",
+    "Float",
+    "Double",
+    "ULEB128",
+    "SLEB128",
+    "UTF-8",
+    "Unix time (32-bit)",
+    "Unix time (64-bit)",
+    "FILETIME",
+    "GUID",
+};
+
+/** Bytes each fixed-size type needs; 0 for variable-length ones. */
+static guint const kind_sizes[GHEXEDIT_N_INSPECT_KINDS] = {
+    1, 1, 1, 2, 2, 4, 4, 8, 8, 4, 8, 0, 0, 0, 4, 8, 8, 16,
+};
+
+
+/* ===[ Decoding ]=== */
+/** Unsigned integer of `size` bytes. */
+static guint64 load(guint8 const *data, guint size, gboolean big_endian)
+{
+    guint64 value = 0;
+    for (guint i = 0; i < size; ++i)
+        value = value << 8 | data[big_endian ? i : size - 1 - i];
+    return value;
+}
+
+/**
+ * Decode a LEB128 number of at most LEB128_MAX_BYTES, setting how many bytes
+ * it took. FALSE if it runs past `length`.
+ */
+static gboolean load_leb128(guint8 const *data, gsize length, gboolean is_signed, guint64 *value, guint *used)
+{
+    guint64 result = 0;
+    guint shift = 0;
+    for (gsize i = 0; i < MIN(length, LEB128_MAX_BYTES); ++i)
+    {
+        if (shift < 64)
+            result |= (guint64)(data[i] & 0x7f) << shift;
+        shift += 7;
+        if (!(data[i] & 0x80))
+        {
+            // Sign-extend from the last group's top bit
+            if (is_signed && shift < 64 && (data[i] & 0x40))
+                result |= ~G_GUINT64_CONSTANT(0) << shift;
+            *value = result;
+            *used = i + 1;
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+/** A UTC date from a Unix time, or a note if GDateTime can't hold it. */
+static char *format_time(gint64 seconds, gint64 microseconds)
+{
+    GDateTime *time = g_date_time_new_from_unix_utc(seconds);
+    if (time && microseconds)
+    {
+        GDateTime *exact = g_date_time_add(time, microseconds);
+        g_date_time_unref(time);
+        time = exact;
+    }
+    if (time == NULL)
+        return g_strdup("Out of range");
+    char *text = g_date_time_format(time, microseconds ? "%Y-%m-%d %H:%M:%S.%f UTC" : "%Y-%m-%d %H:%M:%S UTC");
+    g_date_time_unref(time);
+    return text;
+}
+
+/**
+ * A GUID in registry form. Little-endian reads the first three fields
+ * swapped, as Windows stores them; big-endian reads RFC 4122 byte order.
+ */
+static char *format_guid(guint8 const *data, gboolean big_endian)
+{
+    return g_strdup_printf("{%08x-%04x-%04x-%02x%02x-%02x%02x%02x%02x%02x%02x}",
+        (guint)load(data, 4, big_endian), (guint)load(data + 4, 2, big_endian), (guint)load(data + 6, 2, big_endian),
+        data[8], data[9], data[10], data[11], data[12], data[13], data[14], data[15]);
+}
+
+
+/* ===[ Inspect ]=== */
+/** Display name of a type. */
+char const *ghexedit_inspect_kind_get_name(GHexEditInspectKind kind)
+{
+    g_return_val_if_fail(kind < GHEXEDIT_N_INSPECT_KINDS, NULL);
+    return kind_names[kind];
+}
+
+/**
+ * Decode the value of type `kind` at the start of `data`. Multi-byte types
+ * read `big_endian` or little-endian order. Returns a new string, or NULL if
+ * `length` bytes aren't enough.
+ */
+char *ghexedit_inspect_format(GHexEditInspectKind kind, guint8 const *data, gsize length, gboolean big_endian)
+{
+    g_return_val_if_fail(kind < GHEXEDIT_N_INSPECT_KINDS, NULL);
+    if (length < MAX(kind_sizes[kind], 1))
+        return NULL;
+    guint64 value = kind_sizes[kind] ? load(data, MIN(kind_sizes[kind], 8), big_endian) : 0;
+    char number[G_ASCII_DTOSTR_BUF_SIZE];
+    guint used;
+
+    switch (kind)
+    {
+    case GHEXEDIT_INSPECT_BINARY:
+    {
+        char bits[9];
+        for (int i = 0; i < 8; ++i)
+            bits[i] = data[0] & (0x80 >> i) ? '1' : '0';
+        bits[8] = '\0';
+        return g_strdup(bits);
+    }
+    case GHEXEDIT_INSPECT_INT8:
+        return g_strdup_printf("%d", (gint8)value);
+    case GHEXEDIT_INSPECT_INT16:
+        return g_strdup_printf("%d", (gint16)value);
+    case GHEXEDIT_INSPECT_INT32:
+        return g_strdup_printf("%" G_GINT32_FORMAT, (gint32)value);
+    case GHEXEDIT_INSPECT_INT64:
+        return g_strdup_printf("%" G_GINT64_FORMAT, (gint64)value);
+    case GHEXEDIT_INSPECT_UINT8:
+    case GHEXEDIT_INSPECT_UINT16:
+    case GHEXEDIT_INSPECT_UINT32:
+    case GHEXEDIT_INSPECT_UINT64:
+        return g_strdup_printf("%" G_GUINT64_FORMAT, value);
+    case GHEXEDIT_INSPECT_FLOAT32:
+    {
+        guint32 bits = value;
+        float f;
+        memcpy(&f, &bits, sizeof(f));
+        return g_strdup(g_ascii_formatd(number, sizeof(number), "%.9g", f));
+    }
+    case GHEXEDIT_INSPECT_FLOAT64:
+    {
+        double d;
+        memcpy(&d, &value, sizeof(d));
+        return g_strdup(g_ascii_dtostr(number, sizeof(number), d));
+    }
+    case GHEXEDIT_INSPECT_ULEB128:
+        if (!load_leb128(data, length, FALSE, &value, &used))
+            return NULL;
+        return g_strdup_printf("%" G_GUINT64_FORMAT " (%u bytes)", value, used);
+    case GHEXEDIT_INSPECT_SLEB128:
+        if (!load_leb128(data, length, TRUE, &value, &used))
+            return NULL;
+        return g_strdup_printf("%" G_GINT64_FORMAT " (%u bytes)", (gint64)value, used);
+    case GHEXEDIT_INSPECT_UTF8:
+    {
+        gunichar c = g_utf8_get_char_validated((char const *)data, length);
+        if (c == (gunichar)-1 || c == (gunichar)-2)
+            return g_strdup("Invalid");
+        if (!g_unichar_isprint(c))
+            return g_strdup_printf("U+%04X", c);
+        char utf8[7] = {0};
+        g_unichar_to_utf8(c, utf8);
+        return g_strdup_printf("U+%04X %s", c, utf8);
+    }
+    case GHEXEDIT_INSPECT_UNIX_TIME32:
+        return format_time((gint32)value, 0);
+    case GHEXEDIT_INSPECT_UNIX_TIME64:
+        return format_time((gint64)value, 0);
+    case GHEXEDIT_INSPECT_FILETIME:
+        return format_time((gint64)(value / 10000000) - FILETIME_UNIX_OFFSET, value % 10000000 / 10);
+    case GHEXEDIT_INSPECT_GUID:
+        return format_guid(data, big_endian);
+    default:
+        g_return_val_if_reached(NULL);
+    }
+}
@@ -0,0 +1,55 @@
+/**
+ * Inspect.h - Decoding bytes as typed values.
+ * Copyright (C) 2022 Trevor Last
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _GHX_INSPECT_H
+#define _GHX_INSPECT_H
+
+#include <glib.h>
+
+
+/** Most bytes any type decodes; reading this many at an offset is enough for all. */
+#define GHEXEDIT_INSPECT_MAX_BYTES 16
+
+/** Types bytes can be decoded as. */
+typedef enum
+{
+    GHEXEDIT_INSPECT_BINARY,
+    GHEXEDIT_INSPECT_INT8,
+    GHEXEDIT_INSPECT_UINT8,
+    GHEXEDIT_INSPECT_INT16,
+    GHEXEDIT_INSPECT_UINT16,
+    GHEXEDIT_INSPECT_INT32,
+    GHEXEDIT_INSPECT_UINT32,
+    GHEXEDIT_INSPECT_INT64,
+    GHEXEDIT_INSPECT_UINT64,
+    GHEXEDIT_INSPECT_FLOAT32,
+    GHEXEDIT_INSPECT_FLOAT64,
+    GHEXEDIT_INSPECT_ULEB128,
+    GHEXEDIT_INSPECT_SLEB128,
+    GHEXEDIT_INSPECT_UTF8,
+    GHEXEDIT_INSPECT_UNIX_TIME32,
+    GHEXEDIT_INSPECT_UNIX_TIME64,
+    GHEXEDIT_INSPECT_FILETIME,
+    GHEXEDIT_INSPECT_GUID,
+    GHEXEDIT_N_INSPECT_KINDS,
+} GHexEditInspectKind;
+
+char const *ghexedit_inspect_kind_get_name(GHexEditInspectKind kind);
+char *ghexedit_inspect_format(GHexEditInspectKind kind, guint8 const *data, gsize length, gboolean big_endian);
+
+#endif
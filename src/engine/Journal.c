@@ -0,0 +1,651 @@
+/**
+ * Journal.c - Bounded-memory undo/redo history for a piece table.
+ * Copyright (C) 2022 Trevor Last
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#define _GNU_SOURCE
+
+#include "Journal.h"
+
+#include <glib/gstdio.h>
+
+#include <errno.h>
+#include <unistd.h>
+
+
+/** Added bytes are read back from the spill file in blocks of this size. */
+#define SPILL_BLOCK_SIZE (1024 * 1024)
+
+/**
+ * One edit: at `offset`, the pieces in `removed` were replaced by those in
+ * `inserted`. Stepping over the edit only needs the bytes of one side: those
+ * `removed` while it can be undone, those `inserted` once it has been. Added
+ * bytes on that side are held in the add buffer for the record and count
+ * towards its memory; original pieces cost a few words however many bytes
+ * they cover. The other side is only trusted for its length.
+ */
+typedef struct
+{
+    guint64 serial;
+    guint64 offset;
+    GArray *removed;
+    GArray *inserted;
+    /** Still accepting keystrokes that continue it. */
+    gboolean open;
+} Record;
+
+/** A copy of original bytes that saving in place overwrote. */
+typedef struct
+{
+    guint64 start;
+    guint64 length;
+    guint64 add_start;
+} Displaced;
+
+/** Where a spilled record starts in the spill file. */
+typedef struct
+{
+    guint64 position;
+    guint64 serial;
+} SpillEntry;
+
+/**
+ * Undo records are queued oldest first. When their memory passes the limit
+ * the oldest are written to an unlinked temp file, along with the added bytes
+ * they hold, used as a stack beneath the in-memory queue, and read back as
+ * undo reaches them.
+ */
+struct _GHexEditJournal
+{
+    GHexEditAddBuffer *add;
+    GQueue undo;
+    GQueue redo;
+    guint64 memory;
+    guint64 limit;
+    guint64 next_serial;
+    int spill_fd;
+    GArray *spill_index;
+    guint64 spill_end;
+    /** Sorted and disjoint. Held for good, and not counted towards the limit. */
+    GArray *displaced;
+};
+
+
+static guint64 pieces_length(GArray *pieces)
+{
+    guint64 length = 0;
+    for (guint i = 0; i < pieces->len; ++i)
+        length += g_array_index(pieces, GHexEditPiece, i).length;
+    return length;
+}
+
+static GArray *pieces_new(guint reserve)
+{
+    return g_array_sized_new(FALSE, FALSE, sizeof(GHexEditPiece), reserve);
+}
+
+/** Append `src` minus its first `skip` bytes to `dest`, fusing contiguous pieces. */
+static void pieces_append(GArray *dest, GArray *src, guint64 skip)
+{
+    for (guint i = 0; i < src->len; ++i)
+    {
+        GHexEditPiece piece = g_array_index(src, GHexEditPiece, i);
+        guint64 cut = MIN(skip, piece.length);
+        piece.start += cut;
+        piece.length -= cut;
+        skip -= cut;
+        if (piece.length == 0)
+            continue;
+        GHexEditPiece *last = dest->len ? &g_array_index(dest, GHexEditPiece, dest->len - 1) : NULL;
+        if (last && last->source == piece.source && last->start + last->length == piece.start)
+            last->length += piece.length;
+        else
+            g_array_append_val(dest, piece);
+    }
+}
+
+/** Bytes of `pieces` that live in the add buffer. */
+static guint64 added_length(GArray *pieces)
+{
+    guint64 length = 0;
+    for (guint i = 0; i < pieces->len; ++i)
+        if (g_array_index(pieces, GHexEditPiece, i).source == GHEXEDIT_PIECE_ADD)
+            length += g_array_index(pieces, GHexEditPiece, i).length;
+    return length;
+}
+
+/** Let go of the added bytes among the first `length` bytes of `pieces`. */
+static void release_pieces(GHexEditJournal *journal, GArray *pieces, guint64 length)
+{
+    for (guint i = 0; i < pieces->len && length > 0; ++i)
+    {
+        GHexEditPiece const *piece = &g_array_index(pieces, GHexEditPiece, i);
+        guint64 n = MIN(length, piece->length);
+        if (piece->source == GHEXEDIT_PIECE_ADD)
+            ghexedit_add_buffer_release(journal->add, piece->start, n);
+        length -= n;
+    }
+}
+
+/** The side of a record whose bytes history holds; see Record. */
+static GArray *held_side(Record *record, gboolean undone)
+{
+    return undone ? record->inserted : record->removed;
+}
+
+static guint64 record_memory(Record *record, gboolean undone)
+{
+    return sizeof(Record) + (record->removed->len + record->inserted->len) * sizeof(GHexEditPiece)
+        + added_length(held_side(record, undone));
+}
+
+static void record_free(Record *record)
+{
+    g_array_unref(record->removed);
+    g_array_unref(record->inserted);
+    g_free(record);
+}
+
+/** Index of the first displaced range ending after `start`. */
+static guint find_displaced(GHexEditJournal *journal, guint64 start)
+{
+    guint lo = 0, hi = journal->displaced->len;
+    while (lo < hi)
+    {
+        guint mid = lo + (hi - lo) / 2;
+        Displaced const *displaced = &g_array_index(journal->displaced, Displaced, mid);
+        if (displaced->start + displaced->length <= start)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+/**
+ * Point the parts of original pieces that saving in place overwrote at the
+ * copies kept of them, holding the copies once more for the table.
+ */
+static GArray *resolve(GHexEditJournal *journal, GArray *pieces)
+{
+    if (journal->displaced->len == 0)
+        return g_array_ref(pieces);
+
+    GArray *resolved = pieces_new(pieces->len);
+    for (guint i = 0; i < pieces->len; ++i)
+    {
+        GHexEditPiece piece = g_array_index(pieces, GHexEditPiece, i);
+        guint d = find_displaced(journal, piece.start);
+        while (piece.source == GHEXEDIT_PIECE_ORIGINAL && piece.length > 0 && d < journal->displaced->len)
+        {
+            Displaced const *displaced = &g_array_index(journal->displaced, Displaced, d);
+            if (displaced->start >= piece.start + piece.length)
+                break;
+            if (displaced->start > piece.start)
+            {
+                GHexEditPiece before = {GHEXEDIT_PIECE_ORIGINAL, piece.start, displaced->start - piece.start};
+                g_array_append_val(resolved, before);
+                piece.start += before.length;
+                piece.length -= before.length;
+            }
+            guint64 within = piece.start - displaced->start;
+            GHexEditPiece copy = {GHEXEDIT_PIECE_ADD, displaced->add_start + within, MIN(piece.length, displaced->length - within)};
+            ghexedit_add_buffer_hold(journal->add, copy.start, copy.length);
+            g_array_append_val(resolved, copy);
+            piece.start += copy.length;
+            piece.length -= copy.length;
+            ++d;
+        }
+        if (piece.length > 0)
+            g_array_append_val(resolved, piece);
+    }
+    return resolved;
+}
+
+/**
+ * Put `pieces` at `offset` in place of the bytes `*current` describes, then
+ * make `*current` the pieces actually taken out. Those can differ from the
+ * recorded ones, which may point at added bytes since spilled and read back
+ * elsewhere.
+ */
+static void apply(GHexEditJournal *journal, GHexEditPieceTable *table, guint64 offset, GArray **current, GArray *pieces)
+{
+    GArray *taken = pieces_new((*current)->len);
+    ghexedit_piece_table_remove(table, offset, pieces_length(*current), taken);
+    GArray *resolved = resolve(journal, pieces);
+    ghexedit_piece_table_insert(table, offset, (GHexEditPiece const *)resolved->data, resolved->len);
+    g_array_unref(resolved);
+    g_array_unref(*current);
+    *current = taken;
+}
+
+
+/* ===[ Spill file ]=== */
+static gboolean write_all(int fd, void const *data, gsize length, guint64 offset)
+{
+    guint8 const *p = data;
+    while (length > 0)
+    {
+        ssize_t n = pwrite(fd, p, length, offset);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return FALSE;
+        p += n;
+        length -= n;
+        offset += n;
+    }
+    return TRUE;
+}
+
+static gboolean read_all(int fd, void *data, gsize length, guint64 offset)
+{
+    guint8 *p = data;
+    while (length > 0)
+    {
+        ssize_t n = pread(fd, p, length, offset);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return FALSE;
+        p += n;
+        length -= n;
+        offset += n;
+    }
+    return TRUE;
+}
+
+typedef struct
+{
+    int fd;
+    guint64 position;
+} SpillWriter;
+
+static gboolean spill_run(guint8 const *data, gsize length, gpointer user_data)
+{
+    SpillWriter *writer = user_data;
+    if (!write_all(writer->fd, data, length, writer->position))
+        return FALSE;
+    writer->position += length;
+    return TRUE;
+}
+
+/** Forget everything on disk. */
+static void spill_discard(GHexEditJournal *journal)
+{
+    g_array_set_size(journal->spill_index, 0);
+    journal->spill_end = 0;
+    if (journal->spill_fd >= 0 && ftruncate(journal->spill_fd, 0) != 0)
+        g_warning("Failed to truncate undo history: %s", g_strerror(errno));
+}
+
+/**
+ * Push a record onto the spill file: a header, both sides' pieces, then the
+ * added bytes of its removed pieces in order.
+ */
+static gboolean spill_push(GHexEditJournal *journal, Record *record)
+{
+    if (journal->spill_fd < 0)
+    {
+        char *path = NULL;
+        journal->spill_fd = g_file_open_tmp("ghexedit-journal-XXXXXX", &path, NULL);
+        if (journal->spill_fd < 0)
+            return FALSE;
+        // Nobody else needs to see it; the space goes away with the descriptor
+        g_unlink(path);
+        g_free(path);
+    }
+
+    guint64 header[4] = {record->serial, record->offset, record->removed->len, record->inserted->len};
+    guint64 position = journal->spill_end;
+    gsize removed_size = record->removed->len * sizeof(GHexEditPiece);
+    gsize inserted_size = record->inserted->len * sizeof(GHexEditPiece);
+    if (!write_all(journal->spill_fd, header, sizeof(header), position)
+        || !write_all(journal->spill_fd, record->removed->data, removed_size, position + sizeof(header))
+        || !write_all(journal->spill_fd, record->inserted->data, inserted_size, position + sizeof(header) + removed_size))
+        return FALSE;
+    SpillWriter writer = {journal->spill_fd, position + sizeof(header) + removed_size + inserted_size};
+    for (guint i = 0; i < record->removed->len; ++i)
+    {
+        GHexEditPiece const *piece = &g_array_index(record->removed, GHexEditPiece, i);
+        if (piece->source == GHEXEDIT_PIECE_ADD && !ghexedit_add_buffer_foreach_run(journal->add, piece->start, piece->length, spill_run, &writer))
+            return FALSE;
+    }
+
+    SpillEntry entry = {position, record->serial};
+    g_array_append_val(journal->spill_index, entry);
+    journal->spill_end = writer.position;
+    return TRUE;
+}
+
+/**
+ * Append a spilled record's added bytes, stored from `position` on, back to
+ * the add buffer and point its removed pieces at them. On failure nothing
+ * stays held.
+ */
+static gboolean spill_restore(GHexEditJournal *journal, Record *record, guint64 position)
+{
+    guint8 *block = g_malloc(SPILL_BLOCK_SIZE);
+    guint64 restored = 0;
+    gboolean ok = TRUE;
+    for (guint i = 0; ok && i < record->removed->len; ++i)
+    {
+        GHexEditPiece *piece = &g_array_index(record->removed, GHexEditPiece, i);
+        guint64 start = 0;
+        for (guint64 done = 0; ok && done < piece->length && piece->source == GHEXEDIT_PIECE_ADD; done += SPILL_BLOCK_SIZE)
+        {
+            gsize n = MIN(piece->length - done, SPILL_BLOCK_SIZE);
+            ok = read_all(journal->spill_fd, block, n, position);
+            if (!ok)
+            {
+                if (done > 0)
+                    ghexedit_add_buffer_release(journal->add, start, done);
+                break;
+            }
+            // Nothing else appends meanwhile, so the blocks are contiguous
+            guint64 at = ghexedit_add_buffer_append(journal->add, block, n);
+            if (done == 0)
+                start = at;
+            position += n;
+        }
+        if (!ok)
+            break;
+        if (piece->source == GHEXEDIT_PIECE_ADD)
+            piece->start = start;
+        restored += piece->length;
+    }
+    g_free(block);
+    if (!ok)
+        release_pieces(journal, record->removed, restored);
+    return ok;
+}
+
+/** Pop the newest record off the spill file, or NULL if there is none. */
+static Record *spill_pop(GHexEditJournal *journal)
+{
+    if (journal->spill_index->len == 0)
+        return NULL;
+    SpillEntry entry = g_array_index(journal->spill_index, SpillEntry, journal->spill_index->len - 1);
+
+    guint64 header[4];
+    Record *record = NULL;
+    if (read_all(journal->spill_fd, header, sizeof(header), entry.position))
+    {
+        record = g_new0(Record, 1);
+        record->serial = header[0];
+        record->offset = header[1];
+        record->removed = pieces_new(header[2]);
+        record->inserted = pieces_new(header[3]);
+        g_array_set_size(record->removed, header[2]);
+        g_array_set_size(record->inserted, header[3]);
+        gsize removed_size = header[2] * sizeof(GHexEditPiece);
+        gsize inserted_size = header[3] * sizeof(GHexEditPiece);
+        if (!read_all(journal->spill_fd, record->removed->data, removed_size, entry.position + sizeof(header))
+            || !read_all(journal->spill_fd, record->inserted->data, inserted_size, entry.position + sizeof(header) + removed_size)
+            || !spill_restore(journal, record, entry.position + sizeof(header) + removed_size + inserted_size))
+            g_clear_pointer(&record, record_free);
+    }
+    if (record == NULL)
+    {
+        g_warning("Failed to read back undo history: %s", g_strerror(errno));
+        spill_discard(journal);
+        return NULL;
+    }
+
+    g_array_set_size(journal->spill_index, journal->spill_index->len - 1);
+    journal->spill_end = entry.position;
+    return record;
+}
+
+/** Move the oldest undo records to disk until memory is back under the limit. */
+static void enforce_limit(GHexEditJournal *journal)
+{
+    // The newest record stays in memory so typing can keep coalescing into it
+    while (journal->memory > journal->limit && journal->undo.length > 1)
+    {
+        Record *record = g_queue_pop_head(&journal->undo);
+        journal->memory -= record_memory(record, FALSE);
+        if (!spill_push(journal, record))
+        {
+            // Older history can't be reached past a lost record
+            g_warning("Failed to save undo history; dropping the oldest edits");
+            spill_discard(journal);
+        }
+        // Its added bytes are on disk now, or gone with it
+        release_pieces(journal, record->removed, G_MAXUINT64);
+        record_free(record);
+    }
+}
+
+static void clear_redo(GHexEditJournal *journal)
+{
+    Record *record;
+    while ((record = g_queue_pop_head(&journal->redo)))
+    {
+        journal->memory -= record_memory(record, TRUE);
+        release_pieces(journal, record->inserted, G_MAXUINT64);
+        record_free(record);
+    }
+}
+
+
+/* ===[ GHexEditJournal ]=== */
+/**
+ * History for edits whose added bytes live in `add`, which must outlive the
+ * journal. The journal holds the added bytes only history needs, and lets
+ * go of them as records are spilled or dropped.
+ */
+GHexEditJournal *ghexedit_journal_new(GHexEditAddBuffer *add)
+{
+    GHexEditJournal *journal = g_new0(GHexEditJournal, 1);
+    journal->add = add;
+    g_queue_init(&journal->undo);
+    g_queue_init(&journal->redo);
+    journal->limit = GHEXEDIT_JOURNAL_DEFAULT_LIMIT;
+    journal->spill_fd = -1;
+    journal->spill_index = g_array_new(FALSE, FALSE, sizeof(SpillEntry));
+    journal->displaced = g_array_new(FALSE, FALSE, sizeof(Displaced));
+    return journal;
+}
+
+void ghexedit_journal_free(GHexEditJournal *journal)
+{
+    if (journal == NULL)
+        return;
+    clear_redo(journal);
+    Record *record;
+    while ((record = g_queue_pop_head(&journal->undo)))
+    {
+        release_pieces(journal, record->removed, G_MAXUINT64);
+        record_free(record);
+    }
+    for (guint i = 0; i < journal->displaced->len; ++i)
+    {
+        Displaced const *displaced = &g_array_index(journal->displaced, Displaced, i);
+        ghexedit_add_buffer_release(journal->add, displaced->add_start, displaced->length);
+    }
+    g_array_unref(journal->displaced);
+    g_array_unref(journal->spill_index);
+    if (journal->spill_fd >= 0)
+        g_close(journal->spill_fd, NULL);
+    g_free(journal);
+}
+
+/**
+ * Cap the memory held by history, counting both its records and the added
+ * bytes only they still need; older records beyond it go to disk.
+ */
+void ghexedit_journal_set_limit(GHexEditJournal *journal, guint64 limit)
+{
+    journal->limit = limit;
+    enforce_limit(journal);
+}
+
+guint64 ghexedit_journal_get_limit(GHexEditJournal *journal)
+{
+    return journal->limit;
+}
+
+/**
+ * Identifies the current point in history: equal states mean equal content.
+ * 0 is the state before any edit.
+ */
+guint64 ghexedit_journal_get_state(GHexEditJournal *journal)
+{
+    Record *top = g_queue_peek_tail(&journal->undo);
+    if (top)
+        return top->serial;
+    if (journal->spill_index->len)
+        return g_array_index(journal->spill_index, SpillEntry, journal->spill_index->len - 1).serial;
+    return 0;
+}
+
+gboolean ghexedit_journal_can_undo(GHexEditJournal *journal)
+{
+    return journal->undo.length > 0 || journal->spill_index->len > 0;
+}
+
+gboolean ghexedit_journal_can_redo(GHexEditJournal *journal)
+{
+    return journal->redo.length > 0;
+}
+
+/**
+ * Record an edit already applied to `table`: the pieces in `removed` (taken
+ * over by the journal) were replaced by `added` bytes at `offset`.
+ * A single typed byte landing inside or right after the previous typed run is
+ * folded into that run's record.
+ */
+void ghexedit_journal_record(GHexEditJournal *journal, GHexEditPieceTable *table, guint64 offset, GArray *removed, guint64 added)
+{
+    clear_redo(journal);
+
+    guint64 removed_length = pieces_length(removed);
+    gboolean typing = added == 1 && removed_length <= 1;
+    Record *top = g_queue_peek_tail(&journal->undo);
+    if (typing && top && top->open)
+    {
+        guint64 end = top->offset + pieces_length(top->inserted);
+        if (offset >= top->offset && offset <= end)
+        {
+            // What was removed from inside the run was the run's own bytes
+            guint64 own = MIN(removed_length, end - offset);
+            guint64 new_end = offset + added + (end > offset + removed_length ? end - offset - removed_length : 0);
+            journal->memory -= record_memory(top, FALSE);
+            // Nothing needs the run's own overwritten keystrokes
+            release_pieces(journal, removed, own);
+            pieces_append(top->removed, removed, own);
+            g_array_set_size(top->inserted, 0);
+            ghexedit_piece_table_get_pieces(table, top->offset, new_end - top->offset, top->inserted);
+            journal->memory += record_memory(top, FALSE);
+            g_array_unref(removed);
+            enforce_limit(journal);
+            return;
+        }
+    }
+    ghexedit_journal_seal(journal);
+
+    Record *record = g_new0(Record, 1);
+    record->serial = ++journal->next_serial;
+    record->offset = offset;
+    record->removed = removed;
+    record->inserted = pieces_new(1);
+    ghexedit_piece_table_get_pieces(table, offset, added, record->inserted);
+    record->open = typing;
+    g_queue_push_tail(&journal->undo, record);
+    journal->memory += record_memory(record, FALSE);
+    enforce_limit(journal);
+}
+
+/**
+ * Keep `data`, a copy of the `length` original bytes at `start`, for history
+ * to use once saving in place overwrites them. Bytes already kept aren't the
+ * originals any more, so the earlier copy stays.
+ */
+void ghexedit_journal_displace(GHexEditJournal *journal, guint64 start, guint8 const *data, gsize length)
+{
+    guint64 end = start + length;
+    guint i = find_displaced(journal, start);
+    while (start < end)
+    {
+        Displaced const *next = i < journal->displaced->len ? &g_array_index(journal->displaced, Displaced, i) : NULL;
+        if (next && next->start <= start)
+        {
+            guint64 skip = MIN(end, next->start + next->length) - start;
+            start += skip;
+            data += skip;
+            ++i;
+            continue;
+        }
+        guint64 stop = next ? MIN(end, next->start) : end;
+        Displaced fresh = {start, stop - start, ghexedit_add_buffer_append(journal->add, data, stop - start)};
+        g_array_insert_val(journal->displaced, i, fresh);
+        start = stop;
+        data += fresh.length;
+        ++i;
+    }
+}
+
+/** Stop the newest record from absorbing further keystrokes. */
+void ghexedit_journal_seal(GHexEditJournal *journal)
+{
+    Record *top = g_queue_peek_tail(&journal->undo);
+    if (top)
+        top->open = FALSE;
+}
+
+/**
+ * Revert the newest edit in `table`.
+ * On success the change made is reported as `removed` bytes replaced by
+ * `added` bytes at `offset`.
+ */
+gboolean ghexedit_journal_undo(GHexEditJournal *journal, GHexEditPieceTable *table, guint64 *offset, guint64 *removed, guint64 *added)
+{
+    Record *record = g_queue_pop_tail(&journal->undo);
+    if (record)
+        journal->memory -= record_memory(record, FALSE);
+    else if (!(record = spill_pop(journal)))
+        return FALSE;
+
+    record->open = FALSE;
+    *offset = record->offset;
+    *removed = pieces_length(record->inserted);
+    *added = pieces_length(record->removed);
+    apply(journal, table, record->offset, &record->inserted, record->removed);
+
+    g_queue_push_head(&journal->redo, record);
+    journal->memory += record_memory(record, TRUE);
+    return TRUE;
+}
+
+/** Reapply the most recently undone edit; reports the change like undo. */
+gboolean ghexedit_journal_redo(GHexEditJournal *journal, GHexEditPieceTable *table, guint64 *offset, guint64 *removed, guint64 *added)
+{
+    Record *record = g_queue_pop_head(&journal->redo);
+    if (record == NULL)
+        return FALSE;
+    journal->memory -= record_memory(record, TRUE);
+
+    *offset = record->offset;
+    *removed = pieces_length(record->removed);
+    *added = pieces_length(record->inserted);
+    apply(journal, table, record->offset, &record->removed, record->inserted);
+
+    g_queue_push_tail(&journal->undo, record);
+    journal->memory += record_memory(record, FALSE);
+    enforce_limit(journal);
+    return TRUE;
+}
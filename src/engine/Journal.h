@@ -0,0 +1,46 @@
+/**
+ * Journal.h - Bounded-memory undo/redo history for a piece table.
+ * Copyright (C) 2022 Trevor Last
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _GHX_JOURNAL_H
+#define _GHX_JOURNAL_H
+
+#include <glib.h>
+
+#include "AddBuffer.h"
+#include "PieceTable.h"
+
+
+/** Default cap on in-memory history, in bytes. */
+#define GHEXEDIT_JOURNAL_DEFAULT_LIMIT (64 * 1024 * 1024)
+
+typedef struct _GHexEditJournal GHexEditJournal;
+
+GHexEditJournal *ghexedit_journal_new(GHexEditAddBuffer *add);
+void ghexedit_journal_free(GHexEditJournal *journal);
+void ghexedit_journal_set_limit(GHexEditJournal *journal, guint64 limit);
+guint64 ghexedit_journal_get_limit(GHexEditJournal *journal);
+guint64 ghexedit_journal_get_state(GHexEditJournal *journal);
+gboolean ghexedit_journal_can_undo(GHexEditJournal *journal);
+gboolean ghexedit_journal_can_redo(GHexEditJournal *journal);
+void ghexedit_journal_record(GHexEditJournal *journal, GHexEditPieceTable *table, guint64 offset, GArray *removed, guint64 added);
+void ghexedit_journal_displace(GHexEditJournal *journal, guint64 start, guint8 const *data, gsize length);
+void ghexedit_journal_seal(GHexEditJournal *journal);
+gboolean ghexedit_journal_undo(GHexEditJournal *journal, GHexEditPieceTable *table, guint64 *offset, guint64 *removed, guint64 *added);
+gboolean ghexedit_journal_redo(GHexEditJournal *journal, GHexEditPieceTable *table, guint64 *offset, guint64 *removed, guint64 *added);
+
+#endif
@@ -0,0 +1,491 @@
+/**
+ * PageCache.c - Shared LRU cache of pages read from sources.
+ * Copyright (C) 2022 Trevor Last
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#define _GNU_SOURCE
+
+#include "PageCache.h"
+#include "Trace.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+
+/** Threads reading ahead; more overlap the latency of network reads. */
+#define PREFETCH_THREADS 2
+/** Pages waiting to be read ahead; older requests are dropped past this. */
+#define PREFETCH_QUEUE_LENGTH 64
+
+/** One page of a source, with any bytes in it that couldn't be read. */
+typedef struct
+{
+    GHexEditSource *source;
+    guint64 index;
+    guint8 *data;
+    /** Bytes held; short only for the source's last page. */
+    gsize length;
+    /** Unreadable ranges in the page, as source offsets; NULL if none. */
+    GHexEditRangeSet *unreadable;
+    /** Position in the LRU queue. */
+    GList link;
+} Page;
+
+/** A page to be read ahead, queued or being read. */
+typedef struct
+{
+    GHexEditSource *source;
+    guint64 index;
+} Prefetch;
+
+/**
+ * Pages of every source share one budget, so many open devices can't add
+ * up to more memory than one. Lookups and copies happen under the lock,
+ * but reads don't: two threads missing the same page may both read it,
+ * and the second copy is dropped. A read missing a page that's being read
+ * ahead waits for it instead, which matters where each read is a network
+ * round trip.
+ */
+struct _GHexEditPageCache
+{
+    GMutex lock;
+    /** Page -> itself, keyed by source and index. */
+    GHashTable *pages;
+    /** Most recently used first. */
+    GQueue lru;
+    guint64 budget;
+    guint64 used;
+    /** Prefetches not started yet, oldest first; at most PREFETCH_QUEUE_LENGTH. */
+    GQueue queued;
+    /** Prefetches being read; forgetting a source waits for its own. */
+    GPtrArray *loading;
+    /** Signalled whenever a prefetch finishes. */
+    GCond loaded;
+    /** Created on the first prefetch. Each task takes the oldest queued page. */
+    GThreadPool *workers;
+    guint64 hits;
+    guint64 misses;
+    guint64 prefetched;
+};
+
+
+static guint page_hash(gconstpointer key)
+{
+    Page const *page = key;
+    return g_direct_hash(page->source) ^ (guint)(page->index * 2654435761u) ^ (guint)(page->index >> 32);
+}
+
+static gboolean page_equal(gconstpointer a, gconstpointer b)
+{
+    Page const *pa = a, *pb = b;
+    return pa->source == pb->source && pa->index == pb->index;
+}
+
+static void page_free(Page *page)
+{
+    free(page->data);
+    if (page->unreadable)
+        ghexedit_range_set_free(page->unreadable);
+    g_free(page);
+}
+
+/** Read a page from its source, without the lock. */
+static Page *page_load(GHexEditSource *source, guint64 index, GError **error)
+{
+    // Direct I/O needs aligned buffers; posix_memalign wants at least a pointer's alignment
+    void *data = NULL;
+    if (posix_memalign(&data, MAX(source->alignment, sizeof(void *)), GHEXEDIT_PAGE_SIZE) != 0)
+    {
+        g_set_error(error, G_IO_ERROR, G_IO_ERROR_FAILED, "Out of memory for a page");
+        return NULL;
+    }
+    GHexEditRangeSet *unreadable = ghexedit_range_set_new();
+    GHEXEDIT_TRACE_BEGIN(page_read);
+    gssize got = source->klass->read(source, index * GHEXEDIT_PAGE_SIZE, data, GHEXEDIT_PAGE_SIZE, unreadable, error);
+    GHEXEDIT_TRACE_END(page_read, "page %" G_GUINT64_FORMAT, index);
+    if (got < 0)
+    {
+        free(data);
+        ghexedit_range_set_free(unreadable);
+        return NULL;
+    }
+    if (ghexedit_range_set_get_n_ranges(unreadable) == 0)
+        g_clear_pointer(&unreadable, ghexedit_range_set_free);
+
+    Page *page = g_new0(Page, 1);
+    page->source = source;
+    page->index = index;
+    page->data = data;
+    page->length = got;
+    page->unreadable = unreadable;
+    page->link.data = page;
+    return page;
+}
+
+/** Drop least recently used pages until within budget, sparing the newest. */
+static void evict(GHexEditPageCache *cache)
+{
+    while (cache->used > cache->budget && cache->lru.length > 1)
+    {
+        Page *page = g_queue_peek_tail(&cache->lru);
+        g_queue_unlink(&cache->lru, &page->link);
+        g_hash_table_remove(cache->pages, page);
+        cache->used -= GHEXEDIT_PAGE_SIZE;
+        page_free(page);
+    }
+}
+
+/** Whether a prefetch of the page is queued or running. Called with the lock held. */
+static gboolean prefetching(GHexEditPageCache *cache, GHexEditSource *source, guint64 index, gboolean queued)
+{
+    for (guint i = 0; i < cache->loading->len; ++i)
+    {
+        Prefetch *prefetch = g_ptr_array_index(cache->loading, i);
+        if (prefetch->source == source && prefetch->index == index)
+            return TRUE;
+    }
+    if (!queued)
+        return FALSE;
+    for (GList *link = cache->queued.head; link; link = link->next)
+    {
+        Prefetch *prefetch = link->data;
+        if (prefetch->source == source && prefetch->index == index)
+            return TRUE;
+    }
+    return FALSE;
+}
+
+/** Find a page and mark it used. Called with the lock held. */
+static Page *lookup(GHexEditPageCache *cache, GHexEditSource *source, guint64 index)
+{
+    Page key = {.source = source, .index = index};
+    Page *page = g_hash_table_lookup(cache->pages, &key);
+    if (page)
+    {
+        g_queue_unlink(&cache->lru, &page->link);
+        g_queue_push_head_link(&cache->lru, &page->link);
+    }
+    return page;
+}
+
+/**
+ * Add a freshly read page, or drop it if another thread got there first.
+ * Returns the cached page. Called with the lock held.
+ */
+static Page *insert(GHexEditPageCache *cache, Page *loaded)
+{
+    Page *page = lookup(cache, loaded->source, loaded->index);
+    if (page)
+    {
+        page_free(loaded);
+        return page;
+    }
+    g_hash_table_add(cache->pages, loaded);
+    g_queue_push_head_link(&cache->lru, &loaded->link);
+    cache->used += GHEXEDIT_PAGE_SIZE;
+    evict(cache);
+    return loaded;
+}
+
+/** Worker task: read the oldest queued page, unless it's cached by now. */
+static void prefetch_next(gpointer data, gpointer user_data)
+{
+    GHexEditPageCache *cache = user_data;
+    g_mutex_lock(&cache->lock);
+    // Tasks can outnumber queued pages when old ones were dropped
+    Prefetch *prefetch = g_queue_pop_head(&cache->queued);
+    if (prefetch == NULL)
+    {
+        g_mutex_unlock(&cache->lock);
+        return;
+    }
+    Page key = {.source = prefetch->source, .index = prefetch->index};
+    if (g_hash_table_contains(cache->pages, &key))
+    {
+        g_mutex_unlock(&cache->lock);
+        g_free(prefetch);
+        return;
+    }
+    g_ptr_array_add(cache->loading, prefetch);
+    g_mutex_unlock(&cache->lock);
+
+    // Failures are left for a real read to retry and report
+    Page *loaded = page_load(prefetch->source, prefetch->index, NULL);
+
+    g_mutex_lock(&cache->lock);
+    if (loaded)
+    {
+        // Rank it below the pages actually read, so guessing can't evict them first
+        Page *page = insert(cache, loaded);
+        if (page == loaded && cache->lru.length > 1)
+        {
+            g_queue_unlink(&cache->lru, &page->link);
+            g_queue_push_nth_link(&cache->lru, cache->lru.length / 2, &page->link);
+        }
+        ++cache->prefetched;
+    }
+    g_ptr_array_remove_fast(cache->loading, prefetch);
+    g_cond_broadcast(&cache->loaded);
+    g_mutex_unlock(&cache->lock);
+    g_free(prefetch);
+}
+
+
+/* ===[ GHexEditPageCache ]=== */
+/** The cache every document shares. */
+GHexEditPageCache *ghexedit_page_cache_get_default(void)
+{
+    static GHexEditPageCache *cache = NULL;
+    if (g_once_init_enter(&cache))
+        g_once_init_leave(&cache, ghexedit_page_cache_new(GHEXEDIT_PAGE_CACHE_DEFAULT_BUDGET));
+    return cache;
+}
+
+/** Create a cache holding up to `budget` bytes of pages. */
+GHexEditPageCache *ghexedit_page_cache_new(guint64 budget)
+{
+    GHexEditPageCache *cache = g_new0(GHexEditPageCache, 1);
+    g_mutex_init(&cache->lock);
+    cache->pages = g_hash_table_new(page_hash, page_equal);
+    g_queue_init(&cache->lru);
+    cache->budget = budget;
+    g_queue_init(&cache->queued);
+    cache->loading = g_ptr_array_new();
+    g_cond_init(&cache->loaded);
+    cache->workers = NULL;
+    return cache;
+}
+
+void ghexedit_page_cache_free(GHexEditPageCache *cache)
+{
+    if (cache == NULL)
+        return;
+    // Drop what's queued and let running reads finish
+    if (cache->workers)
+        g_thread_pool_free(cache->workers, TRUE, TRUE);
+    g_queue_free_full(&cache->queued, g_free);
+    g_ptr_array_unref(cache->loading);
+    g_cond_clear(&cache->loaded);
+    Page *page;
+    while ((page = g_queue_peek_head(&cache->lru)))
+    {
+        g_queue_unlink(&cache->lru, &page->link);
+        page_free(page);
+    }
+    g_hash_table_unref(cache->pages);
+    g_mutex_clear(&cache->lock);
+    g_free(cache);
+}
+
+/** Change how much memory the cache may use, evicting at once if it shrank. */
+void ghexedit_page_cache_set_budget(GHexEditPageCache *cache, guint64 budget)
+{
+    g_mutex_lock(&cache->lock);
+    cache->budget = budget;
+    evict(cache);
+    g_mutex_unlock(&cache->lock);
+}
+
+guint64 ghexedit_page_cache_get_budget(GHexEditPageCache *cache)
+{
+    return cache->budget;
+}
+
+/**
+ * Copy up to `length` bytes at `offset` of `source` into `dest`, reading
+ * only the pages not already cached. Unreadable bytes come back as zeroes.
+ * Returns the number copied, short only at the end, or -1 on error.
+ */
+gssize ghexedit_page_cache_read(GHexEditPageCache *cache, GHexEditSource *source, guint64 offset, guint8 *dest, gsize length, GError **error)
+{
+    length = offset < source->size ? MIN(length, source->size - offset) : 0;
+    gsize done = 0;
+    while (done < length)
+    {
+        guint64 index = (offset + done) / GHEXEDIT_PAGE_SIZE;
+        gsize within = (offset + done) % GHEXEDIT_PAGE_SIZE;
+
+        g_mutex_lock(&cache->lock);
+        Page *page = lookup(cache, source, index);
+        if (page)
+            ++cache->hits;
+        else
+            ++cache->misses;
+        // Rather than read it twice, wait for a prefetch of it to finish
+        while (page == NULL && prefetching(cache, source, index, FALSE))
+        {
+            g_cond_wait(&cache->loaded, &cache->lock);
+            page = lookup(cache, source, index);
+        }
+        if (page == NULL)
+        {
+            g_mutex_unlock(&cache->lock);
+            Page *loaded = page_load(source, index, error);
+            if (loaded == NULL)
+                return -1;
+            g_mutex_lock(&cache->lock);
+            page = insert(cache, loaded);
+        }
+        gsize n = page->length > within ? MIN(length - done, page->length - within) : 0;
+        memcpy(dest + done, page->data + within, n);
+        g_mutex_unlock(&cache->lock);
+
+        // The source ended early; it may have shrunk since it was opened
+        if (n == 0)
+            break;
+        done += n;
+    }
+    return done;
+}
+
+static gboolean collect_range(guint64 start, guint64 end, gpointer user_data)
+{
+    ghexedit_range_set_add(user_data, start, end);
+    return TRUE;
+}
+
+/**
+ * Add the bytes within `length` at `offset` known to be unreadable to
+ * `unreadable`: those found so in cached pages, and those the source knows
+ * of without reading. Ranges spanning more pages than are cached visit the
+ * cache instead, so a whole process's address space costs no more than a
+ * screenful.
+ */
+void ghexedit_page_cache_get_unreadable(GHexEditPageCache *cache, GHexEditSource *source, guint64 offset, guint64 length, GHexEditRangeSet *unreadable)
+{
+    guint64 end = offset + length;
+    guint64 first = offset / GHEXEDIT_PAGE_SIZE;
+    guint64 last = (end + GHEXEDIT_PAGE_SIZE - 1) / GHEXEDIT_PAGE_SIZE;
+    g_mutex_lock(&cache->lock);
+    if (last - first > g_hash_table_size(cache->pages))
+    {
+        for (GList *link = cache->lru.head; link; link = link->next)
+        {
+            Page *page = link->data;
+            if (page->source == source && page->unreadable && page->index >= first && page->index < last)
+                ghexedit_range_set_foreach(page->unreadable, offset, end, collect_range, unreadable);
+        }
+    }
+    else
+    {
+        for (guint64 index = first; index < last; ++index)
+        {
+            Page key = {.source = source, .index = index};
+            Page *page = g_hash_table_lookup(cache->pages, &key);
+            if (page && page->unreadable)
+                ghexedit_range_set_foreach(page->unreadable, offset, end, collect_range, unreadable);
+        }
+    }
+    g_mutex_unlock(&cache->lock);
+    ghexedit_source_get_unreadable(source, offset, length, unreadable);
+}
+
+typedef struct
+{
+    GHexEditPageCache *cache;
+    GHexEditSource *source;
+} ForgetClosure;
+
+static gboolean forget_page(gpointer key, gpointer value, gpointer user_data)
+{
+    Page *page = value;
+    ForgetClosure *forget = user_data;
+    if (page->source != forget->source)
+        return FALSE;
+    g_queue_unlink(&forget->cache->lru, &page->link);
+    forget->cache->used -= GHEXEDIT_PAGE_SIZE;
+    page_free(page);
+    return TRUE;
+}
+
+/**
+ * Start reading the pages covering `length` bytes at `offset` of `source`
+ * on worker threads, in order, and return at once. Pages
+ * cached or already on their way are skipped. If prefetches pile up
+ * faster than they're read, the oldest are dropped: a view scrolling
+ * quickly only wants where it's heading.
+ */
+void ghexedit_page_cache_prefetch(GHexEditPageCache *cache, GHexEditSource *source, guint64 offset, guint64 length)
+{
+    length = offset < source->size ? MIN(length, source->size - offset) : 0;
+    if (length == 0)
+        return;
+    guint64 first = offset / GHEXEDIT_PAGE_SIZE;
+    guint64 last = (offset + length - 1) / GHEXEDIT_PAGE_SIZE;
+    g_mutex_lock(&cache->lock);
+    if (cache->workers == NULL)
+        cache->workers = g_thread_pool_new(prefetch_next, cache, PREFETCH_THREADS, FALSE, NULL);
+    for (guint64 index = first; index <= last && index - first < PREFETCH_QUEUE_LENGTH; ++index)
+    {
+        Page key = {.source = source, .index = index};
+        if (g_hash_table_contains(cache->pages, &key) || prefetching(cache, source, index, TRUE))
+            continue;
+        if (cache->queued.length >= PREFETCH_QUEUE_LENGTH)
+            g_free(g_queue_pop_head(&cache->queued));
+        Prefetch *prefetch = g_new(Prefetch, 1);
+        prefetch->source = source;
+        prefetch->index = index;
+        g_queue_push_tail(&cache->queued, prefetch);
+        // The task's data is unused, but the pool refuses NULL
+        g_thread_pool_push(cache->workers, cache, NULL);
+    }
+    g_mutex_unlock(&cache->lock);
+}
+
+/** Fill in how well the cache is doing, for display. */
+void ghexedit_page_cache_get_stats(GHexEditPageCache *cache, GHexEditPageCacheStats *stats)
+{
+    g_mutex_lock(&cache->lock);
+    stats->hits = cache->hits;
+    stats->misses = cache->misses;
+    stats->prefetched = cache->prefetched;
+    stats->used = cache->used;
+    stats->budget = cache->budget;
+    g_mutex_unlock(&cache->lock);
+}
+
+/**
+ * Drop every page of `source`; call before freeing it. Waits for any of
+ * its pages being read ahead, since those reads use it.
+ */
+void ghexedit_page_cache_forget(GHexEditPageCache *cache, GHexEditSource *source)
+{
+    ForgetClosure forget = {cache, source};
+    g_mutex_lock(&cache->lock);
+    for (GList *link = cache->queued.head, *next; link; link = next)
+    {
+        next = link->next;
+        Prefetch *prefetch = link->data;
+        if (prefetch->source == source)
+        {
+            g_queue_delete_link(&cache->queued, link);
+            g_free(prefetch);
+        }
+    }
+    for (guint i = 0; i < cache->loading->len;)
+    {
+        Prefetch *prefetch = g_ptr_array_index(cache->loading, i);
+        if (prefetch->source != source)
+        {
+            ++i;
+            continue;
+        }
+        g_cond_wait(&cache->loaded, &cache->lock);
+        i = 0;
+    }
+    g_hash_table_foreach_remove(cache->pages, forget_page, &forget);
+    g_mutex_unlock(&cache->lock);
+}
@@ -0,0 +1,60 @@
+/**
+ * PageCache.h - Shared LRU cache of pages read from sources.
+ * Copyright (C) 2022 Trevor Last
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _GHX_PAGECACHE_H
+#define _GHX_PAGECACHE_H
+
+#include <glib.h>
+
+#include "RangeSet.h"
+#include "Source.h"
+
+
+/** Bytes per cached page; sources are read in page-aligned units of this. */
+#define GHEXEDIT_PAGE_SIZE (64 * 1024)
+/** Memory the shared cache may hold until told otherwise. */
+#define GHEXEDIT_PAGE_CACHE_DEFAULT_BUDGET (64 * 1024 * 1024)
+
+typedef struct _GHexEditPageCache GHexEditPageCache;
+
+/** Counters since the cache was created. */
+typedef struct
+{
+    /** Page lookups by reads that found the page cached. */
+    guint64 hits;
+    /** Lookups that had to wait for the page to be read. */
+    guint64 misses;
+    /** Pages read ahead of being asked for. */
+    guint64 prefetched;
+    /** Bytes of pages held, and the most allowed. */
+    guint64 used;
+    guint64 budget;
+} GHexEditPageCacheStats;
+
+GHexEditPageCache *ghexedit_page_cache_get_default(void);
+GHexEditPageCache *ghexedit_page_cache_new(guint64 budget);
+void ghexedit_page_cache_free(GHexEditPageCache *cache);
+void ghexedit_page_cache_set_budget(GHexEditPageCache *cache, guint64 budget);
+guint64 ghexedit_page_cache_get_budget(GHexEditPageCache *cache);
+gssize ghexedit_page_cache_read(GHexEditPageCache *cache, GHexEditSource *source, guint64 offset, guint8 *dest, gsize length, GError **error);
+void ghexedit_page_cache_prefetch(GHexEditPageCache *cache, GHexEditSource *source, guint64 offset, guint64 length);
+void ghexedit_page_cache_get_stats(GHexEditPageCache *cache, GHexEditPageCacheStats *stats);
+void ghexedit_page_cache_get_unreadable(GHexEditPageCache *cache, GHexEditSource *source, guint64 offset, guint64 length, GHexEditRangeSet *unreadable);
+void ghexedit_page_cache_forget(GHexEditPageCache *cache, GHexEditSource *source);
+
+#endif
@@ -0,0 +1,343 @@
+/**
+ * Pattern.c - Compiled search patterns.
+ * Copyright (C) 2022 Trevor Last
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#define _GNU_SOURCE
+
+#include "Pattern.h"
+
+#include <gio/gio.h>
+
+#include <string.h>
+
+
+/**
+ * Longest regex match guaranteed to be found whole. Chunked scans read this
+ * far into the next chunk; matches straddling the end of that are cut short.
+ */
+#define REGEX_REACH 4096
+
+/**
+ * A byte pattern where byte i matches c when (c & mask[i]) == value[i].
+ * Exact bytes have a mask of 0xff, `??` a mask of 0 and `?` one nybble.
+ * Regex patterns leave these unused and match with `regex` instead.
+ */
+struct _GHexEditPattern
+{
+    GRegex *regex;
+    guint8 *value;
+    guint8 *mask;
+    gsize length;
+    /** Longest run of exact bytes; located with memmem, then the rest verified. */
+    gsize anchor_start;
+    gsize anchor_length;
+    /** Horspool shifts, for patterns without any exact byte. */
+    gsize shift[256];
+};
+
+
+/** Fill in the search strategy once the bytes and masks are known. */
+static GHexEditPattern *compile(GHexEditPattern *pattern)
+{
+    for (gsize i = 0; i < pattern->length;)
+    {
+        gsize run = 0;
+        while (i + run < pattern->length && pattern->mask[i + run] == 0xff)
+            ++run;
+        if (run > pattern->anchor_length)
+        {
+            pattern->anchor_start = i;
+            pattern->anchor_length = run;
+        }
+        i += MAX(run, 1);
+    }
+
+    // Horspool over masks: a byte may shift the window so far as the last
+    // pattern position (bar the final one) it could match
+    gsize m = pattern->length;
+    for (guint c = 0; c < 256; ++c)
+        pattern->shift[c] = m;
+    for (gsize j = 0; j + 1 < m; ++j)
+        for (guint c = 0; c < 256; ++c)
+            if ((c & pattern->mask[j]) == pattern->value[j])
+                pattern->shift[c] = m - 1 - j;
+    return pattern;
+}
+
+static gboolean matches_at(GHexEditPattern *pattern, guint8 const *p)
+{
+    for (gsize i = 0; i < pattern->length; ++i)
+        if ((p[i] & pattern->mask[i]) != pattern->value[i])
+            return FALSE;
+    return TRUE;
+}
+
+static gboolean add_match(GArray *matches, guint64 offset, gsize length, guint max_matches)
+{
+    GHexEditMatch match = {offset, length};
+    g_array_append_val(matches, match);
+    return matches->len < max_matches;
+}
+
+/** Take ownership of parallel value and mask arrays. */
+static GHexEditPattern *from_arrays(GByteArray *value, GByteArray *mask)
+{
+    GHexEditPattern *pattern = g_new0(GHexEditPattern, 1);
+    pattern->length = value->len;
+    pattern->value = g_byte_array_free(value, FALSE);
+    pattern->mask = g_byte_array_free(mask, FALSE);
+    return compile(pattern);
+}
+
+/** Append one code unit's byte, ignoring case of ASCII letters if asked. */
+static void append_unit_byte(GByteArray *value, GByteArray *mask, guint8 byte, gboolean letter, gboolean match_case)
+{
+    // Upper and lower case ASCII differ only in bit 5
+    guint8 m = letter && !match_case ? 0xdf : 0xff;
+    guint8 v = byte & m;
+    g_byte_array_append(value, &v, 1);
+    g_byte_array_append(mask, &m, 1);
+}
+
+/** Non-overlapping regex matches starting in data[0, limit). */
+static gboolean scan_regex(GHexEditPattern *pattern, guint8 const *data, gsize length, gsize limit, guint64 base, GArray *matches, guint max_matches)
+{
+    GMatchInfo *info = NULL;
+    gboolean more = TRUE;
+    g_regex_match_full(pattern->regex, (char const *)data, length, 0, G_REGEX_MATCH_NOTEMPTY, &info, NULL);
+    while (more && g_match_info_matches(info))
+    {
+        int start, end;
+        g_match_info_fetch_pos(info, 0, &start, &end);
+        if ((gsize)start >= limit)
+            break;
+        more = add_match(matches, base + start, end - start, max_matches);
+        g_match_info_next(info, NULL);
+    }
+    g_match_info_free(info);
+    return more;
+}
+
+
+/* ===[ GHexEditPattern ]=== */
+/**
+ * Parse a hex pattern such as "DE AD ?? B? EF".
+ * Whitespace is ignored; `?` stands for any nybble, so `??` is any byte.
+ */
+GHexEditPattern *ghexedit_pattern_new_hex(char const *text, GError **error)
+{
+    GByteArray *value = g_byte_array_new();
+    GByteArray *mask = g_byte_array_new();
+    guint nybbles = 0;
+    guint8 v = 0, m = 0;
+    gboolean ok = TRUE;
+    for (char const *p = text; *p; ++p)
+    {
+        if (g_ascii_isspace(*p))
+            continue;
+        v <<= 4;
+        m <<= 4;
+        if (*p != '?')
+        {
+            if (!g_ascii_isxdigit(*p))
+            {
+                g_set_error(error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT, "Character %d is not a hex digit or '?'", (int)(p - text) + 1);
+                ok = FALSE;
+                break;
+            }
+            v |= g_ascii_xdigit_value(*p);
+            m |= 0xf;
+        }
+        if (++nybbles % 2 == 0)
+        {
+            g_byte_array_append(value, &v, 1);
+            g_byte_array_append(mask, &m, 1);
+            v = m = 0;
+        }
+    }
+    if (ok && nybbles % 2)
+        g_set_error(error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT, "The last byte is missing a digit");
+    else if (ok && nybbles == 0)
+        g_set_error(error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT, "The pattern is empty");
+    if (!ok || nybbles == 0 || nybbles % 2)
+    {
+        g_byte_array_unref(value);
+        g_byte_array_unref(mask);
+        return NULL;
+    }
+
+    return from_arrays(value, mask);
+}
+
+/**
+ * A pattern matching `text` (UTF-8) stored in the given encoding.
+ * Without `match_case`, ASCII letters match either case.
+ */
+GHexEditPattern *ghexedit_pattern_new_text(char const *text, GHexEditTextEncoding encoding, gboolean match_case, GError **error)
+{
+    if (*text == '\0')
+    {
+        g_set_error(error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT, "The pattern is empty");
+        return NULL;
+    }
+    GByteArray *value = g_byte_array_new();
+    GByteArray *mask = g_byte_array_new();
+    if (encoding == GHEXEDIT_TEXT_ENCODING_UTF8)
+    {
+        for (char const *p = text; *p; ++p)
+            append_unit_byte(value, mask, *p, g_ascii_isalpha(*p), match_case);
+        return from_arrays(value, mask);
+    }
+
+    glong n_units;
+    gunichar2 *units = g_utf8_to_utf16(text, -1, NULL, &n_units, error);
+    if (units == NULL)
+    {
+        g_byte_array_unref(value);
+        g_byte_array_unref(mask);
+        return NULL;
+    }
+    for (glong i = 0; i < n_units; ++i)
+    {
+        gboolean letter = units[i] < 0x80 && g_ascii_isalpha(units[i]);
+        guint8 low = units[i] & 0xff, high = units[i] >> 8;
+        append_unit_byte(value, mask, encoding == GHEXEDIT_TEXT_ENCODING_UTF16LE ? low : high, letter && encoding == GHEXEDIT_TEXT_ENCODING_UTF16LE, match_case);
+        append_unit_byte(value, mask, encoding == GHEXEDIT_TEXT_ENCODING_UTF16LE ? high : low, letter && encoding == GHEXEDIT_TEXT_ENCODING_UTF16BE, match_case);
+    }
+    g_free(units);
+    return from_arrays(value, mask);
+}
+
+/**
+ * A Perl-compatible regular expression over raw bytes, so `.` and classes
+ * match single bytes and `\xNN` any byte value. Matches longer than
+ * REGEX_REACH may be cut short where they cross a chunk boundary.
+ */
+GHexEditPattern *ghexedit_pattern_new_regex(char const *text, gboolean match_case, GError **error)
+{
+    if (*text == '\0')
+    {
+        g_set_error(error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT, "The pattern is empty");
+        return NULL;
+    }
+    // Compiled once and shared by every worker; OPTIMIZE enables the JIT
+    GRegexCompileFlags flags = G_REGEX_RAW | G_REGEX_OPTIMIZE | G_REGEX_DOTALL | (match_case ? 0 : G_REGEX_CASELESS);
+    GRegex *regex = g_regex_new(text, flags, 0, error);
+    if (regex == NULL)
+        return NULL;
+    GHexEditPattern *pattern = g_new0(GHexEditPattern, 1);
+    pattern->regex = regex;
+    return pattern;
+}
+
+/** A pattern matching exactly `data`. */
+GHexEditPattern *ghexedit_pattern_new_bytes(guint8 const *data, gsize length)
+{
+    g_return_val_if_fail(length > 0, NULL);
+    GHexEditPattern *pattern = g_new0(GHexEditPattern, 1);
+    pattern->length = length;
+    pattern->value = g_malloc(length);
+    memcpy(pattern->value, data, length);
+    pattern->mask = g_malloc(length);
+    memset(pattern->mask, 0xff, length);
+    return compile(pattern);
+}
+
+void ghexedit_pattern_free(GHexEditPattern *pattern)
+{
+    if (pattern == NULL)
+        return;
+    g_clear_pointer(&pattern->regex, g_regex_unref);
+    g_free(pattern->value);
+    g_free(pattern->mask);
+    g_free(pattern);
+}
+
+/**
+ * How far a match may reach past its first byte. Scanning a data set in
+ * chunks, each chunk must include this many bytes of the next.
+ */
+gsize ghexedit_pattern_get_overlap(GHexEditPattern *pattern)
+{
+    return pattern->regex ? REGEX_REACH : pattern->length - 1;
+}
+
+/** Bytes every match spans, or 0 for a regex, whose matches vary. */
+gsize ghexedit_pattern_get_length(GHexEditPattern *pattern)
+{
+    return pattern->regex ? 0 : pattern->length;
+}
+
+/**
+ * Append every match starting in data[0, limit) to `matches`, offset by
+ * `base`, in order. Matches may run up to data[length]. Returns FALSE if
+ * scanning stopped because `matches` reached `max_matches`.
+ */
+gboolean ghexedit_pattern_scan(GHexEditPattern *pattern, guint8 const *data, gsize length, gsize limit, guint64 base, GArray *matches, guint max_matches)
+{
+    if (pattern->regex)
+        return scan_regex(pattern, data, length, limit, base, matches, max_matches);
+
+    gsize m = pattern->length;
+    if (length < m)
+        return TRUE;
+    limit = MIN(limit, length - m + 1);
+
+    if (pattern->anchor_length == m)
+    {
+        // Exact: glibc's memmem is hard to beat
+        for (gsize pos = 0; pos < limit;)
+        {
+            guint8 const *hit = memmem(data + pos, length - pos, pattern->value, m);
+            if (hit == NULL || (gsize)(hit - data) >= limit)
+                break;
+            pos = hit - data;
+            if (!add_match(matches, base + pos, m, max_matches))
+                return FALSE;
+            ++pos;
+        }
+    }
+    else if (pattern->anchor_length > 0)
+    {
+        // Find the exact run, then check the masked bytes around it
+        gsize a = pattern->anchor_start;
+        guint8 const *anchor = pattern->value + a;
+        gsize anchor_length = pattern->anchor_length;
+        for (gsize pos = 0; pos < limit;)
+        {
+            gsize from = pos + a;
+            guint8 const *hit = anchor_length == 1
+                ? memchr(data + from, *anchor, length - from)
+                : memmem(data + from, length - from, anchor, anchor_length);
+            if (hit == NULL)
+                break;
+            pos = hit - data - a;
+            if (pos >= limit)
+                break;
+            if (matches_at(pattern, data + pos) && !add_match(matches, base + pos, m, max_matches))
+                return FALSE;
+            ++pos;
+        }
+    }
+    else
+    {
+        for (gsize pos = 0; pos < limit; pos += pattern->shift[data[pos + m - 1]])
+            if (matches_at(pattern, data + pos) && !add_match(matches, base + pos, m, max_matches))
+                return FALSE;
+    }
+    return TRUE;
+}
@@ -0,0 +1,51 @@
+/**
+ * Pattern.h - Compiled search patterns.
+ * Copyright (C) 2022 Trevor Last
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _GHX_PATTERN_H
+#define _GHX_PATTERN_H
+
+#include <glib.h>
+
+
+/** A match: `length` bytes at `offset`. */
+typedef struct
+{
+    guint64 offset;
+    guint64 length;
+} GHexEditMatch;
+
+/** How text patterns are turned into bytes. */
+typedef enum
+{
+    GHEXEDIT_TEXT_ENCODING_UTF8,
+    GHEXEDIT_TEXT_ENCODING_UTF16LE,
+    GHEXEDIT_TEXT_ENCODING_UTF16BE,
+} GHexEditTextEncoding;
+
+typedef struct _GHexEditPattern GHexEditPattern;
+
+GHexEditPattern *ghexedit_pattern_new_hex(char const *text, GError **error);
+GHexEditPattern *ghexedit_pattern_new_text(char const *text, GHexEditTextEncoding encoding, gboolean match_case, GError **error);
+GHexEditPattern *ghexedit_pattern_new_regex(char const *text, gboolean match_case, GError **error);
+GHexEditPattern *ghexedit_pattern_new_bytes(guint8 const *data, gsize length);
+void ghexedit_pattern_free(GHexEditPattern *pattern);
+gsize ghexedit_pattern_get_overlap(GHexEditPattern *pattern);
+gsize ghexedit_pattern_get_length(GHexEditPattern *pattern);
+gboolean ghexedit_pattern_scan(GHexEditPattern *pattern, guint8 const *data, gsize length, gsize limit, guint64 base, GArray *matches, guint max_matches);
+
+#endif
@@ -0,0 +1,323 @@
+/**
+ * PieceTable.c - Balanced piece table over an original and an add buffer.
+ * Copyright (C) 2022 Trevor Last
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "PieceTable.h"
+
+
+/**
+ * Pieces are kept in a treap keyed implicitly by position: each node stores
+ * the byte length of its subtree, so any offset can be found, and the table
+ * split or joined there, in expected O(log n) for n pieces.
+ */
+typedef struct Node
+{
+    GHexEditPiece piece;
+    guint64 total;
+    guint32 priority;
+    guint count;
+    struct Node *left;
+    struct Node *right;
+} Node;
+
+struct _GHexEditPieceTable
+{
+    Node *root;
+    guint32 seed;
+};
+
+
+/** xorshift32; balance only needs the priorities to be well spread. */
+static guint32 next_priority(GHexEditPieceTable *table)
+{
+    guint32 x = table->seed;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return table->seed = x;
+}
+
+static guint64 node_total(Node *node)
+{
+    return node ? node->total : 0;
+}
+
+static guint node_count(Node *node)
+{
+    return node ? node->count : 0;
+}
+
+static void node_update(Node *node)
+{
+    node->total = node_total(node->left) + node->piece.length + node_total(node->right);
+    node->count = node_count(node->left) + 1 + node_count(node->right);
+}
+
+static Node *node_new(GHexEditPieceTable *table, GHexEditPiece const *piece)
+{
+    Node *node = g_new0(Node, 1);
+    node->piece = *piece;
+    node->priority = next_priority(table);
+    node_update(node);
+    return node;
+}
+
+static void node_free(Node *node)
+{
+    if (node == NULL)
+        return;
+    node_free(node->left);
+    node_free(node->right);
+    g_free(node);
+}
+
+/** Join two treaps, every byte of `left` preceding every byte of `right`. */
+static Node *merge(Node *left, Node *right)
+{
+    if (left == NULL)
+        return right;
+    if (right == NULL)
+        return left;
+    if (left->priority > right->priority)
+    {
+        left->right = merge(left->right, right);
+        node_update(left);
+        return left;
+    }
+    right->left = merge(left, right->left);
+    node_update(right);
+    return right;
+}
+
+/** Split a treap so `*left` holds exactly the first `offset` bytes. */
+static void split(GHexEditPieceTable *table, Node *node, guint64 offset, Node **left, Node **right)
+{
+    if (node == NULL)
+    {
+        *left = *right = NULL;
+        return;
+    }
+    guint64 before = node_total(node->left);
+    if (offset <= before)
+    {
+        split(table, node->left, offset, left, &node->left);
+        node_update(node);
+        *right = node;
+    }
+    else if (offset >= before + node->piece.length)
+    {
+        split(table, node->right, offset - before - node->piece.length, &node->right, right);
+        node_update(node);
+        *left = node;
+    }
+    else
+    {
+        // The offset lands inside this piece, so cut it in two
+        guint64 cut = offset - before;
+        GHexEditPiece tail = node->piece;
+        tail.start += cut;
+        tail.length -= cut;
+        node->piece.length = cut;
+        Node *after = node->right;
+        node->right = NULL;
+        node_update(node);
+        *left = node;
+        *right = merge(node_new(table, &tail), after);
+    }
+}
+
+static Node *leftmost(Node *node)
+{
+    while (node && node->left)
+        node = node->left;
+    return node;
+}
+
+static Node *rightmost(Node *node)
+{
+    while (node && node->right)
+        node = node->right;
+    return node;
+}
+
+/** Grow the last piece of a treap by `length`, fixing totals on the way down. */
+static void extend_last(Node *node, guint64 length)
+{
+    for (; node; node = node->right)
+    {
+        node->total += length;
+        if (node->right == NULL)
+            node->piece.length += length;
+    }
+}
+
+/** Unlink and free the first node of a treap. */
+static Node *drop_first(Node *node)
+{
+    if (node->left == NULL)
+    {
+        Node *right = node->right;
+        g_free(node);
+        return right;
+    }
+    node->left = drop_first(node->left);
+    node_update(node);
+    return node;
+}
+
+static gboolean contiguous(GHexEditPiece const *a, GHexEditPiece const *b)
+{
+    return a->source == b->source && a->start + a->length == b->start;
+}
+
+/**
+ * Join two treaps, fusing the pieces at the seam when they continue each
+ * other. This keeps typing runs and undone edits from fragmenting the table.
+ */
+static Node *join(Node *left, Node *right)
+{
+    Node *last = rightmost(left);
+    Node *first = leftmost(right);
+    if (last && first && contiguous(&last->piece, &first->piece))
+    {
+        extend_last(left, first->piece.length);
+        right = drop_first(right);
+    }
+    return merge(left, right);
+}
+
+static void collect(Node *node, GArray *out)
+{
+    if (node == NULL)
+        return;
+    collect(node->left, out);
+    g_array_append_val(out, node->piece);
+    collect(node->right, out);
+}
+
+/** In-order walk over the nodes overlapping [lo, hi); `base` is the subtree's offset. */
+static gboolean visit(Node *node, guint64 base, guint64 lo, guint64 hi, GHexEditPieceFunc func, gpointer user_data)
+{
+    if (node == NULL || lo >= base + node->total || hi <= base)
+        return TRUE;
+    if (!visit(node->left, base, lo, hi, func, user_data))
+        return FALSE;
+
+    guint64 start = base + node_total(node->left);
+    guint64 end = start + node->piece.length;
+    if (lo < end && hi > start)
+    {
+        guint64 from = MAX(lo, start);
+        GHexEditPiece trimmed = node->piece;
+        trimmed.start += from - start;
+        trimmed.length = MIN(hi, end) - from;
+        if (!func(&trimmed, from, user_data))
+            return FALSE;
+    }
+    return visit(node->right, end, lo, hi, func, user_data);
+}
+
+
+/* ===[ GHexEditPieceTable ]=== */
+/** A table presenting `original_length` bytes of the original source. */
+GHexEditPieceTable *ghexedit_piece_table_new(guint64 original_length)
+{
+    GHexEditPieceTable *table = g_new0(GHexEditPieceTable, 1);
+    table->seed = 0x9e3779b9u;
+    if (original_length > 0)
+    {
+        GHexEditPiece piece = {GHEXEDIT_PIECE_ORIGINAL, 0, original_length};
+        table->root = node_new(table, &piece);
+    }
+    return table;
+}
+
+void ghexedit_piece_table_free(GHexEditPieceTable *table)
+{
+    if (table == NULL)
+        return;
+    node_free(table->root);
+    g_free(table);
+}
+
+/** Logical length of the table in bytes. */
+guint64 ghexedit_piece_table_get_length(GHexEditPieceTable *table)
+{
+    return node_total(table->root);
+}
+
+guint ghexedit_piece_table_get_n_pieces(GHexEditPieceTable *table)
+{
+    return node_count(table->root);
+}
+
+/** Insert `pieces`, in order, before the byte at `offset`. */
+void ghexedit_piece_table_insert(GHexEditPieceTable *table, guint64 offset, GHexEditPiece const *pieces, guint n_pieces)
+{
+    g_return_if_fail(offset <= ghexedit_piece_table_get_length(table));
+
+    Node *left, *right;
+    split(table, table->root, offset, &left, &right);
+    for (guint i = 0; i < n_pieces; ++i)
+        if (pieces[i].length > 0)
+            left = join(left, node_new(table, &pieces[i]));
+    table->root = join(left, right);
+}
+
+/**
+ * Remove `length` bytes at `offset`.
+ * If `removed` isn't NULL, the pieces that covered the range are appended to
+ * it in order, so the removal can be reversed with ghexedit_piece_table_insert.
+ */
+void ghexedit_piece_table_remove(GHexEditPieceTable *table, guint64 offset, guint64 length, GArray *removed)
+{
+    guint64 size = ghexedit_piece_table_get_length(table);
+    g_return_if_fail(offset <= size);
+    length = MIN(length, size - offset);
+    if (length == 0)
+        return;
+
+    Node *left, *middle, *right;
+    split(table, table->root, offset, &left, &middle);
+    split(table, middle, length, &middle, &right);
+    if (removed)
+        collect(middle, removed);
+    node_free(middle);
+    table->root = join(left, right);
+}
+
+static gboolean append_piece(GHexEditPiece const *piece, guint64 offset, gpointer out)
+{
+    g_array_append_val((GArray *)out, *piece);
+    return TRUE;
+}
+
+/** Append the pieces covering [offset, offset + length), trimmed to it, to `out`. */
+void ghexedit_piece_table_get_pieces(GHexEditPieceTable *table, guint64 offset, guint64 length, GArray *out)
+{
+    ghexedit_piece_table_foreach(table, offset, length, append_piece, out);
+}
+
+/**
+ * Call `func` for each piece overlapping [offset, offset + length), trimmed
+ * to that range. Returns FALSE if `func` stopped the walk.
+ */
+gboolean ghexedit_piece_table_foreach(GHexEditPieceTable *table, guint64 offset, guint64 length, GHexEditPieceFunc func, gpointer user_data)
+{
+    guint64 end = length > G_MAXUINT64 - offset ? G_MAXUINT64 : offset + length;
+    return visit(table->root, 0, offset, end, func, user_data);
+}
@@ -0,0 +1,57 @@
+/**
+ * PieceTable.h - Balanced piece table over an original and an add buffer.
+ * Copyright (C) 2022 Trevor Last
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _GHX_PIECETABLE_H
+#define _GHX_PIECETABLE_H
+
+#include <glib.h>
+
+
+/** Where a piece's bytes live. */
+typedef enum
+{
+    GHEXEDIT_PIECE_ORIGINAL,
+    GHEXEDIT_PIECE_ADD,
+} GHexEditPieceSource;
+
+/** A run of bytes from one source. */
+typedef struct
+{
+    GHexEditPieceSource source;
+    guint64 start;
+    guint64 length;
+} GHexEditPiece;
+
+/**
+ * Called for each piece in a range, trimmed to the range, with the logical
+ * offset the piece starts at. Return FALSE to stop.
+ */
+typedef gboolean (*GHexEditPieceFunc)(GHexEditPiece const *piece, guint64 offset, gpointer user_data);
+
+typedef struct _GHexEditPieceTable GHexEditPieceTable;
+
+GHexEditPieceTable *ghexedit_piece_table_new(guint64 original_length);
+void ghexedit_piece_table_free(GHexEditPieceTable *table);
+guint64 ghexedit_piece_table_get_length(GHexEditPieceTable *table);
+guint ghexedit_piece_table_get_n_pieces(GHexEditPieceTable *table);
+void ghexedit_piece_table_insert(GHexEditPieceTable *table, guint64 offset, GHexEditPiece const *pieces, guint n_pieces);
+void ghexedit_piece_table_remove(GHexEditPieceTable *table, guint64 offset, guint64 length, GArray *removed);
+void ghexedit_piece_table_get_pieces(GHexEditPieceTable *table, guint64 offset, guint64 length, GArray *out);
+gboolean ghexedit_piece_table_foreach(GHexEditPieceTable *table, guint64 offset, guint64 length, GHexEditPieceFunc func, gpointer user_data);
+
+#endif
@@ -0,0 +1,208 @@
+/**
+ * ProcessSource.c - Live process memory, read through /proc/<pid>/mem.
+ * Copyright (C) 2022 Trevor Last
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#define _GNU_SOURCE
+
+#include "Source.h"
+
+#include <glib/gstdio.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+
+/** Mapped pages that can't be read are retried at this granularity. */
+#define RETRY_SIZE 4096
+
+/**
+ * A process's address space, offsets being addresses. Only the regions
+ * listed in its maps when it was opened are read; the gaps between them
+ * are unreadable without asking the kernel. Mappings made later aren't
+ * seen until the file is opened again.
+ */
+typedef struct
+{
+    GHexEditSource parent;
+    int fd;
+    /** Mapped regions, sorted and disjoint. */
+    GArray *regions;
+} ProcessSource;
+
+
+/** Index of the first region ending after `offset`, or the number of regions. */
+static guint first_region(ProcessSource *process, guint64 offset)
+{
+    guint lo = 0, hi = process->regions->len;
+    while (lo < hi)
+    {
+        guint mid = lo + (hi - lo) / 2;
+        if (g_array_index(process->regions, GHexEditRange, mid).end <= offset)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+/** Read part of a mapped region, marking pages the kernel refuses as unreadable. */
+static void read_mapped(ProcessSource *process, guint64 offset, guint8 *dest, gsize length, GHexEditRangeSet *unreadable)
+{
+    gsize total = 0;
+    while (total < length)
+    {
+        ssize_t got = pread(process->fd, dest + total, length - total, offset + total);
+        if (got < 0 && errno == EINTR)
+            continue;
+        if (got > 0)
+        {
+            total += got;
+            continue;
+        }
+        // Guard pages, unbacked mappings, or the process has gone: skip a page
+        guint64 at = offset + total;
+        gsize n = MIN(length - total, RETRY_SIZE - at % RETRY_SIZE);
+        memset(dest + total, 0, n);
+        ghexedit_range_set_add(unreadable, at, at + n);
+        total += n;
+    }
+}
+
+static gssize process_read(GHexEditSource *source, guint64 offset, guint8 *dest, gsize length, GHexEditRangeSet *unreadable, GError **error)
+{
+    ProcessSource *process = (ProcessSource *)source;
+    length = offset < source->size ? MIN(length, source->size - offset) : 0;
+    guint64 end = offset + length;
+    guint64 pos = offset;
+    for (guint i = first_region(process, offset); pos < end; ++i)
+    {
+        GHexEditRange const *region = i < process->regions->len ? &g_array_index(process->regions, GHexEditRange, i) : NULL;
+        guint64 gap_end = region ? MIN(MAX(region->start, pos), end) : end;
+        if (gap_end > pos)
+        {
+            memset(dest + (pos - offset), 0, gap_end - pos);
+            ghexedit_range_set_add(unreadable, pos, gap_end);
+            pos = gap_end;
+        }
+        if (region == NULL || pos >= end)
+            break;
+        guint64 mapped_end = MIN(region->end, end);
+        read_mapped(process, pos, dest + (pos - offset), mapped_end - pos, unreadable);
+        pos = mapped_end;
+    }
+    return length;
+}
+
+/** The gaps between regions need no read to be known unreadable. */
+static void process_get_unreadable(GHexEditSource *source, guint64 offset, guint64 length, GHexEditRangeSet *unreadable)
+{
+    ProcessSource *process = (ProcessSource *)source;
+    guint64 end = MIN(offset + length, source->size);
+    guint64 pos = offset;
+    for (guint i = first_region(process, offset); pos < end; ++i)
+    {
+        guint64 gap_end = end;
+        if (i < process->regions->len)
+            gap_end = MIN(g_array_index(process->regions, GHexEditRange, i).start, end);
+        if (gap_end > pos)
+            ghexedit_range_set_add(unreadable, pos, gap_end);
+        if (i >= process->regions->len)
+            break;
+        pos = g_array_index(process->regions, GHexEditRange, i).end;
+    }
+}
+
+static void process_free(GHexEditSource *source)
+{
+    ProcessSource *process = (ProcessSource *)source;
+    g_close(process->fd, NULL);
+    g_array_unref(process->regions);
+    g_free(process);
+}
+
+static GHexEditSourceClass const process_class = {
+    .read = process_read,
+    .get_unreadable = process_get_unreadable,
+    .free = process_free,
+};
+
+/**
+ * Parse a maps file into sorted regions. The vsyscall page sits at the top
+ * of the address space, can't be read through mem, and would make the
+ * document 2^64 bytes long, so it's left out.
+ */
+static GArray *parse_maps(char const *contents)
+{
+    GArray *regions = g_array_new(FALSE, FALSE, sizeof(GHexEditRange));
+    char **lines = g_strsplit(contents, "\n", -1);
+    for (char **line = lines; *line; ++line)
+    {
+        char *rest;
+        guint64 start = g_ascii_strtoull(*line, &rest, 16);
+        if (rest == *line || *rest != '-')
+            continue;
+        char *after;
+        guint64 end = g_ascii_strtoull(rest + 1, &after, 16);
+        if (after == rest + 1 || end <= start || g_str_has_suffix(*line, "[vsyscall]"))
+            continue;
+        // Merge neighbours so lookups see one run
+        GHexEditRange *last = regions->len ? &g_array_index(regions, GHexEditRange, regions->len - 1) : NULL;
+        if (last && last->end == start)
+            last->end = end;
+        else
+        {
+            GHexEditRange region = {start, end};
+            g_array_append_val(regions, region);
+        }
+    }
+    g_strfreev(lines);
+    return regions;
+}
+
+/** Open `/proc/<pid>/mem`. Needs the same rights as attaching a debugger. */
+GHexEditSource *ghexedit_source_open_process(char const *path, GError **error)
+{
+    char *dir = g_path_get_dirname(path);
+    char *maps_path = g_build_filename(dir, "maps", NULL);
+    char *contents = NULL;
+    gboolean ok = g_file_get_contents(maps_path, &contents, NULL, error);
+    g_free(maps_path);
+    g_free(dir);
+    if (!ok)
+        return NULL;
+
+    int fd = g_open(path, O_RDONLY | O_CLOEXEC, 0);
+    if (fd < 0)
+    {
+        int saved = errno;
+        g_set_error(error, G_IO_ERROR, g_io_error_from_errno(saved), "%s: %s", path, g_strerror(saved));
+        g_free(contents);
+        return NULL;
+    }
+
+    ProcessSource *process = g_new0(ProcessSource, 1);
+    process->parent.klass = &process_class;
+    process->parent.alignment = 1;
+    process->fd = fd;
+    process->regions = parse_maps(contents);
+    g_free(contents);
+    if (process->regions->len > 0)
+        process->parent.size = g_array_index(process->regions, GHexEditRange, process->regions->len - 1).end;
+    return &process->parent;
+}
@@ -0,0 +1,150 @@
+/**
+ * RangeSet.c - Sorted sets of byte ranges.
+ * Copyright (C) 2022 Trevor Last
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "RangeSet.h"
+
+#include <glib.h>
+
+
+/**
+ * Ranges are kept sorted, with overlapping and touching ones merged, so
+ * both starts and ends ascend and binary search finds any window. Adding
+ * in ascending order, as search results arrive, only ever appends.
+ */
+struct _GHexEditRangeSet
+{
+    GArray *ranges;
+};
+
+
+/* ===[ Searching ]=== */
+/** Index of the first range ending at or after `offset`, or past the end. */
+static guint first_ending_from(GHexEditRangeSet *set, guint64 offset)
+{
+    guint lo = 0, hi = set->ranges->len;
+    while (lo < hi)
+    {
+        guint mid = lo + (hi - lo) / 2;
+        if (g_array_index(set->ranges, GHexEditRange, mid).end < offset)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+/** Index of the first range starting after `offset`, or past the end. */
+static guint first_starting_after(GHexEditRangeSet *set, guint64 offset)
+{
+    guint lo = 0, hi = set->ranges->len;
+    while (lo < hi)
+    {
+        guint mid = lo + (hi - lo) / 2;
+        if (g_array_index(set->ranges, GHexEditRange, mid).start <= offset)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+
+/* ===[ RangeSet ]=== */
+GHexEditRangeSet *ghexedit_range_set_new(void)
+{
+    GHexEditRangeSet *set = g_new(GHexEditRangeSet, 1);
+    set->ranges = g_array_new(FALSE, FALSE, sizeof(GHexEditRange));
+    return set;
+}
+
+void ghexedit_range_set_free(GHexEditRangeSet *set)
+{
+    if (set == NULL)
+        return;
+    g_array_unref(set->ranges);
+    g_free(set);
+}
+
+/** Remove every range, keeping the memory for reuse. */
+void ghexedit_range_set_clear(GHexEditRangeSet *set)
+{
+    g_array_set_size(set->ranges, 0);
+}
+
+/** Add bytes [start, end), merging with any ranges it overlaps or touches. */
+void ghexedit_range_set_add(GHexEditRangeSet *set, guint64 start, guint64 end)
+{
+    if (start >= end)
+        return;
+    // Ranges [first, last) overlap or touch the new one
+    guint first = first_ending_from(set, start);
+    guint last = first_starting_after(set, end);
+    if (first == last)
+    {
+        GHexEditRange range = {start, end};
+        g_array_insert_val(set->ranges, first, range);
+        return;
+    }
+    GHexEditRange *merged = &g_array_index(set->ranges, GHexEditRange, first);
+    merged->start = MIN(merged->start, start);
+    merged->end = MAX(g_array_index(set->ranges, GHexEditRange, last - 1).end, end);
+    if (last - first > 1)
+        g_array_remove_range(set->ranges, first + 1, last - first - 1);
+}
+
+guint ghexedit_range_set_get_n_ranges(GHexEditRangeSet *set)
+{
+    return set->ranges->len;
+}
+
+/**
+ * Call `func` with each range overlapping [start, end), clipped to it, in
+ * order. Costs a binary search plus the ranges visited, however many there
+ * are elsewhere. FALSE if `func` stopped early.
+ */
+gboolean ghexedit_range_set_foreach(GHexEditRangeSet *set, guint64 start, guint64 end, GHexEditRangeFunc func, gpointer user_data)
+{
+    for (guint i = first_ending_from(set, start + 1); i < set->ranges->len; ++i)
+    {
+        GHexEditRange const *range = &g_array_index(set->ranges, GHexEditRange, i);
+        if (range->start >= end)
+            break;
+        if (!func(MAX(range->start, start), MIN(range->end, end), user_data))
+            return FALSE;
+    }
+    return TRUE;
+}
+
+/**
+ * Call `func` with each stretch of [start, end) that no range covers, in
+ * order. FALSE if `func` stopped early.
+ */
+gboolean ghexedit_range_set_foreach_gap(GHexEditRangeSet *set, guint64 start, guint64 end, GHexEditRangeFunc func, gpointer user_data)
+{
+    guint64 pos = start;
+    for (guint i = first_ending_from(set, start + 1); i < set->ranges->len && pos < end; ++i)
+    {
+        GHexEditRange const *range = &g_array_index(set->ranges, GHexEditRange, i);
+        if (range->start >= end)
+            break;
+        if (range->start > pos && !func(pos, range->start, user_data))
+            return FALSE;
+        pos = MAX(pos, range->end);
+    }
+    return pos < end ? func(pos, end, user_data) : TRUE;
+}
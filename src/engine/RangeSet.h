@@ -0,0 +1,45 @@
+/**
+ * RangeSet.h - Sorted sets of byte ranges.
+ * Copyright (C) 2022 Trevor Last
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _GHX_RANGESET_H
+#define _GHX_RANGESET_H
+
+#include <glib.h>
+
+
+/** Bytes [start, end). */
+typedef struct
+{
+    guint64 start;
+    guint64 end;
+} GHexEditRange;
+
+/** Called for each range in a window, clipped to it. Return FALSE to stop. */
+typedef gboolean (*GHexEditRangeFunc)(guint64 start, guint64 end, gpointer user_data);
+
+typedef struct _GHexEditRangeSet GHexEditRangeSet;
+
+GHexEditRangeSet *ghexedit_range_set_new(void);
+void ghexedit_range_set_free(GHexEditRangeSet *set);
+void ghexedit_range_set_clear(GHexEditRangeSet *set);
+void ghexedit_range_set_add(GHexEditRangeSet *set, guint64 start, guint64 end);
+guint ghexedit_range_set_get_n_ranges(GHexEditRangeSet *set);
+gboolean ghexedit_range_set_foreach(GHexEditRangeSet *set, guint64 start, guint64 end, GHexEditRangeFunc func, gpointer user_data);
+gboolean ghexedit_range_set_foreach_gap(GHexEditRangeSet *set, guint64 start, guint64 end, GHexEditRangeFunc func, gpointer user_data);
+
+#endif
@@ -0,0 +1,224 @@
+/**
+ * Registry.c - Buffers shared by every view of the same file.
+ * Copyright (C) 2022 Trevor Last
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "Registry.h"
+
+
+/**
+ * An open buffer, under each key it can be found by. The registry doesn't
+ * keep buffers alive: an entry goes away when the last view lets go of its
+ * buffer.
+ */
+typedef struct
+{
+    GHexEditBuffer *buffer;
+    /** Where the buffer's document was opened from. */
+    char *uri;
+    /** G_FILE_ATTRIBUTE_ID_FILE (device and inode for local files), if known. */
+    char *id;
+} Entry;
+
+/** An open in progress. */
+typedef struct
+{
+    GFile *file;
+    char *id;
+    GFileProgressCallback progress;
+    gpointer progress_data;
+} OpenRequest;
+
+// Main thread only; both map onto the same entries
+static GHashTable *by_uri = NULL;
+static GHashTable *by_id = NULL;
+
+
+static void ensure_tables(void)
+{
+    if (by_uri)
+        return;
+    by_uri = g_hash_table_new(g_str_hash, g_str_equal);
+    by_id = g_hash_table_new(g_str_hash, g_str_equal);
+}
+
+/** Remove `entry`'s keys from the tables, if they still refer to it. */
+static void entry_unlink(Entry *entry)
+{
+    if (entry->uri && g_hash_table_lookup(by_uri, entry->uri) == entry)
+        g_hash_table_remove(by_uri, entry->uri);
+    if (entry->id && g_hash_table_lookup(by_id, entry->id) == entry)
+        g_hash_table_remove(by_id, entry->id);
+}
+
+/** (Re-)file `entry` under new keys, which it takes ownership of. */
+static void entry_set_keys(Entry *entry, char *uri, char *id)
+{
+    entry_unlink(entry);
+    g_free(entry->uri);
+    g_free(entry->id);
+    entry->uri = uri;
+    entry->id = id;
+    if (uri)
+        g_hash_table_replace(by_uri, uri, entry);
+    if (id)
+        g_hash_table_replace(by_id, id, entry);
+}
+
+/** Weak reference callback: the buffer is gone. */
+static void buffer_finalized(gpointer user_data, GObject *where_the_object_was)
+{
+    Entry *entry = user_data;
+    entry_unlink(entry);
+    g_free(entry->uri);
+    g_free(entry->id);
+    g_free(entry);
+}
+
+/**
+ * Buffer::notify::document callback: after Save As the buffer edits another
+ * file. Replacing a file also gives it a new identity, which isn't known
+ * until it's queried again, so only the URI is kept.
+ */
+static void buffer_document_changed(GHexEditBuffer *buffer, GParamSpec *pspec, gpointer user_data)
+{
+    Entry *entry = user_data;
+    GFile *file = ghexedit_document_get_file(ghexedit_buffer_get_document(buffer));
+    char *uri = g_file_get_uri(file);
+    // Following a file swaps in a grown document for the same file
+    if (g_strcmp0(uri, entry->uri) == 0)
+    {
+        g_free(uri);
+        return;
+    }
+    entry_set_keys(entry, uri, NULL);
+}
+
+/** Track a newly opened buffer. */
+static GHexEditBuffer *add_buffer(GHexEditDocument *document, char const *id)
+{
+    Entry *entry = g_new0(Entry, 1);
+    entry->buffer = ghexedit_buffer_new(document);
+    entry_set_keys(entry, g_file_get_uri(ghexedit_document_get_file(document)), g_strdup(id));
+    g_object_weak_ref(G_OBJECT(entry->buffer), buffer_finalized, entry);
+    g_signal_connect(entry->buffer, "notify::document", G_CALLBACK(buffer_document_changed), entry);
+    return entry->buffer;
+}
+
+static GHexEditBuffer *lookup(GFile *file, char const *id)
+{
+    ensure_tables();
+    char *uri = g_file_get_uri(file);
+    Entry *entry = g_hash_table_lookup(by_uri, uri);
+    g_free(uri);
+    if (entry == NULL && id)
+        entry = g_hash_table_lookup(by_id, id);
+    return entry ? entry->buffer : NULL;
+}
+
+static void open_request_free(OpenRequest *request)
+{
+    g_object_unref(request->file);
+    g_free(request->id);
+    g_free(request);
+}
+
+/** Document open callback: share whatever was opened meanwhile, or adopt the new document. */
+static void document_opened(GObject *source, GAsyncResult *result, gpointer user_data)
+{
+    GTask *task = user_data;
+    OpenRequest *request = g_task_get_task_data(task);
+    GError *error = NULL;
+    GHexEditDocument *document = ghexedit_document_new_finish(result, &error);
+    if (document)
+    {
+        // Another open of the same file may have finished first
+        GHexEditBuffer *buffer = lookup(request->file, request->id);
+        if (buffer)
+            g_object_ref(buffer);
+        else
+            buffer = add_buffer(document, request->id);
+        g_task_return_pointer(task, buffer, g_object_unref);
+        g_object_unref(document);
+    }
+    else
+        g_task_return_error(task, error);
+    g_object_unref(task);
+}
+
+/** File identity query callback: reuse a buffer open under another name, or open the document. */
+static void identity_queried(GObject *source, GAsyncResult *result, gpointer user_data)
+{
+    GTask *task = user_data;
+    OpenRequest *request = g_task_get_task_data(task);
+    // Files without an identity can still be matched by URI
+    GFileInfo *info = g_file_query_info_finish(G_FILE(source), result, NULL);
+    if (info)
+    {
+        request->id = g_strdup(g_file_info_get_attribute_string(info, G_FILE_ATTRIBUTE_ID_FILE));
+        g_object_unref(info);
+    }
+
+    GHexEditBuffer *buffer = lookup(request->file, request->id);
+    if (buffer)
+    {
+        g_task_return_pointer(task, g_object_ref(buffer), g_object_unref);
+        g_object_unref(task);
+        return;
+    }
+    ghexedit_document_new_async(request->file, g_task_get_cancellable(task), request->progress, request->progress_data, document_opened, task);
+}
+
+
+/* ===[ GHexEditRegistry ]=== */
+/** The buffer already open for `file`, if any. Main thread only. */
+GHexEditBuffer *ghexedit_registry_lookup(GFile *file)
+{
+    return lookup(file, NULL);
+}
+
+/**
+ * Get the buffer for `file`, opening it only if no view has it open already.
+ * Files are matched by URI and by identity, so two paths to one local file
+ * share a buffer. Must be called from the main thread; `progress` is as for
+ * ghexedit_document_new_async.
+ */
+void ghexedit_registry_open_async(GFile *file, GCancellable *cancellable, GFileProgressCallback progress, gpointer progress_data, GAsyncReadyCallback callback, gpointer user_data)
+{
+    GTask *task = g_task_new(NULL, cancellable, callback, user_data);
+    g_task_set_source_tag(task, ghexedit_registry_open_async);
+
+    GHexEditBuffer *buffer = lookup(file, NULL);
+    if (buffer)
+    {
+        g_task_return_pointer(task, g_object_ref(buffer), g_object_unref);
+        g_object_unref(task);
+        return;
+    }
+
+    OpenRequest *request = g_new0(OpenRequest, 1);
+    request->file = g_object_ref(file);
+    request->progress = progress;
+    request->progress_data = progress_data;
+    g_task_set_task_data(task, request, (GDestroyNotify)open_request_free);
+    g_file_query_info_async(file, G_FILE_ATTRIBUTE_ID_FILE, G_FILE_QUERY_INFO_NONE, G_PRIORITY_DEFAULT, cancellable, identity_queried, task);
+}
+
+GHexEditBuffer *ghexedit_registry_open_finish(GAsyncResult *result, GError **error)
+{
+    g_return_val_if_fail(g_task_is_valid(result, NULL), NULL);
+    return g_task_propagate_pointer(G_TASK(result), error);
+}
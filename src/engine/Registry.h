@@ -0,0 +1,31 @@
+/**
+ * Registry.h - Buffers shared by every view of the same file.
+ * Copyright (C) 2022 Trevor Last
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _GHX_REGISTRY_H
+#define _GHX_REGISTRY_H
+
+#include <gio/gio.h>
+
+#include "Buffer.h"
+
+
+GHexEditBuffer *ghexedit_registry_lookup(GFile *file);
+void ghexedit_registry_open_async(GFile *file, GCancellable *cancellable, GFileProgressCallback progress, gpointer progress_data, GAsyncReadyCallback callback, gpointer user_data);
+GHexEditBuffer *ghexedit_registry_open_finish(GAsyncResult *result, GError **error);
+
+#endif
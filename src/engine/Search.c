@@ -0,0 +1,402 @@
+/**
+ * Search.c - Parallel search over a buffer.
+ * Copyright (C) 2022 Trevor Last
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "Search.h"
+#include "Trace.h"
+#include "Workers.h"
+
+
+/** Bytes of match starts handled per job. */
+#define CHUNK_SIZE (4 * 1024 * 1024)
+
+/** Match starts [start, end), read up to `stop` to finish matches. */
+typedef struct
+{
+    guint64 start;
+    guint64 end;
+    guint64 stop;
+} Chunk;
+
+/** One chunk's window, scanned a readable run at a time. */
+typedef struct
+{
+    GHexEditSearch *search;
+    Chunk const *chunk;
+    guint8 const *window;
+    GArray *found;
+} ScanClosure;
+
+/**
+ * The buffer's readable stretches are cut into chunks that workers claim
+ * one at a time, each reading its chunk plus the pattern's overlap into the
+ * next. Bytes that couldn't be read are skipped, so no match covers them.
+ * Finished chunks are handed to the main loop, which publishes them strictly
+ * in order so matches are always sorted.
+ */
+struct _GHexEditSearch
+{
+    GObject parent;
+    GHexEditBuffer *buffer;
+    GHexEditPattern *pattern;
+    GCancellable *cancellable;
+    guint64 size;
+    /** Offsets a match could start at: all of them, unless every match is as long as the pattern. */
+    guint64 starts;
+    /** Chunks in order, none touching bytes known to be unreadable. */
+    GArray *chunks;
+    guint n_chunks;
+    // Shared with workers
+    gint next_chunk;
+    GMutex lock;
+    /** Each chunk's matches, in an array. */
+    GHexEditDrain drain;
+    guint active;
+    /** The first read that failed; searching stops there. */
+    GError *error;
+    // Main thread only
+    GArray *matches;
+    gboolean truncated;
+    gboolean finished;
+};
+
+G_DEFINE_TYPE(GHexEditSearch, ghexedit_search, G_TYPE_OBJECT)
+
+enum
+{
+    PROP_PROGRESS = 1,
+    PROP_FINISHED,
+    N_PROPERTIES
+};
+
+static GParamSpec *properties[N_PROPERTIES] = {NULL,};
+
+enum
+{
+    SIGNAL_MATCHES_ADDED,
+    N_SIGNALS
+};
+
+static guint signals[N_SIGNALS];
+
+
+/** Main loop: publish finished chunks in order, and notice the end. */
+static void drain(gpointer object)
+{
+    GHexEditSearch *search = GHEXEDIT_SEARCH(object);
+    guint position = search->matches->len;
+
+    g_mutex_lock(&search->lock);
+    GArray *chunk;
+    while (!search->truncated && (chunk = ghexedit_drain_next(&search->drain)))
+    {
+        guint room = GHEXEDIT_SEARCH_MAX_MATCHES - search->matches->len;
+        if (chunk->len > room || (chunk->len == room && search->drain.published < search->n_chunks))
+            search->truncated = TRUE;
+        g_array_append_vals(search->matches, chunk->data, MIN(chunk->len, room));
+        g_array_unref(chunk);
+    }
+    gboolean finished = !search->finished && search->active == 0;
+    g_mutex_unlock(&search->lock);
+
+    if (search->truncated)
+        g_cancellable_cancel(search->cancellable);
+
+    g_object_freeze_notify(G_OBJECT(search));
+    if (search->matches->len > position)
+        g_signal_emit(search, signals[SIGNAL_MATCHES_ADDED], 0, position, search->matches->len - position);
+    g_object_notify_by_pspec(G_OBJECT(search), properties[PROP_PROGRESS]);
+    if (finished)
+    {
+        search->finished = TRUE;
+        g_object_notify_by_pspec(G_OBJECT(search), properties[PROP_FINISHED]);
+    }
+    g_object_thaw_notify(G_OBJECT(search));
+}
+
+/** Scan one readable run of a chunk's window; GHexEditRangeFunc. */
+static gboolean scan_run(guint64 start, guint64 end, gpointer user_data)
+{
+    ScanClosure *closure = user_data;
+    Chunk const *chunk = closure->chunk;
+    if (start >= chunk->end)
+        return FALSE;
+    return ghexedit_pattern_scan(closure->search->pattern, closure->window + (start - chunk->start), end - start, MIN(end, chunk->end) - start, start, closure->found, GHEXEDIT_SEARCH_MAX_MATCHES);
+}
+
+/** Pool worker: claim and scan chunks until none are left. */
+static void worker(gpointer object)
+{
+    GHexEditSearch *search = object;
+    GHexEditRangeSet *unreadable = ghexedit_range_set_new();
+
+    for (;;)
+    {
+        guint index = g_atomic_int_add(&search->next_chunk, 1);
+        if (index >= search->n_chunks || g_cancellable_is_cancelled(search->cancellable))
+            break;
+
+        Chunk const *chunk = &g_array_index(search->chunks, Chunk, index);
+        GHEXEDIT_TRACE_BEGIN(search_chunk);
+        GArray *found = g_array_new(FALSE, FALSE, sizeof(GHexEditMatch));
+        GError *error = NULL;
+        GBytes *bytes = ghexedit_buffer_read_bytes(search->buffer, chunk->start, chunk->stop - chunk->start, &error);
+        if (bytes)
+        {
+            gsize length;
+            guint8 const *window = g_bytes_get_data(bytes, &length);
+            // Pages refused while reading are only known now
+            ghexedit_range_set_clear(unreadable);
+            ghexedit_buffer_get_unreadable(search->buffer, chunk->start, length, unreadable);
+            ScanClosure closure = {search, chunk, window, found};
+            ghexedit_range_set_foreach_gap(unreadable, chunk->start, chunk->start + length, scan_run, &closure);
+            g_bytes_unref(bytes);
+        }
+        GHEXEDIT_TRACE_END(search_chunk, "chunk %u", index);
+        if (bytes == NULL)
+        {
+            // Later chunks would be published past a hole, so stop here
+            g_array_unref(found);
+            g_mutex_lock(&search->lock);
+            if (search->error == NULL)
+                search->error = g_steal_pointer(&error);
+            g_mutex_unlock(&search->lock);
+            g_clear_error(&error);
+            g_cancellable_cancel(search->cancellable);
+            break;
+        }
+
+        g_mutex_lock(&search->lock);
+        ghexedit_drain_put(&search->drain, index, found);
+        g_mutex_unlock(&search->lock);
+    }
+
+    g_mutex_lock(&search->lock);
+    if (--search->active == 0)
+        ghexedit_drain_schedule(&search->drain);
+    g_mutex_unlock(&search->lock);
+    ghexedit_range_set_free(unreadable);
+}
+
+/** Cut a readable run into chunks; GHexEditRangeFunc. */
+static gboolean plan_run(guint64 start, guint64 end, gpointer user_data)
+{
+    GHexEditSearch *search = user_data;
+    guint64 starts_end = MIN(end, search->starts);
+    gsize overlap = ghexedit_pattern_get_overlap(search->pattern);
+    for (guint64 at = start; at < starts_end; at += CHUNK_SIZE)
+    {
+        Chunk chunk = {at, MIN(at + CHUNK_SIZE, starts_end), 0};
+        chunk.stop = MIN(chunk.end + overlap, end);
+        g_array_append_val(search->chunks, chunk);
+    }
+    return start < search->starts;
+}
+
+
+/* ===[ GHexEditSearch ]=== */
+/** The buffer being searched. */
+GHexEditBuffer *ghexedit_search_get_buffer(GHexEditSearch *search)
+{
+    return search->buffer;
+}
+
+/**
+ * Start searching on the worker pool. Matches are published on the calling
+ * thread's main context as they are found, through ::matches-added.
+ */
+void ghexedit_search_start(GHexEditSearch *search, GCancellable *cancellable)
+{
+    g_return_if_fail(search->cancellable == NULL);
+    search->cancellable = cancellable ? g_object_ref(cancellable) : g_cancellable_new();
+
+    search->size = ghexedit_buffer_get_size(search->buffer);
+    // Chunks cover the offsets a match could start at; a regex match may be
+    // as short as a byte, so that is every one
+    gsize length = ghexedit_pattern_get_length(search->pattern);
+    if (length == 0)
+        search->starts = search->size;
+    else
+        search->starts = search->size >= length ? search->size - length + 1 : 0;
+    // Stretches known to be unreadable, like the gaps between a process's
+    // mappings, are left out before any work is queued
+    GHexEditRangeSet *unreadable = ghexedit_range_set_new();
+    ghexedit_buffer_get_unreadable(search->buffer, 0, search->size, unreadable);
+    ghexedit_range_set_foreach_gap(unreadable, 0, search->size, plan_run, search);
+    ghexedit_range_set_free(unreadable);
+    search->n_chunks = search->chunks->len;
+    ghexedit_drain_init(&search->drain, search, drain, &search->lock, search->n_chunks);
+
+    search->active = ghexedit_workers_wanted(search->n_chunks);
+    ghexedit_workers_start(search, worker, search->active);
+}
+
+/** Stop searching; matches found so far are kept. */
+void ghexedit_search_cancel(GHexEditSearch *search)
+{
+    if (search->cancellable)
+        g_cancellable_cancel(search->cancellable);
+}
+
+/** Whether every worker has stopped and all matches are published. */
+gboolean ghexedit_search_get_finished(GHexEditSearch *search)
+{
+    return search->finished;
+}
+
+/** Why searching stopped early, once finished; NULL if it did not fail. */
+GError const *ghexedit_search_get_error(GHexEditSearch *search)
+{
+    return search->finished ? search->error : NULL;
+}
+
+/** Whether matching stopped at GHEXEDIT_SEARCH_MAX_MATCHES. */
+gboolean ghexedit_search_get_truncated(GHexEditSearch *search)
+{
+    return search->truncated;
+}
+
+/** Fraction of the buffer whose matches have been published. */
+double ghexedit_search_get_progress(GHexEditSearch *search)
+{
+    if (search->finished || search->n_chunks == 0)
+        return 1.0;
+    return (double)search->drain.published / search->n_chunks;
+}
+
+guint ghexedit_search_get_n_matches(GHexEditSearch *search)
+{
+    return search->matches->len;
+}
+
+GHexEditMatch const *ghexedit_search_get_match(GHexEditSearch *search, guint index)
+{
+    g_return_val_if_fail(index < search->matches->len, NULL);
+    return &g_array_index(search->matches, GHexEditMatch, index);
+}
+
+/**
+ * The first published match starting after `offset` going forward, or the
+ * last starting before it going backward. NULL if there is none.
+ */
+GHexEditMatch const *ghexedit_search_find(GHexEditSearch *search, guint64 offset, gboolean forward)
+{
+    // First match starting after offset
+    guint lo = 0, hi = search->matches->len;
+    while (lo < hi)
+    {
+        guint mid = lo + (hi - lo) / 2;
+        if (g_array_index(search->matches, GHexEditMatch, mid).offset <= offset)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    if (forward)
+        return lo < search->matches->len ? &g_array_index(search->matches, GHexEditMatch, lo) : NULL;
+    // Step back over a match starting exactly at offset
+    while (lo > 0 && g_array_index(search->matches, GHexEditMatch, lo - 1).offset >= offset)
+        --lo;
+    return lo > 0 ? &g_array_index(search->matches, GHexEditMatch, lo - 1) : NULL;
+}
+
+
+/* ===[ GObject ]=== */
+/** Prepare a search of `buffer`, which takes ownership of `pattern`. */
+GHexEditSearch *ghexedit_search_new(GHexEditBuffer *buffer, GHexEditPattern *pattern)
+{
+    GHexEditSearch *search = g_object_new(GHEXEDIT_TYPE_SEARCH, NULL);
+    search->buffer = g_object_ref(buffer);
+    search->pattern = pattern;
+    return search;
+}
+
+/** Called when a property is read with g_object_get. */
+void ghexedit_search_get_property(GObject *object, guint property_id, GValue *value, GParamSpec *pspec)
+{
+    GHexEditSearch *search = GHEXEDIT_SEARCH(object);
+    switch (property_id)
+    {
+    case PROP_PROGRESS:
+        g_value_set_double(value, ghexedit_search_get_progress(search));
+        break;
+    case PROP_FINISHED:
+        g_value_set_boolean(value, search->finished);
+        break;
+    default:
+        G_OBJECT_WARN_INVALID_PROPERTY_ID(object, property_id, pspec);
+        break;
+    }
+}
+
+/**
+ * Drop held references.
+ * Can be executed more than once!
+ * Should chain up before returning.
+ */
+void ghexedit_search_dispose(GObject *object)
+{
+    GHexEditSearch *search = GHEXEDIT_SEARCH(object);
+    // Workers hold references, so none are running by now
+    g_clear_object(&search->buffer);
+    g_clear_object(&search->cancellable);
+    G_OBJECT_CLASS(ghexedit_search_parent_class)->dispose(object);
+}
+
+/** Free remaining resources. */
+void ghexedit_search_finalize(GObject *object)
+{
+    GHexEditSearch *search = GHEXEDIT_SEARCH(object);
+    ghexedit_drain_clear(&search->drain, (GDestroyNotify)g_array_unref);
+    g_clear_error(&search->error);
+    g_array_unref(search->chunks);
+    g_array_unref(search->matches);
+    ghexedit_pattern_free(search->pattern);
+    g_mutex_clear(&search->lock);
+    G_OBJECT_CLASS(ghexedit_search_parent_class)->finalize(object);
+}
+
+
+/* ===[ Base GLib ]=== */
+/** Equivalent to C++ constructor. */
+void ghexedit_search_init(GHexEditSearch *search)
+{
+    search->matches = g_array_new(FALSE, FALSE, sizeof(GHexEditMatch));
+    search->chunks = g_array_new(FALSE, FALSE, sizeof(Chunk));
+    g_mutex_init(&search->lock);
+}
+
+/**
+ * Called upon first instantiation of an object of this class.
+ * Sets/overrides class methods/signals/properties.
+ */
+void ghexedit_search_class_init(GHexEditSearchClass *class)
+{
+    GObjectClass *klass = G_OBJECT_CLASS(class);
+    klass->get_property = ghexedit_search_get_property;
+    klass->dispose = ghexedit_search_dispose;
+    klass->finalize = ghexedit_search_finalize;
+
+    properties[PROP_PROGRESS] = g_param_spec_double("progress", "Progress", "Fraction of the buffer searched.", 0, 1, 0, G_PARAM_READABLE);
+    properties[PROP_FINISHED] = g_param_spec_boolean("finished", "Finished", "Whether the search has stopped.", FALSE, G_PARAM_READABLE);
+    g_object_class_install_properties(klass, N_PROPERTIES, properties);
+
+    /**
+     * Emitted on the main context when `added` matches were published,
+     * starting at index `position`.
+     */
+    signals[SIGNAL_MATCHES_ADDED] = g_signal_new("matches-added", G_TYPE_FROM_CLASS(class), G_SIGNAL_RUN_LAST, 0, NULL, NULL, NULL, G_TYPE_NONE, 2, G_TYPE_UINT, G_TYPE_UINT);
+}
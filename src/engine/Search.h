@@ -0,0 +1,46 @@
+/**
+ * Search.h - Parallel search over a buffer.
+ * Copyright (C) 2022 Trevor Last
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _GHX_SEARCH_H
+#define _GHX_SEARCH_H
+
+#include <gio/gio.h>
+
+#include "Buffer.h"
+#include "Pattern.h"
+
+
+/** Stop collecting matches past this many. */
+#define GHEXEDIT_SEARCH_MAX_MATCHES (1u << 22)
+
+#define GHEXEDIT_TYPE_SEARCH ghexedit_search_get_type()
+G_DECLARE_FINAL_TYPE(GHexEditSearch, ghexedit_search, GHEXEDIT, SEARCH, GObject);
+
+GHexEditSearch *ghexedit_search_new(GHexEditBuffer *buffer, GHexEditPattern *pattern);
+GHexEditBuffer *ghexedit_search_get_buffer(GHexEditSearch *search);
+void ghexedit_search_start(GHexEditSearch *search, GCancellable *cancellable);
+void ghexedit_search_cancel(GHexEditSearch *search);
+gboolean ghexedit_search_get_finished(GHexEditSearch *search);
+gboolean ghexedit_search_get_truncated(GHexEditSearch *search);
+GError const *ghexedit_search_get_error(GHexEditSearch *search);
+double ghexedit_search_get_progress(GHexEditSearch *search);
+guint ghexedit_search_get_n_matches(GHexEditSearch *search);
+GHexEditMatch const *ghexedit_search_get_match(GHexEditSearch *search, guint index);
+GHexEditMatch const *ghexedit_search_find(GHexEditSearch *search, guint64 offset, gboolean forward);
+
+#endif
@@ -0,0 +1,412 @@
+/**
+ * Session.c - Per-file state kept between runs.
+ * Copyright (C) 2022 Trevor Last
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "Session.h"
+
+#include <glib/gstdio.h>
+
+
+/** Bump when SESSION_TYPE changes; sessions saved by other versions are ignored. */
+#define SESSION_VERSION 1
+/**
+ * Version, URI, size and modification time (in microseconds) of the file
+ * when saved, cursor, top byte, then analyses by name.
+ */
+#define SESSION_TYPE "(ustxtta{sv})"
+/** Sessions kept; the least recently saved beyond this are deleted. */
+#define MAX_SESSIONS 256
+
+/**
+ * Where a file was left and what is known about it, kept in the user's cache
+ * directory from one run to the next. Saved state only comes back while the
+ * file's size and modification time are as they were, which is cheap to
+ * check and doesn't read the file. The session file is mapped, so analyses
+ * are only paged in when they are used.
+ */
+struct _GHexEditSession
+{
+    GObject parent;
+    GFile *file;
+    /** Whether the file's size and modification time could be read; without them nothing is saved. */
+    gboolean known;
+    guint64 size;
+    gint64 mtime;
+    /** Whether the state below was read back from a saved session. */
+    gboolean restored;
+    guint64 cursor;
+    guint64 top;
+    /** Analysis results by name, as GVariants. */
+    GHashTable *analyses;
+};
+
+G_DEFINE_TYPE(GHexEditSession, ghexedit_session, G_TYPE_OBJECT)
+
+/** A session on its way to disk. */
+typedef struct
+{
+    GFile *file;
+    char *uri;
+    char *path;
+    guint64 size;
+    gint64 mtime;
+    guint64 cursor;
+    guint64 top;
+    GVariant *analyses;
+} SaveData;
+
+/** A session file, by when it was last saved. */
+typedef struct
+{
+    char *path;
+    gint64 mtime;
+} SessionFile;
+
+
+/* ===[ Storage ]=== */
+/** The directory sessions are kept in. */
+static char *session_dir(void)
+{
+    return g_build_filename(g_get_user_cache_dir(), "ghexedit", "sessions", NULL);
+}
+
+/** The session file for `file`, named by a hash of its URI so any name fits. */
+static char *session_path(GFile *file)
+{
+    char *uri = g_file_get_uri(file);
+    char *name = g_compute_checksum_for_string(G_CHECKSUM_SHA1, uri, -1);
+    char *dir = session_dir();
+    char *path = g_build_filename(dir, name, NULL);
+    g_free(dir);
+    g_free(name);
+    g_free(uri);
+    return path;
+}
+
+/** Size and modification time of `file`; FALSE if they can't be had. */
+static gboolean query_identity(GFile *file, guint64 *size, gint64 *mtime, GCancellable *cancellable)
+{
+    GFileInfo *info = g_file_query_info(file, G_FILE_ATTRIBUTE_STANDARD_SIZE "," G_FILE_ATTRIBUTE_TIME_MODIFIED "," G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC, G_FILE_QUERY_INFO_NONE, cancellable, NULL);
+    if (info == NULL)
+        return FALSE;
+    gboolean ok = g_file_info_has_attribute(info, G_FILE_ATTRIBUTE_TIME_MODIFIED);
+    if (ok)
+    {
+        *size = g_file_info_get_size(info);
+        *mtime = (gint64)g_file_info_get_attribute_uint64(info, G_FILE_ATTRIBUTE_TIME_MODIFIED) * G_USEC_PER_SEC
+            + g_file_info_get_attribute_uint32(info, G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC);
+    }
+    g_object_unref(info);
+    return ok;
+}
+
+/** Read back the saved session, if it was saved for the file as it is now. */
+static void restore(GHexEditSession *session)
+{
+    char *path = session_path(session->file);
+    GMappedFile *mapped = g_mapped_file_new(path, FALSE, NULL);
+    g_free(path);
+    if (mapped == NULL)
+        return;
+    GBytes *bytes = g_mapped_file_get_bytes(mapped);
+    g_mapped_file_unref(mapped);
+    // Not trusted: a damaged file reads as zeroes, which don't match
+    GVariant *saved = g_variant_ref_sink(g_variant_new_from_bytes(G_VARIANT_TYPE(SESSION_TYPE), bytes, FALSE));
+    g_bytes_unref(bytes);
+
+    guint32 version;
+    char const *saved_uri;
+    guint64 size, cursor, top;
+    gint64 mtime;
+    GVariant *analyses;
+    g_variant_get(saved, "(u&stxtt@a{sv})", &version, &saved_uri, &size, &mtime, &cursor, &top, &analyses);
+    char *uri = g_file_get_uri(session->file);
+    if (version == SESSION_VERSION && g_strcmp0(saved_uri, uri) == 0 && size == session->size && mtime == session->mtime)
+    {
+        session->restored = TRUE;
+        session->cursor = cursor;
+        session->top = top;
+        GVariantIter iter;
+        char *name;
+        GVariant *value;
+        g_variant_iter_init(&iter, analyses);
+        while (g_variant_iter_next(&iter, "{sv}", &name, &value))
+            g_hash_table_replace(session->analyses, name, value);
+    }
+    g_free(uri);
+    g_variant_unref(analyses);
+    g_variant_unref(saved);
+}
+
+static int session_file_compare_newest(gconstpointer a, gconstpointer b)
+{
+    gint64 a_mtime = ((SessionFile const *)a)->mtime, b_mtime = ((SessionFile const *)b)->mtime;
+    return (a_mtime < b_mtime) - (a_mtime > b_mtime);
+}
+
+/** Delete the least recently saved sessions beyond MAX_SESSIONS. */
+static void prune(char const *dir)
+{
+    GDir *handle = g_dir_open(dir, 0, NULL);
+    if (handle == NULL)
+        return;
+    GArray *files = g_array_new(FALSE, FALSE, sizeof(SessionFile));
+    char const *name;
+    while ((name = g_dir_read_name(handle)))
+    {
+        SessionFile file = {g_build_filename(dir, name, NULL), 0};
+        GStatBuf status;
+        if (g_stat(file.path, &status) == 0)
+        {
+            file.mtime = status.st_mtime;
+            g_array_append_val(files, file);
+        }
+        else
+            g_free(file.path);
+    }
+    g_dir_close(handle);
+
+    if (files->len > MAX_SESSIONS)
+    {
+        g_array_sort(files, session_file_compare_newest);
+        for (guint i = MAX_SESSIONS; i < files->len; ++i)
+            g_remove(g_array_index(files, SessionFile, i).path);
+    }
+    for (guint i = 0; i < files->len; ++i)
+        g_free(g_array_index(files, SessionFile, i).path);
+    g_array_unref(files);
+}
+
+static void save_data_free(SaveData *data)
+{
+    g_object_unref(data->file);
+    g_free(data->uri);
+    g_free(data->path);
+    g_variant_unref(data->analyses);
+    g_free(data);
+}
+
+static void load_thread(GTask *task, gpointer source_object, gpointer task_data, GCancellable *cancellable)
+{
+    GHexEditSession *session = g_object_new(GHEXEDIT_TYPE_SESSION, NULL);
+    session->file = g_object_ref(task_data);
+    session->known = query_identity(session->file, &session->size, &session->mtime, cancellable);
+    if (session->known)
+        restore(session);
+
+    if (g_task_return_error_if_cancelled(task))
+        g_object_unref(session);
+    else
+        g_task_return_pointer(task, session, g_object_unref);
+}
+
+static void save_thread(GTask *task, gpointer source_object, gpointer task_data, GCancellable *cancellable)
+{
+    SaveData *data = task_data;
+    guint64 size;
+    gint64 mtime;
+    // Gone, or no longer telling; nothing could be matched to it later
+    if (!query_identity(data->file, &size, &mtime, cancellable))
+    {
+        g_task_return_boolean(task, TRUE);
+        return;
+    }
+    // Changed since it was opened (saved over, or followed as it grew):
+    // where it was left still holds, but the analyses were of what it was
+    GVariant *analyses = data->analyses;
+    if (size != data->size || mtime != data->mtime)
+        analyses = g_variant_new("a{sv}", NULL);
+    GVariant *state = g_variant_ref_sink(g_variant_new("(ustxtt@a{sv})", SESSION_VERSION, data->uri, size, mtime, data->cursor, data->top, analyses));
+    GBytes *bytes = g_variant_get_data_as_bytes(state);
+
+    GError *error = NULL;
+    char *dir = session_dir();
+    g_mkdir_with_parents(dir, 0700);
+    GFile *target = g_file_new_for_path(data->path);
+    // Written aside and renamed over, so a mapped older session stays intact
+    gboolean ok = g_file_replace_contents(target, g_bytes_get_data(bytes, NULL), g_bytes_get_size(bytes), NULL, FALSE, G_FILE_CREATE_PRIVATE, NULL, cancellable, &error);
+    if (ok)
+        prune(dir);
+    g_object_unref(target);
+    g_free(dir);
+    g_bytes_unref(bytes);
+    g_variant_unref(state);
+
+    if (ok)
+        g_task_return_boolean(task, TRUE);
+    else
+        g_task_return_error(task, error);
+}
+
+
+/* ===[ GHexEditSession ]=== */
+/**
+ * Load the session for `file` on a worker thread. There is always one: if
+ * nothing was saved, or the file has changed since, it starts out empty.
+ */
+void ghexedit_session_load_async(GFile *file, GCancellable *cancellable, GAsyncReadyCallback callback, gpointer user_data)
+{
+    GTask *task = g_task_new(NULL, cancellable, callback, user_data);
+    g_task_set_source_tag(task, ghexedit_session_load_async);
+    g_task_set_task_data(task, g_object_ref(file), g_object_unref);
+    g_task_run_in_thread(task, load_thread);
+    g_object_unref(task);
+}
+
+GHexEditSession *ghexedit_session_load_finish(GAsyncResult *result, GError **error)
+{
+    g_return_val_if_fail(g_task_is_valid(result, NULL), NULL);
+    return g_task_propagate_pointer(G_TASK(result), error);
+}
+
+/**
+ * Save the session on a worker thread, stamped with the file's size and
+ * modification time. Analyses are dropped if the file has changed since the
+ * session was loaded.
+ */
+void ghexedit_session_save_async(GHexEditSession *session, GCancellable *cancellable, GAsyncReadyCallback callback, gpointer user_data)
+{
+    GTask *task = g_task_new(session, cancellable, callback, user_data);
+    g_task_set_source_tag(task, ghexedit_session_save_async);
+    if (!session->known)
+    {
+        g_task_return_boolean(task, TRUE);
+        g_object_unref(task);
+        return;
+    }
+
+    GVariantBuilder analyses;
+    g_variant_builder_init(&analyses, G_VARIANT_TYPE("a{sv}"));
+    GHashTableIter iter;
+    gpointer name, value;
+    g_hash_table_iter_init(&iter, session->analyses);
+    while (g_hash_table_iter_next(&iter, &name, &value))
+        g_variant_builder_add(&analyses, "{sv}", name, value);
+
+    SaveData *data = g_new0(SaveData, 1);
+    data->file = g_object_ref(session->file);
+    data->uri = g_file_get_uri(session->file);
+    data->path = session_path(session->file);
+    data->size = session->size;
+    data->mtime = session->mtime;
+    data->cursor = session->cursor;
+    data->top = session->top;
+    // Serialised on the worker; until then the values are only referenced
+    data->analyses = g_variant_ref_sink(g_variant_builder_end(&analyses));
+    g_task_set_task_data(task, data, (GDestroyNotify)save_data_free);
+    g_task_run_in_thread(task, save_thread);
+    g_object_unref(task);
+}
+
+gboolean ghexedit_session_save_finish(GHexEditSession *session, GAsyncResult *result, GError **error)
+{
+    g_return_val_if_fail(g_task_is_valid(result, session), FALSE);
+    return g_task_propagate_boolean(G_TASK(result), error);
+}
+
+/** The file this is the session of. */
+GFile *ghexedit_session_get_file(GHexEditSession *session)
+{
+    return session->file;
+}
+
+/** Whether a saved session was found for the file as it is. */
+gboolean ghexedit_session_get_restored(GHexEditSession *session)
+{
+    return session->restored;
+}
+
+/** Remember where the cursor was left. */
+void ghexedit_session_set_cursor(GHexEditSession *session, guint64 cursor)
+{
+    session->cursor = cursor;
+}
+
+guint64 ghexedit_session_get_cursor(GHexEditSession *session)
+{
+    return session->cursor;
+}
+
+/** Remember the first byte scrolled to. */
+void ghexedit_session_set_top(GHexEditSession *session, guint64 top)
+{
+    session->top = top;
+}
+
+guint64 ghexedit_session_get_top(GHexEditSession *session)
+{
+    return session->top;
+}
+
+/**
+ * Keep an analysis of the file under `name`, to be saved with the session;
+ * NULL forgets it. It should describe the file as it is on disk.
+ */
+void ghexedit_session_set_analysis(GHexEditSession *session, char const *name, GVariant *value)
+{
+    if (value)
+        g_hash_table_replace(session->analyses, g_strdup(name), g_variant_ref_sink(value));
+    else
+        g_hash_table_remove(session->analyses, name);
+}
+
+/** The analysis kept under `name`, or NULL. */
+GVariant *ghexedit_session_get_analysis(GHexEditSession *session, char const *name)
+{
+    return g_hash_table_lookup(session->analyses, name);
+}
+
+
+/* ===[ GObject ]=== */
+/**
+ * Drop held references.
+ * Can be executed more than once!
+ * Should chain up before returning.
+ */
+void ghexedit_session_dispose(GObject *object)
+{
+    GHexEditSession *session = GHEXEDIT_SESSION(object);
+    g_clear_object(&session->file);
+    G_OBJECT_CLASS(ghexedit_session_parent_class)->dispose(object);
+}
+
+/** Free remaining resources. */
+void ghexedit_session_finalize(GObject *object)
+{
+    GHexEditSession *session = GHEXEDIT_SESSION(object);
+    g_hash_table_unref(session->analyses);
+    G_OBJECT_CLASS(ghexedit_session_parent_class)->finalize(object);
+}
+
+
+/* ===[ Base GLib ]=== */
+/** Equivalent to C++ constructor. */
+void ghexedit_session_init(GHexEditSession *session)
+{
+    session->analyses = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, (GDestroyNotify)g_variant_unref);
+}
+
+/**
+ * Called upon first instantiation of an object of this class.
+ * Sets/overrides class methods/signals/properties.
+ */
+void ghexedit_session_class_init(GHexEditSessionClass *class)
+{
+    GObjectClass *klass = G_OBJECT_CLASS(class);
+    klass->dispose = ghexedit_session_dispose;
+    klass->finalize = ghexedit_session_finalize;
+}
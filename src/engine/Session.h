@@ -0,0 +1,41 @@
+/**
+ * Session.h - Per-file state kept between runs.
+ * Copyright (C) 2022 Trevor Last
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _GHX_SESSION_H
+#define _GHX_SESSION_H
+
+#include <gio/gio.h>
+
+
+#define GHEXEDIT_TYPE_SESSION ghexedit_session_get_type()
+G_DECLARE_FINAL_TYPE(GHexEditSession, ghexedit_session, GHEXEDIT, SESSION, GObject);
+
+void ghexedit_session_load_async(GFile *file, GCancellable *cancellable, GAsyncReadyCallback callback, gpointer user_data);
+GHexEditSession *ghexedit_session_load_finish(GAsyncResult *result, GError **error);
+void ghexedit_session_save_async(GHexEditSession *session, GCancellable *cancellable, GAsyncReadyCallback callback, gpointer user_data);
+gboolean ghexedit_session_save_finish(GHexEditSession *session, GAsyncResult *result, GError **error);
+GFile *ghexedit_session_get_file(GHexEditSession *session);
+gboolean ghexedit_session_get_restored(GHexEditSession *session);
+void ghexedit_session_set_cursor(GHexEditSession *session, guint64 cursor);
+guint64 ghexedit_session_get_cursor(GHexEditSession *session);
+void ghexedit_session_set_top(GHexEditSession *session, guint64 top);
+guint64 ghexedit_session_get_top(GHexEditSession *session);
+void ghexedit_session_set_analysis(GHexEditSession *session, char const *name, GVariant *value);
+GVariant *ghexedit_session_get_analysis(GHexEditSession *session, char const *name);
+
+#endif
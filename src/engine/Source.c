@@ -0,0 +1,213 @@
+/**
+ * Source.c - Backing stores read a page at a time.
+ * Copyright (C) 2022 Trevor Last
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#define _GNU_SOURCE
+
+#include "Source.h"
+
+#include <glib/gstdio.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+/** A regular file read with pread, skipping the holes of sparse ones. */
+typedef struct
+{
+    GHexEditSource parent;
+    int fd;
+    /** The file has holes and SEEK_DATA works on it. */
+    gboolean sparse;
+} FileSource;
+
+
+/* ===[ Files ]=== */
+/**
+ * pread all of [offset, offset + length) into `dest`, zeroing whatever the
+ * file no longer has. Bytes that fail with EIO are zeroed and marked
+ * unreadable; other errors fail the read.
+ */
+static gboolean read_data(FileSource *file, guint64 offset, guint8 *dest, gsize length, GHexEditRangeSet *unreadable, GError **error)
+{
+    gsize total = 0;
+    while (total < length)
+    {
+        ssize_t got = pread(file->fd, dest + total, length - total, offset + total);
+        if (got < 0 && errno == EINTR)
+            continue;
+        if (got < 0 && errno == EIO)
+        {
+            memset(dest + total, 0, length - total);
+            ghexedit_range_set_add(unreadable, offset + total, offset + length);
+            return TRUE;
+        }
+        if (got < 0)
+        {
+            int saved = errno;
+            g_set_error(error, G_IO_ERROR, g_io_error_from_errno(saved), "%s", g_strerror(saved));
+            return FALSE;
+        }
+        // The file shrank underneath us
+        if (got == 0)
+        {
+            memset(dest + total, 0, length - total);
+            return TRUE;
+        }
+        total += got;
+    }
+    return TRUE;
+}
+
+/** Holes are filled with zeroes without a read; only data extents touch the disk. */
+static gssize file_read(GHexEditSource *source, guint64 offset, guint8 *dest, gsize length, GHexEditRangeSet *unreadable, GError **error)
+{
+    FileSource *file = (FileSource *)source;
+    length = offset < source->size ? MIN(length, source->size - offset) : 0;
+    guint64 end = offset + length;
+    guint64 pos = offset;
+    while (pos < end)
+    {
+        guint64 data_end = end;
+        if (file->sparse)
+        {
+            off_t data = lseek(file->fd, pos, SEEK_DATA);
+            // ENXIO: nothing but hole from here to the end of the file
+            guint64 next = data < 0 ? (errno == ENXIO ? end : pos) : MIN((guint64)data, end);
+            if (next > pos)
+            {
+                memset(dest + (pos - offset), 0, next - pos);
+                pos = next;
+                continue;
+            }
+            off_t hole = lseek(file->fd, pos, SEEK_HOLE);
+            if (hole > 0)
+                data_end = MIN((guint64)hole, end);
+        }
+        if (!read_data(file, pos, dest + (pos - offset), data_end - pos, unreadable, error))
+            return -1;
+        pos = data_end;
+    }
+    return length;
+}
+
+static void file_free(GHexEditSource *source)
+{
+    FileSource *file = (FileSource *)source;
+    g_close(file->fd, NULL);
+    g_free(file);
+}
+
+static GHexEditSourceClass const file_class = {
+    .read = file_read,
+    .get_unreadable = NULL,
+    .free = file_free,
+};
+
+/**
+ * Open a local file for pread access.
+ * Returns NULL without setting `error` if the file can't seek (a pipe or a
+ * character device), so that it can be spooled instead.
+ */
+GHexEditSource *ghexedit_source_open_file(char const *path, GError **error)
+{
+    int fd = g_open(path, O_RDONLY | O_CLOEXEC, 0);
+    if (fd < 0)
+    {
+        int saved = errno;
+        g_set_error(error, G_IO_ERROR, g_io_error_from_errno(saved), "%s: %s", path, g_strerror(saved));
+        return NULL;
+    }
+    off_t end = lseek(fd, 0, SEEK_END);
+    if (end < 0)
+    {
+        g_close(fd, NULL);
+        return NULL;
+    }
+    FileSource *file = g_new0(FileSource, 1);
+    file->parent.klass = &file_class;
+    file->parent.size = end;
+    file->parent.alignment = 1;
+    file->fd = fd;
+    // Fewer blocks allocated than the size needs means holes
+    struct stat st;
+    file->sparse = fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && (guint64)st.st_blocks * 512 < (guint64)st.st_size
+        && lseek(fd, 0, SEEK_DATA) >= 0;
+    return &file->parent;
+}
+
+
+/* ===[ GHexEditSource ]=== */
+/** Whether `path` names a process's memory, `/proc/<pid>/mem`. */
+gboolean ghexedit_source_is_process_path(char const *path)
+{
+    if (!g_str_has_prefix(path, "/proc/") || !g_str_has_suffix(path, "/mem"))
+        return FALSE;
+    char const *pid = path + strlen("/proc/");
+    gsize digits = strlen(pid) - strlen("/mem");
+    if (digits == 0)
+        return FALSE;
+    if (digits == strlen("self") && strncmp(pid, "self", digits) == 0)
+        return TRUE;
+    for (gsize i = 0; i < digits; ++i)
+        if (!g_ascii_isdigit(pid[i]))
+            return FALSE;
+    return TRUE;
+}
+
+/**
+ * Open the right kind of source for a local path: process memory, a block
+ * device, or a file. Like ghexedit_source_open_file, returns NULL without
+ * an error for things that can't seek.
+ */
+GHexEditSource *ghexedit_source_open(char const *path, GError **error)
+{
+    if (ghexedit_source_is_process_path(path))
+        return ghexedit_source_open_process(path, error);
+    GStatBuf st;
+    if (g_stat(path, &st) == 0 && S_ISBLK(st.st_mode))
+        return ghexedit_source_open_device(path, error);
+    return ghexedit_source_open_file(path, error);
+}
+
+void ghexedit_source_free(GHexEditSource *source)
+{
+    if (source)
+        source->klass->free(source);
+}
+
+/** Size in bytes, fixed when the source was opened. */
+guint64 ghexedit_source_get_size(GHexEditSource *source)
+{
+    return source->size;
+}
+
+/** Read straight from the source, bypassing any cache. See GHexEditSourceClass.read. */
+gssize ghexedit_source_read(GHexEditSource *source, guint64 offset, guint8 *dest, gsize length, GHexEditRangeSet *unreadable, GError **error)
+{
+    return source->klass->read(source, offset, dest, length, unreadable, error);
+}
+
+/** Add the ranges within `length` at `offset` that can be known unreadable without reading. */
+void ghexedit_source_get_unreadable(GHexEditSource *source, guint64 offset, guint64 length, GHexEditRangeSet *unreadable)
+{
+    if (source->klass->get_unreadable)
+        source->klass->get_unreadable(source, offset, length, unreadable);
+}
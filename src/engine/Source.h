@@ -0,0 +1,67 @@
+/**
+ * Source.h - Backing stores read a page at a time.
+ * Copyright (C) 2022 Trevor Last
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _GHX_SOURCE_H
+#define _GHX_SOURCE_H
+
+#include <gio/gio.h>
+
+#include "RangeSet.h"
+
+
+typedef struct _GHexEditSource GHexEditSource;
+
+/**
+ * What a kind of backing store provides. Reads are for whole pages at
+ * page-aligned offsets, except for the last page, and may come from any
+ * thread at once.
+ */
+typedef struct
+{
+    /**
+     * Copy up to `length` bytes at `offset` into `dest`. Bytes that can't be
+     * read are zeroed and added to `unreadable`. Returns the number copied,
+     * short only at the end, or -1 if nothing could be attempted.
+     */
+    gssize (*read)(GHexEditSource *source, guint64 offset, guint8 *dest, gsize length, GHexEditRangeSet *unreadable, GError **error);
+    /** Optional: add ranges known to be unreadable without reading them. */
+    void (*get_unreadable)(GHexEditSource *source, guint64 offset, guint64 length, GHexEditRangeSet *unreadable);
+    void (*free)(GHexEditSource *source);
+} GHexEditSourceClass;
+
+/** Fields shared by every source; each kind extends this. */
+struct _GHexEditSource
+{
+    GHexEditSourceClass const *klass;
+    guint64 size;
+    /** Alignment read buffers need, for direct I/O; 1 if none. */
+    gsize alignment;
+};
+
+GHexEditSource *ghexedit_source_open(char const *path, GError **error);
+GHexEditSource *ghexedit_source_open_file(char const *path, GError **error);
+GHexEditSource *ghexedit_source_open_device(char const *path, GError **error);
+GHexEditSource *ghexedit_source_open_process(char const *path, GError **error);
+GHexEditSource *ghexedit_source_open_stream(GInputStream *stream, guint64 size);
+gboolean ghexedit_source_is_process_path(char const *path);
+void ghexedit_source_free(GHexEditSource *source);
+guint64 ghexedit_source_get_size(GHexEditSource *source);
+gssize ghexedit_source_read(GHexEditSource *source, guint64 offset, guint8 *dest, gsize length, GHexEditRangeSet *unreadable, GError **error);
+void ghexedit_source_get_unreadable(GHexEditSource *source, guint64 offset, guint64 length, GHexEditRangeSet *unreadable);
+
+#endif
@@ -0,0 +1,75 @@
+/**
+ * StreamSource.c - Seekable GIO streams, for files on remote mounts.
+ * Copyright (C) 2022 Trevor Last
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "Source.h"
+
+
+/**
+ * A seekable GInputStream, such as a file on an sftp:// or smb:// mount.
+ * The stream has one position, so reads take turns; the page cache in front
+ * keeps them to pages nobody has fetched yet.
+ */
+typedef struct
+{
+    GHexEditSource parent;
+    GInputStream *stream;
+    GMutex lock;
+} StreamSource;
+
+
+/** Seek and read a page. A failed read fails the page; it can be retried later. */
+static gssize stream_read(GHexEditSource *source, guint64 offset, guint8 *dest, gsize length, GHexEditRangeSet *unreadable, GError **error)
+{
+    StreamSource *stream = (StreamSource *)source;
+    length = offset < source->size ? MIN(length, source->size - offset) : 0;
+    gsize total = 0;
+    g_mutex_lock(&stream->lock);
+    gboolean ok = g_seekable_seek(G_SEEKABLE(stream->stream), offset, G_SEEK_SET, NULL, error)
+        && g_input_stream_read_all(stream->stream, dest, length, &total, NULL, error);
+    g_mutex_unlock(&stream->lock);
+    return ok ? (gssize)total : -1;
+}
+
+static void stream_free(GHexEditSource *source)
+{
+    StreamSource *stream = (StreamSource *)source;
+    g_object_unref(stream->stream);
+    g_mutex_clear(&stream->lock);
+    g_free(stream);
+}
+
+static GHexEditSourceClass const stream_class = {
+    .read = stream_read,
+    .get_unreadable = NULL,
+    .free = stream_free,
+};
+
+
+/* ===[ GHexEditSource ]=== */
+/** Read `size` bytes of a stream that can seek. Takes a reference to `stream`. */
+GHexEditSource *ghexedit_source_open_stream(GInputStream *stream, guint64 size)
+{
+    g_return_val_if_fail(G_IS_SEEKABLE(stream) && g_seekable_can_seek(G_SEEKABLE(stream)), NULL);
+    StreamSource *source = g_new0(StreamSource, 1);
+    source->parent.klass = &stream_class;
+    source->parent.size = size;
+    source->parent.alignment = 1;
+    source->stream = g_object_ref(stream);
+    g_mutex_init(&source->lock);
+    return &source->parent;
+}
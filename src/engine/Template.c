@@ -0,0 +1,430 @@
+/**
+ * Template.c - Declarative binary templates.
+ * Copyright (C) 2022 Trevor Last
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "Template.h"
+
+#include <gio/gio.h>
+#include <glib.h>
+
+#include <string.h>
+
+
+/**
+ * A template is a list of structs, the first of which describes the start
+ * of the file:
+ *
+ *     // Comments run to the end of the line
+ *     struct File {
+ *         char magic[4];
+ *         u32 count;
+ *         Record records[count];
+ *     }
+ *     struct Record {
+ *         u16be length;
+ *         u8 data[length];
+ *     }
+ *
+ * Integer types are u8, i8, u16, i16, u32, i32, u64 and i64, floats f32 and
+ * f64; all but the single bytes take an optional `le` or `be` suffix and
+ * default to little-endian. `char` arrays show as strings. An array's count
+ * is a number or an earlier integer field of the same struct.
+ */
+struct _GHexEditTemplate
+{
+    gint ref_count;
+    /** GHexEditTemplateStruct*, the first being the root. */
+    GPtrArray *structs;
+};
+
+/** Scalar type names and what they mean. */
+static struct
+{
+    char const *name;
+    GHexEditFieldKind kind;
+    guint width;
+    gboolean is_signed;
+} const scalar_types[] = {
+    {"u8", GHEXEDIT_FIELD_INT, 1, FALSE},
+    {"i8", GHEXEDIT_FIELD_INT, 1, TRUE},
+    {"u16", GHEXEDIT_FIELD_INT, 2, FALSE},
+    {"i16", GHEXEDIT_FIELD_INT, 2, TRUE},
+    {"u32", GHEXEDIT_FIELD_INT, 4, FALSE},
+    {"i32", GHEXEDIT_FIELD_INT, 4, TRUE},
+    {"u64", GHEXEDIT_FIELD_INT, 8, FALSE},
+    {"i64", GHEXEDIT_FIELD_INT, 8, TRUE},
+    {"f32", GHEXEDIT_FIELD_FLOAT, 4, TRUE},
+    {"f64", GHEXEDIT_FIELD_FLOAT, 8, TRUE},
+    {"char", GHEXEDIT_FIELD_CHAR, 1, FALSE},
+};
+
+/** Where the parser is up to. */
+typedef struct
+{
+    char const *p;
+    guint line;
+    GHexEditTemplate *template;
+    /** Struct names, to the index in `structs` plus one. */
+    GHashTable *names;
+} Parser;
+
+
+/* ===[ Lexing ]=== */
+/** Skip whitespace and comments, counting lines. */
+static void skip_space(Parser *parser)
+{
+    for (;;)
+    {
+        if (*parser->p == '\n')
+            ++parser->line;
+        if (g_ascii_isspace(*parser->p))
+            ++parser->p;
+        else if (parser->p[0] == '/' && parser->p[1] == '/')
+        {
+            while (*parser->p && *parser->p != '\n')
+                ++parser->p;
+        }
+        else
+            return;
+    }
+}
+
+/** Consume `c` if it comes next. */
+static gboolean accept(Parser *parser, char c)
+{
+    skip_space(parser);
+    if (*parser->p != c)
+        return FALSE;
+    ++parser->p;
+    return TRUE;
+}
+
+/** Consume `c`, or fail with an error naming `what` it was for. */
+static gboolean expect(Parser *parser, char c, char const *what, GError **error)
+{
+    if (accept(parser, c))
+        return TRUE;
+    g_set_error(error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT, "Line %u: expected '%c' %s", parser->line, c, what);
+    return FALSE;
+}
+
+/** A new string of the identifier that comes next, or NULL. */
+static char *identifier(Parser *parser)
+{
+    skip_space(parser);
+    char const *start = parser->p;
+    if (!g_ascii_isalpha(*start) && *start != '_')
+        return NULL;
+    while (g_ascii_isalnum(*parser->p) || *parser->p == '_')
+        ++parser->p;
+    return g_strndup(start, parser->p - start);
+}
+
+/** Parse a decimal or 0x-prefixed number, if one comes next. */
+static gboolean number(Parser *parser, guint64 *value)
+{
+    skip_space(parser);
+    if (!g_ascii_isdigit(*parser->p))
+        return FALSE;
+    gboolean hex = parser->p[0] == '0' && (parser->p[1] == 'x' || parser->p[1] == 'X');
+    char *end;
+    *value = g_ascii_strtoull(parser->p + (hex ? 2 : 0), &end, hex ? 16 : 10);
+    parser->p = end;
+    return TRUE;
+}
+
+
+/* ===[ Parsing ]=== */
+/** Free a field's strings; GArray clear function. */
+static void field_clear(gpointer data)
+{
+    GHexEditTemplateField *field = data;
+    g_free(field->name);
+    g_free(field->type_name);
+}
+
+/** Free a struct; GPtrArray free function. */
+static void struct_free(gpointer data)
+{
+    GHexEditTemplateStruct *st = data;
+    g_free(st->name);
+    g_array_unref(st->fields);
+    g_free(st);
+}
+
+/** Fill in a field's type from its name; struct types are resolved later. */
+static void set_type(GHexEditTemplateField *field)
+{
+    gsize length = strlen(field->type_name);
+    for (guint i = 0; i < G_N_ELEMENTS(scalar_types); ++i)
+    {
+        gsize n = strlen(scalar_types[i].name);
+        if (strncmp(field->type_name, scalar_types[i].name, n) != 0)
+            continue;
+        char const *suffix = field->type_name + n;
+        gboolean endian = scalar_types[i].width > 1 && (!strcmp(suffix, "le") || !strcmp(suffix, "be"));
+        if (length != n && !endian)
+            continue;
+        field->kind = scalar_types[i].kind;
+        field->width = scalar_types[i].width;
+        field->is_signed = scalar_types[i].is_signed;
+        field->big_endian = endian && suffix[0] == 'b';
+        return;
+    }
+    field->kind = GHEXEDIT_FIELD_STRUCT;
+}
+
+/** The index of the field called `name` in `fields`, or -1. */
+static gint find_field(GArray *fields, char const *name)
+{
+    for (guint i = 0; i < fields->len; ++i)
+        if (!strcmp(g_array_index(fields, GHexEditTemplateField, i).name, name))
+            return i;
+    return -1;
+}
+
+/** `type name;` or `type name[count];`, appended to `st`. */
+static gboolean parse_field(Parser *parser, GHexEditTemplateStruct *st, GError **error)
+{
+    GHexEditTemplateField field = {.count = 1, .count_field = -1};
+    field.type_name = identifier(parser);
+    field.name = identifier(parser);
+    if (field.type_name == NULL || field.name == NULL)
+    {
+        g_set_error(error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT, "Line %u: expected a type and a field name", parser->line);
+        field_clear(&field);
+        return FALSE;
+    }
+    set_type(&field);
+    if (find_field(st->fields, field.name) >= 0)
+    {
+        g_set_error(error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT, "Line %u: '%s' is already a field of '%s'", parser->line, field.name, st->name);
+        field_clear(&field);
+        return FALSE;
+    }
+
+    if (accept(parser, '['))
+    {
+        field.is_array = TRUE;
+        char *count = NULL;
+        if (!number(parser, &field.count) && (count = identifier(parser)) == NULL)
+        {
+            g_set_error(error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT, "Line %u: expected a number or field name as the count of '%s'", parser->line, field.name);
+            field_clear(&field);
+            return FALSE;
+        }
+        if (count)
+        {
+            field.count_field = find_field(st->fields, count);
+            GHexEditTemplateField const *counter = field.count_field >= 0 ? &g_array_index(st->fields, GHexEditTemplateField, field.count_field) : NULL;
+            if (counter == NULL || counter->kind != GHEXEDIT_FIELD_INT || counter->is_array)
+            {
+                g_set_error(error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT, "Line %u: the count of '%s' must be an earlier integer field, not '%s'", parser->line, field.name, count);
+                g_free(count);
+                field_clear(&field);
+                return FALSE;
+            }
+            g_free(count);
+        }
+        if (!expect(parser, ']', "after an array count", error))
+        {
+            field_clear(&field);
+            return FALSE;
+        }
+    }
+    if (!expect(parser, ';', "after a field", error))
+    {
+        field_clear(&field);
+        return FALSE;
+    }
+    g_array_append_val(st->fields, field);
+    return TRUE;
+}
+
+/** `struct Name { fields }`, appended to the template. */
+static gboolean parse_struct(Parser *parser, GError **error)
+{
+    char *keyword = identifier(parser);
+    gboolean is_struct = keyword && !strcmp(keyword, "struct");
+    g_free(keyword);
+    if (!is_struct)
+    {
+        g_set_error(error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT, "Line %u: expected 'struct'", parser->line);
+        return FALSE;
+    }
+    char *name = identifier(parser);
+    if (name == NULL)
+    {
+        g_set_error(error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT, "Line %u: expected a struct name", parser->line);
+        return FALSE;
+    }
+    if (g_hash_table_contains(parser->names, name))
+    {
+        g_set_error(error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT, "Line %u: struct '%s' is defined twice", parser->line, name);
+        g_free(name);
+        return FALSE;
+    }
+
+    GHexEditTemplateStruct *st = g_new0(GHexEditTemplateStruct, 1);
+    st->name = name;
+    st->fields = g_array_new(FALSE, FALSE, sizeof(GHexEditTemplateField));
+    g_array_set_clear_func(st->fields, field_clear);
+    g_ptr_array_add(parser->template->structs, st);
+    g_hash_table_insert(parser->names, name, GUINT_TO_POINTER(parser->template->structs->len));
+
+    if (!expect(parser, '{', "to open a struct", error))
+        return FALSE;
+    while (!accept(parser, '}'))
+    {
+        if (*parser->p == '\0')
+        {
+            g_set_error(error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT, "Line %u: struct '%s' is missing its '}'", parser->line, name);
+            return FALSE;
+        }
+        if (!parse_field(parser, st, error))
+            return FALSE;
+    }
+    accept(parser, ';');
+    return TRUE;
+}
+
+/** Point struct-typed fields at their structs. */
+static gboolean resolve(Parser *parser, GError **error)
+{
+    for (guint s = 0; s < parser->template->structs->len; ++s)
+    {
+        GHexEditTemplateStruct *st = g_ptr_array_index(parser->template->structs, s);
+        for (guint f = 0; f < st->fields->len; ++f)
+        {
+            GHexEditTemplateField *field = &g_array_index(st->fields, GHexEditTemplateField, f);
+            if (field->kind != GHEXEDIT_FIELD_STRUCT)
+                continue;
+            guint index = GPOINTER_TO_UINT(g_hash_table_lookup(parser->names, field->type_name));
+            if (index == 0)
+            {
+                g_set_error(error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT, "Field '%s' of '%s' has unknown type '%s'", field->name, st->name, field->type_name);
+                return FALSE;
+            }
+            field->struct_index = index - 1;
+        }
+    }
+    return TRUE;
+}
+
+/**
+ * Work out the size of struct `index` if it's fixed, depth first. `state`
+ * marks structs in progress (1) and done (2), to catch a struct containing
+ * itself other than through a variable-length array, which would never end.
+ */
+static gboolean measure(GHexEditTemplate *template, guint index, guint8 *state, GError **error)
+{
+    GHexEditTemplateStruct *st = g_ptr_array_index(template->structs, index);
+    state[index] = 1;
+    gint64 size = 0;
+    for (guint f = 0; f < st->fields->len; ++f)
+    {
+        GHexEditTemplateField *field = &g_array_index(st->fields, GHexEditTemplateField, f);
+        gint64 element = field->width;
+        if (field->kind == GHEXEDIT_FIELD_STRUCT)
+        {
+            if (state[field->struct_index] == 1 && field->count_field < 0)
+            {
+                g_set_error(error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT, "Struct '%s' contains itself through field '%s'", st->name, field->name);
+                return FALSE;
+            }
+            if (state[field->struct_index] == 0 && !measure(template, field->struct_index, state, error))
+                return FALSE;
+            GHexEditTemplateStruct *type = g_ptr_array_index(template->structs, field->struct_index);
+            element = state[field->struct_index] == 2 ? type->size : -1;
+        }
+        if (size < 0 || element < 0 || field->count_field >= 0 || (element && field->count > (guint64)G_MAXINT64 / element))
+            size = -1;
+        else
+            size += element * field->count;
+    }
+    st->size = size;
+    state[index] = 2;
+    return TRUE;
+}
+
+
+/* ===[ Template ]=== */
+/** Compile template source `text`. NULL and sets `error` if it's invalid. */
+GHexEditTemplate *ghexedit_template_new(char const *text, GError **error)
+{
+    GHexEditTemplate *template = g_new0(GHexEditTemplate, 1);
+    template->ref_count = 1;
+    template->structs = g_ptr_array_new_with_free_func(struct_free);
+    Parser parser = {
+        .p = text,
+        .line = 1,
+        .template = template,
+        .names = g_hash_table_new(g_str_hash, g_str_equal),
+    };
+
+    gboolean ok = TRUE;
+    while (ok && (skip_space(&parser), *parser.p))
+        ok = parse_struct(&parser, error);
+    if (ok && template->structs->len == 0)
+    {
+        g_set_error(error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT, "The template defines no structs");
+        ok = FALSE;
+    }
+    ok = ok && resolve(&parser, error);
+    if (ok)
+    {
+        guint8 *state = g_malloc0(template->structs->len);
+        for (guint s = 0; ok && s < template->structs->len; ++s)
+            if (state[s] == 0)
+                ok = measure(template, s, state, error);
+        g_free(state);
+    }
+    g_hash_table_unref(parser.names);
+
+    if (!ok)
+    {
+        ghexedit_template_unref(template);
+        return NULL;
+    }
+    return template;
+}
+
+GHexEditTemplate *ghexedit_template_ref(GHexEditTemplate *template)
+{
+    g_atomic_int_inc(&template->ref_count);
+    return template;
+}
+
+void ghexedit_template_unref(GHexEditTemplate *template)
+{
+    if (template == NULL || !g_atomic_int_dec_and_test(&template->ref_count))
+        return;
+    g_ptr_array_unref(template->structs);
+    g_free(template);
+}
+
+guint ghexedit_template_get_n_structs(GHexEditTemplate *template)
+{
+    return template->structs->len;
+}
+
+/** Struct `index`; 0 is the root, laid over the start of the file. */
+GHexEditTemplateStruct const *ghexedit_template_get_struct(GHexEditTemplate *template, guint index)
+{
+    g_return_val_if_fail(index < template->structs->len, NULL);
+    return g_ptr_array_index(template->structs, index);
+}
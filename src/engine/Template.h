@@ -0,0 +1,71 @@
+/**
+ * Template.h - Declarative binary templates.
+ * Copyright (C) 2022 Trevor Last
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _GHX_TEMPLATE_H
+#define _GHX_TEMPLATE_H
+
+#include <glib.h>
+
+
+/** What a field holds. */
+typedef enum
+{
+    GHEXEDIT_FIELD_INT,
+    GHEXEDIT_FIELD_FLOAT,
+    GHEXEDIT_FIELD_CHAR,
+    GHEXEDIT_FIELD_STRUCT,
+} GHexEditFieldKind;
+
+/** One field of a struct, possibly an array. */
+typedef struct
+{
+    char *name;
+    /** As written in the template, such as `u32be` or a struct's name. */
+    char *type_name;
+    GHexEditFieldKind kind;
+    /** Bytes per element, for scalars. */
+    guint width;
+    gboolean is_signed;
+    gboolean big_endian;
+    /** Index of the element struct, for GHEXEDIT_FIELD_STRUCT. */
+    guint struct_index;
+    gboolean is_array;
+    /** Element count, unless `count_field` is set. */
+    guint64 count;
+    /** Index of an earlier integer field of the same struct holding the element count, or -1. */
+    gint count_field;
+} GHexEditTemplateField;
+
+/** A named sequence of fields. */
+typedef struct
+{
+    char *name;
+    GArray *fields;
+    /** Bytes per instance if every instance is the same size, else -1. */
+    gint64 size;
+} GHexEditTemplateStruct;
+
+typedef struct _GHexEditTemplate GHexEditTemplate;
+
+GHexEditTemplate *ghexedit_template_new(char const *text, GError **error);
+GHexEditTemplate *ghexedit_template_ref(GHexEditTemplate *template);
+void ghexedit_template_unref(GHexEditTemplate *template);
+guint ghexedit_template_get_n_structs(GHexEditTemplate *template);
+GHexEditTemplateStruct const *ghexedit_template_get_struct(GHexEditTemplate *template, guint index);
+
+#endif
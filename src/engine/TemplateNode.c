@@ -0,0 +1,659 @@
+/**
+ * TemplateNode.c - A template laid over a buffer, evaluated lazily.
+ * Copyright (C) 2022 Trevor Last
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "TemplateNode.h"
+#include "Inspect.h"
+
+#include <gio/gio.h>
+
+#include <string.h>
+
+
+/** Most characters of a char array shown as its value. */
+#define STRING_PREVIEW 64
+
+typedef enum
+{
+    NODE_STRUCT,
+    NODE_ARRAY,
+    NODE_VALUE,
+} GHexEditTemplateNodeKind;
+
+/** What every node of a tree shares. */
+typedef struct
+{
+    GHexEditTemplate *template;
+    GHexEditBuffer *buffer;
+    /** Size of the buffer when the tree was made. */
+    guint64 limit;
+} Context;
+
+/**
+ * A struct, an array or a scalar value, and the list model of its children.
+ *
+ * Nothing is read until asked for: a struct works out its field offsets one
+ * by one as far as needed, an array of fixed-size elements computes where
+ * each one starts, and an array of variable-size elements remembers the
+ * starts it has walked past so binary search finds any of them again. Only
+ * nodes that are opened, scrolled to or highlighted are ever evaluated, and
+ * child structs and arrays are kept so the work is done once.
+ */
+struct _GHexEditTemplateNode
+{
+    GObject parent;
+    Context ctx;
+    GHexEditTemplateNodeKind kind;
+    /** The field this is, or is an element of; NULL for the root. */
+    GHexEditTemplateField const *field;
+    /** The struct laid out here, or of the elements; NULL for scalars. */
+    GHexEditTemplateStruct const *type;
+    char *name;
+    char *type_name;
+    guint64 offset;
+    /** Elements, for arrays. */
+    guint64 count;
+    guint depth;
+    /** Index of the field within its struct. */
+    guint color;
+    /** An element of an array, rather than the field itself. */
+    gboolean element;
+    /** Bytes covered, or -1 until measured. */
+    gint64 size;
+    // Struct layout: offsets[0..laid_out) are known, with counts and integer values of those fields
+    guint laid_out;
+    guint64 *offsets;
+    guint64 *counts;
+    guint64 *values;
+    /** Starts of variable-size elements walked so far. */
+    GArray *starts;
+    /** An element was empty, so every later one starts at the same place. */
+    gboolean stalled;
+    /** Struct and array children handed out, by index. */
+    GHashTable *children;
+};
+
+static void ghexedit_template_node_list_model_init(GListModelInterface *iface);
+
+G_DEFINE_TYPE_WITH_CODE(GHexEditTemplateNode, ghexedit_template_node, G_TYPE_OBJECT,
+    G_IMPLEMENT_INTERFACE(G_TYPE_LIST_MODEL, ghexedit_template_node_list_model_init))
+
+
+/* ===[ Evaluation ]=== */
+/** Unsigned integer of `width` bytes at `offset`; 0 past the end. */
+static guint64 read_uint(Context const *ctx, guint64 offset, guint width, gboolean big_endian)
+{
+    guint8 data[8];
+    if (offset >= ctx->limit || ghexedit_buffer_read(ctx->buffer, offset, data, width, NULL) != (gssize)width)
+        return 0;
+    guint64 value = 0;
+    for (guint i = 0; i < width; ++i)
+        value = value << 8 | data[big_endian ? i : width - 1 - i];
+    return value;
+}
+
+/** Bytes per element of `field`, or -1 if they vary. */
+static gint64 element_size(Context const *ctx, GHexEditTemplateField const *field)
+{
+    if (field->kind != GHEXEDIT_FIELD_STRUCT)
+        return field->width;
+    return ghexedit_template_get_struct(ctx->template, field->struct_index)->size;
+}
+
+/**
+ * Elements of `field` at `pos`, given the integer fields before it. However
+ * large a count the data claims, no more elements than bytes left are used.
+ */
+static guint64 field_count(Context const *ctx, GHexEditTemplateField const *field, guint64 const *values, guint64 pos)
+{
+    if (!field->is_array)
+        return 1;
+    guint64 count = field->count_field >= 0 ? values[field->count_field] : field->count;
+    guint64 left = ctx->limit > pos ? ctx->limit - pos : 0;
+    gint64 element = element_size(ctx, field);
+    if (element > 0)
+        count = MIN(count, left / element + (left % element != 0));
+    else if (element < 0)
+        count = MIN(count, left);
+    return MIN(count, G_MAXUINT);
+}
+
+static guint64 measure_struct(Context const *ctx, GHexEditTemplateStruct const *type, guint64 offset, guint depth);
+
+/** Bytes taken by `count` elements of `field` at `pos`, in a struct at `depth`. */
+static guint64 measure_field(Context const *ctx, GHexEditTemplateField const *field, guint64 pos, guint64 count, guint depth)
+{
+    gint64 element = element_size(ctx, field);
+    if (element >= 0)
+        return element * count;
+    GHexEditTemplateStruct const *type = ghexedit_template_get_struct(ctx->template, field->struct_index);
+    guint64 p = pos;
+    for (guint64 k = 0; k < count; ++k)
+    {
+        guint64 size = measure_struct(ctx, type, p, depth + 1);
+        // Same place, same data: the rest would be empty too
+        if (size == 0)
+            break;
+        p += size;
+    }
+    return p - pos;
+}
+
+/** Bytes taken by an instance of `type` at `offset`, at `depth`. */
+static guint64 measure_struct(Context const *ctx, GHexEditTemplateStruct const *type, guint64 offset, guint depth)
+{
+    if (type->size >= 0)
+        return type->size;
+    if (depth >= GHEXEDIT_TEMPLATE_MAX_DEPTH)
+        return 0;
+    guint n = type->fields->len;
+    guint64 stack[32];
+    guint64 *values = n <= G_N_ELEMENTS(stack) ? stack : g_new(guint64, n);
+    guint64 pos = offset;
+    for (guint i = 0; i < n; ++i)
+    {
+        GHexEditTemplateField const *field = &g_array_index(type->fields, GHexEditTemplateField, i);
+        guint64 count = field_count(ctx, field, values, pos);
+        if (field->kind == GHEXEDIT_FIELD_INT && !field->is_array)
+            values[i] = read_uint(ctx, pos, field->width, field->big_endian);
+        pos += measure_field(ctx, field, pos, count, depth);
+    }
+    if (values != stack)
+        g_free(values);
+    return pos - offset;
+}
+
+static gboolean query_struct(Context const *ctx, GHexEditTemplateStruct const *type, guint64 offset, guint depth,
+    guint64 start, guint64 end, GHexEditTemplateFunc func, gpointer user_data, guint64 *size);
+
+/**
+ * Report the scalars of `count` instances of `type` at `pos` that overlap
+ * [start, end), setting their `size`. TRUE if it stopped at `end` instead,
+ * in which case `size` isn't known.
+ */
+static gboolean query_elements(Context const *ctx, GHexEditTemplateStruct const *type, guint64 pos, guint64 count, guint depth,
+    guint64 start, guint64 end, GHexEditTemplateFunc func, gpointer user_data, guint64 *size)
+{
+    guint64 k = 0;
+    guint64 p = pos;
+    if (depth >= GHEXEDIT_TEMPLATE_MAX_DEPTH)
+        count = 0;
+    else if (type->size > 0 && start > pos)
+    {
+        // Skip straight to the first element that can overlap
+        k = MIN((start - pos) / type->size, count);
+        p = pos + k * type->size;
+    }
+    for (; k < count; ++k)
+    {
+        guint64 element;
+        if (p >= end || query_struct(ctx, type, p, depth, start, end, func, user_data, &element))
+            return TRUE;
+        if (element == 0)
+            break;
+        p += element;
+    }
+    *size = type->size >= 0 ? type->size * count : p - pos;
+    return FALSE;
+}
+
+/** Report the scalars of an instance of `type` at `offset`, as query_elements(). */
+static gboolean query_struct(Context const *ctx, GHexEditTemplateStruct const *type, guint64 offset, guint depth,
+    guint64 start, guint64 end, GHexEditTemplateFunc func, gpointer user_data, guint64 *size)
+{
+    guint n = type->fields->len;
+    guint64 stack[32];
+    guint64 *values = n <= G_N_ELEMENTS(stack) ? stack : g_new(guint64, n);
+    guint64 pos = offset;
+    gboolean stopped = FALSE;
+    for (guint i = 0; i < n && !stopped; ++i)
+    {
+        GHexEditTemplateField const *field = &g_array_index(type->fields, GHexEditTemplateField, i);
+        guint64 count = field_count(ctx, field, values, pos);
+        if (field->kind == GHEXEDIT_FIELD_INT && !field->is_array)
+            values[i] = read_uint(ctx, pos, field->width, field->big_endian);
+        if (pos >= end)
+            stopped = TRUE;
+        else if (field->kind == GHEXEDIT_FIELD_STRUCT)
+        {
+            guint64 taken;
+            stopped = query_elements(ctx, ghexedit_template_get_struct(ctx->template, field->struct_index), pos, count, depth + 1, start, end, func, user_data, &taken);
+            pos += taken;
+        }
+        else
+        {
+            guint64 taken = field->width * count;
+            if (taken && pos + taken > start)
+                func(pos, taken, i, user_data);
+            pos += taken;
+        }
+    }
+    if (values != stack)
+        g_free(values);
+    *size = pos - offset;
+    return stopped;
+}
+
+
+/* ===[ Layout ]=== */
+static GHexEditTemplateNode *node_new(GHexEditTemplateNode *parent, GHexEditTemplateNodeKind kind, GHexEditTemplateField const *field, char *name, guint64 offset, guint64 count, guint color)
+{
+    GHexEditTemplateNode *node = g_object_new(GHEXEDIT_TYPE_TEMPLATE_NODE, NULL);
+    node->ctx.template = ghexedit_template_ref(parent->ctx.template);
+    node->ctx.buffer = g_object_ref(parent->ctx.buffer);
+    node->ctx.limit = parent->ctx.limit;
+    node->kind = kind;
+    node->field = field;
+    node->type = field->kind == GHEXEDIT_FIELD_STRUCT ? ghexedit_template_get_struct(node->ctx.template, field->struct_index) : NULL;
+    node->name = name;
+    node->offset = offset;
+    node->count = count;
+    node->depth = parent->depth + (parent->kind == NODE_STRUCT);
+    node->color = color;
+    if (kind == NODE_STRUCT)
+        node->type_name = g_strdup(node->type->name);
+    else if (kind == NODE_ARRAY || (field->is_array && field->kind == GHEXEDIT_FIELD_CHAR && parent->kind == NODE_STRUCT))
+        node->type_name = g_strdup_printf("%s[%" G_GUINT64_FORMAT "]", field->type_name, count);
+    else
+        node->type_name = g_strdup(field->type_name);
+    return node;
+}
+
+/** Record where field `k` of a struct node starts, reading what later fields depend on. */
+static void place(GHexEditTemplateNode *node, guint k, guint64 pos)
+{
+    node->offsets[k] = pos;
+    if (k == node->type->fields->len)
+        return;
+    GHexEditTemplateField const *field = &g_array_index(node->type->fields, GHexEditTemplateField, k);
+    node->counts[k] = field_count(&node->ctx, field, node->values, pos);
+    if (field->kind == GHEXEDIT_FIELD_INT && !field->is_array)
+        node->values[k] = read_uint(&node->ctx, pos, field->width, field->big_endian);
+}
+
+/** Work out field offsets of a struct node up to `index`, which may be one past the last field. */
+static void lay_out(GHexEditTemplateNode *node, guint index)
+{
+    guint n = node->type->fields->len;
+    if (node->offsets == NULL)
+    {
+        node->offsets = g_new(guint64, n + 1);
+        node->counts = g_new0(guint64, n);
+        node->values = g_new0(guint64, n);
+        place(node, 0, node->offset);
+        node->laid_out = 1;
+    }
+    while (node->laid_out <= index)
+    {
+        guint k = node->laid_out - 1;
+        GHexEditTemplateNode *child = g_hash_table_lookup(node->children, GUINT_TO_POINTER(k));
+        GHexEditTemplateField const *field = &g_array_index(node->type->fields, GHexEditTemplateField, k);
+        guint64 size = child
+            ? ghexedit_template_node_get_size(child)
+            : measure_field(&node->ctx, field, node->offsets[k], node->counts[k], node->depth);
+        place(node, k + 1, node->offsets[k] + size);
+        ++node->laid_out;
+    }
+}
+
+/** Where element `k` of an array node starts; `count` gives the end. */
+static guint64 element_start(GHexEditTemplateNode *node, guint64 k)
+{
+    gint64 size = element_size(&node->ctx, node->field);
+    if (size >= 0)
+        return node->offset + k * size;
+    if (node->starts == NULL)
+    {
+        node->starts = g_array_new(FALSE, FALSE, sizeof(guint64));
+        g_array_append_val(node->starts, node->offset);
+    }
+    while (node->starts->len <= k)
+    {
+        guint64 last = g_array_index(node->starts, guint64, node->starts->len - 1);
+        guint64 next = node->stalled ? 0 : measure_struct(&node->ctx, node->type, last, node->depth);
+        if (next == 0)
+        {
+            node->stalled = TRUE;
+            return last;
+        }
+        next += last;
+        g_array_append_val(node->starts, next);
+    }
+    return g_array_index(node->starts, guint64, k);
+}
+
+/** The last element of an array node starting at or before `offset`. */
+static guint64 find_element(GHexEditTemplateNode *node, guint64 offset)
+{
+    gint64 size = element_size(&node->ctx, node->field);
+    if (size >= 0)
+        return size > 0 && offset > node->offset ? MIN((offset - node->offset) / size, node->count) : 0;
+
+    // Walk past `offset` once; from then on it's a binary search over the starts seen
+    element_start(node, 0);
+    while (!node->stalled && node->starts->len <= node->count && g_array_index(node->starts, guint64, node->starts->len - 1) <= offset)
+        element_start(node, node->starts->len);
+    guint64 lo = 0;
+    guint64 hi = MIN(node->starts->len, node->count);
+    while (hi - lo > 1)
+    {
+        guint64 mid = lo + (hi - lo) / 2;
+        if (g_array_index(node->starts, guint64, mid) <= offset)
+            lo = mid;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+/** Child `index` of a struct node. */
+static GHexEditTemplateNode *struct_child(GHexEditTemplateNode *node, guint index)
+{
+    GHexEditTemplateNode *child = g_hash_table_lookup(node->children, GUINT_TO_POINTER(index));
+    if (child)
+        return g_object_ref(child);
+    lay_out(node, index);
+    GHexEditTemplateField const *field = &g_array_index(node->type->fields, GHexEditTemplateField, index);
+    GHexEditTemplateNodeKind kind = NODE_VALUE;
+    if (field->is_array && field->kind != GHEXEDIT_FIELD_CHAR)
+        kind = NODE_ARRAY;
+    else if (field->kind == GHEXEDIT_FIELD_STRUCT)
+        kind = NODE_STRUCT;
+    child = node_new(node, kind, field, g_strdup(field->name), node->offsets[index], node->counts[index], index);
+    if (kind != NODE_VALUE)
+        g_hash_table_insert(node->children, GUINT_TO_POINTER(index), g_object_ref(child));
+    return child;
+}
+
+/** Element `k` of an array node. */
+static GHexEditTemplateNode *array_child(GHexEditTemplateNode *node, guint64 k)
+{
+    GHexEditTemplateNode *child = node_new(node, node->type ? NODE_STRUCT : NODE_VALUE, node->field,
+        g_strdup_printf("[%" G_GUINT64_FORMAT "]", k), element_start(node, k), 1, node->color);
+    child->element = TRUE;
+    return child;
+}
+
+/** Report scalars in [start, end); TRUE if it stopped at `end`, as query_elements(). */
+static gboolean node_query(GHexEditTemplateNode *node, guint64 start, guint64 end, GHexEditTemplateFunc func, gpointer user_data)
+{
+    if (node->offset >= end)
+        return TRUE;
+    if (node->type == NULL)
+    {
+        guint64 size = ghexedit_template_node_get_size(node);
+        if (size && node->offset + size > start)
+            func(node->offset, size, node->color, user_data);
+        return FALSE;
+    }
+    if (node->depth >= GHEXEDIT_TEMPLATE_MAX_DEPTH)
+        return FALSE;
+
+    if (node->kind == NODE_STRUCT)
+    {
+        guint n = node->type->fields->len;
+        for (guint i = 0; i < n; ++i)
+        {
+            lay_out(node, i);
+            if (node->offsets[i] >= end)
+                return TRUE;
+            GHexEditTemplateField const *field = &g_array_index(node->type->fields, GHexEditTemplateField, i);
+            if (field->kind == GHEXEDIT_FIELD_STRUCT)
+            {
+                GHexEditTemplateNode *child = struct_child(node, i);
+                gboolean stopped = node_query(child, start, end, func, user_data);
+                g_object_unref(child);
+                if (stopped)
+                    return TRUE;
+            }
+            else
+            {
+                guint64 size = field->width * node->counts[i];
+                if (size && node->offsets[i] + size > start)
+                    func(node->offsets[i], size, i, user_data);
+            }
+        }
+        return FALSE;
+    }
+
+    // Elements are laid out afresh; only where they start is kept
+    for (guint64 k = find_element(node, start); k < node->count; ++k)
+    {
+        guint64 p = element_start(node, k);
+        guint64 size;
+        if (p >= end || query_struct(&node->ctx, node->type, p, node->depth, start, end, func, user_data, &size))
+            return TRUE;
+        // Having measured the element anyway, note where the next one starts
+        if (node->starts && node->starts->len == k + 1 && size > 0)
+        {
+            p += size;
+            g_array_append_val(node->starts, p);
+        }
+    }
+    return FALSE;
+}
+
+
+/* ===[ GHexEditTemplateNode ]=== */
+char const *ghexedit_template_node_get_name(GHexEditTemplateNode *node)
+{
+    return node->name;
+}
+
+/** The type as written in the template, with the element count of arrays. */
+char const *ghexedit_template_node_get_type_name(GHexEditTemplateNode *node)
+{
+    return node->type_name;
+}
+
+guint64 ghexedit_template_node_get_offset(GHexEditTemplateNode *node)
+{
+    return node->offset;
+}
+
+/** Bytes covered, measuring variable-size contents the first time. */
+guint64 ghexedit_template_node_get_size(GHexEditTemplateNode *node)
+{
+    if (node->size >= 0)
+        return node->size;
+    if (node->kind == NODE_VALUE)
+        node->size = node->field->width * node->count;
+    else if (node->kind == NODE_ARRAY)
+        node->size = element_start(node, node->count) - node->offset;
+    else if (node->type->size >= 0)
+        node->size = node->type->size;
+    else if (node->depth >= GHEXEDIT_TEMPLATE_MAX_DEPTH)
+        node->size = 0;
+    else
+    {
+        lay_out(node, node->type->fields->len);
+        node->size = node->offsets[node->type->fields->len] - node->offset;
+    }
+    return node->size;
+}
+
+gboolean ghexedit_template_node_has_children(GHexEditTemplateNode *node)
+{
+    return g_list_model_get_n_items(G_LIST_MODEL(node)) > 0;
+}
+
+/** The value of a scalar or char array, as a new string; NULL for anything else or past the end. */
+char *ghexedit_template_node_format_value(GHexEditTemplateNode *node)
+{
+    static GHexEditInspectKind const int_kinds[2][4] = {
+        {GHEXEDIT_INSPECT_UINT8, GHEXEDIT_INSPECT_UINT16, GHEXEDIT_INSPECT_UINT32, GHEXEDIT_INSPECT_UINT64},
+        {GHEXEDIT_INSPECT_INT8, GHEXEDIT_INSPECT_INT16, GHEXEDIT_INSPECT_INT32, GHEXEDIT_INSPECT_INT64},
+    };
+    if (node->kind != NODE_VALUE)
+        return NULL;
+    GHexEditTemplateField const *field = node->field;
+    guint8 data[STRING_PREVIEW];
+    gsize wanted = field->kind == GHEXEDIT_FIELD_CHAR ? MIN(node->count, STRING_PREVIEW) : field->width;
+    gssize length = node->offset < node->ctx.limit ? ghexedit_buffer_read(node->ctx.buffer, node->offset, data, wanted, NULL) : -1;
+    if (length <= 0)
+        return NULL;
+
+    switch (field->kind)
+    {
+    case GHEXEDIT_FIELD_INT:
+        return ghexedit_inspect_format(int_kinds[field->is_signed][g_bit_nth_lsf(field->width, -1)], data, length, field->big_endian);
+    case GHEXEDIT_FIELD_FLOAT:
+        return ghexedit_inspect_format(field->width == 4 ? GHEXEDIT_INSPECT_FLOAT32 : GHEXEDIT_INSPECT_FLOAT64, data, length, field->big_endian);
+    case GHEXEDIT_FIELD_CHAR:
+    {
+        // C-style: up to the first NUL, escaping the rest
+        char quote = field->is_array && !node->element ? '"' : '\'';
+        GString *text = g_string_new(NULL);
+        g_string_append_c(text, quote);
+        gssize i;
+        for (i = 0; i < length && data[i]; ++i)
+        {
+            if (data[i] == quote || data[i] == '\\')
+                g_string_append_printf(text, "\\%c", data[i]);
+            else if (g_ascii_isprint(data[i]))
+                g_string_append_c(text, data[i]);
+            else
+                g_string_append_printf(text, "\\x%02x", data[i]);
+        }
+        g_string_append_c(text, quote);
+        if (i == length && (guint64)length < node->count)
+            g_string_append(text, "…");
+        return g_string_free(text, FALSE);
+    }
+    default:
+        return NULL;
+    }
+}
+
+/**
+ * Call `func` with every scalar overlapping [start, end), in order. Fields
+ * before `start` are skipped by offset and evaluation stops at `end`, so
+ * the cost depends on the range rather than the number of records.
+ */
+void ghexedit_template_node_query(GHexEditTemplateNode *node, guint64 start, guint64 end, GHexEditTemplateFunc func, gpointer user_data)
+{
+    if (start < end)
+        node_query(node, start, end, func, user_data);
+}
+
+
+/* ===[ GListModel ]=== */
+static GType get_item_type(GListModel *model)
+{
+    return GHEXEDIT_TYPE_TEMPLATE_NODE;
+}
+
+static guint get_n_items(GListModel *model)
+{
+    GHexEditTemplateNode *node = GHEXEDIT_TEMPLATE_NODE(model);
+    if (node->depth >= GHEXEDIT_TEMPLATE_MAX_DEPTH)
+        return 0;
+    switch (node->kind)
+    {
+    case NODE_STRUCT:
+        return node->type->fields->len;
+    case NODE_ARRAY:
+        return node->count;
+    default:
+        return 0;
+    }
+}
+
+static gpointer get_item(GListModel *model, guint position)
+{
+    GHexEditTemplateNode *node = GHEXEDIT_TEMPLATE_NODE(model);
+    if (position >= get_n_items(model))
+        return NULL;
+    return node->kind == NODE_STRUCT ? struct_child(node, position) : array_child(node, position);
+}
+
+static void ghexedit_template_node_list_model_init(GListModelInterface *iface)
+{
+    iface->get_item_type = get_item_type;
+    iface->get_n_items = get_n_items;
+    iface->get_item = get_item;
+}
+
+
+/* ===[ GObject ]=== */
+/**
+ * The root of `template` laid over the start of `buffer`. The tree is a
+ * snapshot: make a new one when the buffer changes.
+ */
+GHexEditTemplateNode *ghexedit_template_node_new(GHexEditTemplate *template, GHexEditBuffer *buffer)
+{
+    GHexEditTemplateNode *node = g_object_new(GHEXEDIT_TYPE_TEMPLATE_NODE, NULL);
+    node->ctx.template = ghexedit_template_ref(template);
+    node->ctx.buffer = g_object_ref(buffer);
+    node->ctx.limit = ghexedit_buffer_get_size(buffer);
+    node->kind = NODE_STRUCT;
+    node->type = ghexedit_template_get_struct(template, 0);
+    node->name = g_strdup(node->type->name);
+    node->type_name = g_strdup(node->type->name);
+    node->count = 1;
+    return node;
+}
+
+/**
+ * Drop held references.
+ * Can be executed more than once!
+ * Should chain up before returning.
+ */
+void ghexedit_template_node_dispose(GObject *object)
+{
+    GHexEditTemplateNode *node = GHEXEDIT_TEMPLATE_NODE(object);
+    g_hash_table_remove_all(node->children);
+    G_OBJECT_CLASS(ghexedit_template_node_parent_class)->dispose(object);
+}
+
+/** Free held memory. */
+void ghexedit_template_node_finalize(GObject *object)
+{
+    GHexEditTemplateNode *node = GHEXEDIT_TEMPLATE_NODE(object);
+    g_hash_table_unref(node->children);
+    g_clear_object(&node->ctx.buffer);
+    // The template owns the struct and field pointers, so it goes last
+    g_free(node->name);
+    g_free(node->type_name);
+    g_free(node->offsets);
+    g_free(node->counts);
+    g_free(node->values);
+    if (node->starts)
+        g_array_unref(node->starts);
+    ghexedit_template_unref(node->ctx.template);
+    G_OBJECT_CLASS(ghexedit_template_node_parent_class)->finalize(object);
+}
+
+
+/* ===[ Base GLib ]=== */
+/** Equivalent to C++ constructor. */
+void ghexedit_template_node_init(GHexEditTemplateNode *node)
+{
+    node->size = -1;
+    node->children = g_hash_table_new_full(NULL, NULL, NULL, g_object_unref);
+}
+
+/**
+ * Called upon first instantiation of an object of this class.
+ * Sets/overrides class methods/signals/properties.
+ */
+void ghexedit_template_node_class_init(GHexEditTemplateNodeClass *class)
+{
+    GObjectClass *klass = G_OBJECT_CLASS(class);
+    klass->dispose = ghexedit_template_node_dispose;
+    klass->finalize = ghexedit_template_node_finalize;
+}
@@ -0,0 +1,46 @@
+/**
+ * TemplateNode.h - A template laid over a buffer, evaluated lazily.
+ * Copyright (C) 2022 Trevor Last
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _GHX_TEMPLATE_NODE_H
+#define _GHX_TEMPLATE_NODE_H
+
+#include <gio/gio.h>
+
+#include "Buffer.h"
+#include "Template.h"
+
+
+/** Deepest nesting of structs that is evaluated. */
+#define GHEXEDIT_TEMPLATE_MAX_DEPTH 32
+
+/** Called with each scalar field in a range; `color` numbers it within its struct. */
+typedef void (*GHexEditTemplateFunc)(guint64 offset, guint64 size, guint color, gpointer user_data);
+
+#define GHEXEDIT_TYPE_TEMPLATE_NODE ghexedit_template_node_get_type()
+G_DECLARE_FINAL_TYPE(GHexEditTemplateNode, ghexedit_template_node, GHEXEDIT, TEMPLATE_NODE, GObject);
+
+GHexEditTemplateNode *ghexedit_template_node_new(GHexEditTemplate *template, GHexEditBuffer *buffer);
+char const *ghexedit_template_node_get_name(GHexEditTemplateNode *node);
+char const *ghexedit_template_node_get_type_name(GHexEditTemplateNode *node);
+guint64 ghexedit_template_node_get_offset(GHexEditTemplateNode *node);
+guint64 ghexedit_template_node_get_size(GHexEditTemplateNode *node);
+gboolean ghexedit_template_node_has_children(GHexEditTemplateNode *node);
+char *ghexedit_template_node_format_value(GHexEditTemplateNode *node);
+void ghexedit_template_node_query(GHexEditTemplateNode *node, guint64 start, guint64 end, GHexEditTemplateFunc func, gpointer user_data);
+
+#endif
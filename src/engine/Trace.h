@@ -0,0 +1,52 @@
+/**
+ * Trace.h - Spans around hot paths, recorded as sysprof marks.
+ * Copyright (C) 2022 Trevor Last
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _GHX_TRACE_H
+#define _GHX_TRACE_H
+
+#include <glib.h>
+
+
+/*
+ * Configure with -DGHX_ENABLE_TRACING=ON and run under sysprof to see these
+ * as marks next to its perf samples; otherwise they compile to nothing, and
+ * their messages aren't even evaluated. Spans are named by identifier so
+ * that each start has a variable its end can find:
+ *
+ *     GHEXEDIT_TRACE_BEGIN(format);
+ *     ...
+ *     GHEXEDIT_TRACE_END(format, "%" G_GSIZE_FORMAT " bytes", length);
+ */
+#ifdef GHX_ENABLE_TRACING
+
+#include <sysprof-capture.h>
+
+/** Start timing a span; end it in the same block. */
+#define GHEXEDIT_TRACE_BEGIN(span) gint64 ghx_trace_##span = SYSPROF_CAPTURE_CURRENT_TIME
+/** Record the span begun as `span`, with a printf-style message. */
+#define GHEXEDIT_TRACE_END(span, ...) \
+    sysprof_collector_mark_printf(ghx_trace_##span, SYSPROF_CAPTURE_CURRENT_TIME - ghx_trace_##span, "ghexedit", #span, __VA_ARGS__)
+
+#else
+
+#define GHEXEDIT_TRACE_BEGIN(span) do {} while (0)
+#define GHEXEDIT_TRACE_END(span, ...) do {} while (0)
+
+#endif
+
+#endif
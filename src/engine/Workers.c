@@ -0,0 +1,149 @@
+/**
+ * Workers.c - Workers.c - The engine's shared worker pool.
+ * Copyright (C) 2022 Trevor Last
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "Workers.h"
+
+
+/** One worker's share of an object's jobs. */
+typedef struct
+{
+    GHexEditWorkFunc work;
+    gpointer object;
+} Task;
+
+
+/* ===[ Pool ]=== */
+/** GThreadPool function: work a task, then let go of its object. */
+static void run_task(gpointer data, gpointer user_data)
+{
+    Task *task = data;
+    task->work(task->object);
+    g_object_unref(task->object);
+    g_free(task);
+}
+
+/**
+ * The pool every search, comparison, checksum and analysis shares, one
+ * thread per processor, so running several at once never oversubscribes.
+ */
+static GThreadPool *get_pool(void)
+{
+    static GThreadPool *pool = NULL;
+    if (g_once_init_enter(&pool))
+        g_once_init_leave(&pool, g_thread_pool_new(run_task, NULL, g_get_num_processors(), FALSE, NULL));
+    return pool;
+}
+
+/** How many workers to start for `jobs` jobs: one per processor at most, and at least one. */
+guint ghexedit_workers_wanted(guint jobs)
+{
+    return MIN((guint)g_get_num_processors(), MAX(jobs, 1));
+}
+
+/**
+ * Run `work` on `workers` pool threads, each holding a reference to
+ * `object`. Workers claim jobs themselves, so set up whatever they share,
+ * including the count of active ones, before calling.
+ */
+void ghexedit_workers_start(gpointer object, GHexEditWorkFunc work, guint workers)
+{
+    for (guint i = 0; i < workers; ++i)
+    {
+        Task *task = g_new(Task, 1);
+        task->work = work;
+        task->object = g_object_ref(object);
+        g_thread_pool_push(get_pool(), task, NULL);
+    }
+}
+
+
+/* ===[ Draining ]=== */
+/** Main loop: let the owner publish whatever arrived since last time. */
+static gboolean run_drain(gpointer user_data)
+{
+    GHexEditDrain *drain = user_data;
+    g_mutex_lock(drain->lock);
+    drain->pending = FALSE;
+    g_mutex_unlock(drain->lock);
+    drain->func(drain->object);
+    return G_SOURCE_REMOVE;
+}
+
+/** Drop the reference taken by ghexedit_drain_schedule. */
+static void release_drain(gpointer user_data)
+{
+    GHexEditDrain *drain = user_data;
+    g_object_unref(drain->object);
+}
+
+/**
+ * Prepare to hand `n_slots` results of `object` to the calling thread's main
+ * context, where `func` publishes them. `drain` lives inside `object`.
+ */
+void ghexedit_drain_init(GHexEditDrain *drain, gpointer object, GHexEditDrainFunc func, GMutex *lock, guint n_slots)
+{
+    drain->object = object;
+    drain->func = func;
+    drain->lock = lock;
+    drain->context = g_main_context_ref_thread_default();
+    drain->slots = g_new0(gpointer, n_slots);
+    drain->n_slots = n_slots;
+    drain->published = 0;
+    drain->pending = FALSE;
+}
+
+/** Free results that were never published. Every worker has stopped. */
+void ghexedit_drain_clear(GHexEditDrain *drain, GDestroyNotify free_result)
+{
+    for (guint i = 0; i < drain->n_slots; ++i)
+        if (drain->slots[i] && free_result)
+            free_result(drain->slots[i]);
+    g_clear_pointer(&drain->slots, g_free);
+    drain->n_slots = 0;
+    g_clear_pointer(&drain->context, g_main_context_unref);
+}
+
+/** Have the main loop drain soon, unless it is about to already. */
+void ghexedit_drain_schedule(GHexEditDrain *drain)
+{
+    if (drain->pending)
+        return;
+    drain->pending = TRUE;
+    // The object owns the drain, so its reference keeps both alive
+    g_object_ref(drain->object);
+    g_main_context_invoke_full(drain->context, G_PRIORITY_DEFAULT, run_drain, drain, release_drain);
+}
+
+/** Hand over the result of job `slot` and have it published. */
+void ghexedit_drain_put(GHexEditDrain *drain, guint slot, gpointer result)
+{
+    g_return_if_fail(slot < drain->n_slots && drain->slots[slot] == NULL);
+    drain->slots[slot] = result;
+    ghexedit_drain_schedule(drain);
+}
+
+/**
+ * Take the next result in slot order, or NULL if it hasn't been put yet or
+ * all have been taken. Only the drain function should call this.
+ */
+gpointer ghexedit_drain_next(GHexEditDrain *drain)
+{
+    if (drain->published >= drain->n_slots || drain->slots[drain->published] == NULL)
+        return NULL;
+    return g_steal_pointer(&drain->slots[drain->published++]);
+}
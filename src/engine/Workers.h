@@ -0,0 +1,58 @@
+/**
+ * Workers.h - Workers.h - The engine's shared worker pool.
+ * Copyright (C) 2022 Trevor Last
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _GHX_WORKERS_H
+#define _GHX_WORKERS_H
+
+#include <glib-object.h>
+
+
+/** Work on `object` until its jobs run out. Runs on a pool thread. */
+typedef void (*GHexEditWorkFunc)(gpointer object);
+/** Publish what workers handed over for `object`. Runs on its main context. */
+typedef void (*GHexEditDrainFunc)(gpointer object);
+
+/**
+ * Results handed from workers to the main context. Workers put each job's
+ * result into its slot; ghexedit_drain_next then gives them back strictly in
+ * slot order, however the jobs finished. Every call but ghexedit_drain_init
+ * and ghexedit_drain_clear needs the lock passed to ghexedit_drain_init.
+ */
+typedef struct
+{
+    gpointer object;
+    GHexEditDrainFunc func;
+    GMutex *lock;
+    GMainContext *context;
+    gpointer *slots;
+    guint n_slots;
+    /** Slots already given back by ghexedit_drain_next. */
+    guint published;
+    gboolean pending;
+} GHexEditDrain;
+
+guint ghexedit_workers_wanted(guint jobs);
+void ghexedit_workers_start(gpointer object, GHexEditWorkFunc work, guint workers);
+
+void ghexedit_drain_init(GHexEditDrain *drain, gpointer object, GHexEditDrainFunc func, GMutex *lock, guint n_slots);
+void ghexedit_drain_clear(GHexEditDrain *drain, GDestroyNotify free_result);
+void ghexedit_drain_schedule(GHexEditDrain *drain);
+void ghexedit_drain_put(GHexEditDrain *drain, guint slot, gpointer result);
+gpointer ghexedit_drain_next(GHexEditDrain *drain);
+
+#endif
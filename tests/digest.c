@@ -0,0 +1,202 @@
+/**
+ * digest.c - Check the digests against published vectors and one sequential pass.
+ * Copyright (C) 2022 Trevor Last
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "engine/Digest.h"
+
+#include <glib.h>
+
+#include <string.h>
+
+
+/** Longest BLAKE3 test vector input. */
+#define MAX_INPUT 102400
+
+
+/** The official BLAKE3 vectors: the first 32 bytes of the hash of `length` bytes i % 251. */
+static struct
+{
+    gsize length;
+    char const *hash;
+} const blake3_vectors[] = {
+    {0, "af1349b9f5f9a1a6a0404dea36dcc9499bcb25c9adc112b7cc9a93cae41f3262"},
+    {1, "2d3adedff11b61f14c886e35afa036736dcd87a74d27b5c1510225d0f592e213"},
+    {1023, "10108970eeda3eb932baac1428c7a2163b0e924c9a9e25b35bba72b28f70bd11"},
+    {1024, "42214739f095a406f3fc83deb889744ac00df831c10daa55189b5d121c855af7"},
+    {1025, "d00278ae47eb27b34faecf67b4fe263f82d5412916c1ffd97c8cb7fb814b8444"},
+    {2048, "e776b6028c7cd22a4d0ba182a8bf62205d2ef576467e838ed6f2529b85fba24a"},
+    {2049, "5f4d72f40d7a5f82b15ca2b2e44b1de3c2ef86c426c95c1af0b6879522563030"},
+    {3072, "b98cb0ff3623be03326b373de6b9095218513e64f1ee2edd2525c7ad1e5cffd2"},
+    {3073, "7124b49501012f81cc7f11ca069ec9226cecb8a2c850cfe644e327d22d3e1cd3"},
+    {4096, "015094013f57a5277b59d8475c0501042c0b642e531b0a1c8f58d2163229e969"},
+    {4097, "9b4052b38f1c5fc8b1f9ff7ac7b27cd242487b3d890d15c96a1c25b8aa0fb995"},
+    {5120, "9cadc15fed8b5d854562b26a9536d9707cadeda9b143978f319ab34230535833"},
+    {5121, "628bd2cb2004694adaab7bbd778a25df25c47b9d4155a55f8fbd79f2fe154cff"},
+    {6144, "3e2e5b74e048f3add6d21faab3f83aa44d3b2278afb83b80b3c35164ebeca205"},
+    {6145, "f1323a8631446cc50536a9f705ee5cb619424d46887f3c376c695b70e0f0507f"},
+    {7168, "61da957ec2499a95d6b8023e2b0e604ec7f6b50e80a9678b89d2628e99ada77a"},
+    {7169, "a003fc7a51754a9b3c7fae0367ab3d782dccf28855a03d435f8cfe74605e7817"},
+    {8192, "aae792484c8efe4f19e2ca7d371d8c467ffb10748d8a5a1ae579948f718a2a63"},
+    {8193, "bab6c09cb8ce8cf459261398d2e7aef35700bf488116ceb94a36d0f5f1b7bc3b"},
+    {16384, "f875d6646de28985646f34ee13be9a576fd515f76b5b0a26bb324735041ddde4"},
+    {31744, "62b6960e1a44bcc1eb1a611a8d6235b6b4b78f32e7abc4fb4c6cdcce94895c47"},
+    {102400, "bc3e3d41a1146b069abffad3c0d44860cf664390afce4d9661f7902e7943e085"},
+};
+
+
+/* ===[ Helpers ]=== */
+/** The vectors' input: byte i is i % 251. */
+static guint8 *make_input(gsize length)
+{
+    guint8 *data = g_malloc(MAX(length, 1));
+    for (gsize i = 0; i < length; ++i)
+        data[i] = i % 251;
+    return data;
+}
+
+/** Finish `hasher` and compare with `expected` in hex. */
+static void check_hash(GHexEditBlake3 const *hasher, char const *expected)
+{
+    guint8 out[GHEXEDIT_BLAKE3_OUT_LEN];
+    ghexedit_blake3_finish(hasher, out);
+    char hex[2 * GHEXEDIT_BLAKE3_OUT_LEN + 1];
+    for (gsize i = 0; i < sizeof(out); ++i)
+        g_snprintf(hex + 2 * i, 3, "%02x", out[i]);
+    g_assert_cmpstr(hex, ==, expected);
+}
+
+/** BLAKE3 of `length` bytes in one pass, as hex. */
+static char *blake3_hex(guint8 const *data, gsize length)
+{
+    GHexEditBlake3 hasher;
+    ghexedit_blake3_init(&hasher);
+    ghexedit_blake3_update(&hasher, data, length);
+    guint8 out[GHEXEDIT_BLAKE3_OUT_LEN];
+    ghexedit_blake3_finish(&hasher, out);
+    GString *hex = g_string_new(NULL);
+    for (gsize i = 0; i < sizeof(out); ++i)
+        g_string_append_printf(hex, "%02x", out[i]);
+    return g_string_free(hex, FALSE);
+}
+
+
+/* ===[ Tests ]=== */
+/** Every vector, hashed whole and fed in awkward pieces. */
+static void test_blake3_vectors(void)
+{
+    static gsize const pieces[] = {1, 63, 64, 65, 1023, 1024, 1025, 4096};
+    guint8 *data = make_input(MAX_INPUT);
+    for (gsize v = 0; v < G_N_ELEMENTS(blake3_vectors); ++v)
+    {
+        gsize length = blake3_vectors[v].length;
+        GHexEditBlake3 hasher;
+        ghexedit_blake3_init(&hasher);
+        ghexedit_blake3_update(&hasher, data, length);
+        check_hash(&hasher, blake3_vectors[v].hash);
+
+        for (gsize p = 0; p < G_N_ELEMENTS(pieces); ++p)
+        {
+            ghexedit_blake3_init(&hasher);
+            for (gsize at = 0; at < length; at += pieces[p])
+                ghexedit_blake3_update(&hasher, data + at, MIN(pieces[p], length - at));
+            check_hash(&hasher, blake3_vectors[v].hash);
+        }
+    }
+    g_free(data);
+}
+
+/**
+ * Subtrees hashed on their own and pushed in order, then a tail, as
+ * Checksum joins segments, must match hashing everything in one pass.
+ */
+static void test_blake3_subtrees(void)
+{
+    static gsize const tails[] = {1, 1023, 1024, 1025, 5000};
+    guint8 *data = make_input(MAX_INPUT);
+    for (guint64 subtree_chunks = 1; subtree_chunks <= 16; subtree_chunks *= 2)
+        for (gsize n_subtrees = 1; n_subtrees <= 5; ++n_subtrees)
+            for (gsize t = 0; t < G_N_ELEMENTS(tails); ++t)
+            {
+                gsize subtree = subtree_chunks * GHEXEDIT_BLAKE3_CHUNK_LEN;
+                gsize length = n_subtrees * subtree + tails[t];
+                g_assert_cmpuint(length, <=, MAX_INPUT);
+
+                GHexEditBlake3 hasher;
+                ghexedit_blake3_init(&hasher);
+                for (gsize i = 0; i < n_subtrees; ++i)
+                {
+                    guint32 cv[8];
+                    ghexedit_blake3_subtree(data + i * subtree, subtree, i * subtree_chunks, cv);
+                    ghexedit_blake3_push_subtree(&hasher, cv, subtree_chunks);
+                }
+                ghexedit_blake3_update(&hasher, data + n_subtrees * subtree, tails[t]);
+                char *expected = blake3_hex(data, length);
+                check_hash(&hasher, expected);
+                g_free(expected);
+            }
+    g_free(data);
+}
+
+/** Published check values, so the sequential pass the joins are checked against is right too. */
+static void test_checksum_values(void)
+{
+    guint8 const *digits = (guint8 const *)"123456789";
+    g_assert_cmphex(ghexedit_crc32_update(0, digits, 9), ==, 0xcbf43926);
+    g_assert_cmphex(ghexedit_adler32_update(1, (guint8 const *)"Wikipedia", 9), ==, 0x11e60398);
+    g_assert_cmphex(ghexedit_crc32_update(0, NULL, 0), ==, 0);
+    g_assert_cmphex(ghexedit_adler32_update(1, NULL, 0), ==, 1);
+}
+
+/** Joining the digests of two parts must match one pass over both, wherever the split. */
+static void test_combine(void)
+{
+    static gsize const lengths[] = {0, 1, 2, 3, 15, 16, 17, 255, 256, 5551, 5552, 5553, 65536, 100000};
+    guint8 *data = g_malloc(MAX_INPUT);
+    // Something less regular than the vectors' input, with runs of 0xff for Adler-32's modulus
+    guint32 state = 2463534242u;
+    for (gsize i = 0; i < MAX_INPUT; ++i)
+    {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        data[i] = i % 7000 < 3000 ? 0xff : state;
+    }
+    for (gsize a = 0; a < G_N_ELEMENTS(lengths); ++a)
+        for (gsize b = 0; b < G_N_ELEMENTS(lengths); ++b)
+        {
+            gsize first = lengths[a], second = lengths[b];
+            if (first + second > MAX_INPUT)
+                continue;
+            guint8 const *rest = data + first;
+            guint32 crc = ghexedit_crc32_combine(ghexedit_crc32_update(0, data, first), ghexedit_crc32_update(0, rest, second), second);
+            g_assert_cmphex(crc, ==, ghexedit_crc32_update(0, data, first + second));
+            guint32 adler = ghexedit_adler32_combine(ghexedit_adler32_update(1, data, first), ghexedit_adler32_update(1, rest, second), second);
+            g_assert_cmphex(adler, ==, ghexedit_adler32_update(1, data, first + second));
+        }
+    g_free(data);
+}
+
+
+int main(int argc, char *argv[])
+{
+    g_test_init(&argc, &argv, NULL);
+    g_test_add_func("/digest/blake3-vectors", test_blake3_vectors);
+    g_test_add_func("/digest/blake3-subtrees", test_blake3_subtrees);
+    g_test_add_func("/digest/checksum-values", test_checksum_values);
+    g_test_add_func("/digest/combine", test_combine);
+    return g_test_run();
+}
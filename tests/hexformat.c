@@ -0,0 +1,181 @@
+/**
+ * hexformat.c - Check every hex formatting kernel against the scalar reference.
+ * Copyright (C) 2022 Trevor Last
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "engine/HexFormat.h"
+
+#include <glib.h>
+
+#include <string.h>
+
+
+/** Widest row checked; covers several whole vectors plus every tail. */
+#define MAX_BYTES_PER_LINE 64
+/** Bytes formatted per throughput measurement. */
+#define THROUGHPUT_BYTES (16 * 1024 * 1024)
+/** Canary bytes kept past the output, which no kernel may touch. */
+#define GUARD 64
+
+
+/* ===[ Helpers ]=== */
+static guint32 xorshift(guint32 *state)
+{
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return *state;
+}
+
+/**
+ * Format `length` bytes of `data` with `kernel` and with the scalar
+ * reference, and check the two agree byte for byte. The data ends exactly
+ * at the end of its allocation, so a kernel reading past it shows up under
+ * a memory checker.
+ */
+static void check_equal(GHexEditHexKernel kernel, GHexEditHexFormat const *format, guint8 const *data, gsize length, guint64 base)
+{
+    gsize size = ghexedit_hex_format_max_length(format, length);
+    char *expected = g_malloc(size + GUARD);
+    char *got = g_malloc(size + GUARD);
+    memset(expected, 0x5A, size + GUARD);
+    memset(got, 0x5A, size + GUARD);
+
+    gsize expected_length = ghexedit_hex_format_with(GHEXEDIT_HEX_KERNEL_SCALAR, format, data, length, base, expected);
+    gsize got_length = ghexedit_hex_format_with(kernel, format, data, length, base, got);
+    if (got_length != expected_length || memcmp(got, expected, expected_length) != 0)
+        g_test_fail_printf("%s differs at %u bytes per line, grouping %u, %u offset digits, %" G_GSIZE_FORMAT " bytes from %" G_GUINT64_FORMAT,
+            ghexedit_hex_kernel_get_name(kernel), format->bytes_per_line, format->grouping, format->offset_digits, length, base);
+    for (gsize i = size; i < size + GUARD; ++i)
+        if (got[i] != 0x5A)
+        {
+            g_test_fail_printf("%s wrote past its output at %u bytes per line, grouping %u, %" G_GSIZE_FORMAT " bytes",
+                ghexedit_hex_kernel_get_name(kernel), format->bytes_per_line, format->grouping, length);
+            break;
+        }
+
+    g_free(got);
+    g_free(expected);
+}
+
+
+/* ===[ Tests ]=== */
+/**
+ * Every row width up to MAX_BYTES_PER_LINE with every grouping, over
+ * lengths that end mid-row, from unaligned addresses.
+ */
+static void test_layouts(gconstpointer user_data)
+{
+    GHexEditHexKernel kernel = GPOINTER_TO_UINT(user_data);
+    if (!ghexedit_hex_kernel_is_supported(kernel))
+    {
+        g_test_skip("Not supported by this CPU");
+        return;
+    }
+    guint32 state = 2463534242u;
+    for (guint bpl = 1; bpl <= MAX_BYTES_PER_LINE && !g_test_failed(); ++bpl)
+        for (guint grouping = 1; grouping <= bpl + 1 && !g_test_failed(); ++grouping)
+        {
+            // Two full rows, then a partial one, ending at each alignment
+            gsize length = 2 * bpl + xorshift(&state) % bpl;
+            guint misalign = xorshift(&state) % 32;
+            guint8 *block = g_malloc(misalign + length);
+            guint8 *data = block + misalign;
+            for (gsize i = 0; i < length; ++i)
+                data[i] = xorshift(&state);
+
+            for (guint digits = 8; digits <= 16; digits += 8)
+            {
+                GHexEditHexFormat format = {bpl, grouping, digits};
+                check_equal(kernel, &format, data, length, xorshift(&state));
+                // Every short tail of a single row
+                for (gsize tail = 0; tail <= bpl && tail <= length; ++tail)
+                    check_equal(kernel, &format, data + length - tail, tail, 0);
+            }
+            g_free(block);
+        }
+}
+
+/** Large random buffers, every byte value included, at the common layouts. */
+static void test_random(gconstpointer user_data)
+{
+    GHexEditHexKernel kernel = GPOINTER_TO_UINT(user_data);
+    if (!ghexedit_hex_kernel_is_supported(kernel))
+    {
+        g_test_skip("Not supported by this CPU");
+        return;
+    }
+    static guint const layouts[][2] = {{8, 4}, {16, 8}, {16, 1}, {32, 8}, {64, 16}};
+    guint32 state = 88675123u;
+    for (guint round = 0; round < 64; ++round)
+    {
+        gsize length = 1 + xorshift(&state) % 65536;
+        guint8 *data = g_malloc(length);
+        for (gsize i = 0; i < length; ++i)
+            data[i] = round == 0 ? (guint8)i : xorshift(&state);
+        for (guint l = 0; l < G_N_ELEMENTS(layouts); ++l)
+        {
+            GHexEditHexFormat format = {layouts[l][0], layouts[l][1], ghexedit_hex_format_offset_digits(length)};
+            check_equal(kernel, &format, data, length, 0);
+        }
+        g_free(data);
+    }
+}
+
+/** Not a check: report each kernel's formatting throughput. */
+static void test_throughput(void)
+{
+    guint8 *data = g_malloc(THROUGHPUT_BYTES);
+    guint32 state = 521288629u;
+    for (gsize i = 0; i < THROUGHPUT_BYTES; ++i)
+        data[i] = xorshift(&state);
+    GHexEditHexFormat format = {16, 8, ghexedit_hex_format_offset_digits(THROUGHPUT_BYTES)};
+    char *out = g_malloc(ghexedit_hex_format_max_length(&format, THROUGHPUT_BYTES));
+
+    for (GHexEditHexKernel kernel = 0; kernel < GHEXEDIT_N_HEX_KERNELS; ++kernel)
+    {
+        if (!ghexedit_hex_kernel_is_supported(kernel))
+            continue;
+        // Once to fault the output in, once timed
+        ghexedit_hex_format_with(kernel, &format, data, THROUGHPUT_BYTES, 0, out);
+        gint64 start = g_get_monotonic_time();
+        ghexedit_hex_format_with(kernel, &format, data, THROUGHPUT_BYTES, 0, out);
+        gint64 elapsed = g_get_monotonic_time() - start;
+        double seconds = MAX(elapsed, 1) / 1e6;
+        g_test_message("%s: %.2f GB/s", ghexedit_hex_kernel_get_name(kernel), THROUGHPUT_BYTES / seconds / 1e9);
+    }
+
+    g_free(out);
+    g_free(data);
+}
+
+
+/* ===[ Main ]=== */
+int main(int argc, char *argv[])
+{
+    g_test_init(&argc, &argv, NULL);
+    for (GHexEditHexKernel kernel = GHEXEDIT_HEX_KERNEL_SSE2; kernel < GHEXEDIT_N_HEX_KERNELS; ++kernel)
+    {
+        char *path = g_strdup_printf("/hexformat/%s/layouts", ghexedit_hex_kernel_get_name(kernel));
+        g_test_add_data_func(path, GUINT_TO_POINTER(kernel), test_layouts);
+        g_free(path);
+        path = g_strdup_printf("/hexformat/%s/random", ghexedit_hex_kernel_get_name(kernel));
+        g_test_add_data_func(path, GUINT_TO_POINTER(kernel), test_random);
+        g_free(path);
+    }
+    g_test_add_func("/hexformat/throughput", test_throughput);
+    return g_test_run();
+}
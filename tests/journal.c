@@ -0,0 +1,273 @@
+/**
+ * journal.c - Check undo and redo restore every state of a piece table.
+ * Copyright (C) 2022 Trevor Last
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "engine/Journal.h"
+
+#include <glib.h>
+
+#include <string.h>
+
+
+/** Length of the original document. */
+#define ORIGINAL_LENGTH 4096
+/** Edits made per run. */
+#define EDITS 300
+/** Most bytes a random edit touches. */
+#define MAX_EDIT 512
+
+
+/** A piece table and its history, edited the way Buffer does. */
+typedef struct
+{
+    guint8 original[ORIGINAL_LENGTH];
+    GHexEditAddBuffer *add;
+    GHexEditPieceTable *table;
+    GHexEditJournal *journal;
+    /** What the table should read as now. */
+    GByteArray *model;
+} Fixture;
+
+
+/* ===[ Helpers ]=== */
+static guint32 xorshift(guint32 *state)
+{
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return *state;
+}
+
+static void fixture_setup(Fixture *fixture, gconstpointer user_data)
+{
+    guint32 state = 88675123u;
+    for (gsize i = 0; i < ORIGINAL_LENGTH; ++i)
+        fixture->original[i] = xorshift(&state);
+    fixture->add = ghexedit_add_buffer_new();
+    fixture->table = ghexedit_piece_table_new(ORIGINAL_LENGTH);
+    fixture->journal = ghexedit_journal_new(fixture->add);
+    fixture->model = g_byte_array_new();
+    g_byte_array_append(fixture->model, fixture->original, ORIGINAL_LENGTH);
+}
+
+static void fixture_teardown(Fixture *fixture, gconstpointer user_data)
+{
+    g_byte_array_unref(fixture->model);
+    ghexedit_journal_free(fixture->journal);
+    ghexedit_piece_table_free(fixture->table);
+    ghexedit_add_buffer_free(fixture->add);
+}
+
+/** Replace `length` bytes at `offset` with `data`, recording the edit. */
+static void edit(Fixture *fixture, guint64 offset, guint64 length, guint8 const *data, gsize data_length)
+{
+    GArray *removed = g_array_new(FALSE, FALSE, sizeof(GHexEditPiece));
+    ghexedit_piece_table_remove(fixture->table, offset, length, removed);
+    if (data_length > 0)
+    {
+        GHexEditPiece piece = {GHEXEDIT_PIECE_ADD, ghexedit_add_buffer_append(fixture->add, data, data_length), data_length};
+        ghexedit_piece_table_insert(fixture->table, offset, &piece, 1);
+    }
+    ghexedit_journal_record(fixture->journal, fixture->table, offset, removed, data_length);
+
+    g_byte_array_remove_range(fixture->model, offset, length);
+    g_byte_array_insert(fixture->model, offset, data, data_length);
+}
+
+/** A random edit: an insert, a delete or an overwrite, up to `max` bytes. */
+static void random_edit(Fixture *fixture, guint32 *state, guint max)
+{
+    guint8 data[MAX_EDIT];
+    g_assert_cmpuint(max, <=, MAX_EDIT);
+    guint64 size = fixture->model->len;
+    guint64 offset = xorshift(state) % (size + 1);
+    guint64 length = 0;
+    gsize data_length = 0;
+    switch (xorshift(state) % 3)
+    {
+    case 0:
+        data_length = 1 + xorshift(state) % max;
+        break;
+    case 1:
+        length = 1 + xorshift(state) % max;
+        length = MIN(length, size - offset);
+        break;
+    case 2:
+        length = 1 + xorshift(state) % max;
+        data_length = length = MIN(length, size - offset);
+        break;
+    }
+    for (gsize i = 0; i < data_length; ++i)
+        data[i] = xorshift(state);
+    edit(fixture, offset, length, data, data_length);
+}
+
+typedef struct
+{
+    Fixture *fixture;
+    GByteArray *out;
+} ReadClosure;
+
+static gboolean read_piece(GHexEditPiece const *piece, guint64 offset, gpointer user_data)
+{
+    ReadClosure *closure = user_data;
+    guint old = closure->out->len;
+    g_byte_array_set_size(closure->out, old + piece->length);
+    if (piece->source == GHEXEDIT_PIECE_ADD)
+        ghexedit_add_buffer_copy(closure->fixture->add, piece->start, closure->out->data + old, piece->length);
+    else
+    {
+        g_assert_cmpuint(piece->start + piece->length, <=, ORIGINAL_LENGTH);
+        memcpy(closure->out->data + old, closure->fixture->original + piece->start, piece->length);
+    }
+    return TRUE;
+}
+
+/** The table reads as `expected`. */
+static void assert_contents(Fixture *fixture, GByteArray *expected)
+{
+    ReadClosure closure = {fixture, g_byte_array_new()};
+    ghexedit_piece_table_foreach(fixture->table, 0, G_MAXUINT64, read_piece, &closure);
+    g_assert_cmpmem(closure.out->data, closure.out->len, expected->data, expected->len);
+    g_byte_array_unref(closure.out);
+}
+
+static GByteArray *copy_model(Fixture *fixture)
+{
+    GByteArray *copy = g_byte_array_sized_new(fixture->model->len);
+    g_byte_array_append(copy, fixture->model->data, fixture->model->len);
+    return copy;
+}
+
+/**
+ * Make EDITS random edits of up to `max` bytes, then check undo steps back
+ * through every state, and redo forward through them again.
+ */
+static void check_history(Fixture *fixture, guint max)
+{
+    guint32 state = 2463534242u;
+    GPtrArray *states = g_ptr_array_new_with_free_func((GDestroyNotify)g_byte_array_unref);
+    g_ptr_array_add(states, copy_model(fixture));
+    for (guint e = 0; e < EDITS; ++e)
+    {
+        random_edit(fixture, &state, max);
+        ghexedit_journal_seal(fixture->journal);
+        g_ptr_array_add(states, copy_model(fixture));
+        assert_contents(fixture, fixture->model);
+    }
+
+    guint64 offset, removed, added;
+    for (guint e = EDITS; e > 0; --e)
+    {
+        g_assert_true(ghexedit_journal_undo(fixture->journal, fixture->table, &offset, &removed, &added));
+        assert_contents(fixture, g_ptr_array_index(states, e - 1));
+    }
+    g_assert_false(ghexedit_journal_can_undo(fixture->journal));
+    g_assert_cmpuint(ghexedit_journal_get_state(fixture->journal), ==, 0);
+
+    for (guint e = 1; e <= EDITS; ++e)
+    {
+        g_assert_true(ghexedit_journal_redo(fixture->journal, fixture->table, &offset, &removed, &added));
+        assert_contents(fixture, g_ptr_array_index(states, e));
+    }
+    g_assert_false(ghexedit_journal_can_redo(fixture->journal));
+
+    g_ptr_array_unref(states);
+}
+
+
+/* ===[ Tests ]=== */
+static void test_undo_redo(Fixture *fixture, gconstpointer user_data)
+{
+    check_history(fixture, 64);
+}
+
+/** Under a tiny limit history goes to disk, and comes back intact. */
+static void test_spill(Fixture *fixture, gconstpointer user_data)
+{
+    ghexedit_journal_set_limit(fixture->journal, 4096);
+    check_history(fixture, MAX_EDIT);
+}
+
+/** Keystrokes typed in a run undo together; a new edit drops the redo. */
+static void test_typing(Fixture *fixture, gconstpointer user_data)
+{
+    GByteArray *before = copy_model(fixture);
+    for (guint i = 0; i < 10; ++i)
+    {
+        guint8 byte = 'a' + i;
+        edit(fixture, 100 + i, 0, &byte, 1);
+    }
+    // Overwriting inside the run joins it too
+    guint8 byte = 'z';
+    edit(fixture, 103, 1, &byte, 1);
+
+    guint64 offset, removed, added;
+    g_assert_true(ghexedit_journal_undo(fixture->journal, fixture->table, &offset, &removed, &added));
+    g_assert_cmpuint(offset, ==, 100);
+    g_assert_cmpuint(removed, ==, 10);
+    g_assert_cmpuint(added, ==, 0);
+    g_assert_false(ghexedit_journal_can_undo(fixture->journal));
+    assert_contents(fixture, before);
+    g_byte_array_set_size(fixture->model, 0);
+    g_byte_array_append(fixture->model, before->data, before->len);
+
+    g_assert_true(ghexedit_journal_can_redo(fixture->journal));
+    edit(fixture, 0, 1, NULL, 0);
+    g_assert_false(ghexedit_journal_can_redo(fixture->journal));
+    g_byte_array_unref(before);
+}
+
+/**
+ * Original bytes overwritten by an in-place save come back from the copies
+ * handed to the journal.
+ */
+static void test_displace(Fixture *fixture, gconstpointer user_data)
+{
+    GByteArray *before = copy_model(fixture);
+    guint8 data[32];
+    memset(data, 0xEE, sizeof data);
+    edit(fixture, 200, sizeof data, data, sizeof data);
+    ghexedit_journal_seal(fixture->journal);
+
+    // Save in place: the file now holds the edit
+    ghexedit_journal_displace(fixture->journal, 200, fixture->original + 200, sizeof data);
+    // A later copy of the same bytes isn't the originals, and is ignored
+    ghexedit_journal_displace(fixture->journal, 200, data, sizeof data);
+    memcpy(fixture->original + 200, data, sizeof data);
+
+    guint64 offset, removed, added;
+    g_assert_true(ghexedit_journal_undo(fixture->journal, fixture->table, &offset, &removed, &added));
+    assert_contents(fixture, before);
+    g_assert_true(ghexedit_journal_redo(fixture->journal, fixture->table, &offset, &removed, &added));
+    assert_contents(fixture, fixture->model);
+    g_assert_true(ghexedit_journal_undo(fixture->journal, fixture->table, &offset, &removed, &added));
+    assert_contents(fixture, before);
+    g_byte_array_unref(before);
+}
+
+
+/* ===[ Main ]=== */
+int main(int argc, char *argv[])
+{
+    g_test_init(&argc, &argv, NULL);
+    g_test_add("/journal/undo-redo", Fixture, NULL, fixture_setup, test_undo_redo, fixture_teardown);
+    g_test_add("/journal/spill", Fixture, NULL, fixture_setup, test_spill, fixture_teardown);
+    g_test_add("/journal/typing", Fixture, NULL, fixture_setup, test_typing, fixture_teardown);
+    g_test_add("/journal/displace", Fixture, NULL, fixture_setup, test_displace, fixture_teardown);
+    return g_test_run();
+}
@@ -0,0 +1,207 @@
+/**
+ * piecetable.c - Check the piece table against a byte-by-byte model.
+ * Copyright (C) 2022 Trevor Last
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "engine/PieceTable.h"
+
+#include <glib.h>
+
+
+/** Edits made per run. */
+#define EDITS 2000
+
+/**
+ * Where each byte of the table comes from, one entry per byte: its source
+ * in the top bit and its start below. Slow, but obviously right.
+ */
+typedef GArray Model;
+
+#define ADD_BIT (G_GUINT64_CONSTANT(1) << 63)
+
+
+/* ===[ Helpers ]=== */
+static guint32 xorshift(guint32 *state)
+{
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return *state;
+}
+
+/** Append the bytes `pieces` cover to `out`, in model form. */
+static void expand(GArray *pieces, Model *out)
+{
+    for (guint i = 0; i < pieces->len; ++i)
+    {
+        GHexEditPiece const *piece = &g_array_index(pieces, GHexEditPiece, i);
+        guint64 tag = piece->source == GHEXEDIT_PIECE_ADD ? ADD_BIT : 0;
+        for (guint64 b = 0; b < piece->length; ++b)
+        {
+            guint64 byte = tag | (piece->start + b);
+            g_array_append_val(out, byte);
+        }
+    }
+}
+
+static void assert_model_slice(Model *model, guint64 offset, Model *got)
+{
+    g_assert_cmpuint(got->len, <=, model->len - offset);
+    for (guint i = 0; i < got->len; ++i)
+        g_assert_cmpuint(g_array_index(got, guint64, i), ==, g_array_index(model, guint64, offset + i));
+}
+
+/** The table holds exactly the model's bytes, with no two pieces left unfused. */
+static void assert_table(GHexEditPieceTable *table, Model *model)
+{
+    g_assert_cmpuint(ghexedit_piece_table_get_length(table), ==, model->len);
+
+    GArray *pieces = g_array_new(FALSE, FALSE, sizeof(GHexEditPiece));
+    ghexedit_piece_table_get_pieces(table, 0, G_MAXUINT64, pieces);
+    g_assert_cmpuint(pieces->len, ==, ghexedit_piece_table_get_n_pieces(table));
+    for (guint i = 1; i < pieces->len; ++i)
+    {
+        GHexEditPiece const *a = &g_array_index(pieces, GHexEditPiece, i - 1);
+        GHexEditPiece const *b = &g_array_index(pieces, GHexEditPiece, i);
+        g_assert_false(a->source == b->source && a->start + a->length == b->start);
+    }
+    Model *got = g_array_new(FALSE, FALSE, sizeof(guint64));
+    expand(pieces, got);
+    g_assert_cmpuint(got->len, ==, model->len);
+    assert_model_slice(model, 0, got);
+    g_array_unref(got);
+    g_array_unref(pieces);
+}
+
+
+/* ===[ Tests ]=== */
+/** A new table is one original piece, or none at all. */
+static void test_new(void)
+{
+    GHexEditPieceTable *table = ghexedit_piece_table_new(0);
+    g_assert_cmpuint(ghexedit_piece_table_get_length(table), ==, 0);
+    g_assert_cmpuint(ghexedit_piece_table_get_n_pieces(table), ==, 0);
+    ghexedit_piece_table_free(table);
+
+    table = ghexedit_piece_table_new(100);
+    g_assert_cmpuint(ghexedit_piece_table_get_length(table), ==, 100);
+    g_assert_cmpuint(ghexedit_piece_table_get_n_pieces(table), ==, 1);
+    ghexedit_piece_table_free(table);
+}
+
+/** Removing a range and putting it back joins the table up as it was. */
+static void test_split_join(void)
+{
+    GHexEditPieceTable *table = ghexedit_piece_table_new(1000);
+    GArray *removed = g_array_new(FALSE, FALSE, sizeof(GHexEditPiece));
+    for (guint64 offset = 0; offset <= 1000; offset += 125)
+        for (guint64 length = 0; offset + length <= 1000; length += 250)
+        {
+            g_array_set_size(removed, 0);
+            ghexedit_piece_table_remove(table, offset, length, removed);
+            g_assert_cmpuint(ghexedit_piece_table_get_length(table), ==, 1000 - length);
+            ghexedit_piece_table_insert(table, offset, (GHexEditPiece const *)removed->data, removed->len);
+            g_assert_cmpuint(ghexedit_piece_table_get_n_pieces(table), ==, 1);
+        }
+    g_array_unref(removed);
+    ghexedit_piece_table_free(table);
+}
+
+/** Random inserts, removes and moves, checked against the model after each. */
+static void test_random(void)
+{
+    guint32 state = 2463534242u;
+    guint64 const original = 4096;
+    guint64 next_add = 0;
+    GHexEditPieceTable *table = ghexedit_piece_table_new(original);
+    Model *model = g_array_new(FALSE, FALSE, sizeof(guint64));
+    for (guint64 b = 0; b < original; ++b)
+        g_array_append_val(model, b);
+    GArray *removed = g_array_new(FALSE, FALSE, sizeof(GHexEditPiece));
+    Model *slice = g_array_new(FALSE, FALSE, sizeof(guint64));
+
+    for (guint e = 0; e < EDITS; ++e)
+    {
+        guint64 offset = xorshift(&state) % (model->len + 1);
+        guint64 length = xorshift(&state) % 64;
+        length = MIN(length, model->len - offset);
+        g_array_set_size(removed, 0);
+        g_array_set_size(slice, 0);
+        switch (xorshift(&state) % 3)
+        {
+        case 0:
+        {
+            // New bytes, or original ones from elsewhere
+            GHexEditPiece piece = {GHEXEDIT_PIECE_ADD, next_add, 1 + xorshift(&state) % 32};
+            if (xorshift(&state) % 2)
+                piece = (GHexEditPiece){GHEXEDIT_PIECE_ORIGINAL, xorshift(&state) % original, 1 + xorshift(&state) % 32};
+            else
+                next_add += piece.length;
+            ghexedit_piece_table_insert(table, offset, &piece, 1);
+            g_array_append_val(removed, piece);
+            expand(removed, slice);
+            g_array_insert_vals(model, offset, slice->data, slice->len);
+            break;
+        }
+        case 1:
+            ghexedit_piece_table_remove(table, offset, length, removed);
+            expand(removed, slice);
+            g_assert_cmpuint(slice->len, ==, length);
+            assert_model_slice(model, offset, slice);
+            g_array_remove_range(model, offset, length);
+            break;
+        case 2:
+        {
+            // Cut a range and paste it somewhere else
+            ghexedit_piece_table_remove(table, offset, length, removed);
+            expand(removed, slice);
+            assert_model_slice(model, offset, slice);
+            g_array_remove_range(model, offset, length);
+            guint64 to = xorshift(&state) % (model->len + 1);
+            ghexedit_piece_table_insert(table, to, (GHexEditPiece const *)removed->data, removed->len);
+            g_array_insert_vals(model, to, slice->data, slice->len);
+            break;
+        }
+        }
+        assert_table(table, model);
+
+        // Any range reads back trimmed to itself
+        guint64 from = xorshift(&state) % (model->len + 1);
+        guint64 span = xorshift(&state) % 256;
+        g_array_set_size(removed, 0);
+        g_array_set_size(slice, 0);
+        ghexedit_piece_table_get_pieces(table, from, span, removed);
+        expand(removed, slice);
+        g_assert_cmpuint(slice->len, ==, MIN(span, model->len - from));
+        assert_model_slice(model, from, slice);
+    }
+
+    g_array_unref(slice);
+    g_array_unref(removed);
+    g_array_unref(model);
+    ghexedit_piece_table_free(table);
+}
+
+
+/* ===[ Main ]=== */
+int main(int argc, char *argv[])
+{
+    g_test_init(&argc, &argv, NULL);
+    g_test_add_func("/piecetable/new", test_new);
+    g_test_add_func("/piecetable/split-join", test_split_join);
+    g_test_add_func("/piecetable/random", test_random);
+    return g_test_run();
+}
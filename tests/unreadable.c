@@ -0,0 +1,187 @@
+/**
+ * unreadable.c - Check that background work skips bytes that can't be read.
+ * Copyright (C) 2022 Trevor Last
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "engine/Checksum.h"
+#include "engine/RangeSet.h"
+#include "engine/Search.h"
+
+#include <gio/gio.h>
+
+#include <string.h>
+
+
+/** Zeroes in a row searched for. */
+#define ZERO_RUN 64
+
+
+/* ===[ Helpers ]=== */
+/** Collect what a range set visits into an array of GHexEditRange; GHexEditRangeFunc. */
+static gboolean collect(guint64 start, guint64 end, gpointer user_data)
+{
+    GHexEditRange range = {start, end};
+    g_array_append_val(user_data, range);
+    return TRUE;
+}
+
+/** Check the gaps of `set` within [start, end) against `expected` pairs. */
+static void check_gaps(GHexEditRangeSet *set, guint64 start, guint64 end, guint64 const *expected, guint n_expected)
+{
+    GArray *gaps = g_array_new(FALSE, FALSE, sizeof(GHexEditRange));
+    g_assert_true(ghexedit_range_set_foreach_gap(set, start, end, collect, gaps));
+    g_assert_cmpuint(gaps->len, ==, n_expected);
+    for (guint i = 0; i < n_expected; ++i)
+    {
+        g_assert_cmpuint(g_array_index(gaps, GHexEditRange, i).start, ==, expected[2 * i]);
+        g_assert_cmpuint(g_array_index(gaps, GHexEditRange, i).end, ==, expected[2 * i + 1]);
+    }
+    g_array_unref(gaps);
+}
+
+/** This process's memory as a buffer, or NULL (the test skipped) where there is no /proc. */
+static GHexEditBuffer *open_self(void)
+{
+    GFile *file = g_file_new_for_path("/proc/self/mem");
+    GError *error = NULL;
+    GHexEditDocument *doc = ghexedit_document_new(file, &error);
+    g_object_unref(file);
+    if (doc == NULL)
+    {
+        g_test_skip(error->message);
+        g_error_free(error);
+        return NULL;
+    }
+    GHexEditBuffer *buffer = ghexedit_buffer_new(doc);
+    g_object_unref(doc);
+    return buffer;
+}
+
+/** Mapped ranges of this process, sorted, with neighbours joined. */
+static GArray *read_maps(void)
+{
+    char *contents = NULL;
+    g_assert_true(g_file_get_contents("/proc/self/maps", &contents, NULL, NULL));
+    GArray *regions = g_array_new(FALSE, FALSE, sizeof(GHexEditRange));
+    char **lines = g_strsplit(contents, "\n", -1);
+    for (char **line = lines; *line; ++line)
+    {
+        char *rest;
+        guint64 start = g_ascii_strtoull(*line, &rest, 16);
+        if (rest == *line || *rest != '-')
+            continue;
+        guint64 end = g_ascii_strtoull(rest + 1, NULL, 16);
+        GHexEditRange *last = regions->len ? &g_array_index(regions, GHexEditRange, regions->len - 1) : NULL;
+        if (last && last->end == start)
+            last->end = end;
+        else
+        {
+            GHexEditRange region = {start, end};
+            g_array_append_val(regions, region);
+        }
+    }
+    g_strfreev(lines);
+    g_free(contents);
+    return regions;
+}
+
+/** Whether `length` bytes at `offset` lie inside one mapped region. */
+static gboolean is_mapped(GArray *regions, guint64 offset, guint64 length)
+{
+    for (guint i = 0; i < regions->len; ++i)
+    {
+        GHexEditRange const *region = &g_array_index(regions, GHexEditRange, i);
+        if (region->start <= offset && offset + length <= region->end)
+            return TRUE;
+    }
+    return FALSE;
+}
+
+
+/* ===[ Tests ]=== */
+/** The stretches between ranges, clipped to the window. */
+static void test_gaps(void)
+{
+    GHexEditRangeSet *set = ghexedit_range_set_new();
+    check_gaps(set, 5, 9, (guint64[]){5, 9}, 1);
+    ghexedit_range_set_add(set, 10, 20);
+    ghexedit_range_set_add(set, 30, 40);
+    check_gaps(set, 0, 50, (guint64[]){0, 10, 20, 30, 40, 50}, 3);
+    check_gaps(set, 15, 35, (guint64[]){20, 30}, 1);
+    check_gaps(set, 10, 40, (guint64[]){20, 30}, 1);
+    check_gaps(set, 12, 18, NULL, 0);
+    check_gaps(set, 20, 30, (guint64[]){20, 30}, 1);
+    ghexedit_range_set_free(set);
+}
+
+/**
+ * Unmapped memory reads as zeroes, so a search for zeroes over this
+ * process's address space would start matching at address 0 if the gaps
+ * weren't skipped.
+ */
+static void test_search_skips_gaps(void)
+{
+    GHexEditBuffer *buffer = open_self();
+    if (buffer == NULL)
+        return;
+    guint8 zeroes[ZERO_RUN] = {0};
+    GHexEditSearch *search = ghexedit_search_new(buffer, ghexedit_pattern_new_bytes(zeroes, sizeof(zeroes)));
+    ghexedit_search_start(search, NULL);
+    while (!ghexedit_search_get_finished(search))
+        g_main_context_iteration(NULL, TRUE);
+
+    g_assert_null(ghexedit_search_get_error(search));
+    g_assert_cmpuint(ghexedit_search_get_n_matches(search), >, 0);
+    GArray *regions = read_maps();
+    for (guint i = 0; i < ghexedit_search_get_n_matches(search); ++i)
+    {
+        GHexEditMatch const *match = ghexedit_search_get_match(search, i);
+        if (!is_mapped(regions, match->offset, match->length))
+            g_error("match at 0x%" G_GINT64_MODIFIER "x is outside every mapping", match->offset);
+    }
+    g_array_unref(regions);
+    g_object_unref(search);
+    g_object_unref(buffer);
+}
+
+/** A digest over the gaps would be of zeroes that aren't there. */
+static void test_checksum_refuses_gaps(void)
+{
+    GHexEditBuffer *buffer = open_self();
+    if (buffer == NULL)
+        return;
+    GHexEditChecksum *checksum = ghexedit_checksum_new(buffer, 0, ghexedit_buffer_get_size(buffer), 1u << GHEXEDIT_CHECKSUM_CRC32);
+    ghexedit_checksum_start(checksum, NULL);
+    while (!ghexedit_checksum_get_finished(checksum))
+        g_main_context_iteration(NULL, TRUE);
+
+    GError const *error = ghexedit_checksum_get_error(checksum);
+    g_assert_nonnull(error);
+    g_assert_true(g_error_matches(error, G_IO_ERROR, G_IO_ERROR_FAILED));
+    g_assert_null(ghexedit_checksum_get_digest(checksum, GHEXEDIT_CHECKSUM_CRC32));
+    g_object_unref(checksum);
+    g_object_unref(buffer);
+}
+
+
+int main(int argc, char *argv[])
+{
+    g_test_init(&argc, &argv, NULL);
+    g_test_add_func("/unreadable/gaps", test_gaps);
+    g_test_add_func("/unreadable/search", test_search_skips_gaps);
+    g_test_add_func("/unreadable/checksum", test_checksum_refuses_gaps);
+    return g_test_run();
+}